@@ -0,0 +1,156 @@
+#pragma once
+#include "type.h"
+#include <new>
+#include <cstddef>
+#include <vector>
+
+namespace pnmatrix {
+class allocation_tracker;
+
+namespace detail {
+// innermost tracker of the calling thread, nullptr when nothing is tracked.
+inline thread_local allocation_tracker* current_allocation_tracker = nullptr;
+
+inline void note_allocation(std::size_t bytes);
+inline void note_deallocation(std::size_t bytes);
+}
+
+// counts the allocations made through the library allocators by the calling thread while it is alive.
+// trackers nest, an allocation is counted by every enclosing tracker. allocations of the worker
+// threads of an executor are not seen.
+class allocation_tracker {
+public:
+  allocation_tracker():parent_(detail::current_allocation_tracker), count_(0), bytes_(0), deallocation_count_(0), deallocated_bytes_(0) {
+    detail::current_allocation_tracker = this;
+  }
+
+  allocation_tracker(const allocation_tracker&) = delete;
+  allocation_tracker& operator=(const allocation_tracker&) = delete;
+
+  ~allocation_tracker() {
+    detail::current_allocation_tracker = parent_;
+  }
+
+  size_type get_count() const {
+    return count_;
+  }
+
+  size_type get_bytes() const {
+    return bytes_;
+  }
+
+  size_type get_deallocation_count() const {
+    return deallocation_count_;
+  }
+
+  size_type get_deallocated_bytes() const {
+    return deallocated_bytes_;
+  }
+
+  void reset() {
+    count_ = 0;
+    bytes_ = 0;
+    deallocation_count_ = 0;
+    deallocated_bytes_ = 0;
+  }
+
+private:
+  friend void detail::note_allocation(std::size_t bytes);
+  friend void detail::note_deallocation(std::size_t bytes);
+
+  allocation_tracker* parent_;
+  size_type count_;
+  size_type bytes_;
+  size_type deallocation_count_;
+  size_type deallocated_bytes_;
+};
+
+namespace detail {
+inline void note_allocation(std::size_t bytes) {
+  for (allocation_tracker* t = current_allocation_tracker; t != nullptr; t = t->parent_) {
+    ++t->count_;
+    t->bytes_ += bytes;
+  }
+}
+
+inline void note_deallocation(std::size_t bytes) {
+  for (allocation_tracker* t = current_allocation_tracker; t != nullptr; t = t->parent_) {
+    ++t->deallocation_count_;
+    t->deallocated_bytes_ += bytes;
+  }
+}
+}
+
+// the allocator of every library storage, reports to the allocation trackers of the calling thread.
+template <typename T>
+class tracked_allocator {
+public:
+  using value_type = T;
+
+  tracked_allocator() = default;
+
+  template <typename U>
+  tracked_allocator(const tracked_allocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    detail::note_allocation(n * sizeof(T));
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) {
+    detail::note_deallocation(n * sizeof(T));
+    ::operator delete(p);
+  }
+
+  template <typename U>
+  bool operator==(const tracked_allocator<U>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const tracked_allocator<U>&) const {
+    return false;
+  }
+};
+
+// the small containers of the solvers, their workspaces and per column state, so the trackers see them too.
+template <typename T>
+using tracked_vector = std::vector<T, tracked_allocator<T>>;
+
+// cache line aligned, used by the dense vectors and blocks of the solvers.
+template <typename T, std::size_t Alignment = 64>
+class aligned_allocator {
+public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = aligned_allocator<U, Alignment>;
+  };
+
+  aligned_allocator() = default;
+
+  template <typename U>
+  aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+  T* allocate(std::size_t n) {
+    detail::note_allocation(n * sizeof(T));
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T* p, std::size_t n) {
+    detail::note_deallocation(n * sizeof(T));
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  bool operator==(const aligned_allocator<U, Alignment>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const aligned_allocator<U, Alignment>&) const {
+    return false;
+  }
+};
+}
@@ -0,0 +1,397 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "dense_vector.h"
+#include "solve_control.h"
+#include "instrument.h"
+#include "matrix.h"
+#include "matrix_storage_cep.h"
+#include "sparse_matrix_multiply.h"
+#include "sparse_matrix_transpose.h"
+#include "sparse_lu.h"
+#include "jacobian_solver.h"
+#include "gauss_seidel_solver.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <cassert>
+#include <cmath>
+
+namespace pnmatrix {
+enum class amg_smoother {
+  gauss_seidel,
+  jacobian,
+};
+
+// smoothed aggregation algebraic multigrid. every level groups the strongly connected rows of its
+// matrix into aggregates, the tentative prolongation is the constant on each aggregate and is
+// smoothed by one damped jacobi step, the coarse matrix is R * A * P with R = P^T. the coarsest
+// level is solved by a complete lu.
+// apply() is one v-cycle from zero, usable as M in gmres::solve(..., M), solve() repeats v-cycles.
+// both use buffers owned by the hierarchy, one hierarchy must not be used by two threads at once.
+template <typename ValueType>
+class amg {
+public:
+  using value_type = ValueType;
+  using matrix_type = matrix<matrix_storage_cep<ValueType>>;
+
+  struct option {
+    // relative residual of solve().
+    double rm = 1e-6;
+    // v-cycles of solve(), 0 means no limit.
+    size_type max_iteration = 0;
+    // a_ij is strong when |a_ij| >= strength_threshold * sqrt(|a_ii * a_jj|).
+    double strength_threshold = 0.08;
+    size_type max_levels = 10;
+    // levels with at most this many rows are solved directly.
+    size_type coarse_size = 64;
+    amg_smoother smoother = amg_smoother::gauss_seidel;
+    size_type pre_sweeps = 1;
+    size_type post_sweeps = 1;
+    // weight of the jacobi smoother.
+    double jacobian_weight = 2.0 / 3.0;
+    // setup products.
+    size_type thread_count = 1;
+  };
+
+  explicit amg(const matrix_type& A):amg(A, option()) {
+
+  }
+
+  amg(const matrix_type& A, option op):op_(op) {
+    PNMATRIX_TIMED_SCOPE("amg.setup");
+    PNMATRIX_ALLOCATION_SCOPE("amg.setup");
+    assert(A.get_row() == A.get_column());
+    levels_.emplace_back(A);
+    // the near null space, the constant on the finest level.
+    std::vector<value_type> nullspace(A.get_row(), value_type(1));
+    while (true) {
+      level& fine = levels_.back();
+      size_type n = fine.A.get_row();
+      if (n <= op_.coarse_size || (size_type)levels_.size() == op_.max_levels) {
+        break;
+      }
+      std::vector<size_type> aggregate;
+      size_type count = aggregate_rows(fine.A, aggregate);
+      if (count == n) {
+        break;
+      }
+      prolongations_.push_back(smooth_prolongation(fine.A, aggregate, count, nullspace));
+      restrictions_.push_back(transpose(prolongations_.back(), op_.thread_count));
+      matrix_type coarse = galerkin_product(restrictions_.back(), fine.A, prolongations_.back(), op_.thread_count);
+      levels_.emplace_back(std::move(coarse));
+    }
+    if (op_.smoother == amg_smoother::jacobian) {
+      for (level& each : levels_) {
+        get_jacobian_smoother().prepare_sweep(each.A, each.jacobian_ws);
+      }
+    }
+    factorize_coarsest();
+  }
+
+  size_type get_level_count() const {
+    return levels_.size();
+  }
+
+  // rows of level l, 0 is A.
+  size_type get_level_size(size_type l) const {
+    return levels_[l].A.get_row();
+  }
+
+  // stored elements of all level matrices over the stored elements of A.
+  double get_operator_complexity() const {
+    double sum = 0;
+    for (const level& each : levels_) {
+      sum += each.A.get_element_count();
+    }
+    return sum / levels_[0].A.get_element_count();
+  }
+
+  // z = M^-1 * r by one v-cycle.
+  void apply(const value_type* r, value_type* z) const {
+    level& top = levels_[0];
+    std::copy(r, r + top.b.size(), top.b.data());
+    top.x.fill(value_type(0));
+    cycle(0);
+    std::copy(top.x.data(), top.x.data() + top.x.size(), z);
+  }
+
+  matrix_type solve(const matrix_type& b) {
+    solve_control control;
+    return solve(b, control);
+  }
+
+  matrix_type solve(const matrix_type& b, solve_control& control) {
+    assert(b.get_column() == 1);
+    dense_vector<value_type> x(get_level_size(0));
+    solve(to_dense_vector(b), x, control);
+    return to_matrix<matrix_type>(x);
+  }
+
+  // x is the initial guess on entry and the solution on return.
+  void solve(const dense_vector<value_type>& b, dense_vector<value_type>& x, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("amg.solve");
+    level& top = levels_[0];
+    assert(b.size() == top.A.get_row() && x.size() == top.A.get_row());
+    top.x = x;
+    detail::repeat_cycles(control, op_.rm, op_.max_iteration, b.get_second_norm(), top.x, [&]() {
+      matrix_vector_multiply(top.A, top.x, top.r);
+      top.r.scale(value_type(-1));
+      top.r.add_scaled(value_type(1), b);
+      return top.r.get_second_norm();
+    }, [&]() {
+      top.b = b;
+      cycle(0);
+    });
+    x = top.x;
+  }
+
+private:
+  struct level {
+    explicit level(matrix_type a):A(std::move(a)), x(A.get_row()), b(A.get_row()), r(A.get_row()) {
+
+    }
+
+    matrix_type A;
+    dense_vector<value_type> x;
+    dense_vector<value_type> b;
+    dense_vector<value_type> r;
+    jacobian::workspace<value_type> jacobian_ws;
+  };
+
+  option op_;
+  mutable std::vector<level> levels_;
+  // prolongations_[l] maps level l + 1 to level l, restrictions_[l] is its transpose.
+  std::vector<matrix_type> prolongations_;
+  std::vector<matrix_type> restrictions_;
+  detail::local_lu<value_type> coarse_lu_;
+
+  static value_type get_diagonal_value(const matrix_storage_cep<value_type>& c, size_type row) {
+    value_type d = value_type(0);
+    c.for_each_in_row(row, [&](size_type column, const value_type& v) {
+      if (column == row) {
+        d = v;
+      }
+    });
+    return d;
+  }
+
+  // three passes over the strength graph: whole neighbourhoods first, then the rows left over join
+  // an aggregate of a strong neighbour, then what is still left forms aggregates of its own.
+  // returns the number of aggregates, aggregate[i] is the one of row i + 1.
+  size_type aggregate_rows(const matrix_type& A, std::vector<size_type>& aggregate) const {
+    const auto& c = A.get_container();
+    size_type n = A.get_row();
+    std::vector<value_type> diag(n);
+    for (size_type row = 1; row <= n; ++row) {
+      diag[row - 1] = std::abs(get_diagonal_value(c, row));
+    }
+    std::vector<size_type> strong_begin(1, 0);
+    std::vector<size_type> strong;
+    value_type theta = value_type(op_.strength_threshold);
+    for (size_type row = 1; row <= n; ++row) {
+      c.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        if (column != row && std::abs(v) >= theta * std::sqrt(diag[row - 1] * diag[column - 1]) && value_equal(v, value_type(0)) == false) {
+          strong.push_back(column - 1);
+        }
+      });
+      strong_begin.push_back(strong.size());
+    }
+
+    aggregate.assign(n, -1);
+    size_type count = 0;
+    for (size_type i = 0; i < n; ++i) {
+      bool free = aggregate[i] < 0;
+      for (size_type p = strong_begin[i]; p < strong_begin[i + 1] && free == true; ++p) {
+        free = aggregate[strong[p]] < 0;
+      }
+      if (free == false) {
+        continue;
+      }
+      aggregate[i] = count;
+      for (size_type p = strong_begin[i]; p < strong_begin[i + 1]; ++p) {
+        aggregate[strong[p]] = count;
+      }
+      ++count;
+    }
+    std::vector<size_type> joined = aggregate;
+    for (size_type i = 0; i < n; ++i) {
+      if (aggregate[i] >= 0) {
+        continue;
+      }
+      for (size_type p = strong_begin[i]; p < strong_begin[i + 1]; ++p) {
+        if (aggregate[strong[p]] >= 0) {
+          joined[i] = aggregate[strong[p]];
+          break;
+        }
+      }
+    }
+    aggregate.swap(joined);
+    for (size_type i = 0; i < n; ++i) {
+      if (aggregate[i] >= 0) {
+        continue;
+      }
+      aggregate[i] = count;
+      for (size_type p = strong_begin[i]; p < strong_begin[i + 1]; ++p) {
+        if (aggregate[strong[p]] < 0) {
+          aggregate[strong[p]] = count;
+        }
+      }
+      ++count;
+    }
+    return count;
+  }
+
+  // P = (I - omega * D^-1 * A) * T with omega = 4 / 3 / rho(D^-1 * A), rho bounded by the largest
+  // absolute row sum of D^-1 * A. T is the near null space B cut into aggregates, each column
+  // normalized, so T^T * T = I and T * B_coarse = B. nullspace is replaced by B_coarse.
+  matrix_type smooth_prolongation(const matrix_type& A, const std::vector<size_type>& aggregate, size_type count, std::vector<value_type>& nullspace) const {
+    size_type n = A.get_row();
+    std::vector<value_type> aggregate_norm(count, value_type(0));
+    for (size_type i = 0; i < n; ++i) {
+      aggregate_norm[aggregate[i]] += nullspace[i] * nullspace[i];
+    }
+    for (value_type& each : aggregate_norm) {
+      each = std::sqrt(each);
+    }
+    std::vector<value_type> tentative(n);
+    for (size_type i = 0; i < n; ++i) {
+      value_type norm = aggregate_norm[aggregate[i]];
+      tentative[i] = value_equal(norm, value_type(0)) == true ? value_type(0) : nullspace[i] / norm;
+    }
+    nullspace.swap(aggregate_norm);
+    matrix_type T(n, count);
+    auto& tc = T.get_container();
+    for (size_type i = 0; i < n; ++i) {
+      tc.push_back_in_row(i + 1, aggregate[i] + 1, tentative[i]);
+    }
+    const auto& c = A.get_container();
+    std::vector<value_type> inverse_diag(n);
+    for (size_type row = 1; row <= n; ++row) {
+      value_type d = get_diagonal_value(c, row);
+      inverse_diag[row - 1] = value_equal(d, value_type(0)) == true ? value_type(0) : value_type(1) / d;
+    }
+    value_type rho = get_spectral_radius(A, inverse_diag);
+    value_type omega = rho > value_type(0) ? value_type(4.0 / 3.0) / rho : value_type(0);
+
+    matrix_type AT = spgemm(A, T, op_.thread_count);
+    const auto& atc = AT.get_container();
+    matrix_type P(n, count);
+    auto& pc = P.get_container();
+    for (size_type row = 1; row <= n; ++row) {
+      size_type t_column = aggregate[row - 1] + 1;
+      value_type t_value = tentative[row - 1];
+      value_type scale = - omega * inverse_diag[row - 1];
+      bool placed = false;
+      pc.reserve_row(row, atc.get_nth_row_size(row) + 1);
+      atc.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        if (placed == false && t_column < column) {
+          pc.push_back_in_row(row, t_column, t_value);
+          placed = true;
+        }
+        if (column == t_column) {
+          pc.push_back_in_row(row, column, t_value + scale * v);
+          placed = true;
+        }
+        else {
+          pc.push_back_in_row(row, column, scale * v);
+        }
+      });
+      if (placed == false) {
+        pc.push_back_in_row(row, t_column, t_value);
+      }
+    }
+    return P;
+  }
+
+  // rho(D^-1 * A) by power iteration, never above the largest absolute row sum of D^-1 * A.
+  static value_type get_spectral_radius(const matrix_type& A, const std::vector<value_type>& inverse_diag) {
+    size_type n = A.get_row();
+    const auto& c = A.get_container();
+    value_type bound = value_type(0);
+    for (size_type row = 1; row <= n; ++row) {
+      value_type sum = value_type(0);
+      c.for_each_in_row(row, [&](size_type, const value_type& v) {
+        sum += std::abs(v * inverse_diag[row - 1]);
+      });
+      bound = std::max(bound, sum);
+    }
+    dense_vector<value_type> v(n);
+    dense_vector<value_type> w(n);
+    for (size_type i = 0; i < n; ++i) {
+      v[i] = value_type(1) + value_type(i % 7) / value_type(7);
+    }
+    value_type rho = value_type(0);
+    for (size_type k = 0; k < 20; ++k) {
+      value_type norm = v.get_second_norm();
+      if (value_equal(norm, value_type(0)) == true) {
+        return bound;
+      }
+      v.scale(value_type(1) / norm);
+      matrix_vector_multiply(A, v, w);
+      for (size_type i = 0; i < n; ++i) {
+        w[i] *= inverse_diag[i];
+      }
+      rho = w.get_second_norm();
+      std::swap(v, w);
+    }
+    return std::min(rho, bound);
+  }
+
+  void factorize_coarsest() {
+    const matrix_type& A = levels_.back().A;
+    const auto& c = A.get_container();
+    std::vector<size_type> row_begin(1, 0);
+    std::vector<size_type> columns;
+    std::vector<value_type> values;
+    for (size_type row = 1; row <= A.get_row(); ++row) {
+      c.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        columns.push_back(column - 1);
+        values.push_back(v);
+      });
+      row_begin.push_back(columns.size());
+    }
+    coarse_lu_.factorize(A.get_row(), row_begin, columns, values, true);
+  }
+
+  jacobian get_jacobian_smoother() const {
+    jacobian::option op;
+    op.weight = op_.jacobian_weight;
+    return jacobian(op);
+  }
+
+  // plain sweeps, so one v-cycle is a fixed linear map as a preconditioner needs.
+  void smooth(level& l, size_type sweeps) const {
+    if (sweeps <= 0) {
+      return;
+    }
+    if (op_.smoother == amg_smoother::gauss_seidel) {
+      gauss_seidel::sweep(l.A, l.b, l.x, sweeps);
+    }
+    else {
+      get_jacobian_smoother().sweep(l.A, l.b, l.x, sweeps, l.jacobian_ws);
+    }
+  }
+
+  // v-cycle on level l for levels_[l].b, starting from levels_[l].x.
+  void cycle(size_type l) const {
+    level& current = levels_[l];
+    if (l + 1 == (size_type)levels_.size()) {
+      current.x = current.b;
+      coarse_lu_.solve(current.x.data());
+      return;
+    }
+    smooth(current, op_.pre_sweeps);
+    matrix_vector_multiply(current.A, current.x, current.r);
+    current.r.scale(value_type(-1));
+    current.r.add_scaled(value_type(1), current.b);
+    level& coarse = levels_[l + 1];
+    matrix_vector_multiply(restrictions_[l], current.r, coarse.b);
+    coarse.x.fill(value_type(0));
+    cycle(l + 1);
+    matrix_vector_multiply(prolongations_[l], coarse.x, current.r);
+    current.x.add_scaled(value_type(1), current.r);
+    smooth(current, op_.post_sweeps);
+  }
+};
+}
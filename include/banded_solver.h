@@ -0,0 +1,304 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "dense_vector.h"
+#include "batched_solver.h"
+#include "executor.h"
+#include "parallel.h"
+#include "instrument.h"
+#include "allocator.h"
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+namespace pnmatrix {
+// the tridiagonal solvers take the system as three arrays of n values, 0-based:
+//   lower[i] * x[i - 1] + diag[i] * x[i] + upper[i] * x[i + 1] = rhs[i]
+// lower[0] and upper[n - 1] are not read. x holds rhs on entry and the solution on return.
+
+// thomas algorithm, gaussian elimination without pivoting in O(n). stable for diagonally dominant or
+// symmetric positive definite systems. work holds n values. returns false on a zero pivot.
+template <typename ValueType>
+bool thomas_solve(size_type n, const ValueType* lower, const ValueType* diag, const ValueType* upper, ValueType* x, ValueType* work) {
+  PNMATRIX_COUNT("thomas_solve");
+  assert(n > 0);
+  if (value_equal(diag[0], ValueType(0)) == true) {
+    return false;
+  }
+  work[0] = n > 1 ? upper[0] / diag[0] : ValueType(0);
+  x[0] = x[0] / diag[0];
+  for (size_type i = 1; i < n; ++i) {
+    ValueType den = diag[i] - lower[i] * work[i - 1];
+    if (value_equal(den, ValueType(0)) == true) {
+      return false;
+    }
+    work[i] = i + 1 < n ? upper[i] / den : ValueType(0);
+    x[i] = (x[i] - lower[i] * x[i - 1]) / den;
+  }
+  for (size_type i = n - 2; i >= 0; --i) {
+    x[i] -= work[i] * x[i + 1];
+  }
+  return true;
+}
+
+// cyclic reduction: every level eliminates the odd equations of the current system against their
+// neighbours, all of them independently across ex, and halves the system. once at most serial_size
+// equations are left they are solved by the thomas algorithm, and the eliminated ones are recovered
+// level by level, again in parallel. about twice the work of thomas_solve, for long systems on many
+// threads. same conditions on the system as thomas_solve, work holds 3 * n values.
+template <typename ValueType>
+bool cyclic_reduction_solve(executor& ex, size_type n, const ValueType* lower, const ValueType* diag, const ValueType* upper, ValueType* x, ValueType* work,
+                            size_type serial_size = 1024) {
+  PNMATRIX_COUNT("cyclic_reduction_solve");
+  assert(n > 0 && serial_size > 0);
+  ValueType* a = work;
+  ValueType* b = work + n;
+  ValueType* c = work + 2 * n;
+  std::copy(lower, lower + n, a);
+  std::copy(diag, diag + n, b);
+  std::copy(upper, upper + n, c);
+  a[0] = ValueType(0);
+  c[n - 1] = ValueType(0);
+  // the equations (i + 1) % t == 0 form a tridiagonal system coupling i with i - t and i + t.
+  size_type t = 1;
+  while (n / t > serial_size && n / (2 * t) > 0) {
+    const size_type s = t;
+    std::vector<char> level_regular(std::max<size_type>(1, ex.get_thread_count()), 1);
+    parallel_for(ex, 0, n / (2 * s), [&](size_type th, size_type first, size_type last) {
+      for (size_type k = first; k < last; ++k) {
+        size_type i = 2 * s * k + 2 * s - 1;
+        if (value_equal(b[i - s], ValueType(0)) == true) {
+          level_regular[th] = 0;
+          continue;
+        }
+        ValueType alpha = - a[i] / b[i - s];
+        ValueType gamma = ValueType(0);
+        if (i + s < n) {
+          if (value_equal(b[i + s], ValueType(0)) == true) {
+            level_regular[th] = 0;
+            continue;
+          }
+          gamma = - c[i] / b[i + s];
+          b[i] += gamma * a[i + s];
+          x[i] += gamma * x[i + s];
+          c[i] = gamma * c[i + s];
+        }
+        else {
+          c[i] = ValueType(0);
+        }
+        b[i] += alpha * c[i - s];
+        x[i] += alpha * x[i - s];
+        a[i] = alpha * a[i - s];
+      }
+    });
+    if (std::all_of(level_regular.begin(), level_regular.end(), [](char r) { return r != 0; }) == false) {
+      return false;
+    }
+    t *= 2;
+  }
+  // thomas on the reduced system, the coefficients of the first and last equation
+  // couple outside of the system and are already zero. c and x are overwritten.
+  size_type m = n / t;
+  for (size_type k = 0; k < m; ++k) {
+    size_type i = t * k + t - 1;
+    ValueType den = b[i];
+    if (k > 0) {
+      den -= a[i] * c[i - t];
+    }
+    if (value_equal(den, ValueType(0)) == true) {
+      return false;
+    }
+    c[i] = c[i] / den;
+    x[i] = k > 0 ? (x[i] - a[i] * x[i - t]) / den : x[i] / den;
+  }
+  for (size_type k = m - 2; k >= 0; --k) {
+    size_type i = t * k + t - 1;
+    x[i] -= c[i] * x[i + t];
+  }
+  // the equations eliminated at stride s are (i + 1) % (2 * s) == s, their neighbours are known.
+  for (size_type s = t / 2; s >= 1; s /= 2) {
+    parallel_for(ex, 0, (n - s) / (2 * s) + 1, [&](size_type, size_type first, size_type last) {
+      for (size_type k = first; k < last; ++k) {
+        size_type i = 2 * s * k + s - 1;
+        ValueType sum = x[i];
+        if (i - s >= 0) {
+          sum -= a[i] * x[i - s];
+        }
+        if (i + s < n) {
+          sum -= c[i] * x[i + s];
+        }
+        x[i] = sum / b[i];
+      }
+    });
+  }
+  return true;
+}
+
+// many independent tridiagonal systems of the same length, one per lane of the batched vectors:
+// lower(s, i) * x(s, i - 1) + diag(s, i) * x(s, i) + upper(s, i) * x(s, i + 1) = b(s, i), rows start by 1.
+// the thomas algorithm runs across the lanes of a group, the groups are split across threads.
+// b is overwritten by the solutions. returns false if any system hits a zero pivot.
+template <typename ValueType, size_type Lanes>
+bool batched_tridiagonal_solve(const batched_vector<ValueType, Lanes>& lower, const batched_vector<ValueType, Lanes>& diag,
+                               const batched_vector<ValueType, Lanes>& upper, batched_vector<ValueType, Lanes>& b, size_type thread_count = 1) {
+  assert(diag.get_batch_count() == b.get_batch_count() && diag.get_dimension() == b.get_dimension());
+  assert(lower.get_batch_count() == b.get_batch_count() && lower.get_dimension() == b.get_dimension());
+  assert(upper.get_batch_count() == b.get_batch_count() && upper.get_dimension() == b.get_dimension());
+  const size_type n = b.get_dimension();
+  const size_type batch = b.get_batch_count();
+  std::vector<char> regular(b.get_group_count(), 1);
+  parallel_for(0, b.get_group_count(), thread_count, [&](size_type, size_type first, size_type last) {
+    std::vector<ValueType, aligned_allocator<ValueType>> work(n * Lanes);
+    for (size_type g = first; g < last; ++g) {
+      // padding lanes of the last group hold zeros, their pivots are replaced by 1 and ignored.
+      const size_type used = std::min(Lanes, batch - g * Lanes);
+      bool ok = true;
+      for (size_type i = 1; i <= n; ++i) {
+        const ValueType* l = lower.element(g, i);
+        const ValueType* d = diag.element(g, i);
+        const ValueType* u = upper.element(g, i);
+        ValueType* x = b.element(g, i);
+        ValueType* w = &work[(i - 1) * Lanes];
+        for (size_type lane = 0; lane < Lanes; ++lane) {
+          ValueType den = d[lane];
+          if (i > 1) {
+            den -= l[lane] * w[lane - Lanes];
+          }
+          if (value_equal(den, ValueType(0)) == true) {
+            ok = ok && lane >= used;
+            den = ValueType(1);
+          }
+          w[lane] = i < n ? u[lane] / den : ValueType(0);
+          x[lane] = i > 1 ? (x[lane] - l[lane] * x[lane - Lanes]) / den : x[lane] / den;
+        }
+      }
+      for (size_type i = n - 1; i >= 1; --i) {
+        ValueType* x = b.element(g, i);
+        const ValueType* w = &work[(i - 1) * Lanes];
+        for (size_type lane = 0; lane < Lanes; ++lane) {
+          x[lane] -= w[lane] * x[lane + Lanes];
+        }
+      }
+      regular[g] = ok;
+    }
+  });
+  return std::all_of(regular.begin(), regular.end(), [](char r) { return r != 0; });
+}
+
+// lu decomposition with partial pivoting of a square band matrix, O(n * lower * (lower + upper)).
+// row swaps widen the upper band of U to lower + upper, the rows keep lower + (lower + upper) + 1 slots.
+// like lapack gbtrf the multipliers are not permuted by later swaps, solve applies the swaps as it goes.
+template <typename ValueType>
+class banded_lu {
+public:
+  using value_type = ValueType;
+
+  // any square matrix<>, the band is taken from its stored elements. returns false if A is singular.
+  template <typename MatrixType>
+  bool factorize(const MatrixType& A) {
+    PNMATRIX_TIMED_SCOPE("banded_lu.factorize");
+    assert(A.get_row() == A.get_column());
+    n_ = A.get_row();
+    lower_ = 0;
+    size_type upper = 0;
+    for (auto row = A.begin(); row != A.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        lower_ = std::max(lower_, row.row_index() - col.column_index());
+        upper = std::max(upper, col.column_index() - row.row_index());
+      }
+    }
+    upper_ = lower_ + upper;
+    width_ = lower_ + upper_ + 1;
+    values_.assign(n_ * width_, value_type(0));
+    pivot_.assign(n_ + 1, 0);
+    for (auto row = A.begin(); row != A.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        at(row.row_index(), col.column_index()) = *col;
+      }
+    }
+    for (size_type k = 1; k <= n_; ++k) {
+      size_type last_row = std::min(n_, k + lower_);
+      size_type last_column = std::min(n_, k + upper_);
+      size_type p = k;
+      for (size_type i = k + 1; i <= last_row; ++i) {
+        if (std::abs(at(i, k)) > std::abs(at(p, k))) {
+          p = i;
+        }
+      }
+      pivot_[k] = p;
+      if (value_equal(at(p, k), value_type(0)) == true) {
+        return false;
+      }
+      if (p != k) {
+        for (size_type c = k; c <= last_column; ++c) {
+          std::swap(at(k, c), at(p, c));
+        }
+      }
+      value_type inverse = value_type(1) / at(k, k);
+      for (size_type i = k + 1; i <= last_row; ++i) {
+        value_type l = at(i, k) * inverse;
+        at(i, k) = l;
+        if (value_equal(l, value_type(0)) == false) {
+          for (size_type c = k + 1; c <= last_column; ++c) {
+            at(i, c) -= l * at(k, c);
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // x holds b on entry and the solution of A * x = b on return, n values.
+  void solve(value_type* x) const {
+    PNMATRIX_COUNT("banded_lu.solve");
+    for (size_type k = 1; k <= n_; ++k) {
+      if (pivot_[k] != k) {
+        std::swap(x[k - 1], x[pivot_[k] - 1]);
+      }
+      value_type xk = x[k - 1];
+      for (size_type i = k + 1; i <= std::min(n_, k + lower_); ++i) {
+        x[i - 1] -= at(i, k) * xk;
+      }
+    }
+    for (size_type i = n_; i >= 1; --i) {
+      value_type sum = x[i - 1];
+      for (size_type c = i + 1; c <= std::min(n_, i + upper_); ++c) {
+        sum -= at(i, c) * x[c - 1];
+      }
+      x[i - 1] = sum / at(i, i);
+    }
+  }
+
+  void solve(dense_vector<value_type>& x) const {
+    assert(x.size() == n_);
+    solve(x.data());
+  }
+
+  size_type get_lower_bandwidth() const {
+    return lower_;
+  }
+
+  // of U, the upper bandwidth of A plus the lower one.
+  size_type get_upper_bandwidth() const {
+    return upper_;
+  }
+
+private:
+  size_type n_ = 0;
+  size_type lower_ = 0;
+  size_type upper_ = 0;
+  size_type width_ = 1;
+  std::vector<value_type, tracked_allocator<value_type>> values_;
+  std::vector<size_type> pivot_;
+
+  value_type& at(size_type row, size_type column) {
+    return values_[(row - 1) * width_ + column - row + lower_];
+  }
+
+  const value_type& at(size_type row, size_type column) const {
+    return values_[(row - 1) * width_ + column - row + lower_];
+  }
+};
+}
@@ -0,0 +1,356 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "dense_vector.h"
+#include "parallel.h"
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace pnmatrix {
+// many independent n x n systems stored as structure of arrays. the systems are grouped
+// by Lanes, and inside a group element (row, column) of every system is contiguous, so the
+// innermost loops of the kernels run across systems and vectorize.
+// systems start by 0, rows and columns start by 1.
+template <typename ValueType, size_type Lanes = 8>
+class batched_matrix {
+public:
+  using value_type = ValueType;
+  static constexpr size_type lanes = Lanes;
+
+  // every system starts as the identity, so padding lanes of the last group stay regular.
+  batched_matrix(size_type batch, size_type n):batch_(batch), n_(n), data_(((batch + Lanes - 1) / Lanes) * n * n * Lanes, value_type(0)) {
+    assert(batch > 0 && n > 0);
+    for (size_type g = 0; g < get_group_count(); ++g) {
+      for (size_type i = 1; i <= n_; ++i) {
+        std::fill_n(element(g, i, i), Lanes, value_type(1));
+      }
+    }
+  }
+
+  size_type get_batch_count() const {
+    return batch_;
+  }
+
+  size_type get_dimension() const {
+    return n_;
+  }
+
+  size_type get_group_count() const {
+    return (batch_ + Lanes - 1) / Lanes;
+  }
+
+  value_type get_value(size_type system, size_type row, size_type column) const {
+    return element(system / Lanes, row, column)[system % Lanes];
+  }
+
+  void set_value(size_type system, size_type row, size_type column, const value_type& v) {
+    element(system / Lanes, row, column)[system % Lanes] = v;
+  }
+
+  // copies a n x n matrix<> into one system.
+  template <typename MatrixType>
+  void set_system(size_type system, const MatrixType& m) {
+    assert(m.get_row() == n_ && m.get_column() == n_);
+    for (size_type i = 1; i <= n_; ++i) {
+      for (size_type j = 1; j <= n_; ++j) {
+        set_value(system, i, j, value_type(0));
+      }
+    }
+    for (auto row = m.begin(); row != m.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        set_value(system, col.row_index(), col.column_index(), *col);
+      }
+    }
+  }
+
+  // Lanes consecutive values, one per system of the group.
+  value_type* element(size_type group, size_type row, size_type column) {
+    return &data_[((group * n_ + row - 1) * n_ + column - 1) * Lanes];
+  }
+
+  const value_type* element(size_type group, size_type row, size_type column) const {
+    return &data_[((group * n_ + row - 1) * n_ + column - 1) * Lanes];
+  }
+
+private:
+  size_type batch_;
+  size_type n_;
+  std::vector<value_type, aligned_allocator<value_type>> data_;
+};
+
+// one right hand side of length n per system, same grouping as batched_matrix.
+template <typename ValueType, size_type Lanes = 8>
+class batched_vector {
+public:
+  using value_type = ValueType;
+  static constexpr size_type lanes = Lanes;
+
+  batched_vector(size_type batch, size_type n):batch_(batch), n_(n), data_(((batch + Lanes - 1) / Lanes) * n * Lanes, value_type(0)) {
+    assert(batch > 0 && n > 0);
+  }
+
+  size_type get_batch_count() const {
+    return batch_;
+  }
+
+  size_type get_dimension() const {
+    return n_;
+  }
+
+  size_type get_group_count() const {
+    return (batch_ + Lanes - 1) / Lanes;
+  }
+
+  value_type get_value(size_type system, size_type row) const {
+    return element(system / Lanes, row)[system % Lanes];
+  }
+
+  void set_value(size_type system, size_type row, const value_type& v) {
+    element(system / Lanes, row)[system % Lanes] = v;
+  }
+
+  value_type* element(size_type group, size_type row) {
+    return &data_[(group * n_ + row - 1) * Lanes];
+  }
+
+  const value_type* element(size_type group, size_type row) const {
+    return &data_[(group * n_ + row - 1) * Lanes];
+  }
+
+private:
+  size_type batch_;
+  size_type n_;
+  std::vector<value_type, aligned_allocator<value_type>> data_;
+};
+
+// pivot rows of a batched lu decomposition, one per (group, column, lane).
+using batched_pivot = std::vector<size_type>;
+
+namespace detail {
+template <typename ValueType, size_type Lanes>
+bool batched_lu_group(batched_matrix<ValueType, Lanes>& a, size_type g, size_type* pivot) {
+  const size_type n = a.get_dimension();
+  bool regular = true;
+  ValueType factor[Lanes];
+  for (size_type k = 1; k <= n; ++k) {
+    // partial pivoting is chosen per lane, the rows are swapped physically so the
+    // elimination below stays the same for every lane.
+    size_type* p = pivot + (k - 1) * Lanes;
+    for (size_type l = 0; l < Lanes; ++l) {
+      size_type best = k;
+      ValueType best_value = std::abs(a.element(g, k, k)[l]);
+      for (size_type i = k + 1; i <= n; ++i) {
+        ValueType v = std::abs(a.element(g, i, k)[l]);
+        if (v > best_value) {
+          best_value = v;
+          best = i;
+        }
+      }
+      p[l] = best;
+      if (value_equal(best_value, ValueType(0)) == true) {
+        regular = false;
+        continue;
+      }
+      if (best != k) {
+        for (size_type j = 1; j <= n; ++j) {
+          std::swap(a.element(g, k, j)[l], a.element(g, best, j)[l]);
+        }
+      }
+    }
+    const ValueType* pivot_row = a.element(g, k, k);
+    for (size_type l = 0; l < Lanes; ++l) {
+      factor[l] = value_equal(pivot_row[l], ValueType(0)) == true ? ValueType(0) : ValueType(1) / pivot_row[l];
+    }
+    for (size_type i = k + 1; i <= n; ++i) {
+      ValueType* lik = a.element(g, i, k);
+      for (size_type l = 0; l < Lanes; ++l) {
+        lik[l] *= factor[l];
+      }
+      for (size_type j = k + 1; j <= n; ++j) {
+        ValueType* aij = a.element(g, i, j);
+        const ValueType* akj = a.element(g, k, j);
+        for (size_type l = 0; l < Lanes; ++l) {
+          aij[l] -= lik[l] * akj[l];
+        }
+      }
+    }
+  }
+  return regular;
+}
+
+template <typename ValueType, size_type Lanes>
+void batched_lu_solve_group(const batched_matrix<ValueType, Lanes>& lu, const size_type* pivot, batched_vector<ValueType, Lanes>& b, size_type g) {
+  const size_type n = lu.get_dimension();
+  for (size_type k = 1; k <= n; ++k) {
+    const size_type* p = pivot + (k - 1) * Lanes;
+    for (size_type l = 0; l < Lanes; ++l) {
+      if (p[l] != k) {
+        std::swap(b.element(g, k)[l], b.element(g, p[l])[l]);
+      }
+    }
+  }
+  for (size_type i = 2; i <= n; ++i) {
+    ValueType* bi = b.element(g, i);
+    for (size_type j = 1; j < i; ++j) {
+      const ValueType* lij = lu.element(g, i, j);
+      const ValueType* bj = b.element(g, j);
+      for (size_type l = 0; l < Lanes; ++l) {
+        bi[l] -= lij[l] * bj[l];
+      }
+    }
+  }
+  for (size_type i = n; i >= 1; --i) {
+    ValueType* bi = b.element(g, i);
+    for (size_type j = i + 1; j <= n; ++j) {
+      const ValueType* uij = lu.element(g, i, j);
+      const ValueType* bj = b.element(g, j);
+      for (size_type l = 0; l < Lanes; ++l) {
+        bi[l] -= uij[l] * bj[l];
+      }
+    }
+    const ValueType* uii = lu.element(g, i, i);
+    for (size_type l = 0; l < Lanes; ++l) {
+      bi[l] /= uii[l];
+    }
+  }
+}
+
+// lower triangle of a is overwritten by L, a = L * L^T.
+template <typename ValueType, size_type Lanes>
+bool batched_cholesky_group(batched_matrix<ValueType, Lanes>& a, size_type g) {
+  const size_type n = a.get_dimension();
+  bool regular = true;
+  for (size_type j = 1; j <= n; ++j) {
+    ValueType* ajj = a.element(g, j, j);
+    for (size_type k = 1; k < j; ++k) {
+      const ValueType* ajk = a.element(g, j, k);
+      for (size_type l = 0; l < Lanes; ++l) {
+        ajj[l] -= ajk[l] * ajk[l];
+      }
+    }
+    for (size_type l = 0; l < Lanes; ++l) {
+      if (!(ajj[l] > ValueType(0))) {
+        regular = false;
+        ajj[l] = ValueType(1);
+      }
+      ajj[l] = std::sqrt(ajj[l]);
+    }
+    for (size_type i = j + 1; i <= n; ++i) {
+      ValueType* aij = a.element(g, i, j);
+      for (size_type k = 1; k < j; ++k) {
+        const ValueType* aik = a.element(g, i, k);
+        const ValueType* ajk = a.element(g, j, k);
+        for (size_type l = 0; l < Lanes; ++l) {
+          aij[l] -= aik[l] * ajk[l];
+        }
+      }
+      for (size_type l = 0; l < Lanes; ++l) {
+        aij[l] /= ajj[l];
+      }
+    }
+  }
+  return regular;
+}
+
+template <typename ValueType, size_type Lanes>
+void batched_cholesky_solve_group(const batched_matrix<ValueType, Lanes>& chol, batched_vector<ValueType, Lanes>& b, size_type g) {
+  const size_type n = chol.get_dimension();
+  for (size_type i = 1; i <= n; ++i) {
+    ValueType* bi = b.element(g, i);
+    for (size_type j = 1; j < i; ++j) {
+      const ValueType* lij = chol.element(g, i, j);
+      const ValueType* bj = b.element(g, j);
+      for (size_type l = 0; l < Lanes; ++l) {
+        bi[l] -= lij[l] * bj[l];
+      }
+    }
+    const ValueType* lii = chol.element(g, i, i);
+    for (size_type l = 0; l < Lanes; ++l) {
+      bi[l] /= lii[l];
+    }
+  }
+  for (size_type i = n; i >= 1; --i) {
+    ValueType* bi = b.element(g, i);
+    for (size_type j = i + 1; j <= n; ++j) {
+      const ValueType* lji = chol.element(g, j, i);
+      const ValueType* bj = b.element(g, j);
+      for (size_type l = 0; l < Lanes; ++l) {
+        bi[l] -= lji[l] * bj[l];
+      }
+    }
+    const ValueType* lii = chol.element(g, i, i);
+    for (size_type l = 0; l < Lanes; ++l) {
+      bi[l] /= lii[l];
+    }
+  }
+}
+}
+
+// in place lu decomposition with partial pivoting of every system, the groups are split across threads.
+// returns false if any system is singular, the other systems are still decomposed.
+template <typename ValueType, size_type Lanes>
+bool batched_lu_decompose(batched_matrix<ValueType, Lanes>& a, batched_pivot& pivot, size_type thread_count = 1) {
+  const size_type n = a.get_dimension();
+  pivot.assign(a.get_group_count() * n * Lanes, 0);
+  std::vector<char> regular(a.get_group_count(), 1);
+  parallel_for(0, a.get_group_count(), thread_count, [&](size_type, size_type first, size_type last) {
+    for (size_type g = first; g < last; ++g) {
+      regular[g] = detail::batched_lu_group(a, g, &pivot[g * n * Lanes]);
+    }
+  });
+  return std::all_of(regular.begin(), regular.end(), [](char r) { return r != 0; });
+}
+
+// b is overwritten by the solutions.
+template <typename ValueType, size_type Lanes>
+void batched_lu_solve(const batched_matrix<ValueType, Lanes>& lu, const batched_pivot& pivot, batched_vector<ValueType, Lanes>& b, size_type thread_count = 1) {
+  assert(lu.get_batch_count() == b.get_batch_count() && lu.get_dimension() == b.get_dimension());
+  const size_type n = lu.get_dimension();
+  parallel_for(0, lu.get_group_count(), thread_count, [&](size_type, size_type first, size_type last) {
+    for (size_type g = first; g < last; ++g) {
+      detail::batched_lu_solve_group(lu, &pivot[g * n * Lanes], b, g);
+    }
+  });
+}
+
+// in place cholesky decomposition of symmetric positive definite systems, only the lower triangle is used.
+// returns false if any system is not positive definite.
+template <typename ValueType, size_type Lanes>
+bool batched_cholesky_decompose(batched_matrix<ValueType, Lanes>& a, size_type thread_count = 1) {
+  std::vector<char> regular(a.get_group_count(), 1);
+  parallel_for(0, a.get_group_count(), thread_count, [&](size_type, size_type first, size_type last) {
+    for (size_type g = first; g < last; ++g) {
+      regular[g] = detail::batched_cholesky_group(a, g);
+    }
+  });
+  return std::all_of(regular.begin(), regular.end(), [](char r) { return r != 0; });
+}
+
+template <typename ValueType, size_type Lanes>
+void batched_cholesky_solve(const batched_matrix<ValueType, Lanes>& chol, batched_vector<ValueType, Lanes>& b, size_type thread_count = 1) {
+  assert(chol.get_batch_count() == b.get_batch_count() && chol.get_dimension() == b.get_dimension());
+  parallel_for(0, chol.get_group_count(), thread_count, [&](size_type, size_type first, size_type last) {
+    for (size_type g = first; g < last; ++g) {
+      detail::batched_cholesky_solve_group(chol, b, g);
+    }
+  });
+}
+
+// decomposes and solves in one pass over each group while it is hot in cache, a is overwritten by lu.
+template <typename ValueType, size_type Lanes>
+bool batched_solve(batched_matrix<ValueType, Lanes>& a, batched_vector<ValueType, Lanes>& b, size_type thread_count = 1) {
+  assert(a.get_batch_count() == b.get_batch_count() && a.get_dimension() == b.get_dimension());
+  const size_type n = a.get_dimension();
+  std::vector<char> regular(a.get_group_count(), 1);
+  parallel_for(0, a.get_group_count(), thread_count, [&](size_type, size_type first, size_type last) {
+    std::vector<size_type> pivot(n * Lanes);
+    for (size_type g = first; g < last; ++g) {
+      regular[g] = detail::batched_lu_group(a, g, pivot.data());
+      detail::batched_lu_solve_group(a, pivot.data(), b, g);
+    }
+  });
+  return std::all_of(regular.begin(), regular.end(), [](char r) { return r != 0; });
+}
+}
@@ -0,0 +1,244 @@
+#pragma once
+#include "type.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <cassert>
+#ifdef PNMATRIX_USE_MPI
+#include <mpi.h>
+#endif
+
+namespace pnmatrix {
+// point to point messages and collectives between the ranks of one distributed computation.
+// every rank calls the collectives in the same order. messages from one source with one tag
+// arrive in the order they were sent.
+class communicator {
+public:
+  virtual ~communicator() = default;
+
+  virtual int get_rank() const = 0;
+
+  virtual int get_size() const = 0;
+
+  // may return before destination received the message, data can be reused at once.
+  virtual void send(int destination, int tag, const void* data, size_type bytes) = 0;
+
+  // blocks until the next message of source with tag arrived, its size must be bytes.
+  virtual void receive(int source, int tag, void* data, size_type bytes) = 0;
+
+  // waits until the messages sent so far have left this rank.
+  virtual void flush() = 0;
+
+  // values[i] = the sum of values[i] over all ranks, the same on every rank.
+  virtual void all_reduce_sum(double* values, size_type count) = 0;
+
+  virtual void barrier() = 0;
+};
+
+// the ranks are threads of one process, for tests and for spreading a solve over the cores
+// of one machine with the same code that runs across machines.
+class thread_world {
+public:
+  explicit thread_world(int size):shared_(std::make_shared<shared_state>(size)) {
+    assert(size >= 1);
+  }
+
+  int get_size() const {
+    return shared_->size;
+  }
+
+  // runs f(comm) on get_size() threads, rank 0 on the calling thread, and joins them.
+  void run(const std::function<void(communicator&)>& f) {
+    std::vector<std::thread> threads;
+    for (int rank = 1; rank < get_size(); ++rank) {
+      threads.emplace_back([this, rank, &f]() {
+        rank_communicator comm(shared_, rank);
+        f(comm);
+      });
+    }
+    rank_communicator comm(shared_, 0);
+    f(comm);
+    for (auto& each : threads) {
+      each.join();
+    }
+  }
+
+private:
+  struct shared_state {
+    explicit shared_state(int n):size(n), arrived(0), generation(0), contributions(n) {
+
+    }
+
+    int size;
+    std::mutex mutex;
+    std::condition_variable changed;
+    // (source, destination, tag) -> messages in sending order.
+    std::map<std::tuple<int, int, int>, std::deque<std::vector<char>>> mailboxes;
+    int arrived;
+    size_type generation;
+    std::vector<std::vector<double>> contributions;
+    std::vector<double> result;
+  };
+
+  class rank_communicator : public communicator {
+  public:
+    rank_communicator(std::shared_ptr<shared_state> shared, int rank):shared_(std::move(shared)), rank_(rank) {
+
+    }
+
+    int get_rank() const override {
+      return rank_;
+    }
+
+    int get_size() const override {
+      return shared_->size;
+    }
+
+    void send(int destination, int tag, const void* data, size_type bytes) override {
+      assert(destination >= 0 && destination < get_size());
+      std::vector<char> message(bytes);
+      if (bytes > 0) {
+        std::memcpy(message.data(), data, bytes);
+      }
+      {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        shared_->mailboxes[std::make_tuple(rank_, destination, tag)].push_back(std::move(message));
+      }
+      shared_->changed.notify_all();
+    }
+
+    void receive(int source, int tag, void* data, size_type bytes) override {
+      assert(source >= 0 && source < get_size());
+      std::unique_lock<std::mutex> lock(shared_->mutex);
+      auto& box = shared_->mailboxes[std::make_tuple(source, rank_, tag)];
+      shared_->changed.wait(lock, [&box]() {
+        return box.empty() == false;
+      });
+      assert((size_type)box.front().size() == bytes);
+      if (bytes > 0) {
+        std::memcpy(data, box.front().data(), bytes);
+      }
+      box.pop_front();
+    }
+
+    void flush() override {
+
+    }
+
+    // the last rank to arrive adds the contributions in rank order, so every rank gets the
+    // same bits whatever the arrival order.
+    void all_reduce_sum(double* values, size_type count) override {
+      std::unique_lock<std::mutex> lock(shared_->mutex);
+      shared_->contributions[rank_].assign(values, values + count);
+      wait_for_all(lock, [&]() {
+        shared_->result.assign(count, 0.0);
+        for (const auto& each : shared_->contributions) {
+          assert((size_type)each.size() == count);
+          for (size_type i = 0; i < count; ++i) {
+            shared_->result[i] += each[i];
+          }
+        }
+      });
+      std::copy(shared_->result.begin(), shared_->result.end(), values);
+    }
+
+    void barrier() override {
+      std::unique_lock<std::mutex> lock(shared_->mutex);
+      wait_for_all(lock, []() {
+
+      });
+    }
+
+  private:
+    // the last rank to arrive calls on_last() and wakes the others, lock holds shared_->mutex.
+    template <typename F>
+    void wait_for_all(std::unique_lock<std::mutex>& lock, F on_last) {
+      size_type generation = shared_->generation;
+      if (++shared_->arrived == shared_->size) {
+        on_last();
+        shared_->arrived = 0;
+        ++shared_->generation;
+        shared_->changed.notify_all();
+      }
+      else {
+        shared_->changed.wait(lock, [&]() {
+          return shared_->generation != generation;
+        });
+      }
+    }
+
+    std::shared_ptr<shared_state> shared_;
+    int rank_;
+  };
+
+  std::shared_ptr<shared_state> shared_;
+};
+
+#ifdef PNMATRIX_USE_MPI
+// MPI_Init and MPI_Finalize are left to the application.
+class mpi_communicator : public communicator {
+public:
+  explicit mpi_communicator(MPI_Comm comm = MPI_COMM_WORLD):comm_(comm) {
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &size_);
+  }
+
+  ~mpi_communicator() override {
+    flush();
+  }
+
+  int get_rank() const override {
+    return rank_;
+  }
+
+  int get_size() const override {
+    return size_;
+  }
+
+  void send(int destination, int tag, const void* data, size_type bytes) override {
+    pending_.emplace_back();
+    pending_message& m = pending_.back();
+    m.data.assign(static_cast<const char*>(data), static_cast<const char*>(data) + bytes);
+    MPI_Isend(m.data.data(), (int)bytes, MPI_BYTE, destination, tag, comm_, &m.request);
+  }
+
+  void receive(int source, int tag, void* data, size_type bytes) override {
+    MPI_Recv(data, (int)bytes, MPI_BYTE, source, tag, comm_, MPI_STATUS_IGNORE);
+  }
+
+  void flush() override {
+    for (auto& each : pending_) {
+      MPI_Wait(&each.request, MPI_STATUS_IGNORE);
+    }
+    pending_.clear();
+  }
+
+  void all_reduce_sum(double* values, size_type count) override {
+    MPI_Allreduce(MPI_IN_PLACE, values, (int)count, MPI_DOUBLE, MPI_SUM, comm_);
+  }
+
+  void barrier() override {
+    MPI_Barrier(comm_);
+  }
+
+private:
+  struct pending_message {
+    std::vector<char> data;
+    MPI_Request request;
+  };
+
+  MPI_Comm comm_;
+  int rank_;
+  int size_;
+  // a deque keeps the buffers in place while their sends are in flight.
+  std::deque<pending_message> pending_;
+};
+#endif
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include "type.h"
+#include "dense_vector.h"
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace pnmatrix {
+// n x k block of right hand sides or krylov vectors, one column per system.
+// stored row by row, so the k values of one row are contiguous and a row of A
+// is read once for all columns. operator() starts by 0, get_value / set_value start by 1.
+template <typename ValueType>
+class dense_block {
+public:
+  using value_type = ValueType;
+
+  dense_block():row_(0), column_(0) {
+
+  }
+
+  dense_block(size_type row, size_type column, const value_type& v = value_type(0)):row_(row), column_(column), data_(row * column, v) {
+
+  }
+
+  size_type get_row() const {
+    return row_;
+  }
+
+  size_type get_column() const {
+    return column_;
+  }
+
+  value_type& operator()(size_type row, size_type column) {
+    return data_[row * column_ + column];
+  }
+
+  const value_type& operator()(size_type row, size_type column) const {
+    return data_[row * column_ + column];
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    return data_[(row - 1) * column_ + column - 1];
+  }
+
+  void set_value(size_type row, size_type column, const value_type& v) {
+    data_[(row - 1) * column_ + column - 1] = v;
+  }
+
+  value_type* row_data(size_type row) {
+    return data_.data() + row * column_;
+  }
+
+  const value_type* row_data(size_type row) const {
+    return data_.data() + row * column_;
+  }
+
+  value_type* data() {
+    return data_.data();
+  }
+
+  const value_type* data() const {
+    return data_.data();
+  }
+
+  void fill(const value_type& v) {
+    std::fill(data_.begin(), data_.end(), v);
+  }
+
+  dense_vector<value_type> get_column_vector(size_type column) const {
+    dense_vector<value_type> result(row_);
+    for (size_type i = 0; i < row_; ++i) {
+      result[i] = (*this)(i, column);
+    }
+    return result;
+  }
+
+  void set_column_vector(size_type column, const dense_vector<value_type>& v) {
+    assert(v.size() == row_);
+    for (size_type i = 0; i < row_; ++i) {
+      (*this)(i, column) = v[i];
+    }
+  }
+
+  // keeps the columns whose flag is true, in order. used to drop converged systems.
+  template <typename Allocator>
+  void compact_columns(const std::vector<bool, Allocator>& keep) {
+    assert((size_type)keep.size() == column_);
+    size_type new_column = std::count(keep.begin(), keep.end(), true);
+    value_type* out = data_.data();
+    for (size_type i = 0; i < row_; ++i) {
+      const value_type* in = row_data(i);
+      for (size_type j = 0; j < column_; ++j) {
+        if (keep[j] == true) {
+          *out++ = in[j];
+        }
+      }
+    }
+    column_ = new_column;
+    data_.resize(row_ * column_);
+  }
+
+  // out[j] = <this(:, j), other(:, j)>
+  void column_inner_product(const dense_block& other, value_type* out) const {
+    assert(row_ == other.row_ && column_ == other.column_);
+    std::fill(out, out + column_, value_type(0));
+    for (size_type i = 0; i < row_; ++i) {
+      const value_type* a = row_data(i);
+      const value_type* b = other.row_data(i);
+      for (size_type j = 0; j < column_; ++j) {
+        out[j] += a[j] * b[j];
+      }
+    }
+  }
+
+  void column_second_norm(value_type* out) const {
+    column_inner_product(*this, out);
+    for (size_type j = 0; j < column_; ++j) {
+      out[j] = std::sqrt(out[j]);
+    }
+  }
+
+  // this(:, j) += a[j] * x(:, j)
+  void add_scaled(const value_type* a, const dense_block& x) {
+    assert(row_ == x.row_ && column_ == x.column_);
+    for (size_type i = 0; i < row_; ++i) {
+      value_type* y = row_data(i);
+      const value_type* xr = x.row_data(i);
+      for (size_type j = 0; j < column_; ++j) {
+        y[j] += a[j] * xr[j];
+      }
+    }
+  }
+
+  // this(:, j) *= a[j]
+  void scale(const value_type* a) {
+    for (size_type i = 0; i < row_; ++i) {
+      value_type* y = row_data(i);
+      for (size_type j = 0; j < column_; ++j) {
+        y[j] *= a[j];
+      }
+    }
+  }
+
+private:
+  size_type row_;
+  size_type column_;
+  std::vector<value_type, aligned_allocator<value_type>> data_;
+};
+
+// Y = A * X, every stored element of A is read once and applied to all columns of X.
+template <typename MatrixType, typename ValueType>
+void matrix_block_multiply(const MatrixType& A, const dense_block<ValueType>& X, dense_block<ValueType>& Y) {
+  assert(A.get_column() == X.get_row() && A.get_row() == Y.get_row() && X.get_column() == Y.get_column());
+  const size_type k = X.get_column();
+  for (auto row = A.begin(); row != A.end(); ++row) {
+    ValueType* y = Y.row_data(row.row_index() - 1);
+    std::fill(y, y + k, ValueType(0));
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      const ValueType v = *col;
+      const ValueType* x = X.row_data(col.column_index() - 1);
+      for (size_type j = 0; j < k; ++j) {
+        y[j] += v * x[j];
+      }
+    }
+  }
+}
+
+// rows of A split across ex.
+template <typename MatrixType, typename ValueType>
+void matrix_block_multiply(executor& ex, const MatrixType& A, const dense_block<ValueType>& X, dense_block<ValueType>& Y) {
+  using container_type = typename MatrixType::container_type;
+  if constexpr (has_row_access<container_type>::value) {
+    if (ex.get_thread_count() > 1) {
+      assert(A.get_column() == X.get_row() && A.get_row() == Y.get_row() && X.get_column() == Y.get_column());
+      const size_type k = X.get_column();
+      const container_type& c = A.get_container();
+      parallel_for(ex, 1, A.get_row() + 1, [&](size_type, size_type first, size_type last) {
+        for (size_type row = first; row < last; ++row) {
+          ValueType* y = Y.row_data(row - 1);
+          std::fill(y, y + k, ValueType(0));
+          c.for_each_in_row(row, [&](size_type column, const ValueType& v) {
+            const ValueType* x = X.row_data(column - 1);
+            for (size_type j = 0; j < k; ++j) {
+              y[j] += v * x[j];
+            }
+          });
+        }
+      });
+      return;
+    }
+  }
+  matrix_block_multiply(A, X, Y);
+}
+
+// moves the columns of x whose keep flag is false into result, active maps the columns of x to the
+// columns of result. x and active are compacted to the kept columns, returns true if any column left.
+template <typename ValueType, typename BoolAllocator, typename Allocator>
+bool retire_columns(const std::vector<bool, BoolAllocator>& keep, dense_block<ValueType>& x, dense_block<ValueType>& result, std::vector<size_type, Allocator>& active) {
+  assert((size_type)keep.size() == x.get_column() && keep.size() == active.size());
+  std::vector<size_type, Allocator> still_active;
+  for (size_type j = 0; j < x.get_column(); ++j) {
+    if (keep[j] == true) {
+      still_active.push_back(active[j]);
+      continue;
+    }
+    for (size_type i = 0; i < x.get_row(); ++i) {
+      result(i, active[j]) = x(i, j);
+    }
+  }
+  if (still_active.size() == active.size()) {
+    return false;
+  }
+  x.compact_columns(keep);
+  active.swap(still_active);
+  return true;
+}
+
+// conversions at the solver api boundary.
+template <typename MatrixType>
+dense_block<typename MatrixType::value_type> to_dense_block(const MatrixType& m) {
+  dense_block<typename MatrixType::value_type> result(m.get_row(), m.get_column());
+  for (auto row = m.begin(); row != m.end(); ++row) {
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      result.set_value(col.row_index(), col.column_index(), *col);
+    }
+  }
+  return result;
+}
+
+template <typename MatrixType>
+MatrixType to_matrix(const dense_block<typename MatrixType::value_type>& b) {
+  MatrixType result(b.get_row(), b.get_column());
+  for (size_type i = 0; i < b.get_row(); ++i) {
+    for (size_type j = 0; j < b.get_column(); ++j) {
+      if (b(i, j) != typename MatrixType::value_type(0)) {
+        result.set_value(i + 1, j + 1, b(i, j));
+      }
+    }
+  }
+  return result;
+}
+}
@@ -0,0 +1,228 @@
+#pragma once
+#include "type.h"
+#include "matrix_type_traits.h"
+#include "parallel.h"
+#include "instrument.h"
+#include "allocator.h"
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace pnmatrix {
+// contiguous, cache line aligned column vector used by the solvers for their internal work.
+// operator[] starts by 0, get_value / set_value start by 1 like a n x 1 matrix.
+template <typename ValueType>
+class dense_vector {
+public:
+  using value_type = ValueType;
+
+  dense_vector() = default;
+
+  explicit dense_vector(size_type n, const value_type& v = value_type(0)):data_(n, v) {
+
+  }
+
+  size_type size() const {
+    return data_.size();
+  }
+
+  size_type get_row() const {
+    return data_.size();
+  }
+
+  size_type get_column() const {
+    return 1;
+  }
+
+  void resize(size_type n) {
+    data_.resize(n, value_type(0));
+  }
+
+  void fill(const value_type& v) {
+    std::fill(data_.begin(), data_.end(), v);
+  }
+
+  value_type& operator[](size_type i) {
+    return data_[i];
+  }
+
+  const value_type& operator[](size_type i) const {
+    return data_[i];
+  }
+
+  value_type get_value(size_type row, [[maybe_unused]] size_type column) const {
+    assert(column == 1);
+    return data_[row - 1];
+  }
+
+  void set_value(size_type row, [[maybe_unused]] size_type column, const value_type& v) {
+    assert(column == 1);
+    data_[row - 1] = v;
+  }
+
+  value_type* data() {
+    return data_.data();
+  }
+
+  const value_type* data() const {
+    return data_.data();
+  }
+
+  value_type inner_product(const dense_vector& other) const {
+    assert(size() == other.size());
+    value_type sum = value_type(0);
+    for (size_type i = 0; i < size(); ++i) {
+      sum += data_[i] * other.data_[i];
+    }
+    return sum;
+  }
+
+  value_type get_second_norm() const {
+    return std::sqrt(inner_product(*this));
+  }
+
+  // *this += a * x
+  void add_scaled(const value_type& a, const dense_vector& x) {
+    assert(size() == x.size());
+    for (size_type i = 0; i < size(); ++i) {
+      data_[i] += a * x.data_[i];
+    }
+  }
+
+  void scale(const value_type& a) {
+    for (size_type i = 0; i < size(); ++i) {
+      data_[i] *= a;
+    }
+  }
+
+private:
+  std::vector<value_type, aligned_allocator<value_type>> data_;
+};
+
+// y = A * x for any matrix<> type, one pass over the stored elements of A.
+// containers with their own kernel (layout or block aware) use it.
+template <typename MatrixType, typename ValueType>
+void matrix_vector_multiply(const MatrixType& A, const dense_vector<ValueType>& x, dense_vector<ValueType>& y) {
+  assert(A.get_column() == x.size() && A.get_row() == y.size());
+  PNMATRIX_COUNT("spmv");
+  if constexpr (has_multiply<typename MatrixType::container_type>::value) {
+    A.get_container().multiply(x.data(), y.data());
+    return;
+  }
+  for (auto row = A.begin(); row != A.end(); ++row) {
+    ValueType sum = ValueType(0);
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      sum += *col * x[col.column_index() - 1];
+    }
+    y[row.row_index() - 1] = sum;
+  }
+}
+
+// the same kernels split across an executor. reductions add the partial sums of the chunks in order,
+// so the result only depends on the thread count of ex.
+template <typename MatrixType, typename ValueType>
+void matrix_vector_multiply(executor& ex, const MatrixType& A, const dense_vector<ValueType>& x, dense_vector<ValueType>& y) {
+  using container_type = typename MatrixType::container_type;
+  if constexpr (has_executor_multiply<container_type>::value) {
+    if (ex.get_thread_count() > 1) {
+      assert(A.get_column() == x.size() && A.get_row() == y.size());
+      PNMATRIX_COUNT("spmv");
+      A.get_container().multiply(ex, x.data(), y.data());
+      return;
+    }
+  }
+  else if constexpr (has_range_multiply<container_type>::value) {
+    if (ex.get_thread_count() > 1) {
+      assert(A.get_column() == x.size() && A.get_row() == y.size());
+      PNMATRIX_COUNT("spmv");
+      const container_type& c = A.get_container();
+      parallel_for(ex, 1, A.get_row() + 1, [&](size_type, size_type first, size_type last) {
+        c.multiply(x.data(), y.data(), first, last);
+      });
+      return;
+    }
+  }
+  else if constexpr (has_row_access<container_type>::value) {
+    if (ex.get_thread_count() > 1) {
+      assert(A.get_column() == x.size() && A.get_row() == y.size());
+      PNMATRIX_COUNT("spmv");
+      const container_type& c = A.get_container();
+      parallel_for(ex, 1, A.get_row() + 1, [&](size_type, size_type first, size_type last) {
+        for (size_type row = first; row < last; ++row) {
+          ValueType sum = ValueType(0);
+          c.for_each_in_row(row, [&](size_type column, const ValueType& v) {
+            sum += v * x[column - 1];
+          });
+          y[row - 1] = sum;
+        }
+      });
+      return;
+    }
+  }
+  matrix_vector_multiply(A, x, y);
+}
+
+template <typename ValueType>
+ValueType inner_product(executor& ex, const dense_vector<ValueType>& a, const dense_vector<ValueType>& b) {
+  assert(a.size() == b.size());
+  if (ex.get_thread_count() <= 1) {
+    return a.inner_product(b);
+  }
+  std::vector<ValueType> partial(std::max<size_type>(1, ex.get_thread_count()), ValueType(0));
+  parallel_for(ex, 0, a.size(), [&](size_type t, size_type first, size_type last) {
+    ValueType sum = ValueType(0);
+    for (size_type i = first; i < last; ++i) {
+      sum += a[i] * b[i];
+    }
+    partial[t] = sum;
+  });
+  ValueType sum = ValueType(0);
+  for (const ValueType& each : partial) {
+    sum += each;
+  }
+  return sum;
+}
+
+template <typename ValueType>
+ValueType get_second_norm(executor& ex, const dense_vector<ValueType>& a) {
+  return std::sqrt(inner_product(ex, a, a));
+}
+
+// y += a * x
+template <typename ValueType>
+void add_scaled(executor& ex, dense_vector<ValueType>& y, const ValueType& a, const dense_vector<ValueType>& x) {
+  assert(y.size() == x.size());
+  parallel_for(ex, 0, y.size(), [&](size_type, size_type first, size_type last) {
+    for (size_type i = first; i < last; ++i) {
+      y[i] += a * x[i];
+    }
+  });
+}
+
+// conversions at the solver api boundary.
+template <typename MatrixType>
+dense_vector<typename MatrixType::value_type> to_dense_vector(const MatrixType& m) {
+  assert(m.get_column() == 1);
+  dense_vector<typename MatrixType::value_type> result(m.get_row());
+  for (auto row = m.begin(); row != m.end(); ++row) {
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      result[col.row_index() - 1] = *col;
+    }
+  }
+  return result;
+}
+
+template <typename MatrixType>
+MatrixType to_matrix(const dense_vector<typename MatrixType::value_type>& v) {
+  MatrixType result(v.size(), 1);
+  for (size_type i = 0; i < v.size(); ++i) {
+    if (v[i] != typename MatrixType::value_type(0)) {
+      result.set_value(i + 1, 1, v[i]);
+    }
+  }
+  return result;
+}
+}
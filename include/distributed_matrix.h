@@ -0,0 +1,348 @@
+#pragma once
+#include "type.h"
+#include "communicator.h"
+#include "executor.h"
+#include "dense_vector.h"
+#include "instrument.h"
+#include "matrix.h"
+#include "matrix_storage_cep.h"
+#include <algorithm>
+#include <vector>
+#include <cassert>
+#include <cmath>
+
+namespace pnmatrix {
+// rank r owns the rows [get_first_row(r), get_last_row(r)), 0-based.
+class row_partition {
+public:
+  // about n / size rows per rank.
+  row_partition(size_type n, int size):first_row_(size + 1) {
+    assert(size >= 1);
+    for (int r = 0; r <= size; ++r) {
+      first_row_[r] = n * r / size;
+    }
+  }
+
+  // first_row has one entry per rank plus the total row count.
+  explicit row_partition(std::vector<size_type> first_row):first_row_(std::move(first_row)) {
+    assert(first_row_.size() >= 2 && first_row_[0] == 0);
+    assert(std::is_sorted(first_row_.begin(), first_row_.end()));
+  }
+
+  size_type get_row() const {
+    return first_row_.back();
+  }
+
+  int get_rank_count() const {
+    return (int)first_row_.size() - 1;
+  }
+
+  size_type get_first_row(int rank) const {
+    return first_row_[rank];
+  }
+
+  size_type get_last_row(int rank) const {
+    return first_row_[rank + 1];
+  }
+
+  size_type get_local_row(int rank) const {
+    return first_row_[rank + 1] - first_row_[rank];
+  }
+
+  int get_owner(size_type row) const {
+    assert(row >= 0 && row < get_row());
+    return (int)(std::upper_bound(first_row_.begin(), first_row_.end(), row) - first_row_.begin()) - 1;
+  }
+
+private:
+  std::vector<size_type> first_row_;
+};
+
+// the rows of a vector owned by this rank.
+template <typename ValueType>
+class distributed_vector {
+public:
+  using value_type = ValueType;
+
+  distributed_vector(communicator& comm, const row_partition& partition):comm_(&comm), partition_(&partition),
+    local_(partition.get_local_row(comm.get_rank())) {
+    assert(partition.get_rank_count() == comm.get_size());
+  }
+
+  communicator& get_communicator() const {
+    return *comm_;
+  }
+
+  const row_partition& get_partition() const {
+    return *partition_;
+  }
+
+  // global size.
+  size_type size() const {
+    return partition_->get_row();
+  }
+
+  size_type get_first_row() const {
+    return partition_->get_first_row(comm_->get_rank());
+  }
+
+  size_type get_local_size() const {
+    return local_.size();
+  }
+
+  // local element i, global row get_first_row() + i.
+  value_type& operator[](size_type i) {
+    return local_[i];
+  }
+
+  const value_type& operator[](size_type i) const {
+    return local_[i];
+  }
+
+  dense_vector<value_type>& get_local() {
+    return local_;
+  }
+
+  const dense_vector<value_type>& get_local() const {
+    return local_;
+  }
+
+  void fill(const value_type& v) {
+    local_.fill(v);
+  }
+
+  void scale(const value_type& a) {
+    local_.scale(a);
+  }
+
+  // *this += a * x
+  void add_scaled(const value_type& a, const distributed_vector& x) {
+    local_.add_scaled(a, x.local_);
+  }
+
+private:
+  communicator* comm_;
+  const row_partition* partition_;
+  dense_vector<value_type> local_;
+};
+
+// one collective reduction.
+template <typename ValueType>
+ValueType inner_product(const distributed_vector<ValueType>& a, const distributed_vector<ValueType>& b) {
+  double sum = double(a.get_local().inner_product(b.get_local()));
+  a.get_communicator().all_reduce_sum(&sum, 1);
+  return ValueType(sum);
+}
+
+template <typename ValueType>
+ValueType get_second_norm(const distributed_vector<ValueType>& a) {
+  return std::sqrt(inner_product(a, a));
+}
+
+// a square matrix split by rows over the ranks of a communicator. each rank keeps its rows as a
+// block on its own columns and a block on the ghost columns, the columns owned by other ranks
+// that its rows refer to. multiply sends the ghost values first and works on the local block
+// while they travel.
+template <typename ValueType>
+class distributed_matrix {
+public:
+  using value_type = ValueType;
+
+  struct option {
+    // runs the local products, nullptr means the calling thread only.
+    executor* exec = nullptr;
+  };
+
+  // collective. rows holds the rows owned by this rank with global 1-based column indices,
+  // every rank owns at least one row.
+  distributed_matrix(communicator& comm, const row_partition& partition, const matrix<matrix_storage_cep<ValueType>>& rows)
+    :distributed_matrix(comm, partition, rows, option()) {
+
+  }
+
+  distributed_matrix(communicator& comm, const row_partition& partition, const matrix<matrix_storage_cep<ValueType>>& rows, option op)
+    :comm_(&comm), partition_(&partition), exec_(op.exec),
+     local_(partition.get_local_row(comm.get_rank()), partition.get_local_row(comm.get_rank())),
+     ghost_(partition.get_local_row(comm.get_rank()), 1) {
+    assert(partition.get_rank_count() == comm.get_size());
+    assert(rows.get_row() == partition.get_local_row(comm.get_rank()) && rows.get_column() == partition.get_row());
+    int rank = comm.get_rank();
+    size_type first = partition.get_first_row(rank);
+    size_type last = partition.get_last_row(rank);
+    const auto& c = rows.get_container();
+
+    std::vector<size_type> ghost_columns;
+    for (size_type row = 1; row <= rows.get_row(); ++row) {
+      c.for_each_in_row(row, [&](size_type column, const value_type&) {
+        if (column - 1 < first || column - 1 >= last) {
+          ghost_columns.push_back(column - 1);
+        }
+      });
+    }
+    std::sort(ghost_columns.begin(), ghost_columns.end());
+    ghost_columns.erase(std::unique(ghost_columns.begin(), ghost_columns.end()), ghost_columns.end());
+    size_type ghost_count = ghost_columns.size();
+    if (ghost_count > 0) {
+      ghost_ = matrix<matrix_storage_cep<value_type>>(rows.get_row(), ghost_count);
+    }
+    auto& lc = local_.get_container();
+    auto& gc = ghost_.get_container();
+    for (size_type row = 1; row <= rows.get_row(); ++row) {
+      c.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        if (column - 1 >= first && column - 1 < last) {
+          lc.set_value(row, column - first, v);
+        }
+        else {
+          size_type g = std::lower_bound(ghost_columns.begin(), ghost_columns.end(), column - 1) - ghost_columns.begin();
+          gc.set_value(row, g + 1, v);
+        }
+      });
+    }
+    ghost_values_.resize(ghost_count);
+
+    // the ghost columns are sorted, so the ones of each owner are contiguous.
+    for (size_type g = 0; g < ghost_count;) {
+      int owner = partition.get_owner(ghost_columns[g]);
+      size_type end = g;
+      while (end < ghost_count && ghost_columns[end] < partition.get_last_row(owner)) {
+        ++end;
+      }
+      receives_.push_back(neighbour{owner, g, end});
+      g = end;
+    }
+    // tell every rank which of its rows we need, learn which of ours they need.
+    std::vector<size_type> counts(comm.get_size(), 0);
+    for (const neighbour& n : receives_) {
+      counts[n.rank] = n.end - n.begin;
+    }
+    for (int r = 0; r < comm.get_size(); ++r) {
+      if (r == rank) {
+        continue;
+      }
+      comm.send(r, setup_count_tag, &counts[r], sizeof(size_type));
+    }
+    for (const neighbour& n : receives_) {
+      comm.send(n.rank, setup_index_tag, &ghost_columns[n.begin], (n.end - n.begin) * sizeof(size_type));
+    }
+    for (int r = 0; r < comm.get_size(); ++r) {
+      if (r == rank) {
+        continue;
+      }
+      size_type count = 0;
+      comm.receive(r, setup_count_tag, &count, sizeof(size_type));
+      if (count == 0) {
+        continue;
+      }
+      size_type begin = send_rows_.size();
+      send_rows_.resize(begin + count);
+      comm.receive(r, setup_index_tag, &send_rows_[begin], count * sizeof(size_type));
+      for (size_type i = begin; i < begin + count; ++i) {
+        assert(send_rows_[i] >= first && send_rows_[i] < last);
+        send_rows_[i] -= first;
+      }
+      sends_.push_back(neighbour{r, begin, begin + count});
+    }
+    send_values_.resize(send_rows_.size());
+    comm.flush();
+  }
+
+  distributed_matrix(const distributed_matrix&) = delete;
+  distributed_matrix& operator=(const distributed_matrix&) = delete;
+
+  communicator& get_communicator() const {
+    return *comm_;
+  }
+
+  const row_partition& get_partition() const {
+    return *partition_;
+  }
+
+  size_type get_row() const {
+    return partition_->get_row();
+  }
+
+  size_type get_column() const {
+    return partition_->get_row();
+  }
+
+  // columns of other ranks referred to by the local rows.
+  size_type get_ghost_count() const {
+    return ghost_values_.size();
+  }
+
+  // ranks this rank receives from per multiply.
+  size_type get_neighbour_count() const {
+    return receives_.size();
+  }
+
+  // collective, y = A * x. not safe to call from two threads of one rank at the same time.
+  void multiply(const distributed_vector<value_type>& x, distributed_vector<value_type>& y) const {
+    PNMATRIX_COUNT("distributed.spmv");
+    for (const neighbour& n : sends_) {
+      for (size_type i = n.begin; i < n.end; ++i) {
+        send_values_[i] = x[send_rows_[i]];
+      }
+      comm_->send(n.rank, multiply_tag, &send_values_[n.begin], (n.end - n.begin) * sizeof(value_type));
+    }
+    matrix_vector_multiply(get_executor(), local_, x.get_local(), y.get_local());
+    for (const neighbour& n : receives_) {
+      comm_->receive(n.rank, multiply_tag, &ghost_values_[n.begin], (n.end - n.begin) * sizeof(value_type));
+    }
+    if (ghost_values_.empty() == false) {
+      const auto& gc = ghost_.get_container();
+      for (size_type row = 1; row <= ghost_.get_row(); ++row) {
+        value_type sum = value_type(0);
+        gc.for_each_in_row(row, [&](size_type column, const value_type& v) {
+          sum += v * ghost_values_[column - 1];
+        });
+        y[row - 1] += sum;
+      }
+    }
+    comm_->flush();
+  }
+
+private:
+  static constexpr int setup_count_tag = 1;
+  static constexpr int setup_index_tag = 2;
+  static constexpr int multiply_tag = 3;
+
+  // values [begin, end) of the send or ghost buffer go to or come from rank.
+  struct neighbour {
+    int rank;
+    size_type begin;
+    size_type end;
+  };
+
+  communicator* comm_;
+  const row_partition* partition_;
+  executor* exec_;
+  matrix<matrix_storage_cep<value_type>> local_;
+  matrix<matrix_storage_cep<value_type>> ghost_;
+  std::vector<neighbour> sends_;
+  std::vector<neighbour> receives_;
+  // local rows sent to each neighbour.
+  std::vector<size_type> send_rows_;
+  mutable std::vector<value_type> send_values_;
+  mutable std::vector<value_type> ghost_values_;
+
+  executor& get_executor() const {
+    return exec_ == nullptr ? get_inline_executor() : *exec_;
+  }
+};
+
+// the rows [get_first_row(rank), get_last_row(rank)) of A, for building a distributed matrix from
+// one that every rank can see.
+template <typename ValueType>
+matrix<matrix_storage_cep<ValueType>> get_row_block(const matrix<matrix_storage_cep<ValueType>>& A, const row_partition& partition, int rank) {
+  size_type first = partition.get_first_row(rank);
+  matrix<matrix_storage_cep<ValueType>> result(partition.get_local_row(rank), A.get_column());
+  auto& c = result.get_container();
+  const auto& a = A.get_container();
+  for (size_type row = 1; row <= partition.get_local_row(rank); ++row) {
+    a.for_each_in_row(first + row, [&](size_type column, const ValueType& v) {
+      c.set_value(row, column, v);
+    });
+  }
+  return result;
+}
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include "type.h"
+#include "communicator.h"
+#include "distributed_matrix.h"
+#include "gmres_solver.h"
+#include "solve_control.h"
+#include "instrument.h"
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace pnmatrix {
+namespace detail {
+// sums values[0, count) over the ranks and tells whether any rank asked to stop. every rank has
+// its own solve_control, a cancel or deadline seen by one rank reaches the others through the
+// next reduction, so all ranks leave the iteration together.
+inline bool all_reduce_with_stop(communicator& comm, tracked_vector<double>& values, size_type count, bool stop) {
+  values[count] = stop == true ? 1.0 : 0.0;
+  comm.all_reduce_sum(values.data(), count + 1);
+  return values[count] > 0.0;
+}
+}
+
+// conjugate gradients for a symmetric positive definite distributed matrix. every rank calls solve
+// with its own rows of b and x, x holds the initial guess on entry.
+class distributed_cg {
+private:
+  double rm_;
+  size_type max_iteration_;
+
+public:
+  struct option {
+    double rm = 1e-6;
+    // 0 means no limit.
+    size_type max_iteration = 0;
+  };
+
+  distributed_cg(option op):rm_(op.rm), max_iteration_(op.max_iteration) {
+
+  }
+
+  template<class ValueType>
+  void solve(const distributed_matrix<ValueType>& A, const distributed_vector<ValueType>& b, distributed_vector<ValueType>& x) {
+    solve_control control;
+    solve(A, b, x, control);
+  }
+
+  template<class ValueType>
+  void solve(const distributed_matrix<ValueType>& A, const distributed_vector<ValueType>& b, distributed_vector<ValueType>& x, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("distributed_cg.solve");
+    using value_type = ValueType;
+    communicator& comm = A.get_communicator();
+    distributed_vector<value_type> r(comm, A.get_partition());
+    distributed_vector<value_type> p(comm, A.get_partition());
+    distributed_vector<value_type> q(comm, A.get_partition());
+    tracked_vector<double> reduce(2);
+    value_type b_norm = get_second_norm(b);
+    A.multiply(x, r);
+    r.scale(value_type(-1));
+    r.add_scaled(value_type(1), b);
+    p = r;
+    value_type rr = inner_product(r, r);
+    if (std::sqrt(rr) <= rm_ * b_norm) {
+      control.finish(solve_status::converged);
+      return;
+    }
+    size_type iteration = 0;
+    bool stop = false;
+    while (true) {
+      A.multiply(p, q);
+      reduce[0] = double(p.get_local().inner_product(q.get_local()));
+      if (detail::all_reduce_with_stop(comm, reduce, 1, stop) == true) {
+        control.finish(solve_status::cancelled);
+        return;
+      }
+      value_type alpha = rr / value_type(reduce[0]);
+      x.add_scaled(alpha, p);
+      r.add_scaled(- alpha, q);
+      value_type rr_next = inner_product(r, r);
+      ++iteration;
+      value_type rm = std::sqrt(rr_next) / b_norm;
+      if (rm <= rm_) {
+        control.next_iteration(iteration, rm);
+        control.finish(solve_status::converged);
+        return;
+      }
+      // every rank sees the same iteration count, so leaving here is collective. a rank that stopped
+      // keeps its cancelled / deadline status, finish only sets the first one.
+      stop = control.next_iteration(iteration, rm) == false;
+      if (iteration == max_iteration_) {
+        control.finish(solve_status::max_iteration_reached);
+        return;
+      }
+      p.scale(rr_next / rr);
+      p.add_scaled(value_type(1), r);
+      rr = rr_next;
+    }
+  }
+};
+
+// restarted gmres on a distributed matrix. the arnoldi step is classical gram-schmidt, the inner
+// products with the whole basis and |w|^2 share one reduction and h(m + 1, m) comes from
+// |w|^2 - sum h^2. when that loses more than half of |w|^2 the step orthogonalizes a second time,
+// again with one reduction. every rank calls solve with its own rows of b and x, x holds the
+// initial guess on entry.
+class distributed_gmres {
+private:
+  double rm_;
+  size_type m_;
+  size_type max_iteration_;
+
+public:
+  struct option {
+    double rm = 1e-6;
+    size_type m = 30;
+    // inner iterations over all restarts, 0 means no limit.
+    size_type max_iteration = 0;
+  };
+
+  distributed_gmres(option op):rm_(op.rm), m_(op.m), max_iteration_(op.max_iteration) {
+
+  }
+
+  template<class ValueType>
+  void solve(const distributed_matrix<ValueType>& A, const distributed_vector<ValueType>& b, distributed_vector<ValueType>& x) {
+    solve_control control;
+    solve(A, b, x, control);
+  }
+
+  template<class ValueType>
+  void solve(const distributed_matrix<ValueType>& A, const distributed_vector<ValueType>& b, distributed_vector<ValueType>& x, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("distributed_gmres.solve");
+    using value_type = ValueType;
+    communicator& comm = A.get_communicator();
+    size_type restart_m = m_;
+    tracked_vector<distributed_vector<value_type>> Vm;
+    for (size_type i = 0; i <= restart_m; ++i) {
+      Vm.emplace_back(comm, A.get_partition());
+    }
+    distributed_vector<value_type> wm(comm, A.get_partition());
+    tracked_vector<value_type> y(restart_m);
+    tracked_vector<double> reduce(restart_m + 2);
+    detail::givens_hessenberg<value_type> hessenberg;
+    size_type local = x.get_local_size();
+    value_type b_norm = get_second_norm(b);
+    size_type iteration = 0;
+    bool stop = false;
+
+    // x += V(0 ... m - 1) * y
+    auto update = [&](size_type m) {
+      if (m == 0) {
+        return;
+      }
+      hessenberg.solve(m, y.data());
+      for (size_type i = 1; i <= m; ++i) {
+        x.add_scaled(y[i - 1], Vm[i - 1]);
+      }
+    };
+
+    while (true) {
+      distributed_vector<value_type>& r0 = Vm[0];
+      A.multiply(x, r0);
+      r0.scale(value_type(-1));
+      r0.add_scaled(value_type(1), b);
+      reduce[0] = double(r0.get_local().inner_product(r0.get_local()));
+      if (detail::all_reduce_with_stop(comm, reduce, 1, stop) == true) {
+        control.finish(solve_status::cancelled);
+        return;
+      }
+      value_type beta = std::sqrt(value_type(reduce[0]));
+      if (beta <= rm_ * b_norm) {
+        control.finish(solve_status::converged);
+        return;
+      }
+      r0.scale(value_type(1) / beta);
+      hessenberg.reset(restart_m, beta);
+
+      for (size_type m = 1; m <= restart_m; ++m) {
+        A.multiply(Vm[m - 1], wm);
+        for (size_type i = 1; i <= m; ++i) {
+          reduce[i - 1] = double(wm.get_local().inner_product(Vm[i - 1].get_local()));
+        }
+        reduce[m] = double(wm.get_local().inner_product(wm.get_local()));
+        if (detail::all_reduce_with_stop(comm, reduce, m + 1, stop) == true) {
+          update(m - 1);
+          control.finish(solve_status::cancelled);
+          return;
+        }
+        value_type* h = hessenberg.column(m);
+        value_type ww = value_type(reduce[m]);
+        value_type hh = ww;
+        for (size_type i = 1; i <= m; ++i) {
+          h[i - 1] = value_type(reduce[i - 1]);
+          hh -= h[i - 1] * h[i - 1];
+          wm.add_scaled(- h[i - 1], Vm[i - 1]);
+        }
+        if (hh <= ww / value_type(2)) {
+          // cancellation, the projected w is not orthogonal enough to the basis.
+          for (size_type i = 1; i <= m; ++i) {
+            reduce[i - 1] = double(wm.get_local().inner_product(Vm[i - 1].get_local()));
+          }
+          reduce[m] = double(wm.get_local().inner_product(wm.get_local()));
+          comm.all_reduce_sum(reduce.data(), m + 1);
+          hh = value_type(reduce[m]);
+          for (size_type i = 1; i <= m; ++i) {
+            value_type c = value_type(reduce[i - 1]);
+            h[i - 1] += c;
+            hh -= c * c;
+            wm.add_scaled(- c, Vm[i - 1]);
+          }
+        }
+        value_type h_mplus_m = std::sqrt(std::max(hh, value_type(0)));
+        h[m] = h_mplus_m;
+
+        value_type rm = hessenberg.add_column(m) / b_norm;
+        ++iteration;
+        bool done = true;
+        if (rm <= rm_) {
+          control.next_iteration(iteration, rm);
+          control.finish(solve_status::converged);
+        }
+        else {
+          stop = control.next_iteration(iteration, rm) == false;
+          if (iteration == max_iteration_) {
+            control.finish(solve_status::max_iteration_reached);
+          }
+          else {
+            done = false;
+          }
+        }
+        if (done == true || m == restart_m) {
+          update(m);
+          if (done == true) {
+            return;
+          }
+          break;
+        }
+        assert(value_equal(value_type(0), h_mplus_m) == false);
+        for (size_type i = 0; i < local; ++i) {
+          Vm[m][i] = wm[i] / h_mplus_m;
+        }
+      }
+    }
+  }
+};
+}
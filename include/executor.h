@@ -0,0 +1,249 @@
+#pragma once
+#include "type.h"
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace pnmatrix {
+namespace detail {
+// > 0 while the current thread runs a task of some executor, nested bulk calls then run inline.
+inline thread_local size_type parallel_depth = 0;
+
+struct parallel_region {
+  parallel_region() {
+    ++parallel_depth;
+  }
+
+  ~parallel_region() {
+    --parallel_depth;
+  }
+};
+}
+
+// runs task_count independent tasks f(0) ... f(task_count - 1) and returns when all of them are done.
+// kernels split their work into get_thread_count() chunks.
+class executor {
+public:
+  virtual ~executor() = default;
+
+  virtual size_type get_thread_count() const = 0;
+
+  virtual void bulk(size_type task_count, const std::function<void(size_type)>& f) = 0;
+
+  static bool in_parallel_region() {
+    return detail::parallel_depth > 0;
+  }
+};
+
+// everything on the calling thread, the default of the solvers.
+class inline_executor : public executor {
+public:
+  size_type get_thread_count() const override {
+    return 1;
+  }
+
+  void bulk(size_type task_count, const std::function<void(size_type)>& f) override {
+    detail::parallel_region region;
+    for (size_type i = 0; i < task_count; ++i) {
+      f(i);
+    }
+  }
+};
+
+inline executor& get_inline_executor() {
+  static inline_executor ex;
+  return ex;
+}
+
+// fixed set of workers, each with its own deque. a worker pops from the back of its deque and
+// steals from the front of the others, the thread calling bulk works too until its tasks are done.
+// bulk inside a task runs inline, so nested parallel regions never oversubscribe the cores.
+class thread_pool : public executor {
+public:
+  struct option {
+    // counts the calling thread, 0 means std::thread::hardware_concurrency().
+    size_type thread_count = 0;
+    // pins worker i to cpu i % hardware_concurrency(), the workers count from 1 after the calling
+    // thread, linux only.
+    bool pin_threads = false;
+  };
+
+  thread_pool():thread_pool(option()) {
+
+  }
+
+  explicit thread_pool(option op):stop_(false), pending_(0) {
+    size_type n = op.thread_count;
+    if (n <= 0) {
+      n = std::max<size_type>(1, std::thread::hardware_concurrency());
+    }
+    for (size_type i = 0; i < n; ++i) {
+      queues_.emplace_back(new task_queue());
+    }
+    for (size_type i = 1; i < n; ++i) {
+      workers_.emplace_back([this, i]() {
+        worker_loop(i);
+      });
+      if (op.pin_threads == true) {
+        pin(workers_.back(), i);
+      }
+    }
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& each : workers_) {
+      each.join();
+    }
+  }
+
+  size_type get_thread_count() const override {
+    return queues_.size();
+  }
+
+  void bulk(size_type task_count, const std::function<void(size_type)>& f) override {
+    if (task_count <= 0) {
+      return;
+    }
+    if (task_count == 1 || workers_.empty() || in_parallel_region()) {
+      detail::parallel_region region;
+      for (size_type i = 0; i < task_count; ++i) {
+        f(i);
+      }
+      return;
+    }
+    std::atomic<size_type> remaining(task_count);
+    // task 0 stays with the caller, the others are dealt round robin to the workers.
+    for (size_type i = 1; i < task_count; ++i) {
+      task_queue& q = *queues_[1 + (i - 1) % workers_.size()];
+      std::lock_guard<std::mutex> lock(q.mutex_);
+      q.tasks_.push_back(task{&f, i, &remaining});
+    }
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      pending_ += task_count - 1;
+    }
+    wake_.notify_all();
+    run(task{&f, 0, &remaining});
+    task t;
+    while (remaining.load(std::memory_order_acquire) > 0) {
+      if (try_steal(0, t) == true) {
+        run_queued(t);
+      }
+      else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  struct task {
+    const std::function<void(size_type)>* f_;
+    size_type index_;
+    std::atomic<size_type>* remaining_;
+  };
+
+  struct task_queue {
+    std::mutex mutex_;
+    std::deque<task> tasks_;
+  };
+
+  std::vector<std::unique_ptr<task_queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  size_type pending_;
+
+  void run(const task& t) {
+    {
+      detail::parallel_region region;
+      (*t.f_)(t.index_);
+    }
+    t.remaining_->fetch_sub(1, std::memory_order_release);
+  }
+
+  void run_queued(const task& t) {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      --pending_;
+    }
+    run(t);
+  }
+
+  bool try_pop(size_type self, task& t) {
+    task_queue& q = *queues_[self];
+    std::lock_guard<std::mutex> lock(q.mutex_);
+    if (q.tasks_.empty()) {
+      return false;
+    }
+    t = q.tasks_.back();
+    q.tasks_.pop_back();
+    return true;
+  }
+
+  bool try_steal(size_type self, task& t) {
+    size_type n = queues_.size();
+    for (size_type k = 1; k < n; ++k) {
+      task_queue& q = *queues_[(self + k) % n];
+      std::lock_guard<std::mutex> lock(q.mutex_);
+      if (q.tasks_.empty() == false) {
+        t = q.tasks_.front();
+        q.tasks_.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void worker_loop(size_type self) {
+    task t;
+    while (true) {
+      if (try_pop(self, t) == true || try_steal(self, t) == true) {
+        run_queued(t);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      wake_.wait(lock, [this]() {
+        return stop_ == true || pending_ > 0;
+      });
+      if (stop_ == true && pending_ == 0) {
+        return;
+      }
+    }
+  }
+
+  static void pin(std::thread& t, size_type i) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    size_type cpus = std::max<size_type>(1, std::thread::hardware_concurrency());
+    CPU_SET(i % cpus, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &set);
+#endif
+  }
+};
+
+// shared pool behind the thread_count arguments of the kernels, created on first use.
+inline thread_pool& get_default_thread_pool() {
+  static thread_pool pool;
+  return pool;
+}
+}
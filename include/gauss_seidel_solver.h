@@ -2,6 +2,12 @@
 
 #include "type.h"
 #include "value_compare.h"
+#include "dense_vector.h"
+#include "dense_block.h"
+#include "solve_control.h"
+#include "instrument.h"
+#include <vector>
+#include <algorithm>
 #include <utility>
 #include <cassert>
 #include <cmath>
@@ -11,75 +17,210 @@ namespace pnmatrix {
 class gauss_seidel {
 private:
   double rm_;
+  size_type max_iteration_;
 
 public:
   struct option {
     double rm = 1e-6;
+    // 0 means no limit.
+    size_type max_iteration = 0;
   };
 
-  gauss_seidel(option op):rm_(op.rm) {
+  gauss_seidel(option op):rm_(op.rm),max_iteration_(op.max_iteration) {
 
   }
 
   template<class MatrixType>
   MatrixType solve(MatrixType& coeff, MatrixType& b) {
-    assert(coeff.get_column() == b.get_row() && b.get_column() == 1);
-    size_type x_count = coeff.get_column();
-    MatrixType x_prev(x_count, 1);
-    MatrixType x_next(x_count, 1);
-    size_t times = 1;
+    solve_control control;
+    return solve(coeff, b, control);
+  }
+
+  template<class MatrixType>
+  MatrixType solve(MatrixType& coeff, MatrixType& b, solve_control& control) {
+    MatrixType x0(coeff.get_column(), b.get_column());
+    return solve(coeff, b, x0, control);
+  }
+
+  template<class MatrixType>
+  MatrixType solve(MatrixType& coeff, MatrixType& b, const MatrixType& x0) {
+    solve_control control;
+    return solve(coeff, b, x0, control);
+  }
+
+  // starts from x0. stops early when control is cancelled or its deadline passes and returns the
+  // current iterate, the outcome is left in control.get_status().
+  template<class MatrixType>
+  MatrixType solve(MatrixType& coeff, MatrixType& b, const MatrixType& x0, solve_control& control) {
+    assert(coeff.get_column() == b.get_row());
+    assert(x0.get_row() == coeff.get_column() && x0.get_column() == b.get_column());
+    using value_type = typename MatrixType::value_type;
+    if (b.get_column() > 1) {
+      dense_block<value_type> x = to_dense_block(x0);
+      solve_block(coeff, to_dense_block(b), x, control);
+      return to_matrix<MatrixType>(x);
+    }
+    dense_vector<value_type> x = to_dense_vector(x0);
+    solve(coeff, to_dense_vector(b), x, control);
+    return to_matrix<MatrixType>(x);
+  }
+
+  template<class MatrixType, class ValueType>
+  void solve(const MatrixType& coeff, const dense_vector<ValueType>& b, dense_vector<ValueType>& x) {
+    solve_control control;
+    solve(coeff, b, x, control);
+  }
+
+  // x is the initial guess on entry and the solution on return. the sweep works in place,
+  // so there is no workspace and nothing is allocated.
+  template<class MatrixType, class ValueType>
+  void solve(const MatrixType& coeff, const dense_vector<ValueType>& rhs, dense_vector<ValueType>& x, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("gauss_seidel.solve");
+    PNMATRIX_ALLOCATION_SCOPE("gauss_seidel.solve");
+    using value_type = ValueType;
+    assert(coeff.get_column() == rhs.size() && x.size() == coeff.get_column());
+    // the rows are updated in order, so one vector holds x_next for the columns before the row
+    // and x_prev for the columns behind it.
+    size_type times = 1;
     while (true) {
+      double max_err = 0;
       for (auto row_iter = coeff.begin(); row_iter != coeff.end(); ++row_iter) {
-        double result = 0;
-        double sum = 0;
         size_type row = row_iter.row_index();
-        for (auto colu_iter = row_iter.begin(); colu_iter != row_iter.end(); ++colu_iter) {
-          if (colu_iter.column_index() < row) {
-            sum += (*colu_iter) * x_next.get_value(colu_iter.column_index(), 1);
-          }
-          else if(colu_iter.column_index() >= row + 1){
-            sum += (*colu_iter) * x_prev.get_value(colu_iter.column_index(), 1);
-          }
+        value_type result = row_update(row_iter, rhs, x);
+        double error = std::abs(result - x[row - 1]);
+        if (error > max_err) {
+          max_err = error;
         }
+        x[row - 1] = result;
+      }
+      if (max_err <= rm_) {
+        control.next_iteration(times, max_err);
+        control.finish(solve_status::converged);
+        return;
+      }
+      if (control.next_iteration(times, max_err) == false) {
+        return;
+      }
+      if (times == max_iteration_) {
+        control.finish(solve_status::max_iteration_reached);
+        return;
+      }
+      ++times;
+    }
+  }
 
-        result = b.get_value(row, 1) - sum;
+  // `sweeps` forward sweeps over x in place and nothing else : no update norm, no solve_control.
+  // x moves by a fixed linear map, what a multigrid smoother needs.
+  template<class MatrixType, class ValueType>
+  static void sweep(const MatrixType& coeff, const dense_vector<ValueType>& rhs, dense_vector<ValueType>& x, size_type sweeps) {
+    for (size_type s = 0; s < sweeps; ++s) {
+      for (auto row_iter = coeff.begin(); row_iter != coeff.end(); ++row_iter) {
+        x[row_iter.row_index() - 1] = row_update(row_iter, rhs, x);
+      }
+    }
+  }
+
+  // every column of b is an independent system sharing coeff, one sweep reads each row of coeff
+  // once for all columns and a column leaves the sweep when its largest update is small enough.
+  template<class MatrixType>
+  dense_block<typename MatrixType::value_type> solve_block(const MatrixType& coeff, const dense_block<typename MatrixType::value_type>& b) {
+    solve_control control;
+    return solve_block(coeff, b, control);
+  }
+
+  template<class MatrixType>
+  dense_block<typename MatrixType::value_type> solve_block(const MatrixType& coeff, const dense_block<typename MatrixType::value_type>& b, solve_control& control) {
+    dense_block<typename MatrixType::value_type> x(coeff.get_column(), b.get_column());
+    solve_block(coeff, b, x, control);
+    return x;
+  }
 
-        double t = coeff.get_value(row, row);
-        result = result / t;
-        if (value_equal(t, 0.0) == true) {
-          x_next.set_value(row, 1, 0);
+  // x holds the initial guesses on entry and the solutions on return.
+  template<class MatrixType>
+  void solve_block(const MatrixType& coeff, const dense_block<typename MatrixType::value_type>& b, dense_block<typename MatrixType::value_type>& result, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("gauss_seidel.solve_block");
+    PNMATRIX_ALLOCATION_SCOPE("gauss_seidel.solve_block");
+    assert(coeff.get_column() == b.get_row());
+    assert(result.get_row() == coeff.get_column() && result.get_column() == b.get_column());
+    using value_type = typename MatrixType::value_type;
+    tracked_vector<size_type> active(b.get_column());
+    for (size_type j = 0; j < b.get_column(); ++j) {
+      active[j] = j;
+    }
+    dense_block<value_type> rhs = b;
+    dense_block<value_type> x = result;
+    tracked_vector<value_type> sum(b.get_column());
+    tracked_vector<double> max_err(b.get_column());
+    tracked_vector<bool> keep;
+    size_type times = 1;
+    while (active.empty() == false) {
+      size_type k = active.size();
+      std::fill(max_err.begin(), max_err.begin() + k, 0.0);
+      for (auto row_iter = coeff.begin(); row_iter != coeff.end(); ++row_iter) {
+        std::fill(sum.begin(), sum.begin() + k, value_type(0));
+        value_type t = 0;
+        size_type row = row_iter.row_index();
+        for (auto colu_iter = row_iter.begin(); colu_iter != row_iter.end(); ++colu_iter) {
+          if (colu_iter.column_index() == row) {
+            t = *colu_iter;
+            continue;
+          }
+          const value_type v = *colu_iter;
+          const value_type* xr = x.row_data(colu_iter.column_index() - 1);
+          for (size_type j = 0; j < k; ++j) {
+            sum[j] += v * xr[j];
+          }
         }
-        else {
-          x_next.set_value(row, 1, result);
+        value_type* xr = x.row_data(row - 1);
+        const value_type* r = rhs.row_data(row - 1);
+        for (size_type j = 0; j < k; ++j) {
+          value_type next = value_equal(t, value_type(0)) == true ? value_type(0) : (r[j] - sum[j]) / t;
+          max_err[j] = std::max(max_err[j], double(std::abs(next - xr[j])));
+          xr[j] = next;
         }
       }
-      double max_err = max_error(x_prev, x_next);
-      if (max_err <= rm_) {
-        break;
+      double worst = 0;
+      keep.resize(k);
+      for (size_type j = 0; j < k; ++j) {
+        keep[j] = max_err[j] > rm_;
+        worst = keep[j] == true ? std::max(worst, max_err[j]) : worst;
       }
-      else {
-        std::swap(x_prev, x_next);
-        ++times;
+      bool go_on = control.next_iteration(times, worst);
+      if (go_on == true && times == max_iteration_) {
+        control.finish(solve_status::max_iteration_reached);
+        go_on = false;
+      }
+      if (go_on == false) {
+        keep.assign(k, false);
       }
+      if (retire_columns(keep, x, result, active) == true) {
+        rhs.compact_columns(keep);
+      }
+      ++times;
     }
-    return x_next;
+    control.finish(solve_status::converged);
   }
 
 private:
-  template<class MatrixType>
-  double max_error(MatrixType& m1, MatrixType& m2) {
-    assert(m1.get_column() == m2.get_column() && m1.get_row() == m1.get_row());
-    double max_err = 0;
-    for (size_type row = 1; row <= m1.get_row(); ++row) {
-      for (size_type colu = 1; colu <= m1.get_column(); ++colu) {
-        double error = m1.get_value(row, colu) - m2.get_value(row, colu);
-        error = std::abs(error);
-        if (error > max_err) {
-          max_err = error;
-        }
+  // the new value of x at the row of row_iter from the current x, 0 when the diagonal is 0.
+  template<class RowIterator, class ValueType>
+  static ValueType row_update(RowIterator row_iter, const dense_vector<ValueType>& rhs, const dense_vector<ValueType>& x) {
+    ValueType sum = 0;
+    ValueType t = 0;
+    size_type row = row_iter.row_index();
+    for (auto colu_iter = row_iter.begin(); colu_iter != row_iter.end(); ++colu_iter) {
+      if (colu_iter.column_index() == row) {
+        t = *colu_iter;
+      }
+      else {
+        sum += (*colu_iter) * x[colu_iter.column_index() - 1];
       }
     }
-    return max_err;
+    if (value_equal(t, ValueType(0)) == true) {
+      return ValueType(0);
+    }
+    return (rhs[row - 1] - sum) / t;
   }
 };
 }
+
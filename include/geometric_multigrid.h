@@ -0,0 +1,478 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "dense_vector.h"
+#include "executor.h"
+#include "parallel.h"
+#include "solve_control.h"
+#include "instrument.h"
+#include "matrix.h"
+#include "matrix_storage_cep.h"
+#include "sparse_lu.h"
+#include <algorithm>
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace pnmatrix {
+// constant coefficient 5 point (nz == 1) or 7 point stencil on the interior points of a
+// nx * ny * nz grid, the points outside the grid are zero (dirichlet). point (i, j, k), 0-based,
+// is element (k * ny + j) * nx + i of a vector.
+// (A * u)(i, j, k) = center * u(i, j, k) + x * (u(i - 1, j, k) + u(i + 1, j, k)) + y * (...) + z * (...)
+template <typename ValueType>
+class grid_operator {
+public:
+  using value_type = ValueType;
+
+  grid_operator(size_type nx, size_type ny, size_type nz, value_type center, value_type x, value_type y, value_type z)
+    :nx_(nx), ny_(ny), nz_(nz), center_(center), x_(x), y_(y), z_(z) {
+    assert(nx > 0 && ny > 0 && nz > 0);
+    assert(value_equal(center, value_type(0)) == false);
+  }
+
+  // -laplace(u) with the mesh width h on every axis.
+  static grid_operator laplacian(size_type nx, size_type ny, size_type nz = 1, value_type h = value_type(1)) {
+    value_type a = value_type(1) / (h * h);
+    value_type center = (nz == 1 ? value_type(4) : value_type(6)) * a;
+    return grid_operator(nx, ny, nz, center, - a, - a, nz == 1 ? value_type(0) : - a);
+  }
+
+  size_type get_nx() const {
+    return nx_;
+  }
+
+  size_type get_ny() const {
+    return ny_;
+  }
+
+  size_type get_nz() const {
+    return nz_;
+  }
+
+  size_type size() const {
+    return nx_ * ny_ * nz_;
+  }
+
+  value_type get_center() const {
+    return center_;
+  }
+
+  // out = A * u
+  void multiply(executor& ex, const value_type* u, value_type* out) const {
+    parallel_for(ex, 0, ny_ * nz_, [&](size_type, size_type first, size_type last) {
+      for (size_type line = first; line < last; ++line) {
+        size_type j = line % ny_;
+        size_type k = line / ny_;
+        for (size_type i = 0; i < nx_; ++i) {
+          out[line * nx_ + i] = center_ * u[line * nx_ + i] + get_neighbour_sum(u, i, j, k);
+        }
+      }
+    });
+  }
+
+  // the linear operator interface of linear_operator.h, so the krylov solvers run on the stencil
+  // without assembling it.
+  size_type get_row() const {
+    return size();
+  }
+
+  size_type get_column() const {
+    return size();
+  }
+
+  void apply(const dense_vector<value_type>& u, dense_vector<value_type>& out) const {
+    multiply(get_inline_executor(), u.data(), out.data());
+  }
+
+  void get_diagonal(value_type* d) const {
+    std::fill(d, d + size(), center_);
+  }
+
+  // the sum of the off diagonal terms of row (i, j, k).
+  value_type get_neighbour_sum(const value_type* u, size_type i, size_type j, size_type k) const {
+    size_type p = (k * ny_ + j) * nx_ + i;
+    value_type sum = value_type(0);
+    if (i > 0) {
+      sum += x_ * u[p - 1];
+    }
+    if (i + 1 < nx_) {
+      sum += x_ * u[p + 1];
+    }
+    if (j > 0) {
+      sum += y_ * u[p - nx_];
+    }
+    if (j + 1 < ny_) {
+      sum += y_ * u[p + nx_];
+    }
+    if (k > 0) {
+      sum += z_ * u[p - nx_ * ny_];
+    }
+    if (k + 1 < nz_) {
+      sum += z_ * u[p + nx_ * ny_];
+    }
+    return sum;
+  }
+
+  // every coarsened axis needs at least 3 points.
+  bool can_coarsen() const {
+    return coarsens(nx_) && coarsens(ny_) && (nz_ == 1 || coarsens(nz_));
+  }
+
+  // the same operator discretized with twice the mesh width, an axis of n points keeps (n - 1) / 2
+  // and the coarse point i sits on the fine point 2 * i + 1.
+  grid_operator coarsen() const {
+    assert(can_coarsen() == true);
+    size_type cz = nz_ == 1 ? 1 : (nz_ - 1) / 2;
+    return grid_operator((nx_ - 1) / 2, (ny_ - 1) / 2, cz, center_ / value_type(4), x_ / value_type(4), y_ / value_type(4), z_ / value_type(4));
+  }
+
+  matrix<matrix_storage_cep<value_type>> assemble() const {
+    matrix<matrix_storage_cep<value_type>> result(size(), size());
+    auto& c = result.get_container();
+    for (size_type k = 0; k < nz_; ++k) {
+      for (size_type j = 0; j < ny_; ++j) {
+        for (size_type i = 0; i < nx_; ++i) {
+          size_type row = (k * ny_ + j) * nx_ + i + 1;
+          auto push = [&](size_type column, value_type v) {
+            if (value_equal(v, value_type(0)) == false) {
+              c.push_back_in_row(row, column, v);
+            }
+          };
+          if (k > 0) {
+            push(row - nx_ * ny_, z_);
+          }
+          if (j > 0) {
+            push(row - nx_, y_);
+          }
+          if (i > 0) {
+            push(row - 1, x_);
+          }
+          push(row, center_);
+          if (i + 1 < nx_) {
+            push(row + 1, x_);
+          }
+          if (j + 1 < ny_) {
+            push(row + nx_, y_);
+          }
+          if (k + 1 < nz_) {
+            push(row + nx_ * ny_, z_);
+          }
+        }
+      }
+    }
+    return result;
+  }
+
+private:
+  size_type nx_;
+  size_type ny_;
+  size_type nz_;
+  value_type center_;
+  value_type x_;
+  value_type y_;
+  value_type z_;
+
+  static bool coarsens(size_type n) {
+    return n >= 3;
+  }
+};
+
+enum class multigrid_cycle {
+  v,
+  w,
+  f,
+};
+
+// geometric multigrid on a grid_operator, nothing is assembled but the coarsest level. every
+// level coarsens all axes by two, prolongs by (bi/tri)linear interpolation, restricts by its
+// transpose (full weighting) and smooths by red-black gauss-seidel. on an axis of even length
+// the last fine points interpolate towards the boundary, grids of 2^k - 1 points per axis are
+// coarsened exactly.
+// apply() is one cycle from zero, usable as M in gmres::solve(..., M), solve() repeats cycles.
+// both use buffers owned by the hierarchy, one hierarchy must not be used by two threads at once.
+template <typename ValueType>
+class geometric_multigrid {
+public:
+  using value_type = ValueType;
+
+  struct option {
+    // relative residual of solve().
+    double rm = 1e-6;
+    // cycles of solve(), 0 means no limit.
+    size_type max_iteration = 0;
+    multigrid_cycle cycle = multigrid_cycle::v;
+    size_type pre_sweeps = 2;
+    size_type post_sweeps = 2;
+    // levels with at most this many points are solved directly.
+    size_type coarse_size = 512;
+    size_type max_levels = 20;
+    // runs the smoothing and transfers, nullptr means the calling thread only.
+    executor* exec = nullptr;
+  };
+
+  explicit geometric_multigrid(const grid_operator<ValueType>& A):geometric_multigrid(A, option()) {
+
+  }
+
+  geometric_multigrid(const grid_operator<ValueType>& A, option op):op_(op) {
+    PNMATRIX_TIMED_SCOPE("geometric_multigrid.setup");
+    levels_.emplace_back(A);
+    while (levels_.back().A.size() > op_.coarse_size && (size_type)levels_.size() < op_.max_levels && levels_.back().A.can_coarsen() == true) {
+      grid_operator<value_type> coarse = levels_.back().A.coarsen();
+      levels_.emplace_back(coarse);
+    }
+    // a grid stuck above coarse_size would leave a complete lu of a large level.
+    if (levels_.back().A.size() > op_.coarse_size && (size_type)levels_.size() < op_.max_levels) {
+      throw std::invalid_argument("geometric_multigrid: an axis of less than 3 points can not be coarsened");
+    }
+    const grid_operator<value_type>& coarsest = levels_.back().A;
+    matrix<matrix_storage_cep<value_type>> m = coarsest.assemble();
+    const auto& c = m.get_container();
+    std::vector<size_type> row_begin(1, 0);
+    std::vector<size_type> columns;
+    std::vector<value_type> values;
+    for (size_type row = 1; row <= m.get_row(); ++row) {
+      c.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        columns.push_back(column - 1);
+        values.push_back(v);
+      });
+      row_begin.push_back(columns.size());
+    }
+    coarse_lu_.factorize(m.get_row(), row_begin, columns, values, true);
+  }
+
+  size_type get_level_count() const {
+    return levels_.size();
+  }
+
+  size_type get_level_size(size_type l) const {
+    return levels_[l].A.size();
+  }
+
+  // z = M^-1 * r by one cycle.
+  void apply(const value_type* r, value_type* z) const {
+    level& top = levels_[0];
+    std::copy(r, r + top.b.size(), top.b.data());
+    top.x.fill(value_type(0));
+    cycle(0, op_.cycle);
+    std::copy(top.x.data(), top.x.data() + top.x.size(), z);
+  }
+
+  // x is the initial guess on entry and the solution on return.
+  void solve(const dense_vector<value_type>& b, dense_vector<value_type>& x, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("geometric_multigrid.solve");
+    level& top = levels_[0];
+    assert(b.size() == top.A.size() && x.size() == top.A.size());
+    executor& ex = get_executor();
+    top.x = x;
+    detail::repeat_cycles(control, op_.rm, op_.max_iteration, get_second_norm(ex, b), top.x, [&]() {
+      top.A.multiply(ex, top.x.data(), top.r.data());
+      top.r.scale(value_type(-1));
+      add_scaled(ex, top.r, value_type(1), b);
+      return get_second_norm(ex, top.r);
+    }, [&]() {
+      top.b = b;
+      cycle(0, op_.cycle);
+    });
+    x = top.x;
+  }
+
+private:
+  struct level {
+    explicit level(const grid_operator<value_type>& a):A(a), x(a.size()), b(a.size()), r(a.size()) {
+
+    }
+
+    grid_operator<value_type> A;
+    dense_vector<value_type> x;
+    dense_vector<value_type> b;
+    dense_vector<value_type> r;
+  };
+
+  option op_;
+  mutable std::vector<level> levels_;
+  detail::local_lu<value_type> coarse_lu_;
+
+  executor& get_executor() const {
+    return op_.exec == nullptr ? get_inline_executor() : *op_.exec;
+  }
+
+  // the points of one color only depend on points of the other color, so each half sweep is
+  // parallel over the grid lines.
+  void smooth(level& l, size_type sweeps) const {
+    const grid_operator<value_type>& A = l.A;
+    size_type nx = A.get_nx();
+    size_type ny = A.get_ny();
+    value_type* x = l.x.data();
+    const value_type* b = l.b.data();
+    value_type center = A.get_center();
+    executor& ex = get_executor();
+    for (size_type s = 0; s < sweeps; ++s) {
+      for (size_type color = 0; color < 2; ++color) {
+        parallel_for(ex, 0, ny * A.get_nz(), [&](size_type, size_type first, size_type last) {
+          for (size_type line = first; line < last; ++line) {
+            size_type j = line % ny;
+            size_type k = line / ny;
+            for (size_type i = (j + k + color) % 2; i < nx; i += 2) {
+              size_type p = line * nx + i;
+              x[p] = (b[p] - A.get_neighbour_sum(x, i, j, k)) / center;
+            }
+          }
+        });
+      }
+    }
+  }
+
+  // coarse = R * fine with R = P^T / 2 per coarsened axis, the full weighting 1/4, 1/2, 1/4 inside.
+  void restrict_to(const grid_operator<value_type>& fine_grid, const value_type* fine, const grid_operator<value_type>& coarse_grid, value_type* coarse) const {
+    size_type fx = fine_grid.get_nx();
+    size_type fy = fine_grid.get_ny();
+    size_type fz = fine_grid.get_nz();
+    size_type cx = coarse_grid.get_nx();
+    size_type cy = coarse_grid.get_ny();
+    size_type cz = coarse_grid.get_nz();
+    bool flat = fz == 1;
+    parallel_for(get_executor(), 0, cy * cz, [&](size_type, size_type first, size_type last) {
+      size_type ki[4], ji[4], ii[4];
+      value_type kw[4], jw[4], iw[4];
+      for (size_type line = first; line < last; ++line) {
+        size_type cj = line % cy;
+        size_type ck = line / cy;
+        size_type kn = 1;
+        ki[0] = 0;
+        kw[0] = value_type(1);
+        if (flat == false) {
+          kn = restriction_sources(ck, fz, cz, ki, kw);
+        }
+        size_type jn = restriction_sources(cj, fy, cy, ji, jw);
+        for (size_type ci = 0; ci < cx; ++ci) {
+          size_type in = restriction_sources(ci, fx, cx, ii, iw);
+          value_type sum = value_type(0);
+          for (size_type a = 0; a < kn; ++a) {
+            for (size_type b = 0; b < jn; ++b) {
+              for (size_type c = 0; c < in; ++c) {
+                sum += kw[a] * jw[b] * iw[c] * fine[(ki[a] * fy + ji[b]) * fx + ii[c]];
+              }
+            }
+          }
+          coarse[line * cx + ci] = sum;
+        }
+      }
+    });
+  }
+
+  // fine += P * coarse by linear interpolation along every coarsened axis.
+  void prolong_add(const grid_operator<value_type>& coarse_grid, const value_type* coarse, const grid_operator<value_type>& fine_grid, value_type* fine) const {
+    size_type fx = fine_grid.get_nx();
+    size_type fy = fine_grid.get_ny();
+    size_type fz = fine_grid.get_nz();
+    size_type cx = coarse_grid.get_nx();
+    size_type cy = coarse_grid.get_ny();
+    size_type cz = coarse_grid.get_nz();
+    bool flat = fz == 1;
+    parallel_for(get_executor(), 0, fy * fz, [&](size_type, size_type first, size_type last) {
+      size_type ki[2], ji[2], ii[2];
+      value_type kw[2], jw[2], iw[2];
+      for (size_type line = first; line < last; ++line) {
+        size_type j = line % fy;
+        size_type k = line / fy;
+        size_type kn = 1;
+        ki[0] = 0;
+        kw[0] = value_type(1);
+        if (flat == false) {
+          kn = prolongation_sources(k, fz, cz, ki, kw);
+        }
+        size_type jn = prolongation_sources(j, fy, cy, ji, jw);
+        for (size_type i = 0; i < fx; ++i) {
+          size_type in = prolongation_sources(i, fx, cx, ii, iw);
+          value_type sum = value_type(0);
+          for (size_type a = 0; a < kn; ++a) {
+            for (size_type b = 0; b < jn; ++b) {
+              for (size_type c = 0; c < in; ++c) {
+                sum += kw[a] * jw[b] * iw[c] * coarse[(ki[a] * cy + ji[b]) * cx + ii[c]];
+              }
+            }
+          }
+          fine[line * fx + i] += sum;
+        }
+      }
+    });
+  }
+
+  // P(f, ci) of one axis with n fine and c coarse points. the fine point f sits at f + 1 and the
+  // coarse point ci at 2 * ci + 2 between the boundaries 0 and n + 1, P interpolates linearly
+  // between the coarse points and the boundaries next to f.
+  static value_type axis_weight(size_type f, size_type ci, size_type n, size_type c) {
+    size_type p = f + 1;
+    size_type q = 2 * ci + 2;
+    if (p == q) {
+      return value_type(1);
+    }
+    if (p < q) {
+      return q - p == 1 ? value_type(0.5) : value_type(0);
+    }
+    size_type right = ci + 1 < c ? q + 2 : n + 1;
+    return p < right ? value_type(right - p) / value_type(right - q) : value_type(0);
+  }
+
+  // the coarse points next to fine point f and their weights, at most 2.
+  static size_type prolongation_sources(size_type f, size_type n, size_type c, size_type* index, value_type* weight) {
+    size_type left = std::min((f + 1) / 2 - 1, c - 1);
+    size_type count = 0;
+    for (size_type ci = std::max<size_type>(left, 0); ci <= left + 1 && ci < c; ++ci) {
+      value_type w = axis_weight(f, ci, n, c);
+      if (w != value_type(0)) {
+        index[count] = ci;
+        weight[count++] = w;
+      }
+    }
+    return count;
+  }
+
+  // the fine points P^T gathers into coarse point ci and their weights halved, at most 4.
+  static size_type restriction_sources(size_type ci, size_type n, size_type c, size_type* index, value_type* weight) {
+    size_type count = 0;
+    for (size_type f = 2 * ci; f < std::min(n, 2 * ci + 4); ++f) {
+      value_type w = axis_weight(f, ci, n, c);
+      if (w != value_type(0)) {
+        index[count] = f;
+        weight[count++] = w / value_type(2);
+      }
+    }
+    return count;
+  }
+
+  // cycle on level l for levels_[l].b, starting from levels_[l].x. a w cycle visits the next level
+  // twice, an f cycle does an f cycle there followed by a v cycle.
+  void cycle(size_type l, multigrid_cycle type) const {
+    level& current = levels_[l];
+    if (l + 1 == (size_type)levels_.size()) {
+      current.x = current.b;
+      coarse_lu_.solve(current.x.data());
+      return;
+    }
+    executor& ex = get_executor();
+    smooth(current, op_.pre_sweeps);
+    current.A.multiply(ex, current.x.data(), current.r.data());
+    current.r.scale(value_type(-1));
+    add_scaled(ex, current.r, value_type(1), current.b);
+    level& coarse = levels_[l + 1];
+    restrict_to(current.A, current.r.data(), coarse.A, coarse.b.data());
+    coarse.x.fill(value_type(0));
+    if (type == multigrid_cycle::v) {
+      cycle(l + 1, multigrid_cycle::v);
+    }
+    else if (type == multigrid_cycle::w) {
+      cycle(l + 1, multigrid_cycle::w);
+      cycle(l + 1, multigrid_cycle::w);
+    }
+    else {
+      cycle(l + 1, multigrid_cycle::f);
+      cycle(l + 1, multigrid_cycle::v);
+    }
+    prolong_add(coarse.A, coarse.x.data(), current.A, current.x.data());
+    smooth(current, op_.post_sweeps);
+  }
+};
+}
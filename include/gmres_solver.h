@@ -1,87 +1,452 @@
 #pragma once
 #include "type.h"
 #include "value_compare.h"
-#include "qr_decomposition.h"
+#include "dense_vector.h"
+#include "dense_block.h"
+#include "allocator.h"
+#include "solve_control.h"
+#include "instrument.h"
+#include "matrix.h"
+#include "linear_operator.h"
+#include <type_traits>
 #include <utility>
+#include <vector>
 #include <cassert>
 #include <cmath>
 
 namespace pnmatrix {
+namespace detail {
+// the (m + 1) x m hessenberg matrix of one arnoldi process, reduced to upper triangular by
+// givens rotations as its columns arrive. g = Q^T * beta * e1, so |g(m + 1)| is the residual.
+template <typename ValueType>
+class givens_hessenberg {
+public:
+  void reset(size_type restart_m, ValueType beta) {
+    restart_m_ = restart_m;
+    h_.resize((restart_m + 1) * restart_m);
+    cs_.resize(restart_m);
+    sn_.resize(restart_m);
+    g_.assign(restart_m + 1, ValueType(0));
+    g_[0] = beta;
+  }
+
+  // h(1 ... m + 1) of column m, starting by 0.
+  ValueType* column(size_type m) {
+    return &h_[(m - 1) * (restart_m_ + 1)];
+  }
+
+  // rotates the new column m and returns the absolute residual.
+  ValueType add_column(size_type m) {
+    ValueType* h = column(m);
+    for (size_type i = 0; i + 1 < m; ++i) {
+      ValueType t = cs_[i] * h[i] + sn_[i] * h[i + 1];
+      h[i + 1] = - sn_[i] * h[i] + cs_[i] * h[i + 1];
+      h[i] = t;
+    }
+    ValueType r = std::sqrt(h[m - 1] * h[m - 1] + h[m] * h[m]);
+    ValueType c = ValueType(1);
+    ValueType s = ValueType(0);
+    if (r != ValueType(0)) {
+      c = h[m - 1] / r;
+      s = h[m] / r;
+    }
+    cs_[m - 1] = c;
+    sn_[m - 1] = s;
+    h[m - 1] = r;
+    h[m] = ValueType(0);
+    g_[m] = - s * g_[m - 1];
+    g_[m - 1] = c * g_[m - 1];
+    return std::abs(g_[m]);
+  }
+
+  // y(0 ... m - 1) = R^-1 * g by back substitution.
+  void solve(size_type m, ValueType* y) const {
+    for (size_type i = m - 1; i >= 0; --i) {
+      ValueType sum = g_[i];
+      for (size_type j = i + 1; j < m; ++j) {
+        sum -= h_[j * (restart_m_ + 1) + i] * y[j];
+      }
+      y[i] = sum / h_[i * (restart_m_ + 1) + i];
+    }
+  }
+
+private:
+  size_type restart_m_ = 0;
+  tracked_vector<ValueType> h_;
+  tracked_vector<ValueType> cs_;
+  tracked_vector<ValueType> sn_;
+  tracked_vector<ValueType> g_;
+};
+
+// stands for M = I in the preconditioned solve paths.
+struct no_preconditioner {
+};
+}
+
 class gmres {
 private:
   double rm_;
   double m_;
+  size_type max_iteration_;
+  executor* exec_;
 
 public:
   struct option {
     double rm = 1e-6;
     double m = 30;
+    // inner iterations over all restarts, 0 means no limit.
+    size_type max_iteration = 0;
+    // runs the matrix vector products and the vector reductions, nullptr means the calling thread only.
+    executor* exec = nullptr;
   };
 
-  gmres(option op):rm_(op.rm),m_(op.m) {
+  gmres(option op):rm_(op.rm),m_(op.m),max_iteration_(op.max_iteration),exec_(op.exec) {
 
   }
 
+  // the krylov basis and the small least squares problem of one solve, keep it between solves of
+  // the same size to avoid allocating. z is only sized by preconditioned solves.
+  template<class ValueType>
+  struct workspace {
+    tracked_vector<dense_vector<ValueType>> basis;
+    dense_vector<ValueType> w;
+    dense_vector<ValueType> z;
+    tracked_vector<ValueType> y;
+    detail::givens_hessenberg<ValueType> hessenberg;
+
+    void resize(size_type n, size_type restart_m) {
+      basis.resize(restart_m + 1);
+      for (auto& each : basis) {
+        each.resize(n);
+      }
+      w.resize(n);
+      y.resize(restart_m);
+    }
+  };
+
   template<class MatrixType>
   MatrixType solve(MatrixType& A, MatrixType& b) {
-    MatrixType x0(b.get_row(), b.get_column());
-    return solveinner(A, b, x0, m_);
+    solve_control control;
+    return solve(A, b, control);
+  }
+
+  template<class MatrixType>
+  MatrixType solve(MatrixType& A, MatrixType& b, solve_control& control) {
+    MatrixType x0(A.get_column(), b.get_column());
+    return solve(A, b, x0, control);
+  }
+
+  template<class MatrixType>
+  MatrixType solve(MatrixType& A, MatrixType& b, const MatrixType& x0) {
+    solve_control control;
+    return solve(A, b, x0, control);
+  }
+
+  // starts from x0. stops early when control is cancelled or its deadline passes and returns the current
+  // iterate, the residual of gmres never grows so it is the best one. the outcome is left in control.get_status().
+  template<class MatrixType>
+  MatrixType solve(MatrixType& A, MatrixType& b, const MatrixType& x0, solve_control& control) {
+    assert(x0.get_row() == A.get_column() && x0.get_column() == b.get_column());
+    using value_type = typename MatrixType::value_type;
+    if (b.get_column() > 1) {
+      dense_block<value_type> x = to_dense_block(x0);
+      solve_block(A, to_dense_block(b), x, control);
+      return to_matrix<MatrixType>(x);
+    }
+    workspace<value_type> ws;
+    dense_vector<value_type> x = to_dense_vector(x0);
+    solve(A, to_dense_vector(b), x, control, ws);
+    return to_matrix<MatrixType>(x);
+  }
+
+  // right preconditioned, M.apply(r, z) computes z = M^-1 * r on raw arrays of A.get_row() values.
+  // the residual watched for convergence is still the one of A * x = b. b has one column.
+  template<class MatrixType, class Preconditioner>
+  MatrixType solve(MatrixType& A, MatrixType& b, const MatrixType& x0, solve_control& control, const Preconditioner& M) {
+    assert(x0.get_row() == A.get_column() && b.get_column() == 1);
+    using value_type = typename MatrixType::value_type;
+    workspace<value_type> ws;
+    dense_vector<value_type> x = to_dense_vector(x0);
+    solve(A, to_dense_vector(b), x, control, ws, M);
+    return to_matrix<MatrixType>(x);
+  }
+
+  template<class MatrixType, class ValueType>
+  void solve(const MatrixType& A, const dense_vector<ValueType>& b, dense_vector<ValueType>& x, workspace<ValueType>& ws) {
+    solve_control control;
+    solve(A, b, x, control, ws);
+  }
+
+  // x is the initial guess on entry and the solution on return. once ws has been used for a system
+  // of the same size this does not allocate. A is a matrix<> or a linear operator (linear_operator.h).
+  template<class MatrixType, class ValueType>
+  void solve(const MatrixType& A, const dense_vector<ValueType>& b, dense_vector<ValueType>& x, solve_control& control, workspace<ValueType>& ws) {
+    PNMATRIX_TIMED_SCOPE("gmres.solve");
+    PNMATRIX_ALLOCATION_SCOPE("gmres.solve");
+    assert(A.get_row() == b.size() && A.get_column() == x.size());
+    ws.resize(A.get_row(), m_);
+    solveinner(A, b, x, m_, control, ws, detail::no_preconditioner());
+  }
+
+  template<class MatrixType, class ValueType, class Preconditioner>
+  void solve(const MatrixType& A, const dense_vector<ValueType>& b, dense_vector<ValueType>& x, solve_control& control, workspace<ValueType>& ws, const Preconditioner& M) {
+    PNMATRIX_TIMED_SCOPE("gmres.solve");
+    PNMATRIX_ALLOCATION_SCOPE("gmres.solve");
+    assert(A.get_row() == A.get_column() && A.get_row() == b.size() && A.get_column() == x.size());
+    ws.resize(A.get_row(), m_);
+    ws.z.resize(A.get_row());
+    solveinner(A, b, x, m_, control, ws, M);
+  }
+
+  // every column of b is an independent system sharing A. the columns run their own arnoldi
+  // processes in lockstep, so A is read once per step for all of them, and a column leaves
+  // the block as soon as its residual is small enough.
+  template<class MatrixType>
+  dense_block<typename MatrixType::value_type> solve_block(const MatrixType& A, const dense_block<typename MatrixType::value_type>& b) {
+    solve_control control;
+    return solve_block(A, b, control);
   }
 
-private:
   template<class MatrixType>
-  MatrixType solveinner(MatrixType& A, MatrixType& b, MatrixType& x0 ,size_type restart_m) {
+  dense_block<typename MatrixType::value_type> solve_block(const MatrixType& A, const dense_block<typename MatrixType::value_type>& b, solve_control& control) {
+    dense_block<typename MatrixType::value_type> x(A.get_column(), b.get_column());
+    solve_block(A, b, x, control);
+    return x;
+  }
+
+  // result holds the initial guesses on entry and the solutions on return.
+  template<class MatrixType>
+  void solve_block(const MatrixType& A, const dense_block<typename MatrixType::value_type>& b, dense_block<typename MatrixType::value_type>& result, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("gmres.solve_block");
+    PNMATRIX_ALLOCATION_SCOPE("gmres.solve_block");
+    assert(result.get_row() == A.get_column() && result.get_column() == b.get_column());
     using value_type = typename MatrixType::value_type;
-    MatrixType result(x0.get_row(), x0.get_column());
+    size_type n = A.get_row();
+    size_type restart_m = m_;
+    tracked_vector<size_type> active(b.get_column());
+    for (size_type j = 0; j < b.get_column(); ++j) {
+      active[j] = j;
+    }
+    dense_block<value_type> rhs = b;
+    tracked_vector<value_type> b_norm(b.get_column());
+    rhs.column_second_norm(b_norm.data());
+    dense_block<value_type> x0 = result;
+    tracked_vector<dense_block<value_type>> Vm(restart_m + 1);
+    dense_block<value_type> wm(n, b.get_column());
+    tracked_vector<value_type> beta(b.get_column());
+    tracked_vector<value_type> h(b.get_column());
+    tracked_vector<value_type> coeff(b.get_column());
+    tracked_vector<value_type> y(restart_m);
+    tracked_vector<detail::givens_hessenberg<value_type>> H;
+    tracked_vector<bool> keep;
+    executor& ex = get_executor();
+    size_type iteration = 0;
+    while (active.empty() == false) {
+      size_type k = active.size();
+      matrix_block_multiply(ex, A, x0, wm);
+      std::fill(coeff.begin(), coeff.begin() + k, value_type(-1));
+      wm.scale(coeff.data());
+      std::fill(coeff.begin(), coeff.begin() + k, value_type(1));
+      wm.add_scaled(coeff.data(), rhs);
+      wm.column_second_norm(beta.data());
+      keep.assign(k, true);
+      for (size_type j = 0; j < k; ++j) {
+        keep[j] = beta[j] > rm_ * b_norm[j];
+      }
+      if (retire_columns(keep, x0, result, active) == true) {
+        compact_values(keep, beta);
+        compact_values(keep, b_norm);
+        rhs.compact_columns(keep);
+        wm.compact_columns(keep);
+        k = active.size();
+        if (k == 0) {
+          break;
+        }
+      }
+      Vm[0] = wm;
+      for (size_type j = 0; j < k; ++j) {
+        coeff[j] = value_type(1) / beta[j];
+      }
+      Vm[0].scale(coeff.data());
+      H.resize(k);
+      for (size_type j = 0; j < k; ++j) {
+        H[j].reset(restart_m, beta[j]);
+      }
+
+      for (size_type m = 1; m <= restart_m; ++m) {
+        matrix_block_multiply(ex, A, Vm[m - 1], wm);
+        for (size_type i = 1; i <= m; ++i) {
+          wm.column_inner_product(Vm[i - 1], h.data());
+          for (size_type j = 0; j < k; ++j) {
+            H[j].column(m)[i - 1] = h[j];
+          }
+        }
+        for (size_type i = 1; i <= m; ++i) {
+          for (size_type j = 0; j < k; ++j) {
+            coeff[j] = - H[j].column(m)[i - 1];
+          }
+          wm.add_scaled(coeff.data(), Vm[i - 1]);
+        }
+        wm.column_second_norm(h.data());
+        keep.assign(k, true);
+        double worst = 0;
+        for (size_type j = 0; j < k; ++j) {
+          H[j].column(m)[m] = h[j];
+          value_type rm = H[j].add_column(m) / b_norm[j];
+          keep[j] = rm > rm_;
+          worst = keep[j] == true ? std::max(worst, double(rm)) : worst;
+        }
+        ++iteration;
+        bool go_on = control.next_iteration(iteration, worst);
+        if (go_on == true && iteration == max_iteration_) {
+          control.finish(solve_status::max_iteration_reached);
+          go_on = false;
+        }
+        for (size_type j = 0; j < k; ++j) {
+          if (keep[j] == false || m == restart_m || go_on == false) {
+            H[j].solve(m, y.data());
+            for (size_type i = 1; i <= m; ++i) {
+              for (size_type r = 0; r < n; ++r) {
+                x0(r, j) += y[i - 1] * Vm[i - 1](r, j);
+              }
+            }
+          }
+          if (go_on == false) {
+            keep[j] = false;
+          }
+          if (keep[j] == true) {
+            assert(value_equal(value_type(0), h[j]) == false);
+          }
+        }
+        if (retire_columns(keep, x0, result, active) == true) {
+          compact_values(keep, beta);
+          compact_values(keep, b_norm);
+          compact_values(keep, h);
+          compact_values(keep, H);
+          rhs.compact_columns(keep);
+          wm.compact_columns(keep);
+          for (size_type i = 0; i < m; ++i) {
+            Vm[i].compact_columns(keep);
+          }
+          k = active.size();
+          if (k == 0) {
+            control.finish(solve_status::converged);
+            return;
+          }
+        }
+        if (m < restart_m) {
+          Vm[m] = wm;
+          for (size_type j = 0; j < k; ++j) {
+            coeff[j] = value_type(1) / h[j];
+          }
+          Vm[m].scale(coeff.data());
+        }
+      }
+    }
+    control.finish(solve_status::converged);
+  }
+
+private:
+  executor& get_executor() const {
+    return exec_ == nullptr ? get_inline_executor() : *exec_;
+  }
+
+  template<class T>
+  static void compact_values(const tracked_vector<bool>& keep, tracked_vector<T>& values) {
+    size_type count = 0;
+    for (size_type j = 0; j < (size_type)keep.size(); ++j) {
+      if (keep[j] == true) {
+        values[count++] = std::move(values[j]);
+      }
+    }
+    values.erase(values.begin() + count, values.end());
+  }
+
+  // the krylov basis, residuals and x live in dense vectors whatever the storage of A,
+  // the small hessenberg least squares problem is solved by givens rotations as it grows.
+  // with a preconditioner the basis spans A * M^-1 and x moves by M^-1 * (V * y).
+  template<class MatrixType, class ValueType, class Preconditioner>
+  void solveinner(const MatrixType& A, const dense_vector<ValueType>& b, dense_vector<ValueType>& x0, size_type restart_m, solve_control& control, workspace<ValueType>& ws, const Preconditioner& M) {
+    using value_type = ValueType;
+    constexpr bool preconditioned = std::is_same<Preconditioner, detail::no_preconditioner>::value == false;
+    tracked_vector<dense_vector<value_type>>& Vm = ws.basis;
+    dense_vector<value_type>& wm = ws.w;
+    executor& ex = get_executor();
+    value_type b_norm = get_second_norm(ex, b);
+    size_type iteration = 0;
     while (true) {
-      MatrixType r0 = b - A * x0;
-      value_type beta = r0.get_vector_second_norm();
-      MatrixType Vm(A.get_row(), 1);
-      MatrixType v1 = r0 / r0.get_vector_second_norm();
-      Vm.set_column(1, v1);
+      dense_vector<value_type>& r0 = Vm[0];
+      apply_operator(ex, A, x0, r0);
+      r0.scale(value_type(-1));
+      add_scaled(ex, r0, value_type(1), b);
+      value_type beta = get_second_norm(ex, r0);
+      if (beta <= rm_ * b_norm) {
+        control.finish(solve_status::converged);
+        return;
+      }
+      r0.scale(value_type(1) / beta);
+      ws.hessenberg.reset(restart_m, beta);
 
-      MatrixType H(restart_m + 1, restart_m);
       for (size_type m = 1; m <= restart_m; ++m) {
-        H.resize(m + 1, m);
-        MatrixType vsm = Vm.get_nth_column(m);
-        MatrixType wm = A * vsm;
-        MatrixType wmt = tr(wm);
+        if constexpr (preconditioned == true) {
+          M.apply(Vm[m - 1].data(), ws.z.data());
+          apply_operator(ex, A, ws.z, wm);
+        }
+        else {
+          apply_operator(ex, A, Vm[m - 1], wm);
+        }
+        value_type* h = ws.hessenberg.column(m);
         for (size_type i = 1; i <= m; ++i) {
-          MatrixType vsi = Vm.get_sub_matrix(1, Vm.get_row(), i, 1);
-          H.set_value(i, m, wmt.get_vector_inner_product(vsi));
+          h[i - 1] = inner_product(ex, wm, Vm[i - 1]);
         }
         for (size_type i = 1; i <= m; ++i) {
-          MatrixType vsi = Vm.get_sub_matrix(1, Vm.get_row(), i, 1);
-          wm = wm - vsi * H.get_value(i, m);
-        }
-        value_type h_mplus_m = wm.get_vector_second_norm();
-        H.set_value(m + 1, m, h_mplus_m);
-        MatrixType e1(m, 1);
-        e1.set_value(1, 1, 1);
-
-        std::pair<MatrixType, MatrixType> qr = QR<MatrixType>(H);
-        MatrixType q1 = qr.first.get_nth_column(1);
-        q1.delete_row(q1.get_row());
-        MatrixType R = std::move(qr.second);
-        R.delete_row(R.get_row());
-        MatrixType mm(R.get_row(), R.get_column());
-        bool error = R.inverse_with_ert(mm);
-        assert(error == true);
-        value_type rm = qr.first.get_value(m + 1, 1) * beta / b.get_vector_second_norm();
-        if (std::abs(rm) <= rm_) {
-          result = x0 + Vm * mm * q1 * beta;
-          return result;
-        }
-        if (m == restart_m) {
-          result = x0 + Vm * mm * q1 * beta;
+          add_scaled(ex, wm, - h[i - 1], Vm[i - 1]);
+        }
+        value_type h_mplus_m = get_second_norm(ex, wm);
+        h[m] = h_mplus_m;
+
+        value_type rm = ws.hessenberg.add_column(m) / b_norm;
+        ++iteration;
+        bool stop = true;
+        if (rm <= rm_) {
+          control.next_iteration(iteration, rm);
+          control.finish(solve_status::converged);
+        }
+        else if (control.next_iteration(iteration, rm) == true) {
+          if (iteration == max_iteration_) {
+            control.finish(solve_status::max_iteration_reached);
+          }
+          else {
+            stop = false;
+          }
+        }
+        if (stop == true || m == restart_m) {
+          ws.hessenberg.solve(m, ws.y.data());
+          if constexpr (preconditioned == true) {
+            // wm is not needed any more in this cycle.
+            wm.fill(value_type(0));
+            for (size_type i = 1; i <= m; ++i) {
+              add_scaled(ex, wm, ws.y[i - 1], Vm[i - 1]);
+            }
+            M.apply(wm.data(), ws.z.data());
+            add_scaled(ex, x0, value_type(1), ws.z);
+          }
+          else {
+            for (size_type i = 1; i <= m; ++i) {
+              add_scaled(ex, x0, ws.y[i - 1], Vm[i - 1]);
+            }
+          }
+          if (stop == true) {
+            return;
+          }
         }
         assert(value_equal(value_type(0), h_mplus_m) == false);
-        Vm.resize(A.get_row(), m + 1);
-        Vm.set_column(m + 1, wm / h_mplus_m);
+        if (m < restart_m) {
+          Vm[m] = wm;
+          Vm[m].scale(value_type(1) / h_mplus_m);
+        }
       }
-      x0 = std::move(result);
     }
   }
 };
 }
-
@@ -0,0 +1,325 @@
+#pragma once
+#include "type.h"
+#include "allocator.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <ostream>
+
+// hot path counters and timers, compiled in only with PNMATRIX_INSTRUMENT defined.
+// without it the macros expand to nothing, the registry below is still usable directly.
+//
+//   PNMATRIX_COUNT("cep.set_value.append");
+//   PNMATRIX_COUNT_N("cep.get_value.scanned", n);   n is not evaluated when disabled
+//   PNMATRIX_TIMED_SCOPE("gmres.solve");              until the end of the enclosing scope
+//   PNMATRIX_ALLOCATION_SCOPE("gmres.solve");         library allocations of the enclosing scope, counted
+//                                                     as "gmres.solve.allocations" and "gmres.solve.allocated_bytes"
+//
+// names must be string literals. read the results with instrument::registry::get().write_json(os)
+// or write_chrome_trace(os), the latter loads in chrome://tracing or perfetto.
+
+namespace pnmatrix {
+namespace instrument {
+class counter {
+public:
+  explicit counter(const char* name):name_(name), value_(0) {
+
+  }
+
+  const char* get_name() const {
+    return name_;
+  }
+
+  void add(size_type n) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  size_type get() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  void reset() {
+    value_.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  const char* name_;
+  std::atomic<size_type> value_;
+};
+
+// calls and total time of one timed scope.
+class timer {
+public:
+  explicit timer(const char* name):name_(name), calls_(0), total_ns_(0) {
+
+  }
+
+  const char* get_name() const {
+    return name_;
+  }
+
+  void add(size_type ns) {
+    calls_.fetch_add(1, std::memory_order_relaxed);
+    total_ns_.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  size_type get_calls() const {
+    return calls_.load(std::memory_order_relaxed);
+  }
+
+  size_type get_total_ns() const {
+    return total_ns_.load(std::memory_order_relaxed);
+  }
+
+  void reset() {
+    calls_.store(0, std::memory_order_relaxed);
+    total_ns_.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  const char* name_;
+  std::atomic<size_type> calls_;
+  std::atomic<size_type> total_ns_;
+};
+
+struct trace_event {
+  const char* name;
+  size_type start_ns;
+  size_type duration_ns;
+};
+
+class registry {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr size_type default_event_limit = 1 << 20;
+
+  static registry& get() {
+    static registry r;
+    return r;
+  }
+
+  // the returned references stay valid for the lifetime of the program, call sites cache them.
+  counter& get_counter(const char* name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& each : counters_) {
+      if (std::strcmp(each.get_name(), name) == 0) {
+        return each;
+      }
+    }
+    counters_.emplace_back(name);
+    return counters_.back();
+  }
+
+  timer& get_timer(const char* name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& each : timers_) {
+      if (std::strcmp(each.get_name(), name) == 0) {
+        return each;
+      }
+    }
+    timers_.emplace_back(name);
+    return timers_.back();
+  }
+
+  size_type get_counter_value(const char* name) {
+    return get_counter(name).get();
+  }
+
+  size_type now_ns() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - origin_).count();
+  }
+
+  // events past the limit of a thread are only added to their timer, not to the timeline.
+  // recording the timeline allocates, a limit of 0 keeps timed scopes allocation free.
+  void set_event_limit(size_type limit) {
+    event_limit_.store(limit, std::memory_order_relaxed);
+  }
+
+  void record(const trace_event& e) {
+    thread_buffer& b = local_buffer();
+    std::lock_guard<std::mutex> lock(b.mutex_);
+    if ((size_type)b.events_.size() < event_limit_.load(std::memory_order_relaxed)) {
+      b.events_.push_back(e);
+    }
+    else {
+      ++b.dropped_;
+    }
+  }
+
+  // zeroes every counter and timer and clears the timeline.
+  void reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& each : counters_) {
+      each.reset();
+    }
+    for (auto& each : timers_) {
+      each.reset();
+    }
+    for (auto& each : buffers_) {
+      std::lock_guard<std::mutex> buffer_lock(each->mutex_);
+      each->events_.clear();
+      each->dropped_ = 0;
+    }
+  }
+
+  // {"counters": {name: value, ...}, "timers": {name: {"calls": n, "total_ns": t}, ...}, "dropped_events": n}
+  void write_json(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "{\"counters\": {";
+    const char* sep = "";
+    for (auto& each : counters_) {
+      os << sep;
+      write_string(os, each.get_name());
+      os << ": " << each.get();
+      sep = ", ";
+    }
+    os << "}, \"timers\": {";
+    sep = "";
+    for (auto& each : timers_) {
+      os << sep;
+      write_string(os, each.get_name());
+      os << ": {\"calls\": " << each.get_calls() << ", \"total_ns\": " << each.get_total_ns() << "}";
+      sep = ", ";
+    }
+    size_type dropped = 0;
+    for (auto& each : buffers_) {
+      std::lock_guard<std::mutex> buffer_lock(each->mutex_);
+      dropped += each->dropped_;
+    }
+    os << "}, \"dropped_events\": " << dropped << "}";
+  }
+
+  // chrome trace event format, one complete ("X") event per timed scope.
+  void write_chrome_trace(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "{\"traceEvents\": [";
+    const char* sep = "";
+    for (auto& each : buffers_) {
+      std::lock_guard<std::mutex> buffer_lock(each->mutex_);
+      for (const trace_event& e : each->events_) {
+        os << sep << "{\"name\": ";
+        write_string(os, e.name);
+        os << ", \"cat\": \"pnmatrix\", \"ph\": \"X\", \"ts\": " << e.start_ns / 1000.0
+           << ", \"dur\": " << e.duration_ns / 1000.0 << ", \"pid\": 1, \"tid\": " << each->thread_ << "}";
+        sep = ", ";
+      }
+    }
+    os << "], \"displayTimeUnit\": \"ns\"}";
+  }
+
+private:
+  struct thread_buffer {
+    std::mutex mutex_;
+    std::vector<trace_event> events_;
+    size_type dropped_ = 0;
+    size_type thread_ = 0;
+  };
+
+  std::mutex mutex_;
+  std::deque<counter> counters_;
+  std::deque<timer> timers_;
+  std::vector<std::shared_ptr<thread_buffer>> buffers_;
+  std::atomic<size_type> event_limit_;
+  clock::time_point origin_;
+
+  registry():event_limit_(default_event_limit), origin_(clock::now()) {
+
+  }
+
+  thread_buffer& local_buffer() {
+    thread_local std::shared_ptr<thread_buffer> buffer;
+    if (buffer == nullptr) {
+      buffer = std::make_shared<thread_buffer>();
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffer->thread_ = buffers_.size();
+      buffers_.push_back(buffer);
+    }
+    return *buffer;
+  }
+
+  static void write_string(std::ostream& os, const char* s) {
+    os << '"';
+    for (; *s != '\0'; ++s) {
+      if (*s == '"' || *s == '\\') {
+        os << '\\';
+      }
+      os << *s;
+    }
+    os << '"';
+  }
+};
+
+// adds the lifetime of the scope to t and to the timeline.
+class scoped_timer {
+public:
+  explicit scoped_timer(timer& t):timer_(t), start_(registry::get().now_ns()) {
+
+  }
+
+  scoped_timer(const scoped_timer&) = delete;
+  scoped_timer& operator=(const scoped_timer&) = delete;
+
+  ~scoped_timer() {
+    size_type duration = registry::get().now_ns() - start_;
+    timer_.add(duration);
+    registry::get().record(trace_event{timer_.get_name(), start_, duration});
+  }
+
+private:
+  timer& timer_;
+  size_type start_;
+};
+
+// adds the library allocations made by the calling thread during the scope to two counters.
+class scoped_allocation_counter {
+public:
+  scoped_allocation_counter(counter& count, counter& bytes):count_(count), bytes_(bytes) {
+
+  }
+
+  scoped_allocation_counter(const scoped_allocation_counter&) = delete;
+  scoped_allocation_counter& operator=(const scoped_allocation_counter&) = delete;
+
+  ~scoped_allocation_counter() {
+    count_.add(tracker_.get_count());
+    bytes_.add(tracker_.get_bytes());
+  }
+
+private:
+  counter& count_;
+  counter& bytes_;
+  allocation_tracker tracker_;
+};
+}
+}
+
+#define PNMATRIX_INSTRUMENT_CONCAT_IMPL(a, b) a##b
+#define PNMATRIX_INSTRUMENT_CONCAT(a, b) PNMATRIX_INSTRUMENT_CONCAT_IMPL(a, b)
+
+#ifdef PNMATRIX_INSTRUMENT
+#define PNMATRIX_COUNT_N(name, n) \
+  do { \
+    static ::pnmatrix::instrument::counter& pnmatrix_counter_ = ::pnmatrix::instrument::registry::get().get_counter(name); \
+    pnmatrix_counter_.add(n); \
+  } while (0)
+#define PNMATRIX_TIMED_SCOPE(name) \
+  static ::pnmatrix::instrument::timer& PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_timer_, __LINE__) = ::pnmatrix::instrument::registry::get().get_timer(name); \
+  ::pnmatrix::instrument::scoped_timer PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_scoped_timer_, __LINE__)(PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_timer_, __LINE__))
+#define PNMATRIX_ALLOCATION_SCOPE(name) \
+  static ::pnmatrix::instrument::counter& PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_allocation_count_, __LINE__) = ::pnmatrix::instrument::registry::get().get_counter(name ".allocations"); \
+  static ::pnmatrix::instrument::counter& PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_allocation_bytes_, __LINE__) = ::pnmatrix::instrument::registry::get().get_counter(name ".allocated_bytes"); \
+  ::pnmatrix::instrument::scoped_allocation_counter PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_allocation_scope_, __LINE__)( \
+    PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_allocation_count_, __LINE__), PNMATRIX_INSTRUMENT_CONCAT(pnmatrix_allocation_bytes_, __LINE__))
+#else
+#define PNMATRIX_COUNT_N(name, n) do {} while (0)
+#define PNMATRIX_TIMED_SCOPE(name) do {} while (0)
+#define PNMATRIX_ALLOCATION_SCOPE(name) do {} while (0)
+#endif
+
+#define PNMATRIX_COUNT(name) PNMATRIX_COUNT_N(name, 1)
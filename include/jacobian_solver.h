@@ -2,6 +2,12 @@
 
 #include "type.h"
 #include "value_compare.h"
+#include "dense_vector.h"
+#include "dense_block.h"
+#include "solve_control.h"
+#include "instrument.h"
+#include "linear_operator.h"
+#include <vector>
 #include <utility>
 #include <cassert>
 #include <cmath>
@@ -11,66 +17,291 @@ namespace pnmatrix {
 class jacobian {
 private:
   double rm_;
+  size_type max_iteration_;
+  double weight_;
+  executor* exec_;
 
 public:
   struct option {
     double rm = 1e-6;
+    // 0 means no limit.
+    size_type max_iteration = 0;
+    // damping of the update, x = x_prev + weight * (b - A * x_prev) / diag. 1 is plain jacobi,
+    // about 2 / 3 damps the high frequencies better when it smooths for multigrid.
+    double weight = 1;
+    // runs the matrix vector products and updates, nullptr means the calling thread only.
+    executor* exec = nullptr;
   };
 
-  jacobian(option op):rm_(op.rm) {
+  jacobian(option op):rm_(op.rm),max_iteration_(op.max_iteration),weight_(op.weight),exec_(op.exec) {
 
   }
 
+  // the vectors of one solve, keep it between solves of the same size to avoid allocating.
+  template<class ValueType>
+  struct workspace {
+    dense_vector<ValueType> diag;
+    dense_vector<ValueType> x_prev;
+    dense_vector<ValueType> tmp;
+    dense_vector<ValueType> x_best;
+
+    void resize(size_type n) {
+      diag.resize(n);
+      x_prev.resize(n);
+      tmp.resize(n);
+      x_best.resize(n);
+    }
+  };
+
   template<class MatrixType>
   MatrixType solve(MatrixType& coeff, MatrixType& b) {
-    assert(coeff.get_column() == b.get_row() && b.get_column() == 1);
+    solve_control control;
+    return solve(coeff, b, control);
+  }
+
+  template<class MatrixType>
+  MatrixType solve(MatrixType& coeff, MatrixType& b, solve_control& control) {
+    MatrixType x0(coeff.get_column(), b.get_column());
+    return solve(coeff, b, x0, control);
+  }
+
+  template<class MatrixType>
+  MatrixType solve(MatrixType& coeff, MatrixType& b, const MatrixType& x0) {
+    solve_control control;
+    return solve(coeff, b, x0, control);
+  }
+
+  // starts from x0. stops early when control is cancelled or its deadline passes, and returns the
+  // iterate with the smallest residual so far. the outcome is left in control.get_status().
+  template<class MatrixType>
+  MatrixType solve(MatrixType& coeff, MatrixType& b, const MatrixType& x0, solve_control& control) {
+    assert(coeff.get_column() == b.get_row());
+    assert(x0.get_row() == coeff.get_column() && x0.get_column() == b.get_column());
+    using value_type = typename MatrixType::value_type;
+    if (b.get_column() > 1) {
+      dense_block<value_type> x = to_dense_block(x0);
+      solve_block(coeff, to_dense_block(b), x, control);
+      return to_matrix<MatrixType>(x);
+    }
+    workspace<value_type> ws;
+    dense_vector<value_type> x = to_dense_vector(x0);
+    solve(coeff, to_dense_vector(b), x, control, ws);
+    return to_matrix<MatrixType>(x);
+  }
+
+  template<class MatrixType, class ValueType>
+  void solve(const MatrixType& coeff, const dense_vector<ValueType>& b, dense_vector<ValueType>& x, workspace<ValueType>& ws) {
+    solve_control control;
+    solve(coeff, b, x, control, ws);
+  }
+
+  // x is the initial guess on entry and the solution on return. once ws has been used for a system
+  // of the same size this does not allocate. coeff is a matrix<> or a linear operator providing get_diagonal.
+  template<class MatrixType, class ValueType>
+  void solve(const MatrixType& coeff, const dense_vector<ValueType>& b, dense_vector<ValueType>& x, solve_control& control, workspace<ValueType>& ws) {
+    PNMATRIX_TIMED_SCOPE("jacobian.solve");
+    PNMATRIX_ALLOCATION_SCOPE("jacobian.solve");
+    using value_type = ValueType;
+    assert(coeff.get_column() == b.size() && x.size() == coeff.get_column());
     size_type x_count = coeff.get_column();
-    MatrixType x_prev(x_count, 1);
-    MatrixType x_next(x_count, 1);
-    size_t times = 1;
+    ws.resize(x_count);
+    get_diagonal(coeff, ws.diag);
+    ws.x_prev = x;
+    dense_vector<value_type>& x_prev = ws.x_prev;
+    dense_vector<value_type>& tmp = ws.tmp;
+    const dense_vector<value_type>& diag = ws.diag;
+    double best_err = -1;
+    executor& ex = get_executor();
+    size_type times = 1;
     while (true) {
-      for (auto row_iter = coeff.begin(); row_iter != coeff.end(); ++row_iter) {
-        double result = 0;
-        double sum = 0;
-        size_type row = row_iter.row_index();
-        for (auto colu_iter = row_iter.begin(); colu_iter != row_iter.end(); ++colu_iter) {
-          sum += (*colu_iter) * x_prev.get_value(colu_iter.column_index(), 1);
+      step(ex, coeff, b, x_prev, x, tmp, diag);
+      apply_operator(ex, coeff, x, tmp);
+      double max_err = max_error(tmp, b);
+      if (max_err <= rm_) {
+        control.next_iteration(times, max_err);
+        control.finish(solve_status::converged);
+        return;
+      }
+      if (best_err < 0 || max_err < best_err) {
+        best_err = max_err;
+        ws.x_best = x;
+      }
+      if (control.next_iteration(times, max_err) == false) {
+        break;
+      }
+      if (times == max_iteration_) {
+        control.finish(solve_status::max_iteration_reached);
+        break;
+      }
+      std::swap(x_prev, x);
+      ++times;
+    }
+    x = ws.x_best;
+  }
+
+  // fills ws for sweep, once per coefficient matrix.
+  template<class MatrixType, class ValueType>
+  void prepare_sweep(const MatrixType& coeff, workspace<ValueType>& ws) {
+    ws.resize(coeff.get_column());
+    get_diagonal(coeff, ws.diag);
+  }
+
+  // `sweeps` damped updates of x and nothing else : no residual, no best iterate, no solve_control.
+  // x moves by a fixed linear map, what a multigrid smoother needs. ws comes from prepare_sweep.
+  template<class MatrixType, class ValueType>
+  void sweep(const MatrixType& coeff, const dense_vector<ValueType>& b, dense_vector<ValueType>& x, size_type sweeps, workspace<ValueType>& ws) {
+    executor& ex = get_executor();
+    for (size_type s = 0; s < sweeps; ++s) {
+      ws.x_prev = x;
+      step(ex, coeff, b, ws.x_prev, x, ws.tmp, ws.diag);
+    }
+  }
+
+  // every column of b is an independent system sharing coeff. all columns are swept together,
+  // so each row of coeff is read once per sweep, and a column leaves the sweep when it converges.
+  template<class MatrixType>
+  dense_block<typename MatrixType::value_type> solve_block(const MatrixType& coeff, const dense_block<typename MatrixType::value_type>& b) {
+    solve_control control;
+    return solve_block(coeff, b, control);
+  }
+
+  // when control stops the solve the columns still running keep their current iterate.
+  template<class MatrixType>
+  dense_block<typename MatrixType::value_type> solve_block(const MatrixType& coeff, const dense_block<typename MatrixType::value_type>& b, solve_control& control) {
+    dense_block<typename MatrixType::value_type> x(coeff.get_column(), b.get_column());
+    solve_block(coeff, b, x, control);
+    return x;
+  }
+
+  // x holds the initial guesses on entry and the solutions on return.
+  template<class MatrixType>
+  void solve_block(const MatrixType& coeff, const dense_block<typename MatrixType::value_type>& b, dense_block<typename MatrixType::value_type>& x, solve_control& control) {
+    PNMATRIX_TIMED_SCOPE("jacobian.solve_block");
+    PNMATRIX_ALLOCATION_SCOPE("jacobian.solve_block");
+    assert(coeff.get_column() == b.get_row());
+    assert(x.get_row() == coeff.get_column() && x.get_column() == b.get_column());
+    using value_type = typename MatrixType::value_type;
+    size_type x_count = coeff.get_column();
+    dense_vector<value_type> diag(x_count);
+    get_diagonal(coeff, diag);
+    dense_block<value_type>& result = x;
+    tracked_vector<size_type> active(b.get_column());
+    for (size_type j = 0; j < b.get_column(); ++j) {
+      active[j] = j;
+    }
+    dense_block<value_type> rhs = b;
+    dense_block<value_type> x_prev = x;
+    dense_block<value_type> x_next(x_count, b.get_column());
+    dense_block<value_type> tmp(coeff.get_row(), b.get_column());
+    tracked_vector<double> max_err(b.get_column());
+    tracked_vector<bool> keep;
+    executor& ex = get_executor();
+    size_type times = 1;
+    while (active.empty() == false) {
+      size_type k = active.size();
+      matrix_block_multiply(ex, coeff, x_prev, tmp);
+      const value_type w = value_type(weight_);
+      parallel_for(ex, 0, x_count, [&](size_type, size_type first, size_type last) {
+        for (size_type i = first; i < last; ++i) {
+          value_type t = diag[i];
+          value_type* next = x_next.row_data(i);
+          const value_type* prev = x_prev.row_data(i);
+          const value_type* r = rhs.row_data(i);
+          const value_type* ax = tmp.row_data(i);
+          for (size_type j = 0; j < k; ++j) {
+            next[j] = value_equal(t, value_type(0)) == true ? value_type(0) : prev[j] + w * (r[j] - ax[j]) / t;
+          }
         }
-        result = b.get_value(row, 1) - sum + coeff.get_value(row, row) * x_prev.get_value(row, 1);
-        double t = coeff.get_value(row, row);
-        result = result / t;
-        if (value_equal(t, 0.0) == true) {
-          x_next.set_value(row, 1, 0);
+      });
+      matrix_block_multiply(ex, coeff, x_next, tmp);
+      column_max_error(tmp, rhs, max_err.data());
+      double worst = 0;
+      keep.resize(k);
+      for (size_type j = 0; j < k; ++j) {
+        keep[j] = max_err[j] > rm_;
+        worst = keep[j] == true ? std::max(worst, max_err[j]) : worst;
+      }
+      bool go_on = control.next_iteration(times, worst);
+      if (go_on == true && times == max_iteration_) {
+        control.finish(solve_status::max_iteration_reached);
+        go_on = false;
+      }
+      if (go_on == false) {
+        keep.assign(k, false);
+      }
+      if (retire_columns(keep, x_next, result, active) == true) {
+        x_prev.compact_columns(keep);
+        rhs.compact_columns(keep);
+        tmp.compact_columns(keep);
+      }
+      std::swap(x_prev, x_next);
+      ++times;
+    }
+    control.finish(solve_status::converged);
+  }
+
+private:
+  // x = x_prev + weight * (b - A * x_prev) / diag
+  template<class MatrixType, class ValueType>
+  void step(executor& ex, const MatrixType& coeff, const dense_vector<ValueType>& b, const dense_vector<ValueType>& x_prev,
+            dense_vector<ValueType>& x, dense_vector<ValueType>& tmp, const dense_vector<ValueType>& diag) {
+    apply_operator(ex, coeff, x_prev, tmp);
+    const ValueType w = ValueType(weight_);
+    parallel_for(ex, 0, x.size(), [&](size_type, size_type first, size_type last) {
+      for (size_type i = first; i < last; ++i) {
+        ValueType t = diag[i];
+        if (value_equal(t, ValueType(0)) == true) {
+          x[i] = 0;
         }
         else {
-          x_next.set_value(row, 1, result);
+          x[i] = x_prev[i] + w * (b[i] - tmp[i]) / t;
         }
       }
-      MatrixType tmp = coeff * x_next;
-      double max_err = max_error(tmp, b);
-      if (max_err <= rm_) {
-        break;
+    });
+  }
+
+  executor& get_executor() const {
+    return exec_ == nullptr ? get_inline_executor() : *exec_;
+  }
+
+  template<class MatrixType, class ValueType>
+  void get_diagonal(const MatrixType& coeff, dense_vector<ValueType>& diag) {
+    if constexpr (is_linear_operator<MatrixType>::value) {
+      static_assert(has_diagonal<MatrixType>::value, "jacobian needs the diagonal of a linear operator.");
+      coeff.get_diagonal(diag.data());
+    }
+    else {
+      diag.fill(ValueType(0));
+      for (auto row_iter = coeff.begin(); row_iter != coeff.end(); ++row_iter) {
+        for (auto colu_iter = row_iter.begin(); colu_iter != row_iter.end(); ++colu_iter) {
+          if (colu_iter.column_index() == row_iter.row_index()) {
+            diag[row_iter.row_index() - 1] = *colu_iter;
+          }
+        }
       }
-      else {
-        std::swap(x_prev, x_next);
-        ++times;
+    }
+  }
+
+  template<class ValueType>
+  void column_max_error(const dense_block<ValueType>& m1, const dense_block<ValueType>& m2, double* max_err) {
+    std::fill(max_err, max_err + m1.get_column(), 0.0);
+    for (size_type i = 0; i < m1.get_row(); ++i) {
+      const ValueType* a = m1.row_data(i);
+      const ValueType* b = m2.row_data(i);
+      for (size_type j = 0; j < m1.get_column(); ++j) {
+        max_err[j] = std::max(max_err[j], double(std::abs(a[j] - b[j])));
       }
     }
-    return x_next;
   }
 
-private:
-  template<class MatrixType>
-  double max_error(const MatrixType& m1,const MatrixType& m2) {
-    assert(m1.get_row() == m2.get_row() && m1.get_column() == m2.get_column());
+  template<class ValueType>
+  double max_error(const dense_vector<ValueType>& m1, const dense_vector<ValueType>& m2) {
+    assert(m1.size() == m2.size());
     double max_err = 0;
-    for (size_type row = 1; row <= m1.get_row(); ++row) {
-      for (size_type colu = 1; colu <= m1.get_column(); ++colu) {
-        double error = m1.get_value(row, colu) - m2.get_value(row, colu);
-        error = std::abs(error);
-        if (error > max_err) {
-          max_err = error;
-        }
+    for (size_type row = 0; row < m1.size(); ++row) {
+      double error = std::abs(m1[row] - m2[row]);
+      if (error > max_err) {
+        max_err = error;
       }
     }
     return max_err;
@@ -0,0 +1,139 @@
+#pragma once
+#include "type.h"
+#include "dense_vector.h"
+#include "executor.h"
+#include "matrix_type_traits.h"
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <cassert>
+
+namespace pnmatrix {
+// a linear operator is anything the krylov solvers can run on without its elements:
+//   using value_type = ...;
+//   size_type get_row() const;
+//   size_type get_column() const;
+//   void apply(const dense_vector<value_type>& x, dense_vector<value_type>& y) const;   // y = A * x
+// and optionally, for the solvers that scale by the diagonal (jacobian):
+//   void get_diagonal(value_type* d) const;
+// gmres and jacobian take one wherever they take a matrix with dense_vector arguments.
+template <typename T, typename = std::void_t<>>
+struct is_linear_operator : std::false_type {};
+
+template <typename T>
+struct is_linear_operator<T, std::void_t<decltype(std::declval<const T&>().apply(std::declval<const dense_vector<typename T::value_type>&>(),
+                                                                                  std::declval<dense_vector<typename T::value_type>&>())),
+                                         decltype(std::declval<const T&>().get_row()),
+                                         decltype(std::declval<const T&>().get_column())>> : std::true_type {};
+
+template <typename T, typename = std::void_t<>>
+struct has_diagonal : std::false_type {};
+
+template <typename T>
+struct has_diagonal<T, std::void_t<decltype(std::declval<const T&>().get_diagonal(std::declval<typename T::value_type*>()))>> : std::true_type {};
+
+// y = A * x for a matrix<> or a linear operator.
+template <typename MatrixType, typename ValueType>
+void apply_operator(executor& ex, const MatrixType& A, const dense_vector<ValueType>& x, dense_vector<ValueType>& y) {
+  if constexpr (is_linear_operator<MatrixType>::value) {
+    assert(A.get_column() == x.size() && A.get_row() == y.size());
+    A.apply(x, y);
+  }
+  else {
+    matrix_vector_multiply(ex, A, x, y);
+  }
+}
+
+// an assembled matrix<> seen as a linear operator, the products run on exec.
+template <typename MatrixType>
+class matrix_operator {
+public:
+  using value_type = typename MatrixType::value_type;
+
+  explicit matrix_operator(const MatrixType& A, executor* exec = nullptr):A_(&A), exec_(exec) {
+
+  }
+
+  size_type get_row() const {
+    return A_->get_row();
+  }
+
+  size_type get_column() const {
+    return A_->get_column();
+  }
+
+  void apply(const dense_vector<value_type>& x, dense_vector<value_type>& y) const {
+    matrix_vector_multiply(exec_ == nullptr ? get_inline_executor() : *exec_, *A_, x, y);
+  }
+
+  void get_diagonal(value_type* d) const {
+    std::fill(d, d + std::min(get_row(), get_column()), value_type(0));
+    for (auto row_iter = A_->begin(); row_iter != A_->end(); ++row_iter) {
+      for (auto colu_iter = row_iter.begin(); colu_iter != row_iter.end(); ++colu_iter) {
+        if (colu_iter.column_index() == row_iter.row_index()) {
+          d[row_iter.row_index() - 1] = *colu_iter;
+        }
+      }
+    }
+  }
+
+private:
+  const MatrixType* A_;
+  executor* exec_;
+};
+
+namespace detail {
+struct no_diagonal {
+};
+}
+
+// a callable f(const value_type* x, value_type* y) computing y = A * x, and optionally a callable
+// d(value_type* diagonal). both are stored by value and called directly, nothing is type erased.
+template <typename ValueType, typename F, typename D = detail::no_diagonal>
+class function_operator {
+public:
+  using value_type = ValueType;
+
+  function_operator(size_type row, size_type column, F f, D d = D()):row_(row), column_(column), f_(std::move(f)), d_(std::move(d)) {
+
+  }
+
+  size_type get_row() const {
+    return row_;
+  }
+
+  size_type get_column() const {
+    return column_;
+  }
+
+  void apply(const dense_vector<value_type>& x, dense_vector<value_type>& y) const {
+    f_(x.data(), y.data());
+  }
+
+  template <typename DD = D, typename = std::enable_if_t<std::is_same<DD, detail::no_diagonal>::value == false>>
+  void get_diagonal(value_type* d) const {
+    d_(d);
+  }
+
+private:
+  size_type row_;
+  size_type column_;
+  F f_;
+  D d_;
+};
+
+template <typename MatrixType>
+matrix_operator<MatrixType> make_operator(const MatrixType& A, executor* exec = nullptr) {
+  return matrix_operator<MatrixType>(A, exec);
+}
+
+template <typename ValueType, typename F>
+function_operator<ValueType, F> make_operator(size_type row, size_type column, F f) {
+  return function_operator<ValueType, F>(row, column, std::move(f));
+}
+
+template <typename ValueType, typename F, typename D>
+function_operator<ValueType, F, D> make_operator(size_type row, size_type column, F f, D d) {
+  return function_operator<ValueType, F, D>(row, column, std::move(f), std::move(d));
+}
+}
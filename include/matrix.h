@@ -3,6 +3,9 @@
 #include "operator_proxy.h"
 #include "value_compare.h"
 #include "matrix_type_traits.h"
+#include "matrix_view.h"
+#include "parallel.h"
+#include "instrument.h"
 #include <functional>
 #include <cassert>
 #include <cmath>
@@ -25,6 +28,9 @@ public:
 
   matrix(size_type row,size_type column):container_(row, column) {}
 
+  // wraps a storage built elsewhere, e.g. by freeze_pattern or get_sub_storage.
+  explicit matrix(Container&& container):container_(std::move(container)) {}
+
   ~matrix() = default;
 
   matrix(const matrix& other):container_(other.container_) {}
@@ -71,21 +77,57 @@ public:
   }
 
   matrix get_sub_matrix(size_type row_begin, size_type r, size_type col_begin, size_type c) const {
-    matrix result(r, c);
-    for (auto row = begin(); row != end(); ++row) {
-      for (auto col = row.begin(); col != row.end(); ++col) {
-        if (col.row_index() < row_begin || col.column_index() < col_begin) {
+    range_check(row_begin, col_begin);
+    range_check(row_begin + r - 1, col_begin + c - 1);
+    if constexpr (has_sub_storage<Container>::value) {
+      return matrix(container_.get_sub_storage(row_begin, r, col_begin, c));
+    }
+    else {
+      matrix result(r, c);
+      for (auto row = begin(); row != end(); ++row) {
+        if (row.row_index() < row_begin) {
           continue;
         }
-        if (col.row_index() > row_begin + r - 1 || col.column_index() > col_begin + c - 1) {
-          continue;
+        if (row.row_index() > row_begin + r - 1) {
+          break;
+        }
+        for (auto col = row.begin(); col != row.end(); ++col) {
+          if (col.column_index() < col_begin) {
+            continue;
+          }
+          if (col.column_index() > col_begin + c - 1) {
+            break;
+          }
+          size_type rr = col.row_index() - row_begin + 1;
+          size_type rc = col.column_index() - col_begin + 1;
+          result.set_value(rr, rc, *col);
         }
-        size_type rr = col.row_index() - row_begin + 1;
-        size_type rc = col.column_index() - col_begin + 1;
-        result.set_value(rr, rc, *col);
       }
+      return result;
     }
-    return result;
+  }
+
+  // non-owning views, only for dense storages that expose data() and strides.
+  dense_matrix_view<value_type> get_sub_matrix_view(size_type row_begin, size_type r, size_type col_begin, size_type c) {
+    range_check(row_begin, col_begin);
+    range_check(row_begin + r - 1, col_begin + c - 1);
+    size_type offset = (row_begin - 1) * container_.get_row_stride() + (col_begin - 1) * container_.get_column_stride();
+    return dense_matrix_view<value_type>(container_.data() + offset, r, c, container_.get_row_stride(), container_.get_column_stride());
+  }
+
+  dense_matrix_view<const value_type> get_sub_matrix_view(size_type row_begin, size_type r, size_type col_begin, size_type c) const {
+    range_check(row_begin, col_begin);
+    range_check(row_begin + r - 1, col_begin + c - 1);
+    size_type offset = (row_begin - 1) * container_.get_row_stride() + (col_begin - 1) * container_.get_column_stride();
+    return dense_matrix_view<const value_type>(container_.data() + offset, r, c, container_.get_row_stride(), container_.get_column_stride());
+  }
+
+  dense_matrix_view<value_type> get_nth_column_view(size_type n) {
+    return get_sub_matrix_view(1, get_row(), n, 1);
+  }
+
+  dense_matrix_view<const value_type> get_nth_column_view(size_type n) const {
+    return get_sub_matrix_view(1, get_row(), n, 1);
   }
 
   void set_value(size_type row, size_type column, const value_type& value) {
@@ -95,11 +137,18 @@ public:
 
   void set_value_from_matrix(size_type row_begin, size_type column_begin, const matrix& m) {
     range_check(row_begin + m.get_row() - 1, column_begin + m.get_column() - 1);
+    if constexpr (std::is_base_of<dense_container, Container>::value) {
+      set_value_from_proxy(row_begin, column_begin, m);
+      return;
+    }
     for (auto row = begin(); row != end(); ++row) {
+      if (row.row_index() < row_begin) {
+        continue;
+      }
+      if (row.row_index() > row_begin + m.get_row() - 1) {
+        break;
+      }
       for (auto col = row.begin(); col != row.end(); ++col) {
-        if (col.row_index() < row_begin || col.row_index() > row_begin + m.get_row() - 1) {
-          continue;
-        }
         if (col.column_index() < column_begin || col.column_index() > column_begin + m.get_column() - 1) {
           continue;
         }
@@ -114,6 +163,14 @@ public:
       }
     }
   }
+
+  // copies an expression (a view, or an operator proxy) without materializing it first.
+  // the expression must not read the region being written.
+  template <typename Proxy, typename std::enable_if<is_op_type<Proxy>::value, int>::type = 0>
+  void set_value_from_matrix(size_type row_begin, size_type column_begin, const Proxy& m) {
+    range_check(row_begin + m.get_row() - 1, column_begin + m.get_column() - 1);
+    set_value_from_proxy(row_begin, column_begin, m);
+  }
   
   void set_column(size_type column_begin, const matrix& matrix) {
     column_range_check(column_begin);
@@ -233,6 +290,12 @@ public:
     container_.resize(row, column);
   }
 
+  // only for containers with a capacity, e.g. matrix_storage_block.
+  void reserve(size_type row, size_type column) {
+    assert(row >= 1 && column >= 1);
+    container_.reserve(row, column);
+  }
+
   void every_nozero_element(const std::function<void(const_column_iterator iterator)>& func) const {
     for (auto row_iter = begin(); row_iter != end(); ++row_iter) {
       for (auto colu_iter = row_iter.begin(); colu_iter != row_iter.end(); ++colu_iter) {
@@ -293,11 +356,18 @@ public:
     container_.delete_column(column);
   }
 
+  // direct access to the storage, used by the kernels that are specialized for one container.
+  container_type& get_container() {
+    return container_;
+  }
+
+  const container_type& get_container() const {
+    return container_;
+  }
+
 private:
   Container container_;
 
-  explicit matrix(Container&& container):container_(std::move(container)) {}
-
   inline void range_check(size_type row, size_type column) const  {
     assert(row >= 1 && column >= 1 && row <= get_row() && column <= get_column());
   }
@@ -321,6 +391,15 @@ private:
   inline value_type get_value_withoutcheck(size_type row, size_type column) const  {
     return container_.get_value(row, column);
   }
+
+  template <typename Proxy>
+  void set_value_from_proxy(size_type row_begin, size_type column_begin, const Proxy& m) {
+    for (size_type i = 1; i <= m.get_row(); ++i) {
+      for (size_type j = 1; j <= m.get_column(); ++j) {
+        set_value_withoutcheck(row_begin + i - 1, column_begin + j - 1, m.get_value(i, j));
+      }
+    }
+  }
 };
 
 template<typename Proxy1, typename Proxy2,
@@ -337,6 +416,7 @@ auto operator+(const Proxy1& m1, const Proxy2& m2)->op_add<Proxy1, Proxy2> {
 
 template<typename MatrixType, typename std::enable_if<is_sparse_matrix<MatrixType>::value, int>::type = 0>
 auto operator+(const MatrixType& m1, const MatrixType& m2)->MatrixType {
+  PNMATRIX_ALLOCATION_SCOPE("sparse.add");
   assert(m1.get_row() == m2.get_row() && m1.get_column() == m2.get_column());
   MatrixType result(m1.get_row(), m1.get_column());
   for (auto row_iter = m1.begin(); row_iter != m1.end(); ++row_iter) {
@@ -366,6 +446,7 @@ auto operator-(const Proxy1& m1, const Proxy2& m2)->op_sub<Proxy1, Proxy2> {
 
 template<typename MatrixType, typename std::enable_if<is_sparse_matrix<MatrixType>::value, int>::type = 0>
 auto operator-(const MatrixType& m1, const MatrixType& m2)->MatrixType {
+  PNMATRIX_ALLOCATION_SCOPE("sparse.sub");
   assert(m1.get_row() == m2.get_row() && m1.get_column() == m2.get_column());
   MatrixType result(m1.get_row(), m1.get_column());
   for (auto row_iter = m1.begin(); row_iter != m1.end(); ++row_iter) {
@@ -397,6 +478,7 @@ template<typename MatrixType, typename MatrixType2,
     std::conjunction<is_sparse_matrix<MatrixType>,is_matrix_type<MatrixType2>>::value,
   int>::type = 0>
 auto operator*(const MatrixType& m1, const MatrixType2& m2)->MatrixType2 {
+  PNMATRIX_ALLOCATION_SCOPE("sparse.multiply_dense");
   assert(m1.get_column() == m2.get_row());
   using value_type = typename MatrixType::value_type;
   static_assert (std::is_same<value_type, typename MatrixType2::value_type>::value,"error.");
@@ -473,9 +555,26 @@ void construct_from_proxy(MatrixType& self, const Proxy& pro) {
   }
 }
 
+// result = pro with the rows split across ex, result is resized to the shape of pro.
+template <typename MatrixType, typename Proxy,typename std::enable_if<
+  is_dense_matrix<MatrixType>::value, int>::type = 0>
+void evaluate(executor& ex, const Proxy& pro, MatrixType& result) {
+  result.resize(pro.get_row(), pro.get_column());
+  auto& container = result.get_container();
+  parallel_for(ex, 1, pro.get_row() + 1, [&](size_type, size_type first, size_type last) {
+    for (size_type i = first; i < last; ++i) {
+      for (size_type j = 1; j <= pro.get_column(); ++j) {
+        container.set_value(i, j, pro.get_value(i, j));
+      }
+    }
+  });
+}
+
 template <typename Container>
 template <typename Proxy>
 matrix<Container>::matrix(const Proxy& pro):container_(pro.get_row(), pro.get_column()) {
+  PNMATRIX_COUNT("matrix.evaluate");
+  PNMATRIX_COUNT_N("matrix.evaluate.elements", pro.get_row() * pro.get_column());
   construct_from_proxy(*this, pro);
 }
 
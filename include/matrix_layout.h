@@ -0,0 +1,84 @@
+#pragma once
+#include "type.h"
+
+namespace pnmatrix {
+// element placement policies for matrix_storage_block.
+// row_capacity x column_capacity is the allocated shape, indices start by 1.
+// next_in_row(index, column, ...) is the index of (row, column + 1) given the index of (row, column),
+// the row iterators of matrix_storage_block step with it instead of recomputing get_index.
+struct row_major {
+  static constexpr bool is_strided = true;
+  static constexpr bool column_first = false;
+
+  static size_type round_capacity(size_type n) {
+    return n;
+  }
+
+  static size_type get_index(size_type row, size_type column, size_type, size_type column_capacity) {
+    return (row - 1) * column_capacity + column - 1;
+  }
+
+  static size_type next_in_row(size_type index, size_type, size_type, size_type) {
+    return index + 1;
+  }
+
+  static size_type get_row_stride(size_type, size_type column_capacity) {
+    return column_capacity;
+  }
+
+  static size_type get_column_stride(size_type, size_type) {
+    return 1;
+  }
+};
+
+struct column_major {
+  static constexpr bool is_strided = true;
+  static constexpr bool column_first = true;
+
+  static size_type round_capacity(size_type n) {
+    return n;
+  }
+
+  static size_type get_index(size_type row, size_type column, size_type row_capacity, size_type) {
+    return (column - 1) * row_capacity + row - 1;
+  }
+
+  static size_type next_in_row(size_type index, size_type, size_type row_capacity, size_type) {
+    return index + row_capacity;
+  }
+
+  static size_type get_row_stride(size_type, size_type) {
+    return 1;
+  }
+
+  static size_type get_column_stride(size_type row_capacity, size_type) {
+    return row_capacity;
+  }
+};
+
+// TileSize x TileSize row-major tiles stored in row-major tile order, a tile is contiguous.
+// the capacity is rounded up to whole tiles. not strided, so no dense_matrix_view over it.
+template <size_type TileSize>
+struct tiled {
+  static_assert(TileSize > 0, "tile size should be positive.");
+  static constexpr bool is_strided = false;
+  static constexpr bool column_first = false;
+  static constexpr size_type tile_size = TileSize;
+
+  static size_type round_capacity(size_type n) {
+    return (n + TileSize - 1) / TileSize * TileSize;
+  }
+
+  static size_type get_index(size_type row, size_type column, size_type, size_type column_capacity) {
+    size_type r = row - 1;
+    size_type c = column - 1;
+    size_type tile = (r / TileSize) * (column_capacity / TileSize) + c / TileSize;
+    return tile * TileSize * TileSize + (r % TileSize) * TileSize + c % TileSize;
+  }
+
+  // inside a tile the next column is adjacent, past its last column the same row of the next tile.
+  static size_type next_in_row(size_type index, size_type column, size_type, size_type) {
+    return column % TileSize != 0 ? index + 1 : index + TileSize * TileSize - TileSize + 1;
+  }
+};
+}
@@ -0,0 +1,407 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "matrix_type_traits.h"
+#include "matrix.h"
+#include "allocator.h"
+#include <vector>
+#include <cassert>
+#include <algorithm>
+
+namespace pnmatrix {
+// band storage: row r keeps the columns [r - lower, r + upper] in lower + upper + 1 contiguous slots,
+// the slots outside the matrix are padding. every slot inside the matrix counts as stored, zeros
+// included. writing a nonzero value outside the band widens it.
+template<class ValueType>
+class matrix_storage_banded : public sparse_container {
+public:
+  using value_type = ValueType;
+
+private:
+  using self = matrix_storage_banded;
+
+public:
+  // a diagonal band.
+  matrix_storage_banded(size_type row, size_type column):matrix_storage_banded(row, column, 0, 0) {
+
+  }
+
+  matrix_storage_banded(size_type row, size_type column, size_type lower, size_type upper):my_row_(row), my_column_(column), lower_(lower), upper_(upper),
+                                                                                             values_(row * (lower + upper + 1), value_type(0)) {
+    assert(row > 0 && column > 0 && lower >= 0 && upper >= 0);
+  }
+
+  // the smallest band holding the stored elements of c, with their values.
+  template <typename Container>
+  explicit matrix_storage_banded(const Container& c):matrix_storage_banded(c.get_row(), c.get_column()) {
+    size_type lower = 0;
+    size_type upper = 0;
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        lower = std::max(lower, row.row_index() - col.column_index());
+        upper = std::max(upper, col.column_index() - row.row_index());
+      }
+    }
+    *this = self(my_row_, my_column_, lower, upper);
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        at(row.row_index(), col.column_index()) = *col;
+      }
+    }
+  }
+
+  ~matrix_storage_banded() = default;
+  matrix_storage_banded(const self&) = default;
+  matrix_storage_banded(self&&) = default;
+  self& operator=(const self&) = default;
+  self& operator=(self&&) = default;
+
+  bool operator==(const self& other) const {
+    if (get_row() != other.get_row() || get_column() != other.get_column()) {
+      return false;
+    }
+    for (size_type row = 1; row <= get_row(); ++row) {
+      bool same = true;
+      for_each_in_row(row, [&](size_type column, const value_type& v) {
+        same = same && value_equal(v, other.get_value(row, column));
+      });
+      other.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        same = same && value_equal(v, get_value(row, column));
+      });
+      if (same == false) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void set_value(size_type row, size_type column, const value_type& value) {
+    if (in_band(row, column) == false) {
+      if (value_equal(value, value_type(0)) == true) {
+        return;
+      }
+      widen(row - column, column - row);
+    }
+    at(row, column) = value;
+  }
+
+  void add_value(size_type row, size_type column, const value_type& value) {
+    if (in_band(row, column) == false) {
+      if (value_equal(value, value_type(0)) == true) {
+        return;
+      }
+      widen(row - column, column - row);
+    }
+    at(row, column) += value;
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    return in_band(row, column) ? at(row, column) : value_type(0);
+  }
+
+  inline size_type get_row() const {
+    return my_row_;
+  }
+
+  inline size_type get_column() const {
+    return my_column_;
+  }
+
+  size_type get_nth_row_size(size_type row) const {
+    return std::max<size_type>(0, get_last_column(row) - get_first_column(row) + 1);
+  }
+
+  size_type get_element_count() const {
+    size_type count = 0;
+    for (size_type row = 1; row <= my_row_; ++row) {
+      count += get_nth_row_size(row);
+    }
+    return count;
+  }
+
+  size_type get_lower_bandwidth() const {
+    return lower_;
+  }
+
+  size_type get_upper_bandwidth() const {
+    return upper_;
+  }
+
+  // the lower + upper + 1 slots of row, column c at index c - row + lower.
+  value_type* get_band(size_type row) {
+    return &values_[(row - 1) * (lower_ + upper_ + 1)];
+  }
+
+  const value_type* get_band(size_type row) const {
+    return &values_[(row - 1) * (lower_ + upper_ + 1)];
+  }
+
+  // calls f(column, value) for every stored element of row, in column order.
+  template <typename F>
+  void for_each_in_row(size_type row, F f) const {
+    for (size_type c = get_first_column(row); c <= get_last_column(row); ++c) {
+      f(c, at(row, c));
+    }
+  }
+
+  // y = A * x, x has get_column() values and y has get_row() values.
+  void multiply(const value_type* x, value_type* y) const {
+    multiply(x, y, 1, my_row_ + 1);
+  }
+
+  // rows [first, last) of y = A * x, rows start by 1.
+  void multiply(const value_type* x, value_type* y, size_type first, size_type last) const {
+    for (size_type row = first; row < last; ++row) {
+      const value_type* band = get_band(row);
+      value_type sum = value_type(0);
+      for (size_type c = get_first_column(row); c <= get_last_column(row); ++c) {
+        sum += band[c - row + lower_] * x[c - 1];
+      }
+      y[row - 1] = sum;
+    }
+  }
+
+  class row_iterator {
+  private:
+    matrix_storage_banded<value_type>* handle_;
+    size_type row_index_;
+
+  public:
+    row_iterator(matrix_storage_banded<value_type>* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    row_iterator operator++(int) {
+      row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class column_iterator {
+    private:
+      matrix_storage_banded<value_type>* handle_;
+      size_type column_;
+      size_type row_;
+
+    public:
+      column_iterator(matrix_storage_banded<value_type>* h, size_type c, size_type r):handle_(h), column_(c), row_(r) {
+
+      }
+
+      column_iterator& operator++() {
+        ++column_;
+        return *this;
+      }
+
+      column_iterator operator++(int) {
+        column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const column_iterator& other) const {
+        return column_ == other.column_;
+      }
+
+      bool operator!=(const column_iterator& other) const {
+        return column_ != other.column_;
+      }
+
+      value_type& operator*() {
+        return handle_->at(row_, column_);
+      }
+
+      value_type* operator->() {
+        return &handle_->at(row_, column_);
+      }
+
+      size_type column_index() const {
+        return column_;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    column_iterator begin() {
+      return column_iterator(handle_, handle_->get_first_column(row_index_), row_index_);
+    }
+
+    column_iterator end() {
+      return column_iterator(handle_, std::max(handle_->get_first_column(row_index_), handle_->get_last_column(row_index_) + 1), row_index_);
+    }
+  };
+
+  class const_row_iterator {
+  private:
+    const matrix_storage_banded<value_type>* handle_;
+    size_type row_index_;
+
+  public:
+    const_row_iterator(const matrix_storage_banded<value_type>* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    const_row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    const_row_iterator operator++(int) {
+      const_row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const const_row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const const_row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class const_column_iterator {
+    private:
+      const matrix_storage_banded<value_type>* handle_;
+      size_type column_;
+      size_type row_;
+
+    public:
+      const_column_iterator(const matrix_storage_banded<value_type>* h, size_type c, size_type r):handle_(h), column_(c), row_(r) {
+
+      }
+
+      const_column_iterator& operator++() {
+        ++column_;
+        return *this;
+      }
+
+      const_column_iterator operator++(int) {
+        const_column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const const_column_iterator& other) const {
+        return column_ == other.column_;
+      }
+
+      bool operator!=(const const_column_iterator& other) const {
+        return column_ != other.column_;
+      }
+
+      const value_type& operator*() {
+        return handle_->at(row_, column_);
+      }
+
+      const value_type* operator->() {
+        return &handle_->at(row_, column_);
+      }
+
+      size_type column_index() const {
+        return column_;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    const_column_iterator begin() const {
+      return const_column_iterator(handle_, handle_->get_first_column(row_index_), row_index_);
+    }
+
+    const_column_iterator end() const {
+      return const_column_iterator(handle_, std::max(handle_->get_first_column(row_index_), handle_->get_last_column(row_index_) + 1), row_index_);
+    }
+  };
+
+  row_iterator begin() {
+    return row_iterator(this, 1);
+  }
+
+  row_iterator end() {
+    return row_iterator(this, get_row() + 1);
+  }
+
+  const_row_iterator begin() const {
+    return const_row_iterator(this, 1);
+  }
+
+  const_row_iterator end() const {
+    return const_row_iterator(this, get_row() + 1);
+  }
+
+private:
+  size_type my_row_;
+  size_type my_column_;
+  size_type lower_;
+  size_type upper_;
+  std::vector<value_type, tracked_allocator<value_type>> values_;
+
+  bool in_band(size_type row, size_type column) const {
+    assert(row >= 1 && row <= my_row_ && column >= 1 && column <= my_column_);
+    return row - column <= lower_ && column - row <= upper_;
+  }
+
+  value_type& at(size_type row, size_type column) {
+    return values_[(row - 1) * (lower_ + upper_ + 1) + column - row + lower_];
+  }
+
+  const value_type& at(size_type row, size_type column) const {
+    return values_[(row - 1) * (lower_ + upper_ + 1) + column - row + lower_];
+  }
+
+  size_type get_first_column(size_type row) const {
+    return std::max<size_type>(1, row - lower_);
+  }
+
+  size_type get_last_column(size_type row) const {
+    return std::min(my_column_, row + upper_);
+  }
+
+  void widen(size_type lower, size_type upper) {
+    self result(my_row_, my_column_, std::max(lower_, lower), std::max(upper_, upper));
+    for (size_type row = 1; row <= my_row_; ++row) {
+      for_each_in_row(row, [&](size_type column, const value_type& v) {
+        result.at(row, column) = v;
+      });
+    }
+    *this = std::move(result);
+  }
+};
+
+template <typename ValueType>
+using banded_matrix = matrix<matrix_storage_banded<ValueType>>;
+
+// the smallest band holding the stored elements of m, with their values.
+template <typename MatrixType>
+banded_matrix<typename MatrixType::value_type> to_banded_matrix(const MatrixType& m) {
+  banded_matrix<typename MatrixType::value_type> result(m.get_row(), m.get_column());
+  result.get_container() = matrix_storage_banded<typename MatrixType::value_type>(m.get_container());
+  return result;
+}
+}
@@ -1,19 +1,25 @@
 #pragma once
 #include "matrix_type_traits.h"
+#include "matrix_layout.h"
 #include "value_compare.h"
 #include "type.h"
+#include "allocator.h"
 #include <vector>
 #include <cassert>
+#include <algorithm>
 
 namespace pnmatrix {
-template <typename ValueType>
+template <typename ValueType, typename Layout = row_major>
 class matrix_storage_block : public dense_container {
 public:
   using value_type = ValueType;
+  using layout_type = Layout;
 
-  matrix_storage_block(size_type row, size_type column):my_row_(row), my_column_(column),block_row_(row),block_column_(column) {
+  matrix_storage_block(size_type row, size_type column):my_row_(row), my_column_(column),
+                                                        block_row_(Layout::round_capacity(row)),
+                                                        block_column_(Layout::round_capacity(column)) {
     assert(row > 0 && column > 0);
-    block_.resize(row * column, ValueType(0));
+    block_.resize(block_row_ * block_column_, ValueType(0));
   }
 
   matrix_storage_block(const matrix_storage_block&) = default;
@@ -63,48 +69,189 @@ public:
     return my_column_;
   }
 
+  value_type* data() {
+    return block_.data();
+  }
+
+  const value_type* data() const {
+    return block_.data();
+  }
+
+  // element (row, column) lives at data()[(row - 1) * get_row_stride() + (column - 1) * get_column_stride()].
+  size_type get_row_stride() const {
+    static_assert(Layout::is_strided, "this layout can not be described by strides.");
+    return Layout::get_row_stride(block_row_, block_column_);
+  }
+
+  size_type get_column_stride() const {
+    static_assert(Layout::is_strided, "this layout can not be described by strides.");
+    return Layout::get_column_stride(block_row_, block_column_);
+  }
+
+  // strided layouts copy whole rows (row_major) or columns (column_major) at once.
+  matrix_storage_block get_sub_storage(size_type row_begin, size_type r, size_type col_begin, size_type c) const {
+    matrix_storage_block result(r, c);
+    if constexpr (Layout::is_strided && Layout::column_first) {
+      for (size_type j = 0; j < c; ++j) {
+        auto first = block_.begin() + get_index(row_begin, col_begin + j);
+        std::copy(first, first + r, result.block_.begin() + result.get_index(1, j + 1));
+      }
+    }
+    else if constexpr (Layout::is_strided) {
+      for (size_type i = 0; i < r; ++i) {
+        auto first = block_.begin() + get_index(row_begin + i, col_begin);
+        std::copy(first, first + c, result.block_.begin() + result.get_index(i + 1, 1));
+      }
+    }
+    else {
+      for_each_position(1, r, 1, c, [&](size_type i, size_type j) {
+        result.block_[result.get_index(i, j)] = block_[get_index(row_begin + i - 1, col_begin + j - 1)];
+      });
+    }
+    return result;
+  }
+
+  // deleting the last row / column only shrinks the logical size, the allocation is kept.
+  // row_major moves the following rows with one copy, column_major shifts inside every column.
   void delete_row(size_type row) {
-    for (int i = row + 1; i <= my_row_; ++i ) {
-      for (int j = 1; j <= my_column_; ++j) {
-        set_value(i-1, j, get_value(i,j));
+    assert(row >= 1 && row <= my_row_);
+    if (row < my_row_) {
+      if constexpr (Layout::is_strided && Layout::column_first) {
+        for (size_type j = 1; j <= my_column_; ++j) {
+          auto first = block_.begin() + get_index(row + 1, j);
+          std::copy(first, block_.begin() + get_index(my_row_, j) + 1, first - 1);
+        }
+      }
+      else if constexpr (Layout::is_strided) {
+        auto first = block_.begin() + get_index(row + 1, 1);
+        auto last = block_.begin() + get_index(my_row_, 1) + my_column_;
+        std::copy(first, last, block_.begin() + get_index(row, 1));
+      }
+      else {
+        for_each_position(row + 1, my_row_, 1, my_column_, [this](size_type i, size_type j) {
+          block_[get_index(i - 1, j)] = block_[get_index(i, j)];
+        });
       }
     }
     --my_row_;
   }
 
+  // the mirror of delete_row : column_major moves the following columns with one copy.
   void delete_column(size_type column) {
-    for (int j = column + 1; j <= my_column_; ++j) {
-      for (int i = 1; i <= my_row_; ++i) {
-        set_value(i, j-1, get_value(i,j));
+    assert(column >= 1 && column <= my_column_);
+    if (column < my_column_) {
+      if constexpr (Layout::is_strided && Layout::column_first) {
+        auto first = block_.begin() + get_index(1, column + 1);
+        auto last = block_.begin() + get_index(1, my_column_) + my_row_;
+        std::copy(first, last, block_.begin() + get_index(1, column));
+      }
+      else if constexpr (Layout::is_strided) {
+        for (size_type i = 1; i <= my_row_; ++i) {
+          auto first = block_.begin() + get_index(i, column + 1);
+          std::copy(first, block_.begin() + get_index(i, my_column_) + 1, first - 1);
+        }
+      }
+      else {
+        for_each_position(1, my_row_, column + 1, my_column_, [this](size_type i, size_type j) {
+          block_[get_index(i, j - 1)] = block_[get_index(i, j)];
+        });
       }
     }
     --my_column_;
   }
 
+  // growing within capacity only clears the newly exposed rows and columns.
   void resize(size_type new_row, size_type new_column) {
     assert(new_row > 0 && new_column > 0);
-    matrix_storage_block tmp(new_row, new_column);
-    for (int i = 1; i <= my_row_; ++i) {
-      for (int j = 1; j <= my_column_; ++j) {
-        if(i <= new_row && j <= new_column) {
-          tmp.set_value(i, j, get_value(i, j));
-        }
-      }
+    if (new_row > block_row_ || new_column > block_column_) {
+      reallocate(new_row > block_row_ ? std::max(new_row, block_row_ * 2) : block_row_,
+                 new_column > block_column_ ? std::max(new_column, block_column_ * 2) : block_column_);
     }
-    block_.swap(tmp.block_);
+    size_type kept_row = std::min(my_row_, new_row);
+    auto clear = [this](size_type i, size_type j) {
+      block_[get_index(i, j)] = ValueType(0);
+    };
+    if (new_column > my_column_) {
+      for_each_position(1, kept_row, my_column_ + 1, new_column, clear);
+    }
+    for_each_position(kept_row + 1, new_row, 1, new_column, clear);
     my_row_ = new_row;
     my_column_ = new_column;
-    block_row_ = new_row;
-    block_column_ = new_column;
+  }
+
+  // makes room for a row x column matrix without changing the logical size.
+  void reserve(size_type row, size_type column) {
+    if (row > block_row_ || column > block_column_) {
+      reallocate(std::max(row, block_row_), std::max(column, block_column_));
+    }
+  }
+
+  size_type get_row_capacity() const {
+    return block_row_;
+  }
+
+  size_type get_column_capacity() const {
+    return block_column_;
+  }
+
+  // f(column, value) for every column of row.
+  template <typename F>
+  void for_each_in_row(size_type row, F f) const {
+    for (size_type j = 1; j <= my_column_; ++j) {
+      f(j, block_[get_index(row, j)]);
+    }
+  }
+
+  // y = A * x, x has get_column() values and y has get_row() values.
+  void multiply(const value_type* x, value_type* y) const {
+    if constexpr (Layout::column_first) {
+      std::fill(y, y + my_row_, value_type(0));
+      for (size_type j = 1; j <= my_column_; ++j) {
+        const value_type* column = &block_[get_index(1, j)];
+        const value_type xj = x[j - 1];
+        for (size_type i = 0; i < my_row_; ++i) {
+          y[i] += column[i] * xj;
+        }
+      }
+    }
+    else if constexpr (Layout::is_strided) {
+      for (size_type i = 1; i <= my_row_; ++i) {
+        const value_type* row = &block_[get_index(i, 1)];
+        value_type sum = value_type(0);
+        for (size_type j = 0; j < my_column_; ++j) {
+          sum += row[j] * x[j];
+        }
+        y[i - 1] = sum;
+      }
+    }
+    else {
+      // walk tile by tile, every tile row is contiguous.
+      constexpr size_type t = Layout::tile_size;
+      std::fill(y, y + my_row_, value_type(0));
+      for (size_type ti = 1; ti <= my_row_; ti += t) {
+        size_type row_end = std::min(ti + t - 1, my_row_);
+        for (size_type tj = 1; tj <= my_column_; tj += t) {
+          size_type count = std::min(t, my_column_ - tj + 1);
+          for (size_type i = ti; i <= row_end; ++i) {
+            const value_type* row = &block_[get_index(i, tj)];
+            value_type sum = value_type(0);
+            for (size_type j = 0; j < count; ++j) {
+              sum += row[j] * x[tj - 1 + j];
+            }
+            y[i - 1] += sum;
+          }
+        }
+      }
+    }
   }
 
   class row_iterator {
   private:
-    matrix_storage_block<value_type>* handle_;
+    matrix_storage_block* handle_;
     size_type row_index_;
 
   public:
-    row_iterator(matrix_storage_block<ValueType>* h, size_type r):
+    row_iterator(matrix_storage_block* h, size_type r):
         handle_(h),
         row_index_(r)  {
 
@@ -133,18 +280,22 @@ public:
       return row_index_;
     }
 
+    // keeps the index of its element and steps with Layout::next_in_row, a step is one add.
     class column_iterator {
     private:
-      matrix_storage_block<value_type>* handle_;
+      matrix_storage_block* handle_;
       size_type row_;
       size_type column_;
+      size_type index_;
 
     public:
-      column_iterator(matrix_storage_block<value_type>* h, size_type r, size_type c):handle_(h),row_(r), column_(c) {
+      column_iterator(matrix_storage_block* h, size_type r, size_type c):handle_(h),row_(r), column_(c),
+                                                                         index_(c <= h->my_column_ ? h->get_index(r, c) : 0) {
 
       }
 
       column_iterator& operator++() {
+        index_ = Layout::next_in_row(index_, column_, handle_->block_row_, handle_->block_column_);
         ++column_;
         return *this;
       }
@@ -164,7 +315,7 @@ public:
       }
 
       value_type& operator*() {
-        return handle_->block_[handle_->get_index(row_, column_)];
+        return handle_->block_[index_];
       }
 
       value_type* operator->() {
@@ -191,11 +342,11 @@ public:
 
   class const_row_iterator {
   private:
-    const matrix_storage_block<ValueType>* const handle_;
+    const matrix_storage_block* const handle_;
     size_type row_index_;
 
   public:
-    const_row_iterator(const matrix_storage_block<ValueType>*const h, size_type r):
+    const_row_iterator(const matrix_storage_block*const h, size_type r):
         handle_(h),
         row_index_(r)  {
 
@@ -226,16 +377,19 @@ public:
 
     class const_column_iterator {
     private:
-      const matrix_storage_block<value_type>* handle_;
+      const matrix_storage_block* handle_;
       size_type row_;
       size_type column_;
+      size_type index_;
 
     public:
-      const_column_iterator(const matrix_storage_block<value_type>* h, size_type r, size_type c):handle_(h),row_(r),column_(c) {
+      const_column_iterator(const matrix_storage_block* h, size_type r, size_type c):handle_(h),row_(r),column_(c),
+                                                                                     index_(c <= h->my_column_ ? h->get_index(r, c) : 0) {
 
       }
 
       const_column_iterator& operator++() {
+        index_ = Layout::next_in_row(index_, column_, handle_->block_row_, handle_->block_column_);
         ++column_;
         return *this;
       }
@@ -255,7 +409,7 @@ public:
       }
 
       const value_type& operator*() {
-        return handle_->block_[handle_->get_index(row_, column_)];
+        return handle_->block_[index_];
       }
 
       const value_type* const operator->() {
@@ -310,22 +464,60 @@ public:
 
   void element_row_transform_plus(size_type row_i, size_type row_j, value_type k) {
     for (int j = 1; j <= my_column_; ++j) {
-      add_value(row_i, j, get_value(row_j, j) * k);
+      block_[get_index(row_i, j)] += block_[get_index(row_j, j)] * k;
     }
   }
 
 private:
   size_type my_row_;
   size_type my_column_;
-  std::vector<ValueType> block_;
+  std::vector<ValueType, tracked_allocator<ValueType>> block_;
   //这两个值的作用是删除行或者列的时候保留block的映射关系。
+  //block_row_ x block_column_ 是已分配的大小，由 Layout 决定元素的位置。
   size_type block_row_;
   size_type block_column_;
 
+  // visits rows [r1, r2] x columns [c1, c2] in the storage order of the layout,
+  // rows and columns are increasing so shifting towards smaller indices is safe.
+  template <typename F>
+  void for_each_position(size_type r1, size_type r2, size_type c1, size_type c2, F&& f) const {
+    if constexpr (Layout::column_first) {
+      for (size_type j = c1; j <= c2; ++j) {
+        for (size_type i = r1; i <= r2; ++i) {
+          f(i, j);
+        }
+      }
+    }
+    else {
+      for (size_type i = r1; i <= r2; ++i) {
+        for (size_type j = c1; j <= c2; ++j) {
+          f(i, j);
+        }
+      }
+    }
+  }
+
+  void reallocate(size_type row_capacity, size_type column_capacity) {
+    row_capacity = Layout::round_capacity(row_capacity);
+    column_capacity = Layout::round_capacity(column_capacity);
+    std::vector<ValueType, tracked_allocator<ValueType>> tmp(row_capacity * column_capacity, ValueType(0));
+    for_each_position(1, my_row_, 1, my_column_, [&](size_type i, size_type j) {
+      tmp[Layout::get_index(i, j, row_capacity, column_capacity)] = block_[get_index(i, j)];
+    });
+    block_.swap(tmp);
+    block_row_ = row_capacity;
+    block_column_ = column_capacity;
+  }
+
   inline
   size_type get_index(size_type row, size_type column) const {
-    return (row - 1) * block_column_ + column - 1;
+    return Layout::get_index(row, column, block_row_, block_column_);
   }
 };
 
+template <typename ValueType>
+using column_major_matrix = matrix<matrix_storage_block<ValueType, column_major>>;
+
+template <typename ValueType, size_type TileSize = 8>
+using tiled_matrix = matrix<matrix_storage_block<ValueType, tiled<TileSize>>>;
 }
@@ -0,0 +1,838 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "matrix_type_traits.h"
+#include "matrix.h"
+#include "allocator.h"
+#include <vector>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <tuple>
+
+namespace pnmatrix {
+namespace detail {
+// y += a * x for one dense BlockSize x BlockSize block stored row-major.
+template <typename ValueType, size_type BlockSize>
+inline void block_multiply_add(const ValueType* a, const ValueType* x, ValueType* y) {
+  for (size_type i = 0; i < BlockSize; ++i) {
+    ValueType sum = ValueType(0);
+    for (size_type j = 0; j < BlockSize; ++j) {
+      sum += a[i * BlockSize + j] * x[j];
+    }
+    y[i] += sum;
+  }
+}
+
+// c -= a * b for dense BlockSize x BlockSize blocks.
+template <typename ValueType, size_type BlockSize>
+inline void block_multiply_sub(const ValueType* a, const ValueType* b, ValueType* c) {
+  for (size_type i = 0; i < BlockSize; ++i) {
+    for (size_type k = 0; k < BlockSize; ++k) {
+      ValueType aik = a[i * BlockSize + k];
+      for (size_type j = 0; j < BlockSize; ++j) {
+        c[i * BlockSize + j] -= aik * b[k * BlockSize + j];
+      }
+    }
+  }
+}
+
+template <typename ValueType, size_type BlockSize>
+inline void block_identity(ValueType* result) {
+  for (size_type i = 0; i < BlockSize; ++i) {
+    for (size_type j = 0; j < BlockSize; ++j) {
+      result[i * BlockSize + j] = i == j ? ValueType(1) : ValueType(0);
+    }
+  }
+}
+
+// gauss-jordan with partial pivoting, returns false if the block is singular.
+template <typename ValueType, size_type BlockSize>
+bool block_inverse(const ValueType* a, ValueType* result) {
+  std::array<ValueType, BlockSize * BlockSize> tmp;
+  std::copy(a, a + BlockSize * BlockSize, tmp.begin());
+  block_identity<ValueType, BlockSize>(result);
+  for (size_type k = 0; k < BlockSize; ++k) {
+    size_type p = k;
+    for (size_type i = k + 1; i < BlockSize; ++i) {
+      if (std::abs(tmp[i * BlockSize + k]) > std::abs(tmp[p * BlockSize + k])) {
+        p = i;
+      }
+    }
+    if (value_equal(tmp[p * BlockSize + k], ValueType(0)) == true) {
+      return false;
+    }
+    if (p != k) {
+      for (size_type j = 0; j < BlockSize; ++j) {
+        std::swap(tmp[k * BlockSize + j], tmp[p * BlockSize + j]);
+        std::swap(result[k * BlockSize + j], result[p * BlockSize + j]);
+      }
+    }
+    ValueType inv = ValueType(1) / tmp[k * BlockSize + k];
+    for (size_type j = 0; j < BlockSize; ++j) {
+      tmp[k * BlockSize + j] *= inv;
+      result[k * BlockSize + j] *= inv;
+    }
+    for (size_type i = 0; i < BlockSize; ++i) {
+      if (i == k) {
+        continue;
+      }
+      ValueType f = tmp[i * BlockSize + k];
+      for (size_type j = 0; j < BlockSize; ++j) {
+        tmp[i * BlockSize + j] -= f * tmp[k * BlockSize + j];
+        result[i * BlockSize + j] -= f * result[k * BlockSize + j];
+      }
+    }
+  }
+  return true;
+}
+}
+
+// block compressed sparse row storage : every nonzero position is a dense BlockSize x BlockSize block,
+// and only one column index is stored per block.
+// the dimensions do not have to be multiples of BlockSize, the last block row / column is padded with zeros.
+template <typename ValueType, size_type BlockSize>
+class matrix_storage_bsr : public sparse_container {
+  static_assert(BlockSize > 0, "matrix_storage_bsr needs a positive block size.");
+
+public:
+  using value_type = ValueType;
+  static constexpr size_type block_size = BlockSize;
+  static constexpr size_type block_elements = BlockSize * BlockSize;
+
+private:
+  using self = matrix_storage_bsr;
+
+  struct each_block_row_ {
+    // block column indices (start by 1), sorted.
+    std::vector<size_type, tracked_allocator<size_type>> columns_;
+    // block_elements values per block, row-major inside the block.
+    std::vector<value_type, tracked_allocator<value_type>> values_;
+  };
+
+public:
+  matrix_storage_bsr(size_type row, size_type column):
+                      my_row_(row),
+                      my_column_(column),
+                      block_count_(0) {
+    assert(row > 0 && column > 0);
+    container_.resize(get_block_row() + 1); // start by 1.
+  }
+  ~matrix_storage_bsr() = default;
+  matrix_storage_bsr(const self&) = default;
+  matrix_storage_bsr(self&&) = default;
+  self& operator=(const self&) = default;
+  self& operator=(self&&) = default;
+
+  bool operator==(const self& other) const {
+    if (get_row() != other.get_row() || get_column() != other.get_column()) {
+      return false;
+    }
+    for (auto row = begin(); row != end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        if (value_equal(*col, other.get_value(col.row_index(), col.column_index())) == false) {
+          return false;
+        }
+      }
+    }
+    for (auto row = other.begin(); row != other.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        if (value_equal(*col, get_value(col.row_index(), col.column_index())) == false) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void set_value(size_type row, size_type column, const value_type& value) {
+    value_type* block = find_block(row, column, !value_equal(value, value_type(0)));
+    if (block != nullptr) {
+      block[local_index(row, column)] = value;
+    }
+  }
+
+  void add_value(size_type row, size_type column, const value_type& value) {
+    value_type* block = find_block(row, column, !value_equal(value, value_type(0)));
+    if (block != nullptr) {
+      block[local_index(row, column)] += value;
+    }
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    const each_block_row_& br = container_.at(block_index(row));
+    auto it = std::lower_bound(br.columns_.begin(), br.columns_.end(), block_index(column));
+    if (it == br.columns_.end() || *it != block_index(column)) {
+      return value_type(0);
+    }
+    size_type k = it - br.columns_.begin();
+    return br.values_[k * block_elements + local_index(row, column)];
+  }
+
+  inline size_type get_row() const {
+    return my_row_;
+  }
+
+  inline size_type get_column() const {
+    return my_column_;
+  }
+
+  inline size_type get_block_row() const {
+    return (my_row_ + BlockSize - 1) / BlockSize;
+  }
+
+  inline size_type get_block_column() const {
+    return (my_column_ + BlockSize - 1) / BlockSize;
+  }
+
+  size_type get_nth_row_size(size_type row) const {
+    const each_block_row_& br = container_.at(block_index(row));
+    size_type size = br.columns_.size() * BlockSize;
+    if (!br.columns_.empty() && br.columns_.back() == get_block_column()) {
+      size -= get_block_column() * BlockSize - my_column_;
+    }
+    return size;
+  }
+
+  // stored scalars, including the explicit zeros inside stored blocks.
+  size_type get_element_count() const {
+    return block_count_ * block_elements;
+  }
+
+  size_type get_block_count() const {
+    return block_count_;
+  }
+
+  size_type get_nth_block_row_size(size_type block_row) const {
+    return container_.at(block_row).columns_.size();
+  }
+
+  // block column index (start by 1) of the k-th (start by 0) block in block_row.
+  size_type get_block_column_index(size_type block_row, size_type k) const {
+    return container_.at(block_row).columns_[k];
+  }
+
+  const value_type* get_block(size_type block_row, size_type k) const {
+    return container_.at(block_row).values_.data() + k * block_elements;
+  }
+
+  value_type* get_block(size_type block_row, size_type k) {
+    return container_.at(block_row).values_.data() + k * block_elements;
+  }
+
+  // returns the position of block (block_row, block_column) inside block_row, or -1.
+  size_type find_block_position(size_type block_row, size_type block_column) const {
+    const each_block_row_& br = container_.at(block_row);
+    auto it = std::lower_bound(br.columns_.begin(), br.columns_.end(), block_column);
+    if (it == br.columns_.end() || *it != block_column) {
+      return -1;
+    }
+    return it - br.columns_.begin();
+  }
+
+  // y = A * x, x has get_column() values and y has get_row() values.
+  void multiply(const value_type* x, value_type* y) const {
+    const size_type block_columns = get_block_column();
+    for (size_type bi = 1; bi <= get_block_row(); ++bi) {
+      const each_block_row_& br = container_[bi];
+      std::array<value_type, BlockSize> yb;
+      yb.fill(value_type(0));
+      for (size_type k = 0; k < (size_type)br.columns_.size(); ++k) {
+        size_type bj = br.columns_[k];
+        const value_type* xb = x + (bj - 1) * BlockSize;
+        if (bj == block_columns && my_column_ % BlockSize != 0) {
+          std::array<value_type, BlockSize> xpad;
+          xpad.fill(value_type(0));
+          std::copy(xb, x + my_column_, xpad.begin());
+          detail::block_multiply_add<value_type, BlockSize>(&br.values_[k * block_elements], xpad.data(), yb.data());
+        }
+        else {
+          detail::block_multiply_add<value_type, BlockSize>(&br.values_[k * block_elements], xb, yb.data());
+        }
+      }
+      size_type first = (bi - 1) * BlockSize;
+      size_type count = std::min(BlockSize, my_row_ - first);
+      std::copy(yb.begin(), yb.begin() + count, y + first);
+    }
+  }
+
+  void delete_row(size_type row) {
+    rebuild(my_row_ - 1, my_column_, [row](size_type& r, size_type&) {
+      if (r == row) {
+        return false;
+      }
+      if (r > row) {
+        --r;
+      }
+      return true;
+    });
+  }
+
+  void delete_column(size_type column) {
+    rebuild(my_row_, my_column_ - 1, [column](size_type&, size_type& c) {
+      if (c == column) {
+        return false;
+      }
+      if (c > column) {
+        --c;
+      }
+      return true;
+    });
+  }
+
+  void resize(size_type new_row, size_type new_column) {
+    assert(new_row > 0 && new_column > 0);
+    rebuild(new_row, new_column, [new_row, new_column](size_type& r, size_type& c) {
+      return r <= new_row && c <= new_column;
+    });
+  }
+
+  void element_row_transform_swap(size_type row_i, size_type row_j) {
+    if (row_i == row_j) {
+      return;
+    }
+    std::vector<std::pair<size_type, value_type>> ri = take_row(row_i);
+    std::vector<std::pair<size_type, value_type>> rj = take_row(row_j);
+    for (auto& each : ri) {
+      set_value(row_j, each.first, each.second);
+    }
+    for (auto& each : rj) {
+      set_value(row_i, each.first, each.second);
+    }
+  }
+
+  void element_row_transform_multi(size_type row, value_type k) {
+    each_block_row_& br = container_.at(block_index(row));
+    size_type lr = (row - 1) % BlockSize;
+    for (size_type b = 0; b < (size_type)br.columns_.size(); ++b) {
+      for (size_type j = 0; j < BlockSize; ++j) {
+        br.values_[b * block_elements + lr * BlockSize + j] *= k;
+      }
+    }
+  }
+
+  void element_row_transform_plus(size_type row_i, size_type row_j, value_type k) {
+    std::vector<std::pair<size_type, value_type>> rj;
+    for_each_in_row(row_j, [&rj](size_type column, const value_type& v) {
+      rj.push_back({column, v});
+    });
+    for (auto& each : rj) {
+      add_value(row_i, each.first, each.second * k);
+    }
+  }
+
+  class row_iterator {
+  private:
+    matrix_storage_bsr* handle_;
+    size_type row_index_;
+
+  public:
+    row_iterator(matrix_storage_bsr* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    row_iterator operator++(int) {
+      row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const row_iterator& other) const {
+      return handle_ == other.handle_ && row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const row_iterator& other) const {
+      return handle_ != other.handle_ || row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class column_iterator {
+    private:
+      each_block_row_* block_row_;
+      size_type block_;
+      size_type offset_;
+      size_type row_;
+      size_type column_limit_;
+
+    public:
+      column_iterator(each_block_row_* br, size_type block, size_type row, size_type column_limit):
+        block_row_(br), block_(block), offset_(0), row_(row), column_limit_(column_limit) {
+        skip_padding();
+      }
+
+      column_iterator& operator++() {
+        if (++offset_ == BlockSize) {
+          offset_ = 0;
+          ++block_;
+        }
+        skip_padding();
+        return *this;
+      }
+
+      column_iterator operator++(int) {
+        column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const column_iterator& other) const {
+        return block_row_ == other.block_row_ && block_ == other.block_ && offset_ == other.offset_;
+      }
+
+      bool operator!=(const column_iterator& other) const {
+        return !(*this == other);
+      }
+
+      value_type& operator*() {
+        return block_row_->values_[block_ * block_elements + ((row_ - 1) % BlockSize) * BlockSize + offset_];
+      }
+
+      value_type* operator->() {
+        return &(operator*());
+      }
+
+      size_type column_index() const {
+        return (block_row_->columns_[block_] - 1) * BlockSize + offset_ + 1;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+
+    private:
+      // the padded columns can only be at the tail of the last block.
+      void skip_padding() {
+        if (block_ < (size_type)block_row_->columns_.size() && column_index() > column_limit_) {
+          block_ = block_row_->columns_.size();
+          offset_ = 0;
+        }
+      }
+    };
+
+    column_iterator begin() {
+      return column_iterator(&handle_->container_.at(block_index(row_index_)), 0, row_index_, handle_->my_column_);
+    }
+
+    column_iterator end() {
+      each_block_row_* br = &handle_->container_.at(block_index(row_index_));
+      return column_iterator(br, br->columns_.size(), row_index_, handle_->my_column_);
+    }
+  };
+
+  class const_row_iterator {
+  private:
+    const matrix_storage_bsr* handle_;
+    size_type row_index_;
+
+  public:
+    const_row_iterator(const matrix_storage_bsr* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    const_row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    const_row_iterator operator++(int) {
+      const_row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const const_row_iterator& other) const {
+      return handle_ == other.handle_ && row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const const_row_iterator& other) const {
+      return handle_ != other.handle_ || row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class const_column_iterator {
+    private:
+      const each_block_row_* block_row_;
+      size_type block_;
+      size_type offset_;
+      size_type row_;
+      size_type column_limit_;
+
+    public:
+      const_column_iterator(const each_block_row_* br, size_type block, size_type row, size_type column_limit):
+        block_row_(br), block_(block), offset_(0), row_(row), column_limit_(column_limit) {
+        skip_padding();
+      }
+
+      const_column_iterator& operator++() {
+        if (++offset_ == BlockSize) {
+          offset_ = 0;
+          ++block_;
+        }
+        skip_padding();
+        return *this;
+      }
+
+      const_column_iterator operator++(int) {
+        const_column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const const_column_iterator& other) const {
+        return block_row_ == other.block_row_ && block_ == other.block_ && offset_ == other.offset_;
+      }
+
+      bool operator!=(const const_column_iterator& other) const {
+        return !(*this == other);
+      }
+
+      const value_type& operator*() {
+        return block_row_->values_[block_ * block_elements + ((row_ - 1) % BlockSize) * BlockSize + offset_];
+      }
+
+      const value_type* operator->() {
+        return &(operator*());
+      }
+
+      size_type column_index() const {
+        return (block_row_->columns_[block_] - 1) * BlockSize + offset_ + 1;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+
+    private:
+      void skip_padding() {
+        if (block_ < (size_type)block_row_->columns_.size() && column_index() > column_limit_) {
+          block_ = block_row_->columns_.size();
+          offset_ = 0;
+        }
+      }
+    };
+
+    const_column_iterator begin() const {
+      return const_column_iterator(&handle_->container_.at(block_index(row_index_)), 0, row_index_, handle_->my_column_);
+    }
+
+    const_column_iterator end() const {
+      const each_block_row_* br = &handle_->container_.at(block_index(row_index_));
+      return const_column_iterator(br, br->columns_.size(), row_index_, handle_->my_column_);
+    }
+  };
+
+  row_iterator begin() {
+    return row_iterator(this, 1);
+  }
+
+  row_iterator end() {
+    return row_iterator(this, my_row_ + 1);
+  }
+
+  const_row_iterator begin() const {
+    return const_row_iterator(this, 1);
+  }
+
+  const_row_iterator end() const {
+    return const_row_iterator(this, my_row_ + 1);
+  }
+
+private:
+  size_type my_row_;
+  size_type my_column_;
+  size_type block_count_;
+  std::vector<each_block_row_, tracked_allocator<each_block_row_>> container_;
+
+  static inline size_type block_index(size_type index) {
+    return (index - 1) / BlockSize + 1;
+  }
+
+  static inline size_type local_index(size_type row, size_type column) {
+    return ((row - 1) % BlockSize) * BlockSize + (column - 1) % BlockSize;
+  }
+
+  // returns the block holding (row, column), a zero block is inserted when create is true.
+  value_type* find_block(size_type row, size_type column, bool create) {
+    each_block_row_& br = container_.at(block_index(row));
+    size_type bc = block_index(column);
+    auto it = std::lower_bound(br.columns_.begin(), br.columns_.end(), bc);
+    size_type k = it - br.columns_.begin();
+    if (it == br.columns_.end() || *it != bc) {
+      if (create == false) {
+        return nullptr;
+      }
+      br.columns_.insert(it, bc);
+      br.values_.insert(br.values_.begin() + k * block_elements, block_elements, value_type(0));
+      ++block_count_;
+    }
+    return &br.values_[k * block_elements];
+  }
+
+  template <typename F>
+  void for_each_in_row(size_type row, F f) const {
+    const each_block_row_& br = container_.at(block_index(row));
+    size_type lr = (row - 1) % BlockSize;
+    for (size_type b = 0; b < (size_type)br.columns_.size(); ++b) {
+      for (size_type j = 0; j < BlockSize; ++j) {
+        size_type column = (br.columns_[b] - 1) * BlockSize + j + 1;
+        if (column > my_column_) {
+          break;
+        }
+        f(column, br.values_[b * block_elements + lr * BlockSize + j]);
+      }
+    }
+  }
+
+  // removes the nonzeros of row and returns them.
+  std::vector<std::pair<size_type, value_type>> take_row(size_type row) {
+    std::vector<std::pair<size_type, value_type>> result;
+    each_block_row_& br = container_.at(block_index(row));
+    size_type lr = (row - 1) % BlockSize;
+    for (size_type b = 0; b < (size_type)br.columns_.size(); ++b) {
+      for (size_type j = 0; j < BlockSize; ++j) {
+        value_type& v = br.values_[b * block_elements + lr * BlockSize + j];
+        if (value_equal(v, value_type(0)) == false) {
+          result.push_back({(br.columns_[b] - 1) * BlockSize + j + 1, v});
+        }
+        v = value_type(0);
+      }
+    }
+    return result;
+  }
+
+  // rebuilds the storage with new dimensions, keep(row, column) may remap an entry or drop it.
+  template <typename F>
+  void rebuild(size_type new_row, size_type new_column, F keep) {
+    assert(new_row > 0 && new_column > 0);
+    std::vector<std::tuple<size_type, size_type, value_type>> entries;
+    for (size_type r = 1; r <= my_row_; ++r) {
+      for_each_in_row(r, [&](size_type c, const value_type& v) {
+        size_type nr = r;
+        size_type nc = c;
+        if (value_equal(v, value_type(0)) == false && keep(nr, nc)) {
+          entries.emplace_back(nr, nc, v);
+        }
+      });
+    }
+    *this = self(new_row, new_column);
+    for (auto& each : entries) {
+      set_value(std::get<0>(each), std::get<1>(each), std::get<2>(each));
+    }
+  }
+};
+
+template <typename ValueType, size_type BlockSize>
+using bsr_matrix = matrix<matrix_storage_bsr<ValueType, BlockSize>>;
+
+// block spmv : reads one column index per block instead of one per scalar.
+template <typename ValueType, size_type BlockSize, typename Container2>
+auto operator*(const bsr_matrix<ValueType, BlockSize>& m1, const matrix<Container2>& m2)->matrix<Container2> {
+  assert(m1.get_column() == m2.get_row());
+  static_assert (std::is_same<ValueType, typename Container2::value_type>::value, "error.");
+  matrix<Container2> result(m1.get_row(), m2.get_column());
+  std::vector<ValueType> x(m2.get_row());
+  std::vector<ValueType> y(m1.get_row());
+  for (size_type c = 1; c <= m2.get_column(); ++c) {
+    for (size_type r = 1; r <= m2.get_row(); ++r) {
+      x[r - 1] = m2.get_value(r, c);
+    }
+    m1.get_container().multiply(x.data(), y.data());
+    for (size_type r = 1; r <= m1.get_row(); ++r) {
+      result.set_value(r, c, y[r - 1]);
+    }
+  }
+  return result;
+}
+
+// block jacobi preconditioner : z = D^-1 * r, D is the block diagonal of A.
+// a singular diagonal block is replaced by the identity, check get_singular_block_row after construction.
+template <typename ValueType, size_type BlockSize>
+class bsr_block_jacobi {
+public:
+  using value_type = ValueType;
+  static constexpr size_type block_elements = BlockSize * BlockSize;
+
+  explicit bsr_block_jacobi(const bsr_matrix<ValueType, BlockSize>& A):row_(A.get_row()), singular_block_row_(-1) {
+    assert(A.get_row() == A.get_column());
+    const auto& storage = A.get_container();
+    size_type block_rows = storage.get_block_row();
+    inverse_.resize(block_rows * block_elements);
+    for (size_type bi = 1; bi <= block_rows; ++bi) {
+      std::array<value_type, block_elements> diag;
+      diag.fill(value_type(0));
+      size_type k = storage.find_block_position(bi, bi);
+      if (k >= 0) {
+        const value_type* block = storage.get_block(bi, k);
+        std::copy(block, block + block_elements, diag.begin());
+      }
+      // the padded rows of the last block get a unit diagonal.
+      for (size_type i = 0; i < BlockSize; ++i) {
+        if ((bi - 1) * BlockSize + i >= row_) {
+          diag[i * BlockSize + i] = value_type(1);
+        }
+      }
+      if (detail::block_inverse<value_type, BlockSize>(diag.data(), &inverse_[(bi - 1) * block_elements]) == false) {
+        detail::block_identity<value_type, BlockSize>(&inverse_[(bi - 1) * block_elements]);
+        singular_block_row_ = singular_block_row_ < 0 ? bi : singular_block_row_;
+      }
+    }
+  }
+
+  // the first block row (start by 1) whose diagonal block is singular, or -1.
+  size_type get_singular_block_row() const {
+    return singular_block_row_;
+  }
+
+  void apply(const value_type* r, value_type* z) const {
+    size_type block_rows = inverse_.size() / block_elements;
+    for (size_type bi = 0; bi < block_rows; ++bi) {
+      std::array<value_type, BlockSize> rb;
+      std::array<value_type, BlockSize> zb;
+      rb.fill(value_type(0));
+      zb.fill(value_type(0));
+      size_type count = std::min(BlockSize, row_ - bi * BlockSize);
+      std::copy(r + bi * BlockSize, r + bi * BlockSize + count, rb.begin());
+      detail::block_multiply_add<value_type, BlockSize>(&inverse_[bi * block_elements], rb.data(), zb.data());
+      std::copy(zb.begin(), zb.begin() + count, z + bi * BlockSize);
+    }
+  }
+
+private:
+  size_type row_;
+  size_type singular_block_row_;
+  std::vector<value_type> inverse_;
+};
+
+// block ilu(0) preconditioner : L * U keeps the block sparsity pattern of A, z = U^-1 * L^-1 * r.
+// a singular or missing pivot block is replaced by the identity, check get_singular_block_row after
+// construction. apply works in a buffer of the preconditioner, one object serves one solve at a time.
+template <typename ValueType, size_type BlockSize>
+class bsr_block_ilu0 {
+public:
+  using value_type = ValueType;
+  static constexpr size_type block_elements = BlockSize * BlockSize;
+
+  explicit bsr_block_ilu0(const bsr_matrix<ValueType, BlockSize>& A):lu_(A.get_container()), singular_block_row_(-1) {
+    assert(A.get_row() == A.get_column());
+    size_type block_rows = lu_.get_block_row();
+    y_.resize(block_rows * BlockSize);
+    lower_end_.resize(block_rows + 1);
+    upper_begin_.resize(block_rows + 1);
+    diag_inverse_.resize((block_rows + 1) * block_elements);
+    for (size_type bi = 1; bi <= block_rows; ++bi) {
+      size_type row_size = lu_.get_nth_block_row_size(bi);
+      size_type lower_end = row_size;
+      for (size_type k = 0; k < row_size; ++k) {
+        size_type bk = lu_.get_block_column_index(bi, k);
+        if (bk >= bi) {
+          lower_end = k;
+          break;
+        }
+        // L_ik = A_ik * U_kk^-1
+        value_type* aik = lu_.get_block(bi, k);
+        std::array<value_type, block_elements> lik;
+        lik.fill(value_type(0));
+        for (size_type i = 0; i < BlockSize; ++i) {
+          for (size_type j = 0; j < BlockSize; ++j) {
+            for (size_type t = 0; t < BlockSize; ++t) {
+              lik[i * BlockSize + j] += aik[i * BlockSize + t] * diag_inverse_[bk * block_elements + t * BlockSize + j];
+            }
+          }
+        }
+        std::copy(lik.begin(), lik.end(), aik);
+        // A_ij -= L_ik * U_kj for every j > k in the pattern of both rows.
+        for (size_type jj = k + 1; jj < row_size; ++jj) {
+          size_type bj = lu_.get_block_column_index(bi, jj);
+          size_type pos = lu_.find_block_position(bk, bj);
+          if (pos >= 0) {
+            detail::block_multiply_sub<value_type, BlockSize>(aik, lu_.get_block(bk, pos), lu_.get_block(bi, jj));
+          }
+        }
+      }
+      // a diagonal block outside the pattern is a zero pivot.
+      bool has_diag = lower_end < row_size && lu_.get_block_column_index(bi, lower_end) == bi;
+      lower_end_[bi] = lower_end;
+      upper_begin_[bi] = has_diag == true ? lower_end + 1 : lower_end;
+      std::array<value_type, block_elements> diag;
+      diag.fill(value_type(0));
+      if (has_diag == true) {
+        const value_type* block = lu_.get_block(bi, lower_end);
+        std::copy(block, block + block_elements, diag.begin());
+      }
+      for (size_type i = 0; i < BlockSize; ++i) {
+        if ((bi - 1) * BlockSize + i >= lu_.get_row()) {
+          diag[i * BlockSize + i] = value_type(1);
+        }
+      }
+      if (detail::block_inverse<value_type, BlockSize>(diag.data(), &diag_inverse_[bi * block_elements]) == false) {
+        detail::block_identity<value_type, BlockSize>(&diag_inverse_[bi * block_elements]);
+        singular_block_row_ = singular_block_row_ < 0 ? bi : singular_block_row_;
+      }
+    }
+  }
+
+  // the first block row (start by 1) whose pivot block is singular, or -1.
+  size_type get_singular_block_row() const {
+    return singular_block_row_;
+  }
+
+  void apply(const value_type* r, value_type* z) const {
+    size_type n = lu_.get_row();
+    size_type block_rows = lu_.get_block_row();
+    std::vector<value_type>& y = y_;
+    std::copy(r, r + n, y.begin());
+    std::fill(y.begin() + n, y.end(), value_type(0));
+    for (size_type bi = 1; bi <= block_rows; ++bi) {
+      value_type* yi = &y[(bi - 1) * BlockSize];
+      for (size_type k = 0; k < lower_end_[bi]; ++k) {
+        size_type bk = lu_.get_block_column_index(bi, k);
+        std::array<value_type, BlockSize> t;
+        t.fill(value_type(0));
+        detail::block_multiply_add<value_type, BlockSize>(lu_.get_block(bi, k), &y[(bk - 1) * BlockSize], t.data());
+        for (size_type i = 0; i < BlockSize; ++i) {
+          yi[i] -= t[i];
+        }
+      }
+    }
+    for (size_type bi = block_rows; bi >= 1; --bi) {
+      value_type* yi = &y[(bi - 1) * BlockSize];
+      size_type row_size = lu_.get_nth_block_row_size(bi);
+      for (size_type k = upper_begin_[bi]; k < row_size; ++k) {
+        size_type bk = lu_.get_block_column_index(bi, k);
+        std::array<value_type, BlockSize> t;
+        t.fill(value_type(0));
+        detail::block_multiply_add<value_type, BlockSize>(lu_.get_block(bi, k), &y[(bk - 1) * BlockSize], t.data());
+        for (size_type i = 0; i < BlockSize; ++i) {
+          yi[i] -= t[i];
+        }
+      }
+      std::array<value_type, BlockSize> zi;
+      zi.fill(value_type(0));
+      detail::block_multiply_add<value_type, BlockSize>(&diag_inverse_[bi * block_elements], yi, zi.data());
+      std::copy(zi.begin(), zi.end(), yi);
+    }
+    std::copy(y.begin(), y.begin() + n, z);
+  }
+
+private:
+  matrix_storage_bsr<ValueType, BlockSize> lu_;
+  size_type singular_block_row_;
+  // row bi keeps L in [0, lower_end_[bi]) and U in [upper_begin_[bi], row size) of its blocks.
+  std::vector<size_type> lower_end_;
+  std::vector<size_type> upper_begin_;
+  std::vector<value_type> diag_inverse_;
+  mutable std::vector<value_type> y_;
+};
+}
@@ -3,6 +3,8 @@
 #include "value_compare.h"
 #include "matrix_type_traits.h"
 #include "matrix_storage_cep_config.h"
+#include "instrument.h"
+#include "allocator.h"
 #include <vector>
 #include <cassert>
 #include <algorithm>
@@ -22,10 +24,14 @@ private:
     node_(size_type c, value_type v) :column_(c), value_(v) {}
   };
 
+  using row_type_ = std::vector<node_, tracked_allocator<node_>>;
+
   struct each_row_container_ {
-      std::vector<node_> this_row_;
+      row_type_ this_row_;
   };
 
+  using rows_type_ = std::vector<each_row_container_, tracked_allocator<each_row_container_>>;
+
 public:
   matrix_storage_cep(size_type row, size_type column):
                       my_row_(row),
@@ -66,7 +72,7 @@ public:
 
 #ifdef DELETE_ZERO
   void set_value(size_type row, size_type column, const value_type& value) {
-    std::vector<node_>& row_root = get_nth_row(row);
+    row_type_& row_root = get_nth_row(row);
     bool iszero = value_equal(value, value_type(0));
     bool insert = false;
     bool update = false;
@@ -75,9 +81,13 @@ public:
         it->value_ = value;
         update = true;
         if (iszero) {
+          PNMATRIX_COUNT("cep.set_value.erase_zero");
           row_root.erase(it);
           --element_count_;
         }
+        else {
+          PNMATRIX_COUNT("cep.set_value.update");
+        }
         break;
       }
       else if (it->column_ > column) {
@@ -89,11 +99,13 @@ public:
       return;
     }
     else if (update == false && insert == false) {
+      PNMATRIX_COUNT("cep.set_value.append");
       row_root.push_back(node_(column, value));
       ++element_count_;
       return;
     }
     else {
+      PNMATRIX_COUNT("cep.set_value.sort");
       row_root.push_back(node_(column, value));
       //排序
       std::sort(row_root.begin(), row_root.end(),
@@ -106,11 +118,12 @@ public:
   }
 #else
   void set_value(size_type row, size_type column, const value_type& value) {
-    std::vector<node_>& row_root = get_nth_row(row);
+    row_type_& row_root = get_nth_row(row);
     auto it = std::find_if(row_root.begin(), row_root.end(), [column](const node_& node)->bool {
       return node.column_ == column;
     });
     if (it == row_root.end()) {
+      PNMATRIX_COUNT("cep.set_value.sort");
       row_root.push_back(node_(column, value));
       std::sort(row_root.begin(),row_root.end(),[](const node_& n1, const node_& n2)->bool {
         return n1.column_ < n2.column_;
@@ -118,6 +131,7 @@ public:
       ++element_count_;
     }
     else {
+      PNMATRIX_COUNT("cep.set_value.update");
       it->value_ = value;
     }
   }
@@ -128,7 +142,7 @@ public:
     bool iszero = value_equal(value, value_type(0));
     if (iszero == true)
       return;
-    std::vector<node_>& row_root = get_nth_row(row);
+    row_type_& row_root = get_nth_row(row);
     bool insert = false;
     bool update = false;
     for (auto it = row_root.begin(); it != row_root.end(); ++it) {
@@ -136,9 +150,13 @@ public:
         it->value_ += value;
         update = true;
         if (value_equal(it->value_,value_type(0))) {
+          PNMATRIX_COUNT("cep.add_value.erase_zero");
           row_root.erase(it);
           --element_count_;
         }
+        else {
+          PNMATRIX_COUNT("cep.add_value.update");
+        }
         break;
       }
       else if (it->column_ > column) {
@@ -150,11 +168,13 @@ public:
       return;
     }
     else if (update == false && insert == false) {
+      PNMATRIX_COUNT("cep.add_value.append");
       row_root.push_back(node_(column, value));
       ++element_count_;
       return;
     }
     else {
+      PNMATRIX_COUNT("cep.add_value.sort");
       row_root.push_back(node_(column, value));
       //排序
       std::sort(row_root.begin(), row_root.end(),
@@ -167,11 +187,12 @@ public:
   }
 #else
   void add_value(size_type row, size_type column, const value_type& value) {
-    std::vector<node_>& row_root = get_nth_row(row);
+    row_type_& row_root = get_nth_row(row);
     auto it = std::find_if(row_root.begin(), row_root.end(), [column](const node_& node)->bool {
       return node.column_ == column;
     });
     if (it == row_root.end()) {
+     PNMATRIX_COUNT("cep.add_value.sort");
      row_root.push_back(node_(column, value));
      std::sort(row_root.begin(),row_root.end(),[](const node_& n1, const node_& n2)->bool {
        return n1.column_ < n2.column_;
@@ -179,16 +200,22 @@ public:
      ++element_count_;
     }
     else {
+      PNMATRIX_COUNT("cep.add_value.update");
       it->value_ += value;
     }
   }
 #endif
 
   value_type get_value(size_type row, size_type column) const  {
-    for (auto it = get_nth_row(row).begin(); it != get_nth_row(row).end(); ++it) {
-      if (it->column_ == column)
+    const row_type_& row_root = get_nth_row(row);
+    PNMATRIX_COUNT("cep.get_value");
+    for (auto it = row_root.begin(); it != row_root.end(); ++it) {
+      if (it->column_ == column) {
+        PNMATRIX_COUNT_N("cep.get_value.scanned", it - row_root.begin() + 1);
         return it->value_;
+      }
     }
+    PNMATRIX_COUNT_N("cep.get_value.scanned", row_root.size());
     return value_type(0);
   }
 
@@ -263,14 +290,14 @@ public:
   }
 
   void element_row_transform_multi(size_type row, value_type k) {
-    std::vector<node_>& this_row = get_nth_row(row);
+    row_type_& this_row = get_nth_row(row);
     for (auto colu_iter = this_row.begin(); colu_iter != this_row.end(); ++colu_iter) {
       colu_iter->value_ = colu_iter->value_ * k;
     }
   }
 
   void element_row_transform_plus(size_type row_i, size_type row_j, value_type k) {
-    std::vector<node_>& this_row = get_nth_row(row_j);
+    row_type_& this_row = get_nth_row(row_j);
     for (auto colu_iter = this_row.begin(); colu_iter != this_row.end(); ++colu_iter) {
       size_type column = colu_iter->column_;
       add_value(row_i, column, colu_iter->value_ * k);
@@ -281,14 +308,52 @@ public:
     return element_count_;
   }
 
+  // calls f(column, value) for every stored element of row, in column order.
+  template <typename F>
+  void for_each_in_row(size_type row, F f) const {
+    const row_type_& this_row = get_nth_row(row);
+    for (auto it = this_row.begin(); it != this_row.end(); ++it) {
+      f(it->column_, it->value_);
+    }
+  }
+
+  void reserve_row(size_type row, size_type n) {
+    get_nth_row(row).reserve(n);
+  }
+
+  // appends an element behind the last one of row without searching or sorting,
+  // column must be greater than every column already stored in row.
+  void push_back_in_row(size_type row, size_type column, const value_type& value) {
+    row_type_& this_row = get_nth_row(row);
+    assert(this_row.empty() || this_row.back().column_ < column);
+    this_row.push_back(node_(column, value));
+    ++element_count_;
+  }
+
+  // copies the rectangular region with a binary search per row, O(r * log(row size) + copied elements).
+  self get_sub_storage(size_type row_begin, size_type r, size_type col_begin, size_type c) const {
+    self result(r, c);
+    size_type col_end = col_begin + c - 1;
+    for (size_type i = 0; i < r; ++i) {
+      const row_type_& this_row = get_nth_row(row_begin + i);
+      auto it = std::lower_bound(this_row.begin(), this_row.end(), col_begin, [](const node_& n, size_type column)->bool {
+        return n.column_ < column;
+      });
+      for (; it != this_row.end() && it->column_ <= col_end; ++it) {
+        result.push_back_in_row(i + 1, it->column_ - col_begin + 1, it->value_);
+      }
+    }
+    return result;
+  }
+
   class row_iterator {
   private:
     matrix_storage_cep<value_type>* handle_;
-    typename std::vector<each_row_container_>::iterator proxy_;
+    typename rows_type_::iterator proxy_;
     size_type row_index_;
 
   public:
-    row_iterator(matrix_storage_cep<ValueType>* h, typename std::vector<each_row_container_>::iterator it, size_type r):
+    row_iterator(matrix_storage_cep<ValueType>* h, typename rows_type_::iterator it, size_type r):
         handle_(h),
         proxy_(it),
         row_index_(r)  {
@@ -321,11 +386,11 @@ public:
 
     class column_iterator {
     private:
-      typename std::vector<node_>::iterator proxy_;
+      typename row_type_::iterator proxy_;
       size_type row_;
 
     public:
-      column_iterator(typename std::vector<node_>::iterator it, size_type r):proxy_(it),row_(r) {
+      column_iterator(typename row_type_::iterator it, size_type r):proxy_(it),row_(r) {
 
       }
 
@@ -377,11 +442,11 @@ public:
   class const_row_iterator {
   private:
     const matrix_storage_cep<ValueType>* const handle_;
-    typename std::vector<each_row_container_>::const_iterator proxy_;
+    typename rows_type_::const_iterator proxy_;
     size_type row_index_;
 
   public:
-    const_row_iterator(const matrix_storage_cep<ValueType>*const h, typename std::vector<each_row_container_>::const_iterator it, size_type r):
+    const_row_iterator(const matrix_storage_cep<ValueType>*const h, typename rows_type_::const_iterator it, size_type r):
         handle_(h),
         proxy_(it),
         row_index_(r)  {
@@ -414,11 +479,11 @@ public:
 
     class const_column_iterator {
     private:
-      typename std::vector<node_>::const_iterator proxy_;
+      typename row_type_::const_iterator proxy_;
       size_type row_;
 
     public:
-      const_column_iterator(typename std::vector<node_>::const_iterator it, size_type r):proxy_(it),row_(r) {
+      const_column_iterator(typename row_type_::const_iterator it, size_type r):proxy_(it),row_(r) {
 
       }
 
@@ -487,13 +552,13 @@ private:
   size_type my_row_;
   size_type my_column_;
   size_type element_count_;
-  std::vector<each_row_container_> container_;
+  rows_type_ container_;
 
-  inline const std::vector<node_>& get_nth_row(size_type row) const {
+  inline const row_type_& get_nth_row(size_type row) const {
     return container_.at(row).this_row_;
   }
 
-  inline std::vector<node_>& get_nth_row(size_type row) {
+  inline row_type_& get_nth_row(size_type row) {
     return container_.at(row).this_row_;
   }
 };
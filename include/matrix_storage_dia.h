@@ -0,0 +1,455 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "matrix_type_traits.h"
+#include "matrix.h"
+#include "allocator.h"
+#include <vector>
+#include <cassert>
+#include <algorithm>
+
+namespace pnmatrix {
+// diagonal storage for matrices whose nonzeros lie on a few diagonals, like the 5 / 7 point stencils.
+// a diagonal is stored as its offset (column - row) and get_row() values indexed by row, the slots
+// whose column falls outside the matrix are padding. there is no column index per value, so the
+// spmv reads the values and x with unit stride.
+// every in-range slot of a stored diagonal counts as stored, zeros included. writing a nonzero
+// value off the stored diagonals inserts a new diagonal.
+template<class ValueType>
+class matrix_storage_dia : public sparse_container {
+public:
+  using value_type = ValueType;
+  // rows per tile of the spmv, y of one tile stays in cache while the diagonals pass over it.
+  static constexpr size_type tile_rows = 2048;
+
+private:
+  using self = matrix_storage_dia;
+
+public:
+  // no stored diagonal.
+  matrix_storage_dia(size_type row, size_type column):my_row_(row), my_column_(column) {
+    assert(row > 0 && column > 0);
+  }
+
+  // zero valued diagonals at the given offsets.
+  matrix_storage_dia(size_type row, size_type column, std::vector<size_type> offsets):matrix_storage_dia(row, column) {
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+    for (size_type k : offsets) {
+      assert(k > - row && k < column);
+      offsets_.push_back(k);
+    }
+    values_.resize(offsets_.size() * row, value_type(0));
+  }
+
+  // the diagonals holding the stored elements of c, with their values.
+  template <typename Container>
+  explicit matrix_storage_dia(const Container& c):matrix_storage_dia(c.get_row(), c.get_column(), get_offsets_of(c)) {
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        size_type d = find_diagonal(col.column_index() - row.row_index());
+        values_[d * my_row_ + row.row_index() - 1] = *col;
+      }
+    }
+  }
+
+  ~matrix_storage_dia() = default;
+  matrix_storage_dia(const self&) = default;
+  matrix_storage_dia(self&&) = default;
+  self& operator=(const self&) = default;
+  self& operator=(self&&) = default;
+
+  bool operator==(const self& other) const {
+    if (get_row() != other.get_row() || get_column() != other.get_column()) {
+      return false;
+    }
+    for (size_type row = 1; row <= get_row(); ++row) {
+      bool same = true;
+      for_each_in_row(row, [&](size_type column, const value_type& v) {
+        same = same && value_equal(v, other.get_value(row, column));
+      });
+      other.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        same = same && value_equal(v, get_value(row, column));
+      });
+      if (same == false) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void set_value(size_type row, size_type column, const value_type& value) {
+    value_type* p = find_value(row, column, value_equal(value, value_type(0)) == false);
+    if (p != nullptr) {
+      *p = value;
+    }
+  }
+
+  void add_value(size_type row, size_type column, const value_type& value) {
+    value_type* p = find_value(row, column, value_equal(value, value_type(0)) == false);
+    if (p != nullptr) {
+      *p += value;
+    }
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    assert(row >= 1 && row <= my_row_ && column >= 1 && column <= my_column_);
+    size_type d = find_diagonal(column - row);
+    return d >= 0 ? values_[d * my_row_ + row - 1] : value_type(0);
+  }
+
+  inline size_type get_row() const {
+    return my_row_;
+  }
+
+  inline size_type get_column() const {
+    return my_column_;
+  }
+
+  size_type get_nth_row_size(size_type row) const {
+    return get_last_diagonal(row) - get_first_diagonal(row);
+  }
+
+  size_type get_element_count() const {
+    size_type count = 0;
+    for (size_type k : offsets_) {
+      count += std::min(my_row_, my_column_ - k) - std::max<size_type>(1, 1 - k) + 1;
+    }
+    return count;
+  }
+
+  size_type get_diagonal_count() const {
+    return offsets_.size();
+  }
+
+  // offset (column - row) of the d-th stored diagonal, d starts by 0, the offsets ascend.
+  size_type get_offset(size_type d) const {
+    return offsets_[d];
+  }
+
+  // the get_row() values of the d-th stored diagonal, row r (start by 1) at index r - 1.
+  value_type* get_diagonal(size_type d) {
+    return &values_[d * my_row_];
+  }
+
+  const value_type* get_diagonal(size_type d) const {
+    return &values_[d * my_row_];
+  }
+
+  // calls f(column, value) for every stored element of row, in column order.
+  template <typename F>
+  void for_each_in_row(size_type row, F f) const {
+    for (size_type d = get_first_diagonal(row); d < get_last_diagonal(row); ++d) {
+      f(row + offsets_[d], values_[d * my_row_ + row - 1]);
+    }
+  }
+
+  // y = A * x, x has get_column() values and y has get_row() values.
+  void multiply(const value_type* x, value_type* y) const {
+    multiply(x, y, 1, my_row_ + 1);
+  }
+
+  // rows [first, last) of y = A * x, rows start by 1. every diagonal is one unit stride pass
+  // y[i] += a[i] * x[i + k] over the rows of a tile.
+  void multiply(const value_type* x, value_type* y, size_type first, size_type last) const {
+    for (size_type tile = first - 1; tile < last - 1; tile += tile_rows) {
+      size_type tile_end = std::min(tile + tile_rows, last - 1);
+      std::fill(y + tile, y + tile_end, value_type(0));
+      for (size_type d = 0; d < (size_type)offsets_.size(); ++d) {
+        size_type k = offsets_[d];
+        size_type lo = std::max(tile, - k);
+        size_type hi = std::min(tile_end, my_column_ - k);
+        const value_type* a = &values_[d * my_row_];
+        for (size_type i = lo; i < hi; ++i) {
+          y[i] += a[i] * x[i + k];
+        }
+      }
+    }
+  }
+
+  class row_iterator {
+  private:
+    matrix_storage_dia<value_type>* handle_;
+    size_type row_index_;
+
+  public:
+    row_iterator(matrix_storage_dia<value_type>* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    row_iterator operator++(int) {
+      row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class column_iterator {
+    private:
+      matrix_storage_dia<value_type>* handle_;
+      size_type diagonal_;
+      size_type row_;
+
+    public:
+      column_iterator(matrix_storage_dia<value_type>* h, size_type d, size_type r):handle_(h), diagonal_(d), row_(r) {
+
+      }
+
+      column_iterator& operator++() {
+        ++diagonal_;
+        return *this;
+      }
+
+      column_iterator operator++(int) {
+        column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const column_iterator& other) const {
+        return diagonal_ == other.diagonal_;
+      }
+
+      bool operator!=(const column_iterator& other) const {
+        return diagonal_ != other.diagonal_;
+      }
+
+      value_type& operator*() {
+        return handle_->values_[diagonal_ * handle_->my_row_ + row_ - 1];
+      }
+
+      value_type* operator->() {
+        return &handle_->values_[diagonal_ * handle_->my_row_ + row_ - 1];
+      }
+
+      size_type column_index() const {
+        return row_ + handle_->offsets_[diagonal_];
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    column_iterator begin() {
+      return column_iterator(handle_, handle_->get_first_diagonal(row_index_), row_index_);
+    }
+
+    column_iterator end() {
+      return column_iterator(handle_, handle_->get_last_diagonal(row_index_), row_index_);
+    }
+  };
+
+  class const_row_iterator {
+  private:
+    const matrix_storage_dia<value_type>* handle_;
+    size_type row_index_;
+
+  public:
+    const_row_iterator(const matrix_storage_dia<value_type>* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    const_row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    const_row_iterator operator++(int) {
+      const_row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const const_row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const const_row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class const_column_iterator {
+    private:
+      const matrix_storage_dia<value_type>* handle_;
+      size_type diagonal_;
+      size_type row_;
+
+    public:
+      const_column_iterator(const matrix_storage_dia<value_type>* h, size_type d, size_type r):handle_(h), diagonal_(d), row_(r) {
+
+      }
+
+      const_column_iterator& operator++() {
+        ++diagonal_;
+        return *this;
+      }
+
+      const_column_iterator operator++(int) {
+        const_column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const const_column_iterator& other) const {
+        return diagonal_ == other.diagonal_;
+      }
+
+      bool operator!=(const const_column_iterator& other) const {
+        return diagonal_ != other.diagonal_;
+      }
+
+      const value_type& operator*() {
+        return handle_->values_[diagonal_ * handle_->my_row_ + row_ - 1];
+      }
+
+      const value_type* operator->() {
+        return &handle_->values_[diagonal_ * handle_->my_row_ + row_ - 1];
+      }
+
+      size_type column_index() const {
+        return row_ + handle_->offsets_[diagonal_];
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    const_column_iterator begin() const {
+      return const_column_iterator(handle_, handle_->get_first_diagonal(row_index_), row_index_);
+    }
+
+    const_column_iterator end() const {
+      return const_column_iterator(handle_, handle_->get_last_diagonal(row_index_), row_index_);
+    }
+  };
+
+  row_iterator begin() {
+    return row_iterator(this, 1);
+  }
+
+  row_iterator end() {
+    return row_iterator(this, get_row() + 1);
+  }
+
+  const_row_iterator begin() const {
+    return const_row_iterator(this, 1);
+  }
+
+  const_row_iterator end() const {
+    return const_row_iterator(this, get_row() + 1);
+  }
+
+private:
+  size_type my_row_;
+  size_type my_column_;
+  // ascending.
+  std::vector<size_type, tracked_allocator<size_type>> offsets_;
+  // get_row() values per diagonal, diagonal d starts at d * get_row().
+  std::vector<value_type, tracked_allocator<value_type>> values_;
+
+  template <typename Container>
+  static std::vector<size_type> get_offsets_of(const Container& c) {
+    std::vector<bool> used(c.get_row() + c.get_column(), false);
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        used[col.column_index() - row.row_index() + c.get_row()] = true;
+      }
+    }
+    std::vector<size_type> result;
+    for (size_type i = 0; i < (size_type)used.size(); ++i) {
+      if (used[i] == true) {
+        result.push_back(i - c.get_row());
+      }
+    }
+    return result;
+  }
+
+  // index of the diagonal with offset k, or -1.
+  size_type find_diagonal(size_type k) const {
+    auto it = std::lower_bound(offsets_.begin(), offsets_.end(), k);
+    if (it == offsets_.end() || *it != k) {
+      return -1;
+    }
+    return it - offsets_.begin();
+  }
+
+  // the stored diagonals crossing row are [get_first_diagonal(row), get_last_diagonal(row)),
+  // the ones whose column 1 <= row + k <= get_column().
+  size_type get_first_diagonal(size_type row) const {
+    return std::lower_bound(offsets_.begin(), offsets_.end(), 1 - row) - offsets_.begin();
+  }
+
+  size_type get_last_diagonal(size_type row) const {
+    return std::upper_bound(offsets_.begin(), offsets_.end(), my_column_ - row) - offsets_.begin();
+  }
+
+  // returns the slot of (row, column), a zero diagonal is inserted when create is true.
+  value_type* find_value(size_type row, size_type column, bool create) {
+    assert(row >= 1 && row <= my_row_ && column >= 1 && column <= my_column_);
+    size_type k = column - row;
+    auto it = std::lower_bound(offsets_.begin(), offsets_.end(), k);
+    size_type d = it - offsets_.begin();
+    if (it == offsets_.end() || *it != k) {
+      if (create == false) {
+        return nullptr;
+      }
+      offsets_.insert(it, k);
+      values_.insert(values_.begin() + d * my_row_, my_row_, value_type(0));
+    }
+    return &values_[d * my_row_ + row - 1];
+  }
+};
+
+template <typename ValueType>
+using dia_matrix = matrix<matrix_storage_dia<ValueType>>;
+
+// the diagonals of m, with its values.
+template <typename MatrixType>
+dia_matrix<typename MatrixType::value_type> to_dia_matrix(const MatrixType& m) {
+  dia_matrix<typename MatrixType::value_type> result(m.get_row(), m.get_column());
+  result.get_container() = matrix_storage_dia<typename MatrixType::value_type>(m.get_container());
+  return result;
+}
+
+// diagonal spmv : one unit stride pass per diagonal, no column index is read.
+template <typename ValueType, typename Container2>
+auto operator*(const dia_matrix<ValueType>& m1, const matrix<Container2>& m2)->matrix<Container2> {
+  assert(m1.get_column() == m2.get_row());
+  static_assert (std::is_same<ValueType, typename Container2::value_type>::value, "error.");
+  matrix<Container2> result(m1.get_row(), m2.get_column());
+  std::vector<ValueType> x(m2.get_row());
+  std::vector<ValueType> y(m1.get_row());
+  for (size_type c = 1; c <= m2.get_column(); ++c) {
+    for (size_type r = 1; r <= m2.get_row(); ++r) {
+      x[r - 1] = m2.get_value(r, c);
+    }
+    m1.get_container().multiply(x.data(), y.data());
+    for (size_type r = 1; r <= m1.get_row(); ++r) {
+      result.set_value(r, c, y[r - 1]);
+    }
+  }
+  return result;
+}
+}
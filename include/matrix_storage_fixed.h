@@ -0,0 +1,520 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "matrix_type_traits.h"
+#include "matrix.h"
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+namespace pnmatrix {
+namespace detail {
+template <typename F, size_type... I>
+inline void unroll_impl(F&& f, std::integer_sequence<size_type, I...>) {
+  (f(std::integral_constant<size_type, I>{}), ...);
+}
+
+// calls f(integral_constant<0>) ... f(integral_constant<N - 1>), expanded at compile time.
+template <size_type N, typename F>
+inline void unroll(F&& f) {
+  unroll_impl(f, std::make_integer_sequence<size_type, N>{});
+}
+}
+
+template <typename ValueType, size_type Row, size_type Column>
+class matrix_storage_fixed : public dense_container {
+  static_assert(Row > 0 && Column > 0, "matrix_storage_fixed needs positive dimensions.");
+
+public:
+  using value_type = ValueType;
+  static constexpr size_type row_count = Row;
+  static constexpr size_type column_count = Column;
+
+  matrix_storage_fixed() {
+    block_.fill(value_type(0));
+  }
+
+  matrix_storage_fixed([[maybe_unused]] size_type row, [[maybe_unused]] size_type column) {
+    assert(row == Row && column == Column);
+    block_.fill(value_type(0));
+  }
+
+  matrix_storage_fixed(const matrix_storage_fixed&) = default;
+  matrix_storage_fixed(matrix_storage_fixed&&) = default;
+  matrix_storage_fixed& operator=(const matrix_storage_fixed&) = default;
+  matrix_storage_fixed& operator=(matrix_storage_fixed&&) = default;
+
+  bool operator==(const matrix_storage_fixed& other) const {
+    for (size_type i = 0; i < Row * Column; ++i) {
+      if (value_equal(block_[i], other.block_[i]) == false) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool operator!=(const matrix_storage_fixed& other) const {
+    return !(*this == other);
+  }
+
+  void set_value(size_type row, size_type column, const value_type& v) {
+    block_[get_index(row, column)] = v;
+  }
+
+  void add_value(size_type row, size_type column, const value_type& v) {
+    block_[get_index(row, column)] += v;
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    return block_[get_index(row, column)];
+  }
+
+  constexpr size_type get_row() const {
+    return Row;
+  }
+
+  constexpr size_type get_column() const {
+    return Column;
+  }
+
+  constexpr size_type get_nth_row_size(size_type row) const {
+    return Column;
+  }
+
+  size_type get_element_count() const {
+    return Row * Column;
+  }
+
+  // the dimensions are part of the type, so resize only accepts the current shape.
+  void resize(size_type new_row, size_type new_column) {
+    assert(new_row == Row && new_column == Column);
+  }
+
+  value_type* data() {
+    return block_.data();
+  }
+
+  const value_type* data() const {
+    return block_.data();
+  }
+
+  size_type get_row_stride() const {
+    return Column;
+  }
+
+  size_type get_column_stride() const {
+    return 1;
+  }
+
+  class row_iterator {
+  private:
+    matrix_storage_fixed* handle_;
+    size_type row_index_;
+
+  public:
+    row_iterator(matrix_storage_fixed* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    row_iterator operator++(int) {
+      row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const row_iterator& other) const {
+      return handle_ == other.handle_ && row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const row_iterator& other) const {
+      return handle_ != other.handle_ || row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class column_iterator {
+    private:
+      matrix_storage_fixed* handle_;
+      size_type row_;
+      size_type column_;
+
+    public:
+      column_iterator(matrix_storage_fixed* h, size_type r, size_type c):handle_(h), row_(r), column_(c) {
+
+      }
+
+      column_iterator& operator++() {
+        ++column_;
+        return *this;
+      }
+
+      column_iterator operator++(int) {
+        column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const column_iterator& other) const {
+        return handle_ == other.handle_ && row_ == other.row_ && column_ == other.column_;
+      }
+
+      bool operator!=(const column_iterator& other) const {
+        return handle_ != other.handle_ || row_ != other.row_ || column_ != other.column_;
+      }
+
+      value_type& operator*() {
+        return handle_->block_[get_index(row_, column_)];
+      }
+
+      value_type* operator->() {
+        return &(operator*());
+      }
+
+      size_type column_index() const {
+        return column_;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    column_iterator begin() {
+      return column_iterator(handle_, row_index_, 1);
+    }
+
+    column_iterator end() {
+      return column_iterator(handle_, row_index_, Column + 1);
+    }
+  };
+
+  class const_row_iterator {
+  private:
+    const matrix_storage_fixed* handle_;
+    size_type row_index_;
+
+  public:
+    const_row_iterator(const matrix_storage_fixed* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    const_row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    const_row_iterator operator++(int) {
+      const_row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const const_row_iterator& other) const {
+      return handle_ == other.handle_ && row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const const_row_iterator& other) const {
+      return handle_ != other.handle_ || row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class const_column_iterator {
+    private:
+      const matrix_storage_fixed* handle_;
+      size_type row_;
+      size_type column_;
+
+    public:
+      const_column_iterator(const matrix_storage_fixed* h, size_type r, size_type c):handle_(h), row_(r), column_(c) {
+
+      }
+
+      const_column_iterator& operator++() {
+        ++column_;
+        return *this;
+      }
+
+      const_column_iterator operator++(int) {
+        const_column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const const_column_iterator& other) const {
+        return handle_ == other.handle_ && row_ == other.row_ && column_ == other.column_;
+      }
+
+      bool operator!=(const const_column_iterator& other) const {
+        return handle_ != other.handle_ || row_ != other.row_ || column_ != other.column_;
+      }
+
+      const value_type& operator*() {
+        return handle_->block_[get_index(row_, column_)];
+      }
+
+      const value_type* operator->() {
+        return &(operator*());
+      }
+
+      size_type column_index() const {
+        return column_;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    const_column_iterator begin() const {
+      return const_column_iterator(handle_, row_index_, 1);
+    }
+
+    const_column_iterator end() const {
+      return const_column_iterator(handle_, row_index_, Column + 1);
+    }
+  };
+
+  row_iterator begin() {
+    return row_iterator(this, 1);
+  }
+
+  row_iterator end() {
+    return row_iterator(this, Row + 1);
+  }
+
+  const_row_iterator begin() const {
+    return const_row_iterator(this, 1);
+  }
+
+  const_row_iterator end() const {
+    return const_row_iterator(this, Row + 1);
+  }
+
+  void element_row_transform_swap(size_type row_i, size_type row_j) {
+    detail::unroll<Column>([&](auto j) {
+      std::swap(block_[get_index(row_i, j + 1)], block_[get_index(row_j, j + 1)]);
+    });
+  }
+
+  void element_row_transform_multi(size_type row, value_type k) {
+    detail::unroll<Column>([&](auto j) {
+      block_[get_index(row, j + 1)] *= k;
+    });
+  }
+
+  void element_row_transform_plus(size_type row_i, size_type row_j, value_type k) {
+    detail::unroll<Column>([&](auto j) {
+      block_[get_index(row_i, j + 1)] += block_[get_index(row_j, j + 1)] * k;
+    });
+  }
+
+private:
+  std::array<ValueType, Row * Column> block_;
+
+  static constexpr size_type get_index(size_type row, size_type column) {
+    return (row - 1) * Column + column - 1;
+  }
+};
+
+template <typename T>
+struct is_fixed_matrix : std::false_type {};
+
+template <typename ValueType, size_type Row, size_type Column>
+struct is_fixed_matrix<matrix<matrix_storage_fixed<ValueType, Row, Column>>> : std::true_type {};
+
+template <typename ValueType, size_type Row, size_type Column>
+using fixed_matrix = matrix<matrix_storage_fixed<ValueType, Row, Column>>;
+
+template <typename ValueType, size_type R1, size_type C1, size_type R2, size_type C2>
+fixed_matrix<ValueType, R1, C2> operator*(const fixed_matrix<ValueType, R1, C1>& m1, const fixed_matrix<ValueType, R2, C2>& m2) {
+  static_assert(C1 == R2, "fixed matrix multiply: column count of the left side must equal row count of the right side.");
+  fixed_matrix<ValueType, R1, C2> result;
+  detail::unroll<R1>([&](auto i) {
+    detail::unroll<C2>([&](auto j) {
+      ValueType sum = ValueType(0);
+      detail::unroll<C1>([&](auto k) {
+        sum += m1.get_value(i + 1, k + 1) * m2.get_value(k + 1, j + 1);
+      });
+      result.set_value(i + 1, j + 1, sum);
+    });
+  });
+  return result;
+}
+
+template <typename ValueType, size_type R1, size_type C1, size_type R2, size_type C2>
+fixed_matrix<ValueType, R1, C1> operator+(const fixed_matrix<ValueType, R1, C1>& m1, const fixed_matrix<ValueType, R2, C2>& m2) {
+  static_assert(R1 == R2 && C1 == C2, "fixed matrix add: dimensions must be equal.");
+  fixed_matrix<ValueType, R1, C1> result;
+  detail::unroll<R1>([&](auto i) {
+    detail::unroll<C1>([&](auto j) {
+      result.set_value(i + 1, j + 1, m1.get_value(i + 1, j + 1) + m2.get_value(i + 1, j + 1));
+    });
+  });
+  return result;
+}
+
+template <typename ValueType, size_type R1, size_type C1, size_type R2, size_type C2>
+fixed_matrix<ValueType, R1, C1> operator-(const fixed_matrix<ValueType, R1, C1>& m1, const fixed_matrix<ValueType, R2, C2>& m2) {
+  static_assert(R1 == R2 && C1 == C2, "fixed matrix sub: dimensions must be equal.");
+  fixed_matrix<ValueType, R1, C1> result;
+  detail::unroll<R1>([&](auto i) {
+    detail::unroll<C1>([&](auto j) {
+      result.set_value(i + 1, j + 1, m1.get_value(i + 1, j + 1) - m2.get_value(i + 1, j + 1));
+    });
+  });
+  return result;
+}
+
+template <typename ValueType, size_type Row, size_type Column>
+fixed_matrix<ValueType, Column, Row> tr(const fixed_matrix<ValueType, Row, Column>& m) {
+  fixed_matrix<ValueType, Column, Row> result;
+  detail::unroll<Row>([&](auto i) {
+    detail::unroll<Column>([&](auto j) {
+      result.set_value(j + 1, i + 1, m.get_value(i + 1, j + 1));
+    });
+  });
+  return result;
+}
+
+// LU decomposition with partial pivoting, P * m = L * U.
+// L (unit diagonal, not stored) and U are packed into lu, pivot[i - 1] is the original row placed at row i.
+template <typename ValueType, size_type N>
+bool lu_decompose(const fixed_matrix<ValueType, N, N>& m, fixed_matrix<ValueType, N, N>& lu, std::array<size_type, std::size_t(N)>& pivot) {
+  lu = m;
+  bool ok = true;
+  detail::unroll<N>([&](auto i) {
+    pivot[i] = i + 1;
+  });
+  detail::unroll<N>([&](auto k) {
+    size_type p = k + 1;
+    ValueType max_v = std::abs(lu.get_value(k + 1, k + 1));
+    detail::unroll<N>([&](auto i) {
+      if constexpr (i > k) {
+        ValueType v = std::abs(lu.get_value(i + 1, k + 1));
+        if (v > max_v) {
+          max_v = v;
+          p = i + 1;
+        }
+      }
+    });
+    if (value_equal(max_v, ValueType(0)) == true) {
+      ok = false;
+      return;
+    }
+    if (p != k + 1) {
+      lu.element_row_transform_swap(k + 1, p);
+      std::swap(pivot[k], pivot[p - 1]);
+    }
+    ValueType inv = ValueType(1) / lu.get_value(k + 1, k + 1);
+    detail::unroll<N>([&](auto i) {
+      if constexpr (i > k) {
+        ValueType l = lu.get_value(i + 1, k + 1) * inv;
+        lu.set_value(i + 1, k + 1, l);
+        detail::unroll<N>([&](auto j) {
+          if constexpr (j > k) {
+            lu.add_value(i + 1, j + 1, - l * lu.get_value(k + 1, j + 1));
+          }
+        });
+      }
+    });
+  });
+  return ok;
+}
+
+template <typename ValueType, size_type N, size_type K>
+fixed_matrix<ValueType, N, K> lu_solve(const fixed_matrix<ValueType, N, N>& lu, const std::array<size_type, std::size_t(N)>& pivot,
+                                       const fixed_matrix<ValueType, N, K>& b) {
+  fixed_matrix<ValueType, N, K> x;
+  detail::unroll<K>([&](auto c) {
+    detail::unroll<N>([&](auto i) {
+      ValueType sum = b.get_value(pivot[i], c + 1);
+      detail::unroll<decltype(i)::value>([&](auto j) {
+        sum -= lu.get_value(i + 1, j + 1) * x.get_value(j + 1, c + 1);
+      });
+      x.set_value(i + 1, c + 1, sum);
+    });
+    detail::unroll<N>([&](auto ri) {
+      constexpr size_type i = N - 1 - decltype(ri)::value;
+      ValueType sum = x.get_value(i + 1, c + 1);
+      detail::unroll<N>([&](auto j) {
+        if constexpr (j > i) {
+          sum -= lu.get_value(i + 1, j + 1) * x.get_value(j + 1, c + 1);
+        }
+      });
+      x.set_value(i + 1, c + 1, sum / lu.get_value(i + 1, i + 1));
+    });
+  });
+  return x;
+}
+
+template <typename ValueType, size_type N>
+bool inverse_with_lu(const fixed_matrix<ValueType, N, N>& m, fixed_matrix<ValueType, N, N>& result) {
+  fixed_matrix<ValueType, N, N> lu;
+  std::array<size_type, std::size_t(N)> pivot;
+  if (lu_decompose(m, lu, pivot) == false) {
+    return false;
+  }
+  result = lu_solve(lu, pivot, fixed_matrix<ValueType, N, N>::get_identity_matrix(N));
+  return true;
+}
+
+// householder qr for fixed matrix, same contract as QR() in qr_decomposition.h : returns Q-t and R.
+template <typename ValueType, size_type Row, size_type Column>
+std::pair<fixed_matrix<ValueType, Row, Row>, fixed_matrix<ValueType, Row, Column>> QR(const fixed_matrix<ValueType, Row, Column>& m) {
+  static_assert(Row > Column, "qr decomposition needs matrix(m > n)");
+  fixed_matrix<ValueType, Row, Column> R(m);
+  fixed_matrix<ValueType, Row, Row> Q = fixed_matrix<ValueType, Row, Row>::get_identity_matrix(Row);
+  detail::unroll<Column>([&](auto k) {
+    std::array<ValueType, Row> w;
+    ValueType norm = ValueType(0);
+    detail::unroll<Row>([&](auto i) {
+      w[i] = i >= k ? R.get_value(i + 1, k + 1) : ValueType(0);
+      norm += w[i] * w[i];
+    });
+    norm = std::sqrt(norm);
+    if (value_equal(norm, ValueType(0)) == true) {
+      return;
+    }
+    // reflect x onto -sign(x_k) * |x| * e_k to avoid cancellation.
+    w[k] += w[k] < ValueType(0) ? -norm : norm;
+    ValueType wnorm = ValueType(0);
+    detail::unroll<Row>([&](auto i) {
+      wnorm += w[i] * w[i];
+    });
+    ValueType scale = ValueType(2) / wnorm;
+    detail::unroll<Column>([&](auto j) {
+      ValueType dot = ValueType(0);
+      detail::unroll<Row>([&](auto i) {
+        dot += w[i] * R.get_value(i + 1, j + 1);
+      });
+      dot *= scale;
+      detail::unroll<Row>([&](auto i) {
+        R.add_value(i + 1, j + 1, - dot * w[i]);
+      });
+    });
+    detail::unroll<Row>([&](auto j) {
+      ValueType dot = ValueType(0);
+      detail::unroll<Row>([&](auto i) {
+        dot += w[i] * Q.get_value(i + 1, j + 1);
+      });
+      dot *= scale;
+      detail::unroll<Row>([&](auto i) {
+        Q.add_value(i + 1, j + 1, - dot * w[i]);
+      });
+    });
+  });
+  return { Q, R };
+}
+}
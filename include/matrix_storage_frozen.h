@@ -0,0 +1,546 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "matrix_type_traits.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "allocator.h"
+#include "sparse_lu.h"
+#include <vector>
+#include <memory>
+#include <cassert>
+#include <algorithm>
+
+namespace pnmatrix {
+// row offsets and sorted column indices of a sparse matrix whose nonzero structure does not change any more.
+// positions start by 0 and index the flat value array of every matrix frozen on this pattern.
+class sparsity_pattern {
+public:
+  // no stored element.
+  sparsity_pattern(size_type row, size_type column):row_(row), column_(column), offset_(row + 2, 0), diagonal_(row + 1, -1) {
+    assert(row > 0 && column > 0);
+  }
+
+  // the stored elements of any container, explicit zeros included.
+  template <typename Container>
+  explicit sparsity_pattern(const Container& c):row_(c.get_row()), column_(c.get_column()), offset_(c.get_row() + 2, 0), diagonal_(c.get_row() + 1, -1) {
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      size_type r = row.row_index();
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        columns_.push_back(col.column_index());
+      }
+      offset_[r + 1] = columns_.size();
+    }
+    for (size_type r = 1; r <= row_; ++r) {
+      offset_[r + 1] = std::max(offset_[r + 1], offset_[r]);
+      for (size_type p = offset_[r]; p < offset_[r + 1]; ++p) {
+        assert(p == offset_[r] || columns_[p - 1] < columns_[p]);
+        if (columns_[p] == r) {
+          diagonal_[r] = p;
+        }
+      }
+    }
+  }
+
+  // the elements of p inside rows [row_begin, row_begin + r) and columns [col_begin, col_begin + c),
+  // renumbered to start by 1.
+  sparsity_pattern(const sparsity_pattern& p, size_type row_begin, size_type r, size_type col_begin, size_type c):row_(r), column_(c), offset_(r + 2, 0), diagonal_(r + 1, -1) {
+    assert(r > 0 && c > 0);
+    size_type col_end = col_begin + c - 1;
+    for (size_type i = 1; i <= r; ++i) {
+      for (size_type q = p.sub_row_begin(row_begin + i - 1, col_begin); q < p.row_end(row_begin + i - 1) && p.columns_[q] <= col_end; ++q) {
+        size_type column = p.columns_[q] - col_begin + 1;
+        if (column == i) {
+          diagonal_[i] = columns_.size();
+        }
+        columns_.push_back(column);
+      }
+      offset_[i + 1] = columns_.size();
+    }
+  }
+
+  size_type get_row() const {
+    return row_;
+  }
+
+  size_type get_column() const {
+    return column_;
+  }
+
+  size_type get_element_count() const {
+    return columns_.size();
+  }
+
+  // positions [row_begin(row), row_end(row)) hold row, row starts by 1.
+  size_type row_begin(size_type row) const {
+    return offset_[row];
+  }
+
+  size_type row_end(size_type row) const {
+    return offset_[row + 1];
+  }
+
+  size_type get_column_index(size_type position) const {
+    return columns_[position];
+  }
+
+  // position of (row, column), or -1 if it is not part of the pattern.
+  size_type find(size_type row, size_type column) const {
+    auto first = columns_.begin() + offset_[row];
+    auto last = columns_.begin() + offset_[row + 1];
+    auto it = std::lower_bound(first, last, column);
+    if (it == last || *it != column) {
+      return -1;
+    }
+    return it - columns_.begin();
+  }
+
+  // position of (row, row), or -1. computed once, factorizations use it instead of searching.
+  size_type get_diagonal_position(size_type row) const {
+    return diagonal_[row];
+  }
+
+  // first position of row whose column is >= column.
+  size_type sub_row_begin(size_type row, size_type column) const {
+    auto first = columns_.begin() + offset_[row];
+    auto last = columns_.begin() + offset_[row + 1];
+    return std::lower_bound(first, last, column) - columns_.begin();
+  }
+
+private:
+  size_type row_;
+  size_type column_;
+  std::vector<size_type, tracked_allocator<size_type>> offset_;
+  std::vector<size_type, tracked_allocator<size_type>> columns_;
+  std::vector<size_type, tracked_allocator<size_type>> diagonal_;
+};
+
+// sparse storage with a fixed nonzero pattern and one flat value array aligned with it.
+// set_value / add_value only write positions of the pattern, zeros stay stored, so refilling the
+// values is O(nnz) and keeps the pattern. copies share the pattern, has_same_pattern is O(1) and
+// tells preconditioners and factorizations that their symbolic analysis is still valid, see frozen_lu.
+template<class ValueType>
+class matrix_storage_frozen : public sparse_container {
+public:
+  using value_type = ValueType;
+
+private:
+  using self = matrix_storage_frozen;
+
+public:
+  // an empty pattern could only hold zeros, so the generic matrix operations that start from
+  // matrix(row, column) and write their result, e.g. f + f or tr(f), do not compile. freeze a
+  // pattern with freeze_pattern.
+  matrix_storage_frozen(size_type row, size_type column) = delete;
+
+  explicit matrix_storage_frozen(std::shared_ptr<const sparsity_pattern> pattern):pattern_(std::move(pattern)), values_(pattern_->get_element_count(), value_type(0)) {
+
+  }
+
+  // freezes the stored elements of c, with their values.
+  template <typename Container>
+  explicit matrix_storage_frozen(const Container& c):matrix_storage_frozen(std::make_shared<const sparsity_pattern>(c)) {
+    size_type p = 0;
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        values_[p++] = *col;
+      }
+    }
+  }
+
+  ~matrix_storage_frozen() = default;
+  matrix_storage_frozen(const self&) = default;
+  matrix_storage_frozen(self&&) = default;
+  self& operator=(const self&) = default;
+  self& operator=(self&&) = default;
+
+  bool operator==(const self& other) const {
+    if (get_row() != other.get_row() || get_column() != other.get_column()) {
+      return false;
+    }
+    for (size_type row = 1; row <= get_row(); ++row) {
+      for (size_type p = pattern_->row_begin(row); p < pattern_->row_end(row); ++p) {
+        if (value_equal(values_[p], other.get_value(row, pattern_->get_column_index(p))) == false) {
+          return false;
+        }
+      }
+      for (size_type p = other.pattern_->row_begin(row); p < other.pattern_->row_end(row); ++p) {
+        if (value_equal(other.values_[p], get_value(row, other.pattern_->get_column_index(p))) == false) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void set_value(size_type row, size_type column, const value_type& value) {
+    size_type p = pattern_->find(row, column);
+    assert(p >= 0 || value_equal(value, value_type(0)));
+    if (p >= 0) {
+      values_[p] = value;
+    }
+  }
+
+  void add_value(size_type row, size_type column, const value_type& value) {
+    size_type p = pattern_->find(row, column);
+    assert(p >= 0 || value_equal(value, value_type(0)));
+    if (p >= 0) {
+      values_[p] += value;
+    }
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    size_type p = pattern_->find(row, column);
+    return p >= 0 ? values_[p] : value_type(0);
+  }
+
+  inline size_type get_row() const {
+    return pattern_->get_row();
+  }
+
+  inline size_type get_column() const {
+    return pattern_->get_column();
+  }
+
+  size_type get_nth_row_size(size_type row) const {
+    return pattern_->row_end(row) - pattern_->row_begin(row);
+  }
+
+  size_type get_element_count() const {
+    return values_.size();
+  }
+
+  const sparsity_pattern& get_pattern() const {
+    return *pattern_;
+  }
+
+  std::shared_ptr<const sparsity_pattern> get_shared_pattern() const {
+    return pattern_;
+  }
+
+  bool has_same_pattern(const self& other) const {
+    return pattern_ == other.pattern_;
+  }
+
+  // the window gets its own pattern, it is not shared with this one.
+  self get_sub_storage(size_type row_begin, size_type r, size_type col_begin, size_type c) const {
+    self result(std::make_shared<const sparsity_pattern>(*pattern_, row_begin, r, col_begin, c));
+    size_type p = 0;
+    for (size_type i = 0; i < r; ++i) {
+      size_type row = row_begin + i;
+      for (size_type q = pattern_->sub_row_begin(row, col_begin); q < pattern_->row_end(row) && pattern_->get_column_index(q) < col_begin + c; ++q) {
+        result.values_[p++] = values_[q];
+      }
+    }
+    return result;
+  }
+
+  // the values in pattern order, get_element_count() of them.
+  value_type* get_values() {
+    return values_.data();
+  }
+
+  const value_type* get_values() const {
+    return values_.data();
+  }
+
+  void fill(const value_type& v) {
+    std::fill(values_.begin(), values_.end(), v);
+  }
+
+  // calls f(row, column, value&) for every position of the pattern, the rows are split across thread_count threads.
+  template <typename F>
+  void refill(size_type thread_count, F f) {
+    parallel_for(1, get_row() + 1, thread_count, [&](size_type, size_type first, size_type last) {
+      for (size_type row = first; row < last; ++row) {
+        for (size_type p = pattern_->row_begin(row); p < pattern_->row_end(row); ++p) {
+          f(row, pattern_->get_column_index(p), values_[p]);
+        }
+      }
+    });
+  }
+
+  // calls f(column, value) for every stored element of row, in column order.
+  template <typename F>
+  void for_each_in_row(size_type row, F f) const {
+    for (size_type p = pattern_->row_begin(row); p < pattern_->row_end(row); ++p) {
+      f(pattern_->get_column_index(p), values_[p]);
+    }
+  }
+
+  // y = A * x, x has get_column() values and y has get_row() values.
+  void multiply(const value_type* x, value_type* y) const {
+    for (size_type row = 1; row <= get_row(); ++row) {
+      value_type sum = value_type(0);
+      for (size_type p = pattern_->row_begin(row); p < pattern_->row_end(row); ++p) {
+        sum += values_[p] * x[pattern_->get_column_index(p) - 1];
+      }
+      y[row - 1] = sum;
+    }
+  }
+
+  class row_iterator {
+  private:
+    matrix_storage_frozen<value_type>* handle_;
+    size_type row_index_;
+
+  public:
+    row_iterator(matrix_storage_frozen<value_type>* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    row_iterator operator++(int) {
+      row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class column_iterator {
+    private:
+      matrix_storage_frozen<value_type>* handle_;
+      size_type position_;
+      size_type row_;
+
+    public:
+      column_iterator(matrix_storage_frozen<value_type>* h, size_type p, size_type r):handle_(h), position_(p), row_(r) {
+
+      }
+
+      column_iterator& operator++() {
+        ++position_;
+        return *this;
+      }
+
+      column_iterator operator++(int) {
+        column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const column_iterator& other) const {
+        return position_ == other.position_;
+      }
+
+      bool operator!=(const column_iterator& other) const {
+        return position_ != other.position_;
+      }
+
+      value_type& operator*() {
+        return handle_->values_[position_];
+      }
+
+      value_type* operator->() {
+        return &handle_->values_[position_];
+      }
+
+      size_type column_index() const {
+        return handle_->pattern_->get_column_index(position_);
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    column_iterator begin() {
+      return column_iterator(handle_, handle_->pattern_->row_begin(row_index_), row_index_);
+    }
+
+    column_iterator end() {
+      return column_iterator(handle_, handle_->pattern_->row_end(row_index_), row_index_);
+    }
+  };
+
+  class const_row_iterator {
+  private:
+    const matrix_storage_frozen<value_type>* handle_;
+    size_type row_index_;
+
+  public:
+    const_row_iterator(const matrix_storage_frozen<value_type>* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    const_row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    const_row_iterator operator++(int) {
+      const_row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const const_row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const const_row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class const_column_iterator {
+    private:
+      const matrix_storage_frozen<value_type>* handle_;
+      size_type position_;
+      size_type row_;
+
+    public:
+      const_column_iterator(const matrix_storage_frozen<value_type>* h, size_type p, size_type r):handle_(h), position_(p), row_(r) {
+
+      }
+
+      const_column_iterator& operator++() {
+        ++position_;
+        return *this;
+      }
+
+      const_column_iterator operator++(int) {
+        const_column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const const_column_iterator& other) const {
+        return position_ == other.position_;
+      }
+
+      bool operator!=(const const_column_iterator& other) const {
+        return position_ != other.position_;
+      }
+
+      const value_type& operator*() {
+        return handle_->values_[position_];
+      }
+
+      const value_type* operator->() {
+        return &handle_->values_[position_];
+      }
+
+      size_type column_index() const {
+        return handle_->pattern_->get_column_index(position_);
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    const_column_iterator begin() const {
+      return const_column_iterator(handle_, handle_->pattern_->row_begin(row_index_), row_index_);
+    }
+
+    const_column_iterator end() const {
+      return const_column_iterator(handle_, handle_->pattern_->row_end(row_index_), row_index_);
+    }
+  };
+
+  row_iterator begin() {
+    return row_iterator(this, 1);
+  }
+
+  row_iterator end() {
+    return row_iterator(this, get_row() + 1);
+  }
+
+  const_row_iterator begin() const {
+    return const_row_iterator(this, 1);
+  }
+
+  const_row_iterator end() const {
+    return const_row_iterator(this, get_row() + 1);
+  }
+
+private:
+  std::shared_ptr<const sparsity_pattern> pattern_;
+  std::vector<value_type, tracked_allocator<value_type>> values_;
+};
+
+template <typename ValueType>
+using frozen_matrix = matrix<matrix_storage_frozen<ValueType>>;
+
+// the stored elements of m become the fixed pattern, refill the values through
+// get_container().get_values() or refill() afterwards.
+template <typename MatrixType>
+frozen_matrix<typename MatrixType::value_type> freeze_pattern(const MatrixType& m) {
+  return frozen_matrix<typename MatrixType::value_type>(matrix_storage_frozen<typename MatrixType::value_type>(m.get_container()));
+}
+
+// lu of a square frozen matrix, the complete factorization with fill or ilu(0) without it. the
+// symbolic analysis runs once per pattern, factorize() of a matrix sharing the pattern only
+// recomputes the values. apply() makes it a preconditioner, e.g. ilu(0) for gmres.
+template <typename ValueType>
+class frozen_lu {
+public:
+  using value_type = ValueType;
+
+  explicit frozen_lu(const frozen_matrix<ValueType>& A, bool fill = false):fill_(fill), analysis_count_(0) {
+    factorize(A);
+  }
+
+  void factorize(const frozen_matrix<ValueType>& A) {
+    const auto& c = A.get_container();
+    if (c.get_shared_pattern() == pattern_) {
+      lu_.refactorize(row_begin_, columns_, c.get_values());
+      return;
+    }
+    assert(A.get_row() == A.get_column());
+    pattern_ = c.get_shared_pattern();
+    const sparsity_pattern& p = *pattern_;
+    row_begin_.assign(1, 0);
+    columns_.clear();
+    for (size_type row = 1; row <= p.get_row(); ++row) {
+      assert(p.get_diagonal_position(row) >= 0);
+      for (size_type q = p.row_begin(row); q < p.row_end(row); ++q) {
+        columns_.push_back(p.get_column_index(q) - 1);
+      }
+      row_begin_.push_back(columns_.size());
+    }
+    std::vector<value_type> values(c.get_values(), c.get_values() + c.get_element_count());
+    lu_.factorize(p.get_row(), row_begin_, columns_, values, fill_);
+    ++analysis_count_;
+  }
+
+  // how many patterns were analyzed, the refactorizations on a known pattern do not count.
+  size_type get_analysis_count() const {
+    return analysis_count_;
+  }
+
+  // z = (L * U)^-1 * r
+  void apply(const value_type* r, value_type* z) const {
+    std::copy(r, r + pattern_->get_row(), z);
+    lu_.solve(z);
+  }
+
+private:
+  bool fill_;
+  size_type analysis_count_;
+  std::shared_ptr<const sparsity_pattern> pattern_;
+  // the pattern renumbered from 0 in the layout of detail::local_lu.
+  std::vector<size_type> row_begin_;
+  std::vector<size_type> columns_;
+  detail::local_lu<value_type> lu_;
+};
+}
@@ -0,0 +1,548 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "matrix_type_traits.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "allocator.h"
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace pnmatrix {
+// sliced ellpack (SELL-C-sigma) storage of a sparse matrix with a fixed nonzero pattern.
+// the rows are sorted by length inside windows of sigma rows, the sorted rows are cut into chunks of
+// ChunkSize rows, and a chunk is stored column-major: its k-th elements of the ChunkSize rows are
+// adjacent, padded to the longest row of the chunk. one step of the spmv is then one vector load of
+// values, one gather of x and one fma over ChunkSize rows. with double and ChunkSize == 8 the kernel
+// uses avx-512 or avx2 when the compiler targets them (cmake -DPNMATRIX_NATIVE=ON), otherwise the
+// lane loop is left to the compiler.
+// like matrix_storage_frozen only the stored positions can be written, build one with to_sell_matrix.
+template<class ValueType, size_type ChunkSize = 8>
+class matrix_storage_sell : public sparse_container {
+  static_assert(ChunkSize > 0, "matrix_storage_sell needs a positive chunk size.");
+
+public:
+  using value_type = ValueType;
+  static constexpr size_type chunk_size = ChunkSize;
+
+private:
+  using self = matrix_storage_sell;
+  // column indices are stored in 32 bits, half the index traffic of size_type.
+  using index_type = std::int32_t;
+
+public:
+  // as for matrix_storage_frozen an empty pattern could only hold zeros, so the generic matrix
+  // operations that start from matrix(row, column), e.g. s + s or tr(s), do not compile.
+  matrix_storage_sell(size_type row, size_type column) = delete;
+
+  // the stored elements of c, with their values. the rows are sorted inside windows of sigma rows,
+  // a larger sigma pads less but moves the rows of a chunk further apart in y.
+  template <typename Container>
+  explicit matrix_storage_sell(const Container& c, size_type sigma = 256):matrix_storage_sell(c.get_row(), c.get_column(), sigma, row_lengths(c)) {
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      size_type p = row_base_[row.row_index() - 1];
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        columns_[p] = index_type(col.column_index() - 1);
+        values_[p] = *col;
+        p += ChunkSize;
+      }
+    }
+    pad_rows();
+  }
+
+  ~matrix_storage_sell() = default;
+  matrix_storage_sell(const self&) = default;
+  matrix_storage_sell(self&&) = default;
+  self& operator=(const self&) = default;
+  self& operator=(self&&) = default;
+
+  bool operator==(const self& other) const {
+    if (get_row() != other.get_row() || get_column() != other.get_column()) {
+      return false;
+    }
+    for (size_type row = 1; row <= get_row(); ++row) {
+      bool same = true;
+      for_each_in_row(row, [&](size_type column, const value_type& v) {
+        same = same && value_equal(v, other.get_value(row, column));
+      });
+      other.for_each_in_row(row, [&](size_type column, const value_type& v) {
+        same = same && value_equal(v, get_value(row, column));
+      });
+      if (same == false) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void set_value(size_type row, size_type column, const value_type& value) {
+    size_type p = find(row, column);
+    assert(p >= 0 || value_equal(value, value_type(0)));
+    if (p >= 0) {
+      values_[p] = value;
+    }
+  }
+
+  void add_value(size_type row, size_type column, const value_type& value) {
+    size_type p = find(row, column);
+    assert(p >= 0 || value_equal(value, value_type(0)));
+    if (p >= 0) {
+      values_[p] += value;
+    }
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    size_type p = find(row, column);
+    return p >= 0 ? values_[p] : value_type(0);
+  }
+
+  inline size_type get_row() const {
+    return my_row_;
+  }
+
+  inline size_type get_column() const {
+    return my_column_;
+  }
+
+  size_type get_nth_row_size(size_type row) const {
+    return row_length_[row - 1];
+  }
+
+  size_type get_element_count() const {
+    return element_count_;
+  }
+
+  // stored slots, padding included.
+  size_type get_padded_element_count() const {
+    return values_.size();
+  }
+
+  size_type get_chunk_count() const {
+    return chunk_offset_.size() - 1;
+  }
+
+  size_type get_sigma() const {
+    return sigma_;
+  }
+
+  // the stored elements inside the window, laid out again with the same sigma.
+  self get_sub_storage(size_type row_begin, size_type r, size_type col_begin, size_type c) const {
+    size_type col_end = col_begin + c - 1;
+    std::vector<size_type> length(r, 0);
+    for (size_type i = 0; i < r; ++i) {
+      for_each_in_row(row_begin + i, [&](size_type column, const value_type&) {
+        length[i] += (column >= col_begin && column <= col_end) ? 1 : 0;
+      });
+    }
+    self result(r, c, sigma_, length);
+    for (size_type i = 0; i < r; ++i) {
+      size_type p = result.row_base_[i];
+      for_each_in_row(row_begin + i, [&](size_type column, const value_type& v) {
+        if (column >= col_begin && column <= col_end) {
+          result.columns_[p] = index_type(column - col_begin);
+          result.values_[p] = v;
+          p += ChunkSize;
+        }
+      });
+    }
+    result.pad_rows();
+    return result;
+  }
+
+  // calls f(column, value) for every stored element of row, in column order.
+  template <typename F>
+  void for_each_in_row(size_type row, F f) const {
+    size_type p = row_base_[row - 1];
+    for (size_type j = 0; j < row_length_[row - 1]; ++j, p += ChunkSize) {
+      f(size_type(columns_[p]) + 1, values_[p]);
+    }
+  }
+
+  // y = A * x, x has get_column() values and y has get_row() values.
+  void multiply(const value_type* x, value_type* y) const {
+    multiply_chunks(x, y, 0, get_chunk_count());
+  }
+
+  // the same split by chunks across ex.
+  void multiply(executor& ex, const value_type* x, value_type* y) const {
+    parallel_for(ex, 0, get_chunk_count(), [&](size_type, size_type first, size_type last) {
+      multiply_chunks(x, y, first, last);
+    });
+  }
+
+  class row_iterator {
+  private:
+    matrix_storage_sell* handle_;
+    size_type row_index_;
+
+  public:
+    row_iterator(matrix_storage_sell* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    row_iterator operator++(int) {
+      row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class column_iterator {
+    private:
+      matrix_storage_sell* handle_;
+      size_type position_;
+      size_type row_;
+
+    public:
+      column_iterator(matrix_storage_sell* h, size_type p, size_type r):handle_(h), position_(p), row_(r) {
+
+      }
+
+      column_iterator& operator++() {
+        position_ += ChunkSize;
+        return *this;
+      }
+
+      column_iterator operator++(int) {
+        column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const column_iterator& other) const {
+        return position_ == other.position_;
+      }
+
+      bool operator!=(const column_iterator& other) const {
+        return position_ != other.position_;
+      }
+
+      value_type& operator*() {
+        return handle_->values_[position_];
+      }
+
+      value_type* operator->() {
+        return &handle_->values_[position_];
+      }
+
+      size_type column_index() const {
+        return size_type(handle_->columns_[position_]) + 1;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    column_iterator begin() {
+      return column_iterator(handle_, handle_->row_base_[row_index_ - 1], row_index_);
+    }
+
+    column_iterator end() {
+      return column_iterator(handle_, handle_->row_base_[row_index_ - 1] + handle_->row_length_[row_index_ - 1] * ChunkSize, row_index_);
+    }
+  };
+
+  class const_row_iterator {
+  private:
+    const matrix_storage_sell* handle_;
+    size_type row_index_;
+
+  public:
+    const_row_iterator(const matrix_storage_sell* h, size_type r):handle_(h), row_index_(r) {
+
+    }
+
+    const_row_iterator& operator++() {
+      ++row_index_;
+      return *this;
+    }
+
+    const_row_iterator operator++(int) {
+      const_row_iterator result = *this;
+      ++ *this;
+      return result;
+    }
+
+    bool operator==(const const_row_iterator& other) const {
+      return row_index_ == other.row_index_;
+    }
+
+    bool operator!=(const const_row_iterator& other) const {
+      return row_index_ != other.row_index_;
+    }
+
+    size_type row_index() const {
+      return row_index_;
+    }
+
+    class const_column_iterator {
+    private:
+      const matrix_storage_sell* handle_;
+      size_type position_;
+      size_type row_;
+
+    public:
+      const_column_iterator(const matrix_storage_sell* h, size_type p, size_type r):handle_(h), position_(p), row_(r) {
+
+      }
+
+      const_column_iterator& operator++() {
+        position_ += ChunkSize;
+        return *this;
+      }
+
+      const_column_iterator operator++(int) {
+        const_column_iterator result = *this;
+        ++ *this;
+        return result;
+      }
+
+      bool operator==(const const_column_iterator& other) const {
+        return position_ == other.position_;
+      }
+
+      bool operator!=(const const_column_iterator& other) const {
+        return position_ != other.position_;
+      }
+
+      const value_type& operator*() {
+        return handle_->values_[position_];
+      }
+
+      const value_type* operator->() {
+        return &handle_->values_[position_];
+      }
+
+      size_type column_index() const {
+        return size_type(handle_->columns_[position_]) + 1;
+      }
+
+      size_type row_index() const {
+        return row_;
+      }
+    };
+
+    const_column_iterator begin() const {
+      return const_column_iterator(handle_, handle_->row_base_[row_index_ - 1], row_index_);
+    }
+
+    const_column_iterator end() const {
+      return const_column_iterator(handle_, handle_->row_base_[row_index_ - 1] + handle_->row_length_[row_index_ - 1] * ChunkSize, row_index_);
+    }
+  };
+
+  row_iterator begin() {
+    return row_iterator(this, 1);
+  }
+
+  row_iterator end() {
+    return row_iterator(this, get_row() + 1);
+  }
+
+  const_row_iterator begin() const {
+    return const_row_iterator(this, 1);
+  }
+
+  const_row_iterator end() const {
+    return const_row_iterator(this, get_row() + 1);
+  }
+
+private:
+  size_type my_row_;
+  size_type my_column_;
+  size_type sigma_;
+  size_type element_count_;
+  // chunk c holds the slots [chunk_offset_[c], chunk_offset_[c + 1]), its width times ChunkSize.
+  std::vector<size_type, tracked_allocator<size_type>> chunk_offset_;
+  // row (start by 0) of every sorted row slot, -1 for the padding rows of the last chunk.
+  std::vector<size_type, tracked_allocator<size_type>> slot_row_;
+  // first slot and length of every row (start by 0), the elements of a row are ChunkSize slots apart.
+  std::vector<size_type, tracked_allocator<size_type>> row_base_;
+  std::vector<size_type, tracked_allocator<size_type>> row_length_;
+  // column (start by 0) and value of every slot. a row is padded with its last column and value 0,
+  // so the padding only reads x where the row itself does. the padding rows of the last chunk use
+  // column 0, their sums are dropped.
+  std::vector<index_type, aligned_allocator<index_type>> columns_;
+  std::vector<value_type, aligned_allocator<value_type>> values_;
+
+  // the chunks for rows of the given lengths, every slot column 0 with value 0.
+  matrix_storage_sell(size_type row, size_type column, size_type sigma, const std::vector<size_type>& length):my_row_(row), my_column_(column), sigma_(sigma) {
+    assert(row > 0 && column > 0 && sigma > 0 && column <= size_type(INT32_MAX));
+    build_chunks(length);
+  }
+
+  template <typename Container>
+  static std::vector<size_type> row_lengths(const Container& c) {
+    std::vector<size_type> length(c.get_row(), 0);
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      size_type count = 0;
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        ++count;
+      }
+      length[row.row_index() - 1] = count;
+    }
+    return length;
+  }
+
+  // sorts the rows by length inside the sigma windows and lays out the chunks.
+  void build_chunks(const std::vector<size_type>& length) {
+    size_type chunk_count = (my_row_ + ChunkSize - 1) / ChunkSize;
+    slot_row_.assign(chunk_count * ChunkSize, -1);
+    for (size_type r = 0; r < my_row_; ++r) {
+      slot_row_[r] = r;
+    }
+    for (size_type first = 0; first < my_row_; first += sigma_) {
+      size_type last = std::min(first + sigma_, my_row_);
+      std::stable_sort(slot_row_.begin() + first, slot_row_.begin() + last, [&](size_type a, size_type b) {
+        return length[a] > length[b];
+      });
+    }
+    row_base_.assign(my_row_, 0);
+    row_length_.assign(length.begin(), length.end());
+    chunk_offset_.assign(chunk_count + 1, 0);
+    element_count_ = 0;
+    for (size_type c = 0; c < chunk_count; ++c) {
+      size_type width = 0;
+      for (size_type lane = 0; lane < ChunkSize; ++lane) {
+        size_type r = slot_row_[c * ChunkSize + lane];
+        if (r >= 0) {
+          width = std::max(width, length[r]);
+          row_base_[r] = chunk_offset_[c] + lane;
+          element_count_ += length[r];
+        }
+      }
+      chunk_offset_[c + 1] = chunk_offset_[c] + width * ChunkSize;
+    }
+    columns_.assign(chunk_offset_[chunk_count], index_type(0));
+    values_.assign(chunk_offset_[chunk_count], value_type(0));
+  }
+
+  // repeats the last column of every row over its padding, once the columns are written.
+  void pad_rows() {
+    for (size_type c = 0; c + 1 < size_type(chunk_offset_.size()); ++c) {
+      size_type width = (chunk_offset_[c + 1] - chunk_offset_[c]) / ChunkSize;
+      for (size_type lane = 0; lane < ChunkSize; ++lane) {
+        size_type r = slot_row_[c * ChunkSize + lane];
+        if (r < 0 || row_length_[r] == 0) {
+          continue;
+        }
+        size_type p = row_base_[r] + row_length_[r] * ChunkSize;
+        index_type last = columns_[p - ChunkSize];
+        for (size_type j = row_length_[r]; j < width; ++j, p += ChunkSize) {
+          columns_[p] = last;
+        }
+      }
+    }
+  }
+
+  // slot of (row, column), or -1.
+  size_type find(size_type row, size_type column) const {
+    assert(row >= 1 && row <= my_row_ && column >= 1 && column <= my_column_);
+    index_type target = index_type(column - 1);
+    size_type p = row_base_[row - 1];
+    for (size_type j = 0; j < row_length_[row - 1]; ++j, p += ChunkSize) {
+      if (columns_[p] == target) {
+        return p;
+      }
+    }
+    return -1;
+  }
+
+  void multiply_chunks(const value_type* x, value_type* y, size_type first, size_type last) const {
+    alignas(64) value_type sum[ChunkSize];
+    for (size_type c = first; c < last; ++c) {
+      const index_type* columns = columns_.data() + chunk_offset_[c];
+      const value_type* values = values_.data() + chunk_offset_[c];
+      size_type width = (chunk_offset_[c + 1] - chunk_offset_[c]) / ChunkSize;
+      chunk_kernel(columns, values, width, x, sum);
+      const size_type* rows = &slot_row_[c * ChunkSize];
+      for (size_type lane = 0; lane < ChunkSize; ++lane) {
+        if (rows[lane] >= 0) {
+          // an empty row has nothing of its own to pad with.
+          y[rows[lane]] = row_length_[rows[lane]] > 0 ? sum[lane] : value_type(0);
+        }
+      }
+    }
+  }
+
+  // sum[lane] = sum of values[j * ChunkSize + lane] * x[columns[j * ChunkSize + lane]] over j < width.
+  static void chunk_kernel(const index_type* columns, const value_type* values, size_type width, const value_type* x, value_type* sum) {
+#if defined(__AVX512F__)
+    if constexpr (std::is_same<value_type, double>::value && ChunkSize == 8) {
+      __m512d acc = _mm512_setzero_pd();
+      for (size_type j = 0; j < width; ++j) {
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + j * 8));
+        // the masked gather from zero, the plain one leaves its source undefined and gcc warns.
+        __m512d xv = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, index, x, 8);
+        acc = _mm512_fmadd_pd(_mm512_loadu_pd(values + j * 8), xv, acc);
+      }
+      _mm512_storeu_pd(sum, acc);
+      return;
+    }
+#endif
+#if defined(__AVX2__)
+    if constexpr (std::is_same<value_type, double>::value && ChunkSize == 8) {
+      __m256d acc0 = _mm256_setzero_pd();
+      __m256d acc1 = _mm256_setzero_pd();
+      const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+      for (size_type j = 0; j < width; ++j) {
+        __m128i index0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + j * 8));
+        __m128i index1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + j * 8 + 4));
+        __m256d x0 = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, index0, all, 8);
+        __m256d x1 = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, index1, all, 8);
+#if defined(__FMA__)
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(values + j * 8), x0, acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(values + j * 8 + 4), x1, acc1);
+#else
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(values + j * 8), x0));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(values + j * 8 + 4), x1));
+#endif
+      }
+      _mm256_storeu_pd(sum, acc0);
+      _mm256_storeu_pd(sum + 4, acc1);
+      return;
+    }
+#endif
+    for (size_type lane = 0; lane < ChunkSize; ++lane) {
+      sum[lane] = value_type(0);
+    }
+    for (size_type j = 0; j < width; ++j) {
+      for (size_type lane = 0; lane < ChunkSize; ++lane) {
+        sum[lane] += values[j * ChunkSize + lane] * x[columns[j * ChunkSize + lane]];
+      }
+    }
+  }
+};
+
+template <typename ValueType, size_type ChunkSize = 8>
+using sell_matrix = matrix<matrix_storage_sell<ValueType, ChunkSize>>;
+
+// the stored elements of m in SELL-ChunkSize-sigma form, with their values.
+template <size_type ChunkSize = 8, typename MatrixType>
+sell_matrix<typename MatrixType::value_type, ChunkSize> to_sell_matrix(const MatrixType& m, size_type sigma = 256) {
+  return sell_matrix<typename MatrixType::value_type, ChunkSize>(matrix_storage_sell<typename MatrixType::value_type, ChunkSize>(m.get_container(), sigma));
+}
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include "type.h"
 #include <type_traits>
+#include <utility>
 
 namespace pnmatrix {
 template <bool b1, bool b2>
@@ -33,6 +35,8 @@ struct is_sparse_matrix : std::false_type {};
 template <typename T>
 class matrix;
 
+class executor;
+
 template <typename T>
 struct is_dense_matrix<matrix<T>, std::void_t<typename T::dense_tag>> : public std::true_type {};
 
@@ -44,4 +48,39 @@ struct is_matrix_type : std::false_type {};
 
 template <typename T>
 struct is_matrix_type<matrix<T>> : std::true_type {};
+
+// containers that can copy a rectangular region without scanning the whole storage.
+template <typename T, typename = std::void_t<>>
+struct has_sub_storage : std::false_type {};
+
+template <typename T>
+struct has_sub_storage<T, std::void_t<decltype(std::declval<const T&>().get_sub_storage(size_type(), size_type(), size_type(), size_type()))>> : std::true_type {};
+
+// containers with a raw y = A * x kernel, multiply(const value_type* x, value_type* y).
+template <typename T, typename = std::void_t<>>
+struct has_multiply : std::false_type {};
+
+template <typename T>
+struct has_multiply<T, std::void_t<decltype(std::declval<const T&>().multiply(std::declval<const typename T::value_type*>(), std::declval<typename T::value_type*>()))>> : std::true_type {};
+
+// containers whose kernel can compute the rows [first, last) of y = A * x alone, multiply(x, y, first, last).
+template <typename T, typename = std::void_t<>>
+struct has_range_multiply : std::false_type {};
+
+template <typename T>
+struct has_range_multiply<T, std::void_t<decltype(std::declval<const T&>().multiply(std::declval<const typename T::value_type*>(), std::declval<typename T::value_type*>(), size_type(), size_type()))>> : std::true_type {};
+
+// containers that split their own kernel across an executor, multiply(ex, x, y).
+template <typename T, typename = std::void_t<>>
+struct has_executor_multiply : std::false_type {};
+
+template <typename T>
+struct has_executor_multiply<T, std::void_t<decltype(std::declval<const T&>().multiply(std::declval<executor&>(), std::declval<const typename T::value_type*>(), std::declval<typename T::value_type*>()))>> : std::true_type {};
+
+// containers that can visit one row, for_each_in_row(row, f(column, value)), without walking the rows before it.
+template <typename T, typename = std::void_t<>>
+struct has_row_access : std::false_type {};
+
+template <typename T>
+struct has_row_access<T, std::void_t<decltype(std::declval<const T&>().for_each_in_row(size_type(), std::declval<void(*)(size_type, const typename T::value_type&)>()))>> : std::true_type {};
 }
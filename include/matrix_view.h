@@ -0,0 +1,59 @@
+#pragma once
+#include "type.h"
+#include "operator_proxy.h"
+#include <type_traits>
+#include <cassert>
+
+namespace pnmatrix {
+// non-owning strided window over dense storage, element (row, column) is
+// data[(row - 1) * row_stride + (column - 1) * column_stride].
+// it is an expression template leaf, so it can be used with the operators and to construct dense matrices.
+// the view does not keep the storage alive and is invalidated by resize.
+template <typename ValueType>
+class dense_matrix_view : public op_base {
+public:
+  using value_type = typename std::remove_const<ValueType>::type;
+
+  dense_matrix_view(ValueType* data, size_type row, size_type column, size_type row_stride, size_type column_stride):
+                    op_base(row, column),
+                    data_(data),
+                    row_stride_(row_stride),
+                    column_stride_(column_stride) {
+    assert(row > 0 && column > 0);
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    return data_[get_index(row, column)];
+  }
+
+  void set_value(size_type row, size_type column, const value_type& value) {
+    data_[get_index(row, column)] = value;
+  }
+
+  void add_value(size_type row, size_type column, const value_type& value) {
+    data_[get_index(row, column)] += value;
+  }
+
+  ValueType* data() const {
+    return data_;
+  }
+
+  size_type get_row_stride() const {
+    return row_stride_;
+  }
+
+  size_type get_column_stride() const {
+    return column_stride_;
+  }
+
+private:
+  ValueType* data_;
+  size_type row_stride_;
+  size_type column_stride_;
+
+  inline size_type get_index(size_type row, size_type column) const {
+    assert(row >= 1 && column >= 1 && row <= get_row() && column <= get_column());
+    return (row - 1) * row_stride_ + (column - 1) * column_stride_;
+  }
+};
+}
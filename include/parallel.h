@@ -0,0 +1,45 @@
+#pragma once
+#include "type.h"
+#include "executor.h"
+#include <algorithm>
+
+namespace pnmatrix {
+// splits [first, last) into at most chunk_count contiguous chunks and calls f(chunk_index, chunk_first, chunk_last)
+// for each of them on ex. chunk indices are dense and smaller than chunk_count.
+template <typename F>
+void parallel_for(executor& ex, size_type first, size_type last, size_type chunk_count, F f) {
+  size_type n = last - first;
+  if (n <= 0) {
+    return;
+  }
+  chunk_count = std::max<size_type>(1, std::min(chunk_count, n));
+  if (chunk_count == 1) {
+    f(0, first, last);
+    return;
+  }
+  size_type chunk = (n + chunk_count - 1) / chunk_count;
+  chunk_count = (n + chunk - 1) / chunk;
+  ex.bulk(chunk_count, [&](size_type t) {
+    size_type b = first + t * chunk;
+    f(t, b, std::min(last, b + chunk));
+  });
+}
+
+// one chunk per thread of ex.
+template <typename F>
+void parallel_for(executor& ex, size_type first, size_type last, F f) {
+  parallel_for(ex, first, last, ex.get_thread_count(), f);
+}
+
+// thread_count chunks on the shared default thread pool, thread_count <= 1 runs everything inline.
+template <typename F>
+void parallel_for(size_type first, size_type last, size_type thread_count, F f) {
+  if (thread_count <= 1 || executor::in_parallel_region()) {
+    if (last > first) {
+      f(0, first, last);
+    }
+    return;
+  }
+  parallel_for(get_default_thread_pool(), first, last, thread_count, f);
+}
+}
@@ -1,10 +1,12 @@
 #pragma once
 #include "type.h"
 #include "value_compare.h"
+#include "dense_vector.h"
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <utility>
+#include <cmath>
 
 namespace pnmatrix {
 template<class MatrixType>
@@ -36,23 +38,68 @@ MatrixType get_household_matrix(const MatrixType& vector) {
   return H;
 }
 
+// applies the reflection H = I - 2 * w * w-t to rows [row_begin, row_begin + w.size()) of m,
+// only columns [column_begin, m.get_column()] are touched.
+template<class MatrixType>
+void apply_household_reflection(MatrixType& m, const dense_vector<typename MatrixType::value_type>& w,
+                                size_type row_begin, size_type column_begin) {
+  using value_type = typename MatrixType::value_type;
+  for (size_type j = column_begin; j <= m.get_column(); ++j) {
+    value_type dot = value_type(0);
+    for (size_type k = 0; k < w.size(); ++k) {
+      dot += w[k] * m.get_value(row_begin + k, j);
+    }
+    if (value_equal(dot, value_type(0)) == true) {
+      continue;
+    }
+    for (size_type k = 0; k < w.size(); ++k) {
+      if (value_equal(w[k], value_type(0)) == false) {
+        m.add_value(row_begin + k, j, value_type(-2) * dot * w[k]);
+      }
+    }
+  }
+}
+
 template<class MatrixType>
 std::pair<MatrixType, MatrixType> QR(const MatrixType& matrix) {
   if(matrix.get_row() <= matrix.get_column()) {
       fprintf(stderr,"qr decomposition needs matrix(m > n)");
       std::abort();
   }
+  using value_type = typename MatrixType::value_type;
   MatrixType R(matrix);
   MatrixType Q = MatrixType::get_identity_matrix(matrix.get_row());
+  // the householder vector of step i lives in a dense vector and H is applied in place,
+  // the same reflection get_household_matrix builds, without forming the row x row matrix.
+  dense_vector<value_type> w;
   for (size_type i = 1; i <= matrix.get_column(); ++i) {
-    MatrixType tmp = R.get_sub_matrix(i, matrix.get_row() - i + 1, i, 1);
-    MatrixType H = get_household_matrix(tmp);
-    MatrixType tmp2 = MatrixType::get_identity_matrix(matrix.get_row());
-    tmp2.set_value_from_matrix(i, i, H);
-    Q = tmp2 * Q;
-    MatrixType A_i = R.get_sub_matrix(i, matrix.get_row() - i + 1, i, matrix.get_column() - i + 1);
-    auto hai = H * A_i;
-    R.set_value_from_matrix(i, i, hai);
+    size_type n = matrix.get_row() - i + 1;
+    w.resize(n);
+    value_type norm = value_type(0);
+    bool zero_vec = true;
+    for (size_type k = 0; k < n; ++k) {
+      w[k] = R.get_value(i + k, i);
+      norm += w[k] * w[k];
+      if (!value_equal(w[k], value_type(0))) {
+        zero_vec = false;
+      }
+    }
+    assert(zero_vec == false);
+    norm = std::sqrt(norm);
+    bool already_reduced = value_equal(w[0], norm);
+    for (size_type k = 1; k < n && already_reduced; ++k) {
+      already_reduced = value_equal(w[k], value_type(0));
+    }
+    if (already_reduced == true) {
+      w.fill(value_type(0));
+      w[1] = value_type(1);
+    }
+    else {
+      w[0] -= norm;
+      w.scale(value_type(1) / w.get_second_norm());
+    }
+    apply_household_reflection(R, w, i, i);
+    apply_household_reflection(Q, w, i, 1);
   }
 //actually is Q-t and R.
 return { Q,R };
@@ -0,0 +1,455 @@
+#pragma once
+#include "type.h"
+#include "matrix.h"
+#include "matrix_storage_cep.h"
+#include "dense_vector.h"
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace pnmatrix {
+// symmetric permutation of the rows and columns of a square matrix, indices start by 1.
+// new row i of the permuted matrix is old row get_old(i).
+class permutation {
+public:
+  permutation() = default;
+
+  // the identity of size n.
+  explicit permutation(size_type n):new_to_old_(n + 1), old_to_new_(n + 1) {
+    for (size_type i = 0; i <= n; ++i) {
+      new_to_old_[i] = i;
+      old_to_new_[i] = i;
+    }
+  }
+
+  // new_to_old[i - 1] is the old index of new index i.
+  explicit permutation(const std::vector<size_type>& new_to_old):new_to_old_(new_to_old.size() + 1, 0), old_to_new_(new_to_old.size() + 1, 0) {
+    for (size_type i = 1; i <= size(); ++i) {
+      size_type old = new_to_old[i - 1];
+      assert(old >= 1 && old <= size() && old_to_new_[old] == 0);
+      new_to_old_[i] = old;
+      old_to_new_[old] = i;
+    }
+  }
+
+  size_type size() const {
+    return (size_type)new_to_old_.size() - 1;
+  }
+
+  size_type get_old(size_type new_index) const {
+    return new_to_old_[new_index];
+  }
+
+  size_type get_new(size_type old_index) const {
+    return old_to_new_[old_index];
+  }
+
+  permutation inverse() const {
+    permutation result;
+    result.new_to_old_ = old_to_new_;
+    result.old_to_new_ = new_to_old_;
+    return result;
+  }
+
+private:
+  std::vector<size_type> new_to_old_;
+  std::vector<size_type> old_to_new_;
+};
+
+// max |i - j| over the stored elements.
+template <typename ValueType>
+size_type get_bandwidth(const matrix<matrix_storage_cep<ValueType>>& A) {
+  size_type result = 0;
+  const auto& c = A.get_container();
+  for (size_type row = 1; row <= A.get_row(); ++row) {
+    c.for_each_in_row(row, [&](size_type column, const ValueType&) {
+      result = std::max(result, row > column ? row - column : column - row);
+    });
+  }
+  return result;
+}
+
+// sum over the rows of the distance from the first stored column to the diagonal, the size of the
+// lower envelope that a skyline or banded factorization has to store.
+template <typename ValueType>
+size_type get_profile(const matrix<matrix_storage_cep<ValueType>>& A) {
+  size_type result = 0;
+  const auto& c = A.get_container();
+  for (size_type row = 1; row <= A.get_row(); ++row) {
+    size_type first = row;
+    c.for_each_in_row(row, [&](size_type column, const ValueType&) {
+      first = std::min(first, column);
+    });
+    result += row - first;
+  }
+  return result;
+}
+
+struct ordering_report {
+  size_type bandwidth_before;
+  size_type bandwidth_after;
+  size_type profile_before;
+  size_type profile_after;
+};
+
+namespace detail {
+// adjacency of the symmetrized pattern of A without the diagonal, vertices start by 1.
+class ordering_graph {
+public:
+  template <typename ValueType>
+  explicit ordering_graph(const matrix<matrix_storage_cep<ValueType>>& A):n_(A.get_row()), offset_(A.get_row() + 2, 0) {
+    assert(A.get_row() == A.get_column());
+    const auto& c = A.get_container();
+    std::vector<size_type> degree(n_ + 1, 0);
+    for (size_type row = 1; row <= n_; ++row) {
+      c.for_each_in_row(row, [&](size_type column, const ValueType&) {
+        if (column != row) {
+          ++degree[row];
+          ++degree[column];
+        }
+      });
+    }
+    for (size_type v = 1; v <= n_; ++v) {
+      offset_[v + 1] = offset_[v] + degree[v];
+    }
+    adjacency_.resize(offset_[n_ + 1]);
+    std::vector<size_type> fill(offset_.begin(), offset_.end() - 1);
+    for (size_type row = 1; row <= n_; ++row) {
+      c.for_each_in_row(row, [&](size_type column, const ValueType&) {
+        if (column != row) {
+          adjacency_[fill[row]++] = column;
+          adjacency_[fill[column]++] = row;
+        }
+      });
+    }
+    // a pattern that is already symmetric gives every edge twice.
+    for (size_type v = 1; v <= n_; ++v) {
+      auto first = adjacency_.begin() + offset_[v];
+      auto last = adjacency_.begin() + offset_[v + 1];
+      std::sort(first, last);
+      size_type unique_end = std::unique(first, last) - adjacency_.begin();
+      degree[v] = unique_end - offset_[v];
+    }
+    std::vector<size_type> compact;
+    compact.reserve(adjacency_.size());
+    std::vector<size_type> new_offset(n_ + 2, 0);
+    for (size_type v = 1; v <= n_; ++v) {
+      new_offset[v] = compact.size();
+      compact.insert(compact.end(), adjacency_.begin() + offset_[v], adjacency_.begin() + offset_[v] + degree[v]);
+    }
+    new_offset[n_ + 1] = compact.size();
+    adjacency_.swap(compact);
+    offset_.swap(new_offset);
+  }
+
+  size_type size() const {
+    return n_;
+  }
+
+  size_type degree(size_type v) const {
+    return offset_[v + 1] - offset_[v];
+  }
+
+  const size_type* begin(size_type v) const {
+    return adjacency_.data() + offset_[v];
+  }
+
+  const size_type* end(size_type v) const {
+    return adjacency_.data() + offset_[v + 1];
+  }
+
+  // breadth first levels from root over the vertices with mask[v] == tag. level[v] is set for the reached
+  // vertices, order gets them level by level, returns the number of levels.
+  size_type level_structure(size_type root, const std::vector<size_type>& mask, size_type tag,
+                            std::vector<size_type>& level, std::vector<size_type>& order) const {
+    order.clear();
+    order.push_back(root);
+    level[root] = 0;
+    size_type depth = 0;
+    for (size_type head = 0; head < (size_type)order.size(); ++head) {
+      size_type v = order[head];
+      depth = level[v];
+      for (const size_type* w = begin(v); w != end(v); ++w) {
+        if (mask[*w] == tag && level[*w] < 0) {
+          level[*w] = level[v] + 1;
+          order.push_back(*w);
+        }
+      }
+    }
+    return depth + 1;
+  }
+
+  // george-liu : restarts the search from a vertex of minimum degree in the last level until the
+  // number of levels stops growing. level is -1 on the component on entry and on return.
+  size_type pseudo_peripheral(size_type start, const std::vector<size_type>& mask, size_type tag,
+                              std::vector<size_type>& level, std::vector<size_type>& order) const {
+    size_type root = start;
+    size_type depth = level_structure(root, mask, tag, level, order);
+    while (true) {
+      size_type candidate = -1;
+      for (auto it = order.rbegin(); it != order.rend() && level[*it] == depth - 1; ++it) {
+        if (candidate < 0 || degree(*it) < degree(candidate)) {
+          candidate = *it;
+        }
+      }
+      for (size_type v : order) {
+        level[v] = -1;
+      }
+      size_type candidate_depth = level_structure(candidate, mask, tag, level, order);
+      if (candidate_depth <= depth) {
+        for (size_type v : order) {
+          level[v] = -1;
+        }
+        return root;
+      }
+      root = candidate;
+      depth = candidate_depth;
+    }
+  }
+
+private:
+  size_type n_;
+  std::vector<size_type> offset_;
+  std::vector<size_type> adjacency_;
+};
+}
+
+// reverse cuthill-mckee : breadth first from a pseudo-peripheral vertex of every connected component,
+// neighbours in increasing degree, reversed. keeps the nonzeros close to the diagonal.
+template <typename ValueType>
+permutation reverse_cuthill_mckee(const matrix<matrix_storage_cep<ValueType>>& A) {
+  detail::ordering_graph g(A);
+  size_type n = g.size();
+  std::vector<size_type> mask(n + 1, 0);
+  std::vector<size_type> level(n + 1, -1);
+  std::vector<size_type> order;
+  std::vector<bool> visited(n + 1, false);
+  std::vector<size_type> result;
+  result.reserve(n);
+  std::vector<size_type> neighbours;
+  for (size_type start = 1; start <= n; ++start) {
+    if (visited[start] == true) {
+      continue;
+    }
+    size_type root = g.pseudo_peripheral(start, mask, 0, level, order);
+    size_type head = result.size();
+    result.push_back(root);
+    visited[root] = true;
+    for (; head < (size_type)result.size(); ++head) {
+      size_type v = result[head];
+      neighbours.clear();
+      for (const size_type* w = g.begin(v); w != g.end(v); ++w) {
+        if (visited[*w] == false) {
+          visited[*w] = true;
+          neighbours.push_back(*w);
+        }
+      }
+      std::sort(neighbours.begin(), neighbours.end(), [&g](size_type a, size_type b) {
+        return g.degree(a) < g.degree(b) || (g.degree(a) == g.degree(b) && a < b);
+      });
+      result.insert(result.end(), neighbours.begin(), neighbours.end());
+    }
+  }
+  std::reverse(result.begin(), result.end());
+  return permutation(result);
+}
+
+// nested dissection : splits the graph at the middle level of a level structure rooted at a
+// pseudo-peripheral vertex, orders the two halves recursively and the separator last. parts with
+// at most leaf_size vertices are ordered by reverse cuthill-mckee. reduces the fill of direct factorizations.
+template <typename ValueType>
+permutation nested_dissection(const matrix<matrix_storage_cep<ValueType>>& A, size_type leaf_size = 64) {
+  assert(leaf_size >= 1);
+  detail::ordering_graph g(A);
+  size_type n = g.size();
+  // mask[v] is the part v belongs to, parts are dissected depth first through an explicit stack.
+  std::vector<size_type> mask(n + 1, 0);
+  std::vector<size_type> level(n + 1, -1);
+  std::vector<size_type> order;
+  std::vector<size_type> result(n, 0);
+  size_type next_tag = 1;
+  struct part {
+    std::vector<size_type> vertices;
+    size_type tag;
+    // the positions [first, first + vertices.size()) of result belong to the part.
+    size_type first;
+  };
+  std::vector<part> stack;
+  {
+    part all{std::vector<size_type>(n), 0, 0};
+    for (size_type v = 1; v <= n; ++v) {
+      all.vertices[v - 1] = v;
+    }
+    stack.push_back(std::move(all));
+  }
+  std::vector<size_type> component;
+  while (stack.empty() == false) {
+    part p = std::move(stack.back());
+    stack.pop_back();
+    size_type count = p.vertices.size();
+    if (count == 0) {
+      continue;
+    }
+    size_type root = g.pseudo_peripheral(p.vertices.front(), mask, p.tag, level, order);
+    size_type depth = g.level_structure(root, mask, p.tag, level, order);
+    if ((size_type)order.size() < count) {
+      // more than one component, every component becomes its own part. one breadth first pass over
+      // the part finds them all, so a part with many components costs its size once.
+      for (size_type v : order) {
+        level[v] = -1;
+      }
+      size_type first = p.first;
+      for (size_type start : p.vertices) {
+        if (mask[start] != p.tag) {
+          continue;
+        }
+        size_type tag = next_tag++;
+        component.clear();
+        component.push_back(start);
+        mask[start] = tag;
+        for (size_type head = 0; head < (size_type)component.size(); ++head) {
+          for (const size_type* w = g.begin(component[head]); w != g.end(component[head]); ++w) {
+            if (mask[*w] == p.tag) {
+              mask[*w] = tag;
+              component.push_back(*w);
+            }
+          }
+        }
+        stack.push_back(part{component, tag, first});
+        first += component.size();
+      }
+      continue;
+    }
+    if (count <= leaf_size || depth < 3) {
+      // reverse cuthill-mckee inside the leaf, from the root found above.
+      for (size_type v : order) {
+        level[v] = -1;
+      }
+      std::vector<size_type> rcm;
+      rcm.reserve(count);
+      rcm.push_back(root);
+      mask[root] = -1;
+      std::vector<size_type> neighbours;
+      for (size_type head = 0; head < (size_type)rcm.size(); ++head) {
+        neighbours.clear();
+        for (const size_type* w = g.begin(rcm[head]); w != g.end(rcm[head]); ++w) {
+          if (mask[*w] == p.tag) {
+            mask[*w] = -1;
+            neighbours.push_back(*w);
+          }
+        }
+        std::sort(neighbours.begin(), neighbours.end(), [&g](size_type a, size_type b) {
+          return g.degree(a) < g.degree(b) || (g.degree(a) == g.degree(b) && a < b);
+        });
+        rcm.insert(rcm.end(), neighbours.begin(), neighbours.end());
+      }
+      assert((size_type)rcm.size() == count);
+      for (size_type i = 0; i < count; ++i) {
+        result[p.first + i] = rcm[count - 1 - i];
+      }
+      continue;
+    }
+    // the middle level separates the levels before it from the levels behind it.
+    size_type middle = depth / 2;
+    std::vector<size_type> left;
+    std::vector<size_type> right;
+    std::vector<size_type> separator;
+    for (size_type v : order) {
+      if (level[v] < middle) {
+        left.push_back(v);
+      }
+      else if (level[v] > middle) {
+        right.push_back(v);
+      }
+      else {
+        separator.push_back(v);
+      }
+    }
+    for (size_type v : order) {
+      level[v] = -1;
+    }
+    size_type left_tag = next_tag++;
+    size_type right_tag = next_tag++;
+    for (size_type v : left) {
+      mask[v] = left_tag;
+    }
+    for (size_type v : right) {
+      mask[v] = right_tag;
+    }
+    for (size_type v : separator) {
+      mask[v] = -1;
+    }
+    size_type separator_first = p.first + left.size() + right.size();
+    for (size_type i = 0; i < (size_type)separator.size(); ++i) {
+      result[separator_first + i] = separator[i];
+    }
+    size_type right_first = p.first + left.size();
+    stack.push_back(part{std::move(right), right_tag, right_first});
+    stack.push_back(part{std::move(left), left_tag, p.first});
+  }
+  return permutation(result);
+}
+
+// P * A * P^T : B(i, j) = A(p.get_old(i), p.get_old(j)), O(nnz * log(row size)).
+template <typename ValueType>
+matrix<matrix_storage_cep<ValueType>> permute(const matrix<matrix_storage_cep<ValueType>>& A, const permutation& p) {
+  assert(A.get_row() == p.size() && A.get_column() == p.size());
+  matrix<matrix_storage_cep<ValueType>> result(A.get_row(), A.get_column());
+  auto& c = result.get_container();
+  const auto& a = A.get_container();
+  std::vector<std::pair<size_type, ValueType>> row_elements;
+  for (size_type row = 1; row <= A.get_row(); ++row) {
+    size_type old = p.get_old(row);
+    row_elements.clear();
+    a.for_each_in_row(old, [&](size_type column, const ValueType& v) {
+      row_elements.emplace_back(p.get_new(column), v);
+    });
+    std::sort(row_elements.begin(), row_elements.end(), [](const std::pair<size_type, ValueType>& x, const std::pair<size_type, ValueType>& y) {
+      return x.first < y.first;
+    });
+    c.reserve_row(row, row_elements.size());
+    for (const auto& each : row_elements) {
+      c.push_back_in_row(row, each.first, each.second);
+    }
+  }
+  return result;
+}
+
+// y[i] = x[p.get_old(i)], moves a right hand side into the permuted numbering.
+template <typename ValueType>
+dense_vector<ValueType> permute_vector(const dense_vector<ValueType>& x, const permutation& p) {
+  assert(x.size() == p.size());
+  dense_vector<ValueType> result(x.size());
+  for (size_type i = 1; i <= p.size(); ++i) {
+    result[i - 1] = x[p.get_old(i) - 1];
+  }
+  return result;
+}
+
+// the inverse of permute_vector, moves a solution back into the original numbering.
+template <typename ValueType>
+dense_vector<ValueType> unpermute_vector(const dense_vector<ValueType>& y, const permutation& p) {
+  assert(y.size() == p.size());
+  dense_vector<ValueType> result(y.size());
+  for (size_type i = 1; i <= p.size(); ++i) {
+    result[p.get_old(i) - 1] = y[i - 1];
+  }
+  return result;
+}
+
+// n x 1 matrices, e.g. the b and x of the solvers.
+template <typename Container>
+matrix<Container> permute_vector(const matrix<Container>& x, const permutation& p) {
+  return to_matrix<matrix<Container>>(permute_vector(to_dense_vector(x), p));
+}
+
+template <typename Container>
+matrix<Container> unpermute_vector(const matrix<Container>& y, const permutation& p) {
+  return to_matrix<matrix<Container>>(unpermute_vector(to_dense_vector(y), p));
+}
+
+template <typename ValueType>
+ordering_report get_ordering_report(const matrix<matrix_storage_cep<ValueType>>& before, const matrix<matrix_storage_cep<ValueType>>& after) {
+  return ordering_report{get_bandwidth(before), get_bandwidth(after), get_profile(before), get_profile(after)};
+}
+}
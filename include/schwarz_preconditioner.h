@@ -0,0 +1,231 @@
+#pragma once
+#include "type.h"
+#include "executor.h"
+#include "parallel.h"
+#include "instrument.h"
+#include "matrix.h"
+#include "matrix_storage_cep.h"
+#include "sparse_lu.h"
+#include <algorithm>
+#include <vector>
+#include <cassert>
+
+namespace pnmatrix {
+// one level domain decomposition preconditioner. the rows are cut into contiguous subdomains of
+// about the same number of elements, each one grown by `overlap` layers of neighbouring rows and
+// factorized on its own. apply solves all subdomains concurrently on the executor, so it is used
+// as M in gmres::solve(..., M). overlap 0 is block jacobi.
+// apply uses buffers owned by the preconditioner, one preconditioner must not be applied by two
+// threads at the same time.
+template <typename ValueType>
+class additive_schwarz {
+public:
+  using value_type = ValueType;
+
+  struct option {
+    // 0 means one subdomain per thread of exec.
+    size_type subdomains = 0;
+    size_type overlap = 0;
+    // complete lu of every subdomain instead of ilu(0).
+    bool exact = false;
+    // a row overlapped by several subdomains takes the value of the subdomain owning it (restricted
+    // additive schwarz), otherwise the values of all of them are summed.
+    bool restricted = true;
+    // runs setup and apply, nullptr means the calling thread only.
+    executor* exec = nullptr;
+  };
+
+  explicit additive_schwarz(const matrix<matrix_storage_cep<ValueType>>& A):additive_schwarz(A, option()) {
+
+  }
+
+  additive_schwarz(const matrix<matrix_storage_cep<ValueType>>& A, option op):n_(A.get_row()), restricted_(op.restricted), exec_(op.exec) {
+    PNMATRIX_TIMED_SCOPE("additive_schwarz.setup");
+    assert(A.get_row() == A.get_column());
+    assert(op.overlap >= 0);
+    executor& ex = get_executor();
+    size_type count = op.subdomains > 0 ? op.subdomains : ex.get_thread_count();
+    count = std::max<size_type>(1, std::min(count, n_));
+    const auto& c = A.get_container();
+    partition(c, count);
+    parallel_for(ex, 0, subdomain_count(), subdomain_count(), [&](size_type, size_type first, size_type last) {
+      std::vector<size_type> local(n_, -1);
+      for (size_type s = first; s < last; ++s) {
+        build(c, s, op.overlap, op.exact, local);
+      }
+    });
+    if (restricted_ == false) {
+      link_sources();
+    }
+  }
+
+  // z = M^-1 * r, both of A.get_row() values.
+  void apply(const value_type* r, value_type* z) const {
+    executor& ex = get_executor();
+    parallel_for(ex, 0, subdomain_count(), subdomain_count(), [&](size_type, size_type first, size_type last) {
+      for (size_type s = first; s < last; ++s) {
+        const subdomain& d = subdomains_[s];
+        for (size_type i = 0; i < (size_type)d.rows.size(); ++i) {
+          d.x[i] = r[d.rows[i]];
+        }
+        d.lu.solve(d.x.data());
+        if (restricted_ == true) {
+          for (size_type i = d.owned_begin; i < d.owned_end; ++i) {
+            z[d.rows[i]] = d.x[i];
+          }
+        }
+      }
+    });
+    if (restricted_ == true) {
+      return;
+    }
+    // each subdomain sums the contributions to its own rows, no two threads write the same row.
+    parallel_for(ex, 0, subdomain_count(), subdomain_count(), [&](size_type, size_type first, size_type last) {
+      for (size_type s = first; s < last; ++s) {
+        for (size_type row = first_row_[s]; row < first_row_[s + 1]; ++row) {
+          value_type sum = value_type(0);
+          for (size_type p = source_begin_[row]; p < source_begin_[row + 1]; ++p) {
+            sum += subdomains_[sources_[p].subdomain].x[sources_[p].position];
+          }
+          z[row] = sum;
+        }
+      }
+    });
+  }
+
+  size_type get_subdomain_count() const {
+    return subdomain_count();
+  }
+
+  // rows of subdomain s, 0-based, overlap included.
+  size_type get_subdomain_size(size_type s) const {
+    return subdomains_[s].rows.size();
+  }
+
+  // stored elements of the factors of subdomain s.
+  size_type get_factor_element_count(size_type s) const {
+    return subdomains_[s].lu.get_element_count();
+  }
+
+private:
+  struct subdomain {
+    // global rows, 0-based and sorted. the owned ones are [owned_begin, owned_end).
+    std::vector<size_type> rows;
+    size_type owned_begin = 0;
+    size_type owned_end = 0;
+    detail::local_lu<value_type> lu;
+    mutable std::vector<value_type> x;
+  };
+
+  struct source {
+    size_type subdomain;
+    size_type position;
+  };
+
+  size_type n_;
+  bool restricted_;
+  executor* exec_;
+  // subdomain s owns the rows [first_row_[s], first_row_[s + 1]).
+  std::vector<size_type> first_row_;
+  std::vector<subdomain> subdomains_;
+  // additive only, row i gathers sources_[source_begin_[i], source_begin_[i + 1]).
+  std::vector<size_type> source_begin_;
+  std::vector<source> sources_;
+
+  executor& get_executor() const {
+    return exec_ == nullptr ? get_inline_executor() : *exec_;
+  }
+
+  size_type subdomain_count() const {
+    return subdomains_.size();
+  }
+
+  // contiguous ranges of rows with about the same number of stored elements.
+  void partition(const matrix_storage_cep<value_type>& c, size_type count) {
+    size_type total = 0;
+    for (size_type row = 1; row <= n_; ++row) {
+      total += c.get_nth_row_size(row);
+    }
+    first_row_.assign(1, 0);
+    size_type seen = 0;
+    for (size_type row = 1; row <= n_; ++row) {
+      seen += c.get_nth_row_size(row);
+      size_type done = first_row_.size();
+      // leave at least one row for each remaining subdomain.
+      if (done < count && row < n_ && (seen * count >= done * total || n_ - row == count - done)) {
+        first_row_.push_back(row);
+      }
+    }
+    first_row_.push_back(n_);
+    subdomains_.resize(first_row_.size() - 1);
+  }
+
+  void build(const matrix_storage_cep<value_type>& c, size_type s, size_type overlap, bool exact, std::vector<size_type>& local) {
+    subdomain& d = subdomains_[s];
+    d.rows.clear();
+    for (size_type row = first_row_[s]; row < first_row_[s + 1]; ++row) {
+      d.rows.push_back(row);
+      local[row] = 0;
+    }
+    // breadth first layers through the pattern of A.
+    size_type layer_begin = 0;
+    for (size_type level = 0; level < overlap; ++level) {
+      size_type layer_end = d.rows.size();
+      for (size_type i = layer_begin; i < layer_end; ++i) {
+        c.for_each_in_row(d.rows[i] + 1, [&](size_type column, const value_type&) {
+          if (local[column - 1] < 0) {
+            local[column - 1] = 0;
+            d.rows.push_back(column - 1);
+          }
+        });
+      }
+      layer_begin = layer_end;
+    }
+    std::sort(d.rows.begin(), d.rows.end());
+    size_type size = d.rows.size();
+    for (size_type i = 0; i < size; ++i) {
+      local[d.rows[i]] = i;
+    }
+    d.owned_begin = std::lower_bound(d.rows.begin(), d.rows.end(), first_row_[s]) - d.rows.begin();
+    d.owned_end = d.owned_begin + (first_row_[s + 1] - first_row_[s]);
+
+    std::vector<size_type> row_begin(1, 0);
+    std::vector<size_type> columns;
+    std::vector<value_type> values;
+    for (size_type i = 0; i < size; ++i) {
+      c.for_each_in_row(d.rows[i] + 1, [&](size_type column, const value_type& v) {
+        if (local[column - 1] >= 0) {
+          columns.push_back(local[column - 1]);
+          values.push_back(v);
+        }
+      });
+      row_begin.push_back(columns.size());
+    }
+    d.lu.factorize(size, row_begin, columns, values, exact);
+    d.x.assign(size, value_type(0));
+    for (size_type row : d.rows) {
+      local[row] = -1;
+    }
+  }
+
+  void link_sources() {
+    source_begin_.assign(n_ + 1, 0);
+    for (const subdomain& d : subdomains_) {
+      for (size_type row : d.rows) {
+        ++source_begin_[row + 1];
+      }
+    }
+    for (size_type row = 0; row < n_; ++row) {
+      source_begin_[row + 1] += source_begin_[row];
+    }
+    sources_.resize(source_begin_[n_]);
+    std::vector<size_type> next(source_begin_.begin(), source_begin_.end() - 1);
+    for (size_type s = 0; s < subdomain_count(); ++s) {
+      const subdomain& d = subdomains_[s];
+      for (size_type i = 0; i < (size_type)d.rows.size(); ++i) {
+        sources_[next[d.rows[i]]++] = source{s, i};
+      }
+    }
+  }
+};
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "type.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <utility>
+
+namespace pnmatrix {
+enum class solve_status {
+  running,
+  converged,
+  cancelled,
+  deadline_exceeded,
+  max_iteration_reached,
+};
+
+struct solve_progress {
+  size_type iteration;
+  double residual;
+};
+
+// shared between a running solver and whoever watches it. cancel() and get_progress() may be
+// called from any thread, the solver calls next_iteration() once per iteration and stops with its
+// best iterate so far when it returns false.
+class solve_control {
+public:
+  using clock = std::chrono::steady_clock;
+
+  solve_control():cancelled_(false), has_deadline_(false), iteration_(0), residual_(0), status_(solve_status::running) {
+
+  }
+
+  solve_control(const solve_control&) = delete;
+  solve_control& operator=(const solve_control&) = delete;
+
+  // set before the solve starts.
+  void set_deadline(clock::time_point deadline) {
+    deadline_ = deadline;
+    has_deadline_ = true;
+  }
+
+  template <typename Rep, typename Period>
+  void set_timeout(std::chrono::duration<Rep, Period> timeout) {
+    set_deadline(clock::now() + timeout);
+  }
+
+  void cancel() {
+    cancelled_.store(true, std::memory_order_relaxed);
+  }
+
+  bool is_cancelled() const {
+    return cancelled_.load(std::memory_order_relaxed);
+  }
+
+  solve_progress get_progress() const {
+    return solve_progress{iteration_.load(std::memory_order_relaxed), residual_.load(std::memory_order_relaxed)};
+  }
+
+  solve_status get_status() const {
+    return status_.load(std::memory_order_acquire);
+  }
+
+  // records the progress of the iteration that just finished, returns false if the solver should stop.
+  bool next_iteration(size_type iteration, double residual) {
+    iteration_.store(iteration, std::memory_order_relaxed);
+    residual_.store(residual, std::memory_order_relaxed);
+    if (is_cancelled() == true) {
+      finish(solve_status::cancelled);
+      return false;
+    }
+    if (has_deadline_ == true && clock::now() >= deadline_) {
+      finish(solve_status::deadline_exceeded);
+      return false;
+    }
+    return true;
+  }
+
+  // the first final status wins.
+  void finish(solve_status status) {
+    solve_status expected = solve_status::running;
+    status_.compare_exchange_strong(expected, status, std::memory_order_acq_rel);
+  }
+
+private:
+  std::atomic<bool> cancelled_;
+  bool has_deadline_;
+  clock::time_point deadline_;
+  std::atomic<size_type> iteration_;
+  std::atomic<double> residual_;
+  std::atomic<solve_status> status_;
+};
+
+// future-like handle of a solve running on its own thread.
+template <typename Result>
+class solve_handle {
+public:
+  solve_handle(std::shared_ptr<solve_control> control, std::future<Result> future):control_(std::move(control)), future_(std::move(future)) {
+
+  }
+
+  void cancel() {
+    control_->cancel();
+  }
+
+  solve_progress get_progress() const {
+    return control_->get_progress();
+  }
+
+  solve_status get_status() const {
+    return control_->get_status();
+  }
+
+  bool is_ready() const {
+    return future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  template <typename Rep, typename Period>
+  bool wait_for(std::chrono::duration<Rep, Period> timeout) const {
+    return future_.wait_for(timeout) == std::future_status::ready;
+  }
+
+  void wait() const {
+    future_.wait();
+  }
+
+  // the solution, or the best iterate if the solve was cancelled or ran out of time.
+  Result get() {
+    return future_.get();
+  }
+
+private:
+  std::shared_ptr<solve_control> control_;
+  std::future<Result> future_;
+};
+
+// runs solver.solve(A, b, control) on a new thread. A and b are owned by the task, move them in to avoid the copy.
+template <typename Solver, typename MatrixType>
+solve_handle<MatrixType> solve_async(Solver solver, MatrixType A, MatrixType b,
+                                     std::shared_ptr<solve_control> control = std::make_shared<solve_control>()) {
+  std::future<MatrixType> future = std::async(std::launch::async, [solver, A = std::move(A), b = std::move(b), control]() mutable {
+    return solver.solve(A, b, *control);
+  });
+  return solve_handle<MatrixType>(std::move(control), std::move(future));
+}
+
+namespace detail {
+// the outer loop of the multigrid solve()s. residual() returns |b - A * x| of the current x and
+// cycle() runs one cycle on x. converged means |b - A * x| <= rm * b_norm, b = 0 has the solution
+// x = 0 and returns it at once.
+template <typename Vector, typename Residual, typename Cycle>
+void repeat_cycles(solve_control& control, double rm, size_type max_iteration, double b_norm, Vector& x, Residual residual, Cycle cycle) {
+  if (b_norm == 0) {
+    x.fill(typename Vector::value_type(0));
+    control.finish(solve_status::converged);
+    return;
+  }
+  size_type iteration = 0;
+  while (true) {
+    double r_norm = residual();
+    if (r_norm <= rm * b_norm) {
+      if (iteration > 0) {
+        control.next_iteration(iteration, r_norm / b_norm);
+      }
+      control.finish(solve_status::converged);
+      return;
+    }
+    if (iteration > 0) {
+      if (control.next_iteration(iteration, r_norm / b_norm) == false) {
+        return;
+      }
+      if (iteration == max_iteration) {
+        control.finish(solve_status::max_iteration_reached);
+        return;
+      }
+    }
+    cycle();
+    ++iteration;
+  }
+}
+}
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include "type.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <cassert>
+
+namespace pnmatrix {
+namespace detail {
+// lu of a small sparse matrix without pivoting, the rows of L (unit diagonal, not stored) and U
+// share one compressed array with sorted columns. without fill it is ilu(0) on the pattern of A,
+// with fill it is the complete factorization, reorder the matrix first to keep the fill small.
+template <typename ValueType>
+class local_lu {
+public:
+  // row i of A is columns / values [row_begin[i], row_begin[i + 1]), 0-based and sorted.
+  void factorize(size_type n, const std::vector<size_type>& row_begin, const std::vector<size_type>& columns,
+                 const std::vector<ValueType>& values, bool fill) {
+    n_ = n;
+    row_begin_.assign(1, 0);
+    columns_.clear();
+    values_.clear();
+    diag_.resize(n);
+    std::vector<ValueType> w(n, ValueType(0));
+    std::vector<size_type> mark(n, -1);
+    std::vector<size_type> pattern;
+    // the columns left of the diagonal still to eliminate, a min heap.
+    std::vector<size_type> lower;
+    auto later = std::greater<size_type>();
+    for (size_type i = 0; i < n; ++i) {
+      pattern.clear();
+      for (size_type p = row_begin[i]; p < row_begin[i + 1]; ++p) {
+        size_type c = columns[p];
+        w[c] = values[p];
+        mark[c] = i;
+        pattern.push_back(c);
+        if (c < i) {
+          lower.push_back(c);
+          std::push_heap(lower.begin(), lower.end(), later);
+        }
+      }
+      while (lower.empty() == false) {
+        std::pop_heap(lower.begin(), lower.end(), later);
+        size_type k = lower.back();
+        lower.pop_back();
+        ValueType lik = w[k] / values_[diag_[k]];
+        w[k] = lik;
+        for (size_type p = diag_[k] + 1; p < row_begin_[k + 1]; ++p) {
+          size_type j = columns_[p];
+          if (mark[j] == i) {
+            w[j] -= lik * values_[p];
+          }
+          else if (fill == true) {
+            mark[j] = i;
+            w[j] = - lik * values_[p];
+            pattern.push_back(j);
+            if (j < i) {
+              lower.push_back(j);
+              std::push_heap(lower.begin(), lower.end(), later);
+            }
+          }
+        }
+      }
+      assert(mark[i] == i);
+      std::sort(pattern.begin(), pattern.end());
+      for (size_type c : pattern) {
+        if (c == i) {
+          assert(w[c] != ValueType(0));
+          diag_[i] = columns_.size();
+        }
+        columns_.push_back(c);
+        values_.push_back(w[c]);
+      }
+      row_begin_.push_back(columns_.size());
+    }
+  }
+
+  // the numeric phase only: A has the pattern of the last factorize() and new values, the pattern
+  // of L and U and the elimination order are reused.
+  void refactorize(const std::vector<size_type>& row_begin, const std::vector<size_type>& columns, const ValueType* values) {
+    assert((size_type)row_begin.size() == n_ + 1);
+    std::vector<ValueType> w(n_, ValueType(0));
+    std::vector<size_type> mark(n_, -1);
+    for (size_type i = 0; i < n_; ++i) {
+      for (size_type p = row_begin_[i]; p < row_begin_[i + 1]; ++p) {
+        w[columns_[p]] = ValueType(0);
+        mark[columns_[p]] = i;
+      }
+      for (size_type p = row_begin[i]; p < row_begin[i + 1]; ++p) {
+        assert(mark[columns[p]] == i);
+        w[columns[p]] = values[p];
+      }
+      for (size_type q = row_begin_[i]; q < diag_[i]; ++q) {
+        size_type k = columns_[q];
+        ValueType lik = w[k] / values_[diag_[k]];
+        w[k] = lik;
+        for (size_type p = diag_[k] + 1; p < row_begin_[k + 1]; ++p) {
+          if (mark[columns_[p]] == i) {
+            w[columns_[p]] -= lik * values_[p];
+          }
+        }
+      }
+      assert(w[i] != ValueType(0));
+      for (size_type p = row_begin_[i]; p < row_begin_[i + 1]; ++p) {
+        values_[p] = w[columns_[p]];
+      }
+    }
+  }
+
+  // x = (L * U)^-1 * x.
+  void solve(ValueType* x) const {
+    for (size_type i = 0; i < n_; ++i) {
+      ValueType sum = x[i];
+      for (size_type p = row_begin_[i]; p < diag_[i]; ++p) {
+        sum -= values_[p] * x[columns_[p]];
+      }
+      x[i] = sum;
+    }
+    for (size_type i = n_ - 1; i >= 0; --i) {
+      ValueType sum = x[i];
+      for (size_type p = diag_[i] + 1; p < row_begin_[i + 1]; ++p) {
+        sum -= values_[p] * x[columns_[p]];
+      }
+      x[i] = sum / values_[diag_[i]];
+    }
+  }
+
+  size_type get_element_count() const {
+    return columns_.size();
+  }
+
+private:
+  size_type n_ = 0;
+  std::vector<size_type> row_begin_;
+  std::vector<size_type> columns_;
+  std::vector<size_type> diag_;
+  std::vector<ValueType> values_;
+};
+}
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include "type.h"
+#include "value_compare.h"
+#include "matrix.h"
+#include "matrix_storage_cep.h"
+#include "parallel.h"
+#include "instrument.h"
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace pnmatrix {
+namespace detail {
+// dense accumulator of one result row for gustavson's algorithm, indexed by column (start by 1).
+template <typename ValueType>
+class spgemm_accumulator {
+public:
+  explicit spgemm_accumulator(size_type column):marker_(column + 1, 0), values_(column + 1, ValueType(0)) {
+
+  }
+
+  // accumulates row `row` of A * B, the touched columns are left in columns().
+  void accumulate(const matrix_storage_cep<ValueType>& A, const matrix_storage_cep<ValueType>& B, size_type row) {
+    columns_.clear();
+    A.for_each_in_row(row, [&](size_type k, const ValueType& a) {
+      B.for_each_in_row(k, [&](size_type j, const ValueType& b) {
+        if (marker_[j] != row) {
+          marker_[j] = row;
+          values_[j] = a * b;
+          columns_.push_back(j);
+        }
+        else {
+          values_[j] += a * b;
+        }
+      });
+    });
+  }
+
+  std::vector<size_type>& columns() {
+    return columns_;
+  }
+
+  ValueType& value(size_type column) {
+    return values_[column];
+  }
+
+private:
+  std::vector<size_type> marker_;
+  std::vector<ValueType> values_;
+  std::vector<size_type> columns_;
+};
+
+// the rows of one parallel chunk in compressed form.
+template <typename ValueType>
+struct spgemm_chunk {
+  std::vector<size_type> row_size;
+  std::vector<size_type> columns;
+  std::vector<ValueType> values;
+};
+}
+
+// sparse * sparse with gustavson's row-wise algorithm, the work is O(flops) instead of O(row * column * row_nnz).
+template <typename ValueType>
+matrix<matrix_storage_cep<ValueType>> spgemm(const matrix<matrix_storage_cep<ValueType>>& m1,
+                                             const matrix<matrix_storage_cep<ValueType>>& m2,
+                                             size_type thread_count = 1) {
+  PNMATRIX_TIMED_SCOPE("spgemm");
+  PNMATRIX_ALLOCATION_SCOPE("spgemm");
+  assert(m1.get_column() == m2.get_row());
+  const auto& A = m1.get_container();
+  const auto& B = m2.get_container();
+  size_type row = m1.get_row();
+  size_type column = m2.get_column();
+  thread_count = std::max<size_type>(1, std::min(thread_count, row));
+  std::vector<detail::spgemm_chunk<ValueType>> chunks(thread_count);
+  parallel_for(1, row + 1, thread_count, [&](size_type t, size_type first, size_type last) {
+    detail::spgemm_accumulator<ValueType> acc(column);
+    detail::spgemm_chunk<ValueType>& chunk = chunks[t];
+    for (size_type i = first; i < last; ++i) {
+      acc.accumulate(A, B, i);
+      std::vector<size_type>& cols = acc.columns();
+      std::sort(cols.begin(), cols.end());
+      size_type count = 0;
+      for (size_type j : cols) {
+        ValueType v = acc.value(j);
+#ifdef DELETE_ZERO
+        if (value_equal(v, ValueType(0))) {
+          continue;
+        }
+#endif
+        chunk.columns.push_back(j);
+        chunk.values.push_back(v);
+        ++count;
+      }
+      chunk.row_size.push_back(count);
+    }
+  });
+  matrix<matrix_storage_cep<ValueType>> result(row, column);
+  auto& C = result.get_container();
+  size_type i = 1;
+  for (auto& chunk : chunks) {
+    size_type pos = 0;
+    for (size_type count : chunk.row_size) {
+      C.reserve_row(i, count);
+      for (size_type k = 0; k < count; ++k, ++pos) {
+        C.push_back_in_row(i, chunk.columns[pos], chunk.values[pos]);
+      }
+      ++i;
+    }
+  }
+  return result;
+}
+
+// two-phase spgemm for products that are repeated with the same sparsity patterns.
+// the constructor runs the symbolic phase once, multiply() only recomputes the values.
+template <typename ValueType>
+class spgemm_plan {
+public:
+  spgemm_plan(const matrix<matrix_storage_cep<ValueType>>& m1,
+              const matrix<matrix_storage_cep<ValueType>>& m2,
+              size_type thread_count = 1):row_(m1.get_row()), column_(m2.get_column()) {
+    assert(m1.get_column() == m2.get_row());
+    const auto& A = m1.get_container();
+    const auto& B = m2.get_container();
+    thread_count = std::max<size_type>(1, std::min(thread_count, row_));
+    std::vector<std::vector<size_type>> chunk_columns(thread_count);
+    std::vector<size_type> row_size(row_ + 1, 0);
+    parallel_for(1, row_ + 1, thread_count, [&](size_type t, size_type first, size_type last) {
+      std::vector<size_type> marker(column_ + 1, 0);
+      std::vector<size_type>& cols = chunk_columns[t];
+      for (size_type i = first; i < last; ++i) {
+        size_type begin = cols.size();
+        A.for_each_in_row(i, [&](size_type k, const ValueType&) {
+          B.for_each_in_row(k, [&](size_type j, const ValueType&) {
+            if (marker[j] != i) {
+              marker[j] = i;
+              cols.push_back(j);
+            }
+          });
+        });
+        std::sort(cols.begin() + begin, cols.end());
+        row_size[i] = cols.size() - begin;
+      }
+    });
+    row_ptr_.assign(row_ + 2, 0);
+    for (size_type i = 1; i <= row_; ++i) {
+      row_ptr_[i + 1] = row_ptr_[i] + row_size[i];
+    }
+    columns_.reserve(row_ptr_[row_ + 1]);
+    for (auto& each : chunk_columns) {
+      columns_.insert(columns_.end(), each.begin(), each.end());
+    }
+  }
+
+  size_type get_row() const {
+    return row_;
+  }
+
+  size_type get_column() const {
+    return column_;
+  }
+
+  size_type get_element_count() const {
+    return columns_.size();
+  }
+
+  // numeric phase, m1 and m2 must have the sparsity patterns the plan was built with.
+  // every position of the pattern is kept, even if its value cancels to zero, so the result pattern is stable.
+  matrix<matrix_storage_cep<ValueType>> multiply(const matrix<matrix_storage_cep<ValueType>>& m1,
+                                                 const matrix<matrix_storage_cep<ValueType>>& m2,
+                                                 size_type thread_count = 1) const {
+    assert(m1.get_row() == row_ && m2.get_column() == column_ && m1.get_column() == m2.get_row());
+    const auto& A = m1.get_container();
+    const auto& B = m2.get_container();
+    std::vector<ValueType> values(columns_.size());
+    parallel_for(1, row_ + 1, thread_count, [&](size_type, size_type first, size_type last) {
+      std::vector<ValueType> acc(column_ + 1, ValueType(0));
+      for (size_type i = first; i < last; ++i) {
+        A.for_each_in_row(i, [&](size_type k, const ValueType& a) {
+          B.for_each_in_row(k, [&](size_type j, const ValueType& b) {
+            acc[j] += a * b;
+          });
+        });
+        for (size_type pos = row_ptr_[i]; pos < row_ptr_[i + 1]; ++pos) {
+          values[pos] = acc[columns_[pos]];
+          acc[columns_[pos]] = ValueType(0);
+        }
+      }
+    });
+    matrix<matrix_storage_cep<ValueType>> result(row_, column_);
+    auto& C = result.get_container();
+    for (size_type i = 1; i <= row_; ++i) {
+      C.reserve_row(i, row_ptr_[i + 1] - row_ptr_[i]);
+      for (size_type pos = row_ptr_[i]; pos < row_ptr_[i + 1]; ++pos) {
+        C.push_back_in_row(i, columns_[pos], values[pos]);
+      }
+    }
+    return result;
+  }
+
+private:
+  size_type row_;
+  size_type column_;
+  // row i owns columns_[row_ptr_[i], row_ptr_[i + 1]).
+  std::vector<size_type> row_ptr_;
+  std::vector<size_type> columns_;
+};
+
+// galerkin coarse operator R * A * P used by multigrid.
+template <typename ValueType>
+matrix<matrix_storage_cep<ValueType>> galerkin_product(const matrix<matrix_storage_cep<ValueType>>& R,
+                                                       const matrix<matrix_storage_cep<ValueType>>& A,
+                                                       const matrix<matrix_storage_cep<ValueType>>& P,
+                                                       size_type thread_count = 1) {
+  return spgemm(spgemm(R, A, thread_count), P, thread_count);
+}
+
+// cep * cep takes this overload where this header is included, elsewhere the generic product of matrix.h.
+template <typename ValueType>
+auto operator*(const matrix<matrix_storage_cep<ValueType>>& m1,
+               const matrix<matrix_storage_cep<ValueType>>& m2)->matrix<matrix_storage_cep<ValueType>> {
+  return spgemm(m1, m2);
+}
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "type.h"
+#include "matrix.h"
+#include "matrix_storage_cep.h"
+#include "parallel.h"
+#include "instrument.h"
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace pnmatrix {
+// column compressed snapshot of a cep matrix, built in O(nnz) with a counting sort.
+// the values are copied, later changes of the source matrix are not seen.
+template <typename ValueType>
+class csc_view {
+public:
+  using value_type = ValueType;
+
+  explicit csc_view(const matrix<matrix_storage_cep<ValueType>>& m, size_type thread_count = 1):
+                    row_(m.get_row()),
+                    column_(m.get_column()) {
+    const auto& A = m.get_container();
+    thread_count = std::max<size_type>(1, std::min(thread_count, row_));
+    // counts[t][c] : elements of column c in the rows of chunk t.
+    std::vector<std::vector<size_type>> counts(thread_count);
+    parallel_for(1, row_ + 1, thread_count, [&](size_type t, size_type first, size_type last) {
+      counts[t].assign(column_ + 1, 0);
+      for (size_type i = first; i < last; ++i) {
+        A.for_each_in_row(i, [&](size_type c, const ValueType&) {
+          ++counts[t][c];
+        });
+      }
+    });
+    column_ptr_.assign(column_ + 2, 0);
+    for (size_type c = 1; c <= column_; ++c) {
+      size_type sum = column_ptr_[c];
+      for (size_type t = 0; t < thread_count; ++t) {
+        // parallel_for may use fewer chunks than threads.
+        if (counts[t].empty()) {
+          continue;
+        }
+        size_type n = counts[t][c];
+        counts[t][c] = sum;
+        sum += n;
+      }
+      column_ptr_[c + 1] = sum;
+    }
+    row_indices_.resize(column_ptr_[column_ + 1]);
+    values_.resize(column_ptr_[column_ + 1]);
+    // every chunk scatters into its own slots, rows stay sorted inside each column.
+    parallel_for(1, row_ + 1, thread_count, [&](size_type t, size_type first, size_type last) {
+      std::vector<size_type>& next = counts[t];
+      for (size_type i = first; i < last; ++i) {
+        A.for_each_in_row(i, [&](size_type c, const ValueType& v) {
+          size_type pos = next[c]++;
+          row_indices_[pos] = i;
+          values_[pos] = v;
+        });
+      }
+    });
+  }
+
+  size_type get_row() const {
+    return row_;
+  }
+
+  size_type get_column() const {
+    return column_;
+  }
+
+  size_type get_element_count() const {
+    return values_.size();
+  }
+
+  size_type get_nth_column_size(size_type column) const {
+    return column_ptr_[column + 1] - column_ptr_[column];
+  }
+
+  // calls f(row, value) for every stored element of column, in row order.
+  template <typename F>
+  void for_each_in_column(size_type column, F f) const {
+    for (size_type pos = column_ptr_[column]; pos < column_ptr_[column + 1]; ++pos) {
+      f(row_indices_[pos], values_[pos]);
+    }
+  }
+
+  value_type get_value(size_type row, size_type column) const {
+    auto first = row_indices_.begin() + column_ptr_[column];
+    auto last = row_indices_.begin() + column_ptr_[column + 1];
+    auto it = std::lower_bound(first, last, row);
+    if (it == last || *it != row) {
+      return value_type(0);
+    }
+    return values_[it - row_indices_.begin()];
+  }
+
+  // column c owns [column_ptr()[c], column_ptr()[c + 1]) of row_indices() and values(), c starts by 1.
+  const std::vector<size_type>& column_ptr() const {
+    return column_ptr_;
+  }
+
+  const std::vector<size_type>& row_indices() const {
+    return row_indices_;
+  }
+
+  const std::vector<value_type>& values() const {
+    return values_;
+  }
+
+private:
+  size_type row_;
+  size_type column_;
+  std::vector<size_type> column_ptr_;
+  std::vector<size_type> row_indices_;
+  std::vector<value_type> values_;
+};
+
+// O(nnz) transpose : the columns of the csc view are the rows of the result, already sorted.
+template <typename ValueType>
+matrix<matrix_storage_cep<ValueType>> transpose(const matrix<matrix_storage_cep<ValueType>>& m, size_type thread_count = 1) {
+  PNMATRIX_TIMED_SCOPE("transpose");
+  PNMATRIX_ALLOCATION_SCOPE("transpose");
+  csc_view<ValueType> csc(m, thread_count);
+  matrix<matrix_storage_cep<ValueType>> result(m.get_column(), m.get_row());
+  auto& C = result.get_container();
+  for (size_type c = 1; c <= m.get_column(); ++c) {
+    C.reserve_row(c, csc.get_nth_column_size(c));
+    csc.for_each_in_column(c, [&](size_type r, const ValueType& v) {
+      C.push_back_in_row(c, r, v);
+    });
+  }
+  return result;
+}
+
+// tr() of a cep matrix takes this overload where this header is included, elsewhere the generic one of matrix.h.
+template <typename ValueType>
+matrix<matrix_storage_cep<ValueType>> tr(const matrix<matrix_storage_cep<ValueType>>& m) {
+  const auto& A = m.get_container();
+  std::vector<size_type> counts(m.get_column() + 1, 0);
+  for (size_type i = 1; i <= m.get_row(); ++i) {
+    A.for_each_in_row(i, [&](size_type c, const ValueType&) {
+      ++counts[c];
+    });
+  }
+  matrix<matrix_storage_cep<ValueType>> result(m.get_column(), m.get_row());
+  auto& C = result.get_container();
+  for (size_type c = 1; c <= m.get_column(); ++c) {
+    C.reserve_row(c, counts[c]);
+  }
+  // rows are visited in order, so every append lands behind the last element of its row.
+  for (size_type i = 1; i <= m.get_row(); ++i) {
+    A.for_each_in_row(i, [&](size_type c, const ValueType& v) {
+      C.push_back_in_row(c, i, v);
+    });
+  }
+  return result;
+}
+}
@@ -0,0 +1,99 @@
+#include "../third_party/catch.hpp"
+#include "../include/allocator.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix.h"
+#include "../include/jacobian_solver.h"
+#include "../include/gauss_seidel_solver.h"
+#include "../include/gmres_solver.h"
+#include <vector>
+
+using namespace pnmatrix;
+
+TEST_CASE("allocation tracker counts library allocations test", "[allocation]") {
+  allocation_tracker outer;
+  {
+    allocation_tracker inner;
+    dense_vector<double> v(16);
+    REQUIRE(inner.get_count() == 1);
+    REQUIRE(inner.get_bytes() == 16 * sizeof(double));
+    std::vector<double> not_tracked(16);
+    REQUIRE(inner.get_count() == 1);
+  }
+  REQUIRE(outer.get_count() == 1);
+  REQUIRE(outer.get_deallocation_count() == 1);
+  REQUIRE(outer.get_deallocated_bytes() == 16 * sizeof(double));
+
+  outer.reset();
+  matrix_storage_cep<double> m(3, 3);
+  size_type after_construct = outer.get_count();
+  REQUIRE(after_construct >= 1);
+  m.set_value(1, 1, 1.0);
+  REQUIRE(outer.get_count() == after_construct + 1);
+  m.set_value(1, 1, 2.0);
+  REQUIRE(outer.get_count() == after_construct + 1);
+}
+
+static matrix<matrix_storage_cep<double>> allocation_test_matrix(size_type n) {
+  matrix<matrix_storage_cep<double>> m(n, n);
+  for (size_type i = 1; i <= n; ++i) {
+    m.set_value(i, i, 4);
+    if (i > 1) {
+      m.set_value(i, i - 1, -1);
+    }
+    if (i < n) {
+      m.set_value(i, i + 1, -1);
+    }
+  }
+  return m;
+}
+
+// the allocations of a solve stopped after `iterations` iterations, rm < 0 never converges.
+template <typename Solver>
+static size_type solve_allocations(typename Solver::option op, size_type iterations) {
+  auto A = allocation_test_matrix(20);
+  matrix<matrix_storage_cep<double>> b(20, 1);
+  for (size_type i = 1; i <= 20; ++i) {
+    b.set_value(i, 1, double(i));
+  }
+  op.rm = -1;
+  op.max_iteration = iterations;
+  Solver solver(op);
+  solve_control control;
+  allocation_tracker tracker;
+  solver.solve(A, b, control);
+  REQUIRE(control.get_status() == solve_status::max_iteration_reached);
+  return tracker.get_count();
+}
+
+TEST_CASE("solvers do not allocate per iteration test", "[allocation]") {
+  REQUIRE(solve_allocations<jacobian>(jacobian::option(), 2) == solve_allocations<jacobian>(jacobian::option(), 12));
+  REQUIRE(solve_allocations<gauss_seidel>(gauss_seidel::option(), 2) == solve_allocations<gauss_seidel>(gauss_seidel::option(), 12));
+  gmres::option op;
+  op.m = 5;
+  REQUIRE(solve_allocations<gmres>(op, 2) == solve_allocations<gmres>(op, 12));
+}
+
+TEST_CASE("solver workspaces are tracked test", "[allocation]") {
+  gmres::workspace<double> ws;
+  allocation_tracker tracker;
+  ws.resize(20, 5);
+  // the basis array, its 6 vectors, w and y.
+  REQUIRE(tracker.get_count() == 1 + 6 + 1 + 1);
+  tracker.reset();
+  ws.hessenberg.reset(5, 1.0);
+  REQUIRE(tracker.get_count() == 4);
+}
+
+#ifdef PNMATRIX_INSTRUMENT
+TEST_CASE("allocation scopes report per solver call test", "[allocation]") {
+  instrument::registry& r = instrument::registry::get();
+  r.reset();
+  gmres::option op;
+  op.m = 5;
+  size_type count = solve_allocations<gmres>(op, 4);
+  REQUIRE(r.get_counter_value("gmres.solve.allocations") > 0);
+  REQUIRE(r.get_counter_value("gmres.solve.allocations") <= count);
+  REQUIRE(r.get_counter_value("gmres.solve.allocated_bytes") > 0);
+  r.reset();
+}
+#endif
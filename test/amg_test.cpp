@@ -0,0 +1,141 @@
+#include "../third_party/catch.hpp"
+#include "../include/amg_solver.h"
+#include "../include/gmres_solver.h"
+#include "../include/value_compare.h"
+#include "grid_matrix.h"
+#include <cmath>
+
+using namespace pnmatrix;
+using amg_matrix = matrix<matrix_storage_cep<double>>;
+
+static dense_vector<double> poisson_rhs(const amg_matrix& A, dense_vector<double>& expect) {
+  size_type n = A.get_row();
+  expect.resize(n);
+  for (size_type i = 0; i < n; ++i) {
+    expect[i] = std::sin(double(i) * 0.37) + 0.5;
+  }
+  dense_vector<double> b(n);
+  matrix_vector_multiply(A, expect, b);
+  return b;
+}
+
+static size_type amg_iterations(size_type k, amg<double>::option op) {
+  amg_matrix A = grid_matrix(k);
+  dense_vector<double> expect;
+  dense_vector<double> b = poisson_rhs(A, expect);
+  op.rm = 1e-8;
+  amg<double> solver(A, op);
+  REQUIRE(solver.get_level_count() > 1);
+  for (size_type l = 1; l < solver.get_level_count(); ++l) {
+    REQUIRE(solver.get_level_size(l) < solver.get_level_size(l - 1));
+  }
+  REQUIRE(solver.get_operator_complexity() < 2.0);
+  dense_vector<double> x(A.get_row());
+  solve_control control;
+  solver.solve(b, x, control);
+  REQUIRE(control.get_status() == solve_status::converged);
+  for (size_type i = 0; i < A.get_row(); ++i) {
+    REQUIRE(std::abs(x[i] - expect[i]) < 1e-5);
+  }
+  return control.get_progress().iteration;
+}
+
+TEST_CASE("amg iteration counts do not grow with the mesh test", "[amg]") {
+  amg<double>::option op;
+  size_type small = amg_iterations(32, op);
+  size_type large = amg_iterations(64, op);
+  REQUIRE(large < 25);
+  REQUIRE(large <= small + 4);
+
+  op.smoother = amg_smoother::jacobian;
+  op.pre_sweeps = 2;
+  op.post_sweeps = 2;
+  size_type jacobian_small = amg_iterations(32, op);
+  size_type jacobian_large = amg_iterations(64, op);
+  REQUIRE(jacobian_large < 30);
+  REQUIRE(jacobian_large <= jacobian_small + 4);
+}
+
+TEST_CASE("amg small systems are solved directly test", "[amg]") {
+  amg_matrix A = grid_matrix(4);
+  amg<double> solver(A);
+  REQUIRE(solver.get_level_count() == 1);
+  amg_matrix b(16, 1);
+  for (size_type i = 1; i <= 16; ++i) {
+    b.set_value(i, 1, double(i));
+  }
+  amg_matrix x = solver.solve(b);
+  amg_matrix ax = A * x;
+  for (size_type i = 1; i <= 16; ++i) {
+    REQUIRE(std::abs(ax.get_value(i, 1) - double(i)) < 1e-10);
+  }
+}
+
+TEST_CASE("amg zero right hand side test", "[amg]") {
+  amg_matrix A = grid_matrix(16);
+  amg<double> solver(A);
+  dense_vector<double> b(A.get_row());
+  dense_vector<double> x(A.get_row(), 1.0);
+  solve_control control;
+  solver.solve(b, x, control);
+  REQUIRE(control.get_status() == solve_status::converged);
+  for (size_type i = 0; i < A.get_row(); ++i) {
+    REQUIRE(value_equal(x[i], 0.0));
+  }
+}
+
+TEST_CASE("gmres with an amg preconditioner test", "[amg]") {
+  gmres::option gop;
+  gop.rm = 1e-10;
+  size_type previous = 0;
+  for (size_type k : {24, 48}) {
+    amg_matrix A = grid_matrix(k);
+    dense_vector<double> expect;
+    dense_vector<double> b = poisson_rhs(A, expect);
+    amg<double> M(A);
+    gmres::workspace<double> ws;
+    dense_vector<double> x(A.get_row());
+    solve_control control;
+    gmres(gop).solve(A, b, x, control, ws, M);
+    REQUIRE(control.get_status() == solve_status::converged);
+    for (size_type i = 0; i < A.get_row(); ++i) {
+      REQUIRE(std::abs(x[i] - expect[i]) < 1e-7);
+    }
+    size_type iterations = control.get_progress().iteration;
+    REQUIRE(iterations < 20);
+    if (previous > 0) {
+      REQUIRE(iterations <= previous + 3);
+    }
+    previous = iterations;
+  }
+}
+
+TEST_CASE("amg v-cycle is linear test", "[amg]") {
+  // M^-1 (r1 + 2 r2) == M^-1 r1 + 2 M^-1 r2 holds only if the smoothers are plain sweeps.
+  amg_matrix A = grid_matrix(20);
+  size_type n = A.get_row();
+  std::vector<double> r1(n);
+  std::vector<double> r2(n);
+  std::vector<double> r3(n);
+  for (size_type i = 0; i < n; ++i) {
+    r1[i] = std::sin(double(i));
+    r2[i] = std::cos(double(i) * 0.3);
+    r3[i] = r1[i] + 2 * r2[i];
+  }
+  for (amg_smoother smoother : {amg_smoother::gauss_seidel, amg_smoother::jacobian}) {
+    amg<double>::option op;
+    op.coarse_size = 16;
+    op.smoother = smoother;
+    amg<double> M(A, op);
+    REQUIRE(M.get_level_count() > 1);
+    std::vector<double> z1(n);
+    std::vector<double> z2(n);
+    std::vector<double> z3(n);
+    M.apply(r1.data(), z1.data());
+    M.apply(r2.data(), z2.data());
+    M.apply(r3.data(), z3.data());
+    for (size_type i = 0; i < n; ++i) {
+      REQUIRE(std::abs(z3[i] - (z1[i] + 2 * z2[i])) < 1e-12);
+    }
+  }
+}
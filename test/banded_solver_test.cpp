@@ -0,0 +1,157 @@
+#include "../third_party/catch.hpp"
+#include "../include/banded_solver.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix_storage_banded.h"
+#include "../include/executor.h"
+#include "../include/value_compare.h"
+#include <cmath>
+
+using namespace pnmatrix;
+
+// diagonally dominant tridiagonal system with a known solution.
+struct tridiagonal_test_system {
+  std::vector<double> lower;
+  std::vector<double> diag;
+  std::vector<double> upper;
+  std::vector<double> expect;
+  std::vector<double> rhs;
+
+  explicit tridiagonal_test_system(size_type n):lower(n), diag(n), upper(n), expect(n), rhs(n) {
+    for (size_type i = 0; i < n; ++i) {
+      lower[i] = - 1.0 + 0.3 * std::sin(double(i));
+      upper[i] = - 1.0 + 0.3 * std::cos(double(i));
+      diag[i] = 2.7 + 0.1 * double(i % 3);
+      expect[i] = std::sin(double(i) * 0.01) + double(i % 5);
+    }
+    for (size_type i = 0; i < n; ++i) {
+      rhs[i] = diag[i] * expect[i];
+      if (i > 0) {
+        rhs[i] += lower[i] * expect[i - 1];
+      }
+      if (i + 1 < n) {
+        rhs[i] += upper[i] * expect[i + 1];
+      }
+    }
+  }
+};
+
+TEST_CASE("thomas solve test", "[banded_solver]") {
+  for (size_type n : {1, 2, 3, 100}) {
+    tridiagonal_test_system s(n);
+    std::vector<double> x = s.rhs;
+    std::vector<double> work(n);
+    REQUIRE(thomas_solve(n, s.lower.data(), s.diag.data(), s.upper.data(), x.data(), work.data()) == true);
+    for (size_type i = 0; i < n; ++i) {
+      REQUIRE(std::abs(x[i] - s.expect[i]) < 1e-10);
+    }
+  }
+  std::vector<double> zero(3, 0.0);
+  std::vector<double> x(3, 1.0);
+  std::vector<double> work(3);
+  REQUIRE(thomas_solve<double>(3, zero.data(), zero.data(), zero.data(), x.data(), work.data()) == false);
+}
+
+TEST_CASE("cyclic reduction solve test", "[banded_solver]") {
+  thread_pool::option pool_op;
+  pool_op.thread_count = 4;
+  thread_pool pool(pool_op);
+  for (size_type n : {1, 2, 3, 7, 8, 9, 1000, 4097}) {
+    tridiagonal_test_system s(n);
+    for (size_type serial_size : {1, 5, 1024}) {
+      std::vector<double> x = s.rhs;
+      std::vector<double> work(3 * n);
+      REQUIRE(cyclic_reduction_solve(pool, n, s.lower.data(), s.diag.data(), s.upper.data(), x.data(), work.data(), serial_size) == true);
+      for (size_type i = 0; i < n; ++i) {
+        REQUIRE(std::abs(x[i] - s.expect[i]) < 1e-10);
+      }
+      std::vector<double> y = s.rhs;
+      REQUIRE(cyclic_reduction_solve(get_inline_executor(), n, s.lower.data(), s.diag.data(), s.upper.data(), y.data(), work.data(), serial_size) == true);
+      for (size_type i = 0; i < n; ++i) {
+        REQUIRE(value_equal(x[i], y[i]));
+      }
+    }
+  }
+}
+
+TEST_CASE("batched tridiagonal solve test", "[banded_solver]") {
+  const size_type batch = 13;
+  const size_type n = 40;
+  batched_vector<double> lower(batch, n);
+  batched_vector<double> diag(batch, n);
+  batched_vector<double> upper(batch, n);
+  batched_vector<double> b(batch, n);
+  std::vector<tridiagonal_test_system> systems;
+  for (size_type s = 0; s < batch; ++s) {
+    systems.emplace_back(n + s);
+    for (size_type i = 1; i <= n; ++i) {
+      lower.set_value(s, i, systems[s].lower[i - 1 + s]);
+      diag.set_value(s, i, systems[s].diag[i - 1 + s]);
+      upper.set_value(s, i, systems[s].upper[i - 1 + s]);
+    }
+  }
+  std::vector<std::vector<double>> expect(batch, std::vector<double>(n));
+  for (size_type s = 0; s < batch; ++s) {
+    for (size_type i = 1; i <= n; ++i) {
+      expect[s][i - 1] = double(i) * 0.5 - double(s);
+    }
+    for (size_type i = 1; i <= n; ++i) {
+      double v = diag.get_value(s, i) * expect[s][i - 1];
+      if (i > 1) {
+        v += lower.get_value(s, i) * expect[s][i - 2];
+      }
+      if (i < n) {
+        v += upper.get_value(s, i) * expect[s][i];
+      }
+      b.set_value(s, i, v);
+    }
+  }
+  REQUIRE(batched_tridiagonal_solve(lower, diag, upper, b, 2) == true);
+  for (size_type s = 0; s < batch; ++s) {
+    for (size_type i = 1; i <= n; ++i) {
+      REQUIRE(std::abs(b.get_value(s, i) - expect[s][i - 1]) < 1e-10);
+    }
+  }
+  diag.set_value(4, 1, 0.0);
+  REQUIRE(batched_tridiagonal_solve(lower, diag, upper, b) == false);
+}
+
+TEST_CASE("banded lu with pivoting test", "[banded_solver]") {
+  // the subdiagonal outweighs the diagonal and (1, 1) is zero, only pivoting solves it.
+  size_type n = 60;
+  banded_matrix<double> m(n, n);
+  for (size_type i = 1; i <= n; ++i) {
+    m.set_value(i, i, 1.0 + 0.5 * std::cos(double(i)));
+    if (i > 1) {
+      m.set_value(i, i - 1, 2.0 + std::sin(double(i)));
+    }
+    if (i > 2) {
+      m.set_value(i, i - 2, 0.5 * std::sin(double(i * 13)));
+    }
+    if (i < n) {
+      m.set_value(i, i + 1, -1.0);
+    }
+  }
+  m.set_value(1, 1, 0.0);
+  dense_vector<double> expect(n);
+  for (size_type i = 0; i < n; ++i) {
+    expect[i] = double(i % 7) - 3;
+  }
+  dense_vector<double> x(n);
+  matrix_vector_multiply(m, expect, x);
+  banded_lu<double> lu;
+  REQUIRE(lu.factorize(m) == true);
+  REQUIRE(lu.get_lower_bandwidth() == 2);
+  REQUIRE(lu.get_upper_bandwidth() == 3);
+  lu.solve(x);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(x[i] - expect[i]) < 1e-9);
+  }
+
+  matrix<matrix_storage_cep<double>> singular(3, 3);
+  singular.set_value(1, 1, 1.0);
+  singular.set_value(1, 2, 2.0);
+  singular.set_value(2, 1, 2.0);
+  singular.set_value(2, 2, 4.0);
+  singular.set_value(3, 3, 1.0);
+  REQUIRE(lu.factorize(singular) == false);
+}
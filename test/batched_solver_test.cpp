@@ -0,0 +1,102 @@
+#include "../third_party/catch.hpp"
+#include "../include/batched_solver.h"
+#include "../include/matrix.h"
+#include "../include/matrix_storage_block.h"
+#include "../include/value_compare.h"
+#include <cmath>
+
+using namespace pnmatrix;
+
+// a(s, i, j) and x(s, i) are deterministic, b = a * x.
+static double batched_test_value(size_type s, size_type i, size_type j) {
+  return std::sin(double(s * 31 + i * i * 7 + j * 3 + i * j));
+}
+
+static double batched_test_x(size_type s, size_type i) {
+  return double(i) - 0.25 * double(s % 5);
+}
+
+template <size_type Lanes>
+static void build_batch(batched_matrix<double, Lanes>& a, batched_vector<double, Lanes>& b, bool symmetric) {
+  const size_type n = a.get_dimension();
+  for (size_type s = 0; s < a.get_batch_count(); ++s) {
+    for (size_type i = 1; i <= n; ++i) {
+      for (size_type j = 1; j <= n; ++j) {
+        double v = symmetric ? batched_test_value(s, std::min(i, j), std::max(i, j)) : batched_test_value(s, i, j);
+        if (i == j) {
+          v += symmetric ? double(n) : 0.0;
+        }
+        a.set_value(s, i, j, v);
+      }
+    }
+    for (size_type i = 1; i <= n; ++i) {
+      double sum = 0;
+      for (size_type j = 1; j <= n; ++j) {
+        sum += a.get_value(s, i, j) * batched_test_x(s, j);
+      }
+      b.set_value(s, i, sum);
+    }
+  }
+}
+
+template <size_type Lanes>
+static void check_solution(const batched_vector<double, Lanes>& b) {
+  for (size_type s = 0; s < b.get_batch_count(); ++s) {
+    for (size_type i = 1; i <= b.get_dimension(); ++i) {
+      REQUIRE(std::abs(b.get_value(s, i) - batched_test_x(s, i)) < 1e-8);
+    }
+  }
+}
+
+TEST_CASE("batched matrix layout test", "[batched]") {
+  batched_matrix<double, 4> a(6, 3);
+  REQUIRE(a.get_group_count() == 2);
+  REQUIRE(value_equal(a.get_value(5, 2, 2), 1.0));
+  a.set_value(5, 2, 3, 2.5);
+  REQUIRE(value_equal(a.element(1, 2, 3)[1], 2.5));
+  matrix<matrix_storage_block<double>> m(3, 3);
+  m.set_value(1, 2, 4.0);
+  a.set_system(0, m);
+  REQUIRE(value_equal(a.get_value(0, 1, 2), 4.0));
+  REQUIRE(value_equal(a.get_value(0, 1, 1), 0.0));
+}
+
+TEST_CASE("batched lu solve test", "[batched]") {
+  batched_matrix<double> a(37, 10);
+  batched_vector<double> b(37, 10);
+  build_batch(a, b, false);
+
+  SECTION("decompose then solve") {
+    batched_pivot pivot;
+    REQUIRE(batched_lu_decompose(a, pivot, 3) == true);
+    batched_lu_solve(a, pivot, b, 3);
+    check_solution(b);
+  }
+
+  SECTION("fused") {
+    REQUIRE(batched_solve(a, b, 2) == true);
+    check_solution(b);
+  }
+}
+
+TEST_CASE("batched lu singular test", "[batched]") {
+  batched_matrix<double, 4> a(5, 2);
+  batched_vector<double, 4> b(5, 2);
+  a.set_value(3, 1, 1, 0.0);
+  a.set_value(3, 2, 2, 0.0);
+  batched_pivot pivot;
+  REQUIRE(batched_lu_decompose(a, pivot) == false);
+}
+
+TEST_CASE("batched cholesky solve test", "[batched]") {
+  batched_matrix<double, 4> a(19, 10);
+  batched_vector<double, 4> b(19, 10);
+  build_batch(a, b, true);
+  REQUIRE(batched_cholesky_decompose(a, 4) == true);
+  batched_cholesky_solve(a, b, 4);
+  check_solution(b);
+
+  batched_matrix<double, 4> indefinite(2, 2);
+  indefinite.set_value(1, 2, 2, -1.0);
+  REQUIRE(batched_cholesky_decompose(indefinite) == false);
+}
@@ -0,0 +1,83 @@
+#include "../third_party/catch.hpp"
+#include "../include/dense_block.h"
+#include "../include/matrix.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/value_compare.h"
+
+using namespace pnmatrix;
+
+TEST_CASE("dense block test", "[dense_block]") {
+  dense_block<double> b(3, 2);
+  REQUIRE(b.get_row() == 3);
+  REQUIRE(b.get_column() == 2);
+  b.set_value(1, 1, 1.0);
+  b.set_value(2, 1, 2.0);
+  b.set_value(3, 2, 4.0);
+  REQUIRE(value_equal(b(1, 0), 2.0));
+  REQUIRE(value_equal(b.row_data(2)[1], 4.0));
+
+  double out[2];
+  b.column_inner_product(b, out);
+  REQUIRE(value_equal(out[0], 5.0));
+  REQUIRE(value_equal(out[1], 16.0));
+  b.column_second_norm(out);
+  REQUIRE(value_equal(out[1], 4.0));
+
+  double a[2] = {2.0, -1.0};
+  dense_block<double> c(3, 2, 1.0);
+  c.add_scaled(a, b);
+  REQUIRE(value_equal(c(1, 0), 5.0));
+  REQUIRE(value_equal(c(2, 1), -3.0));
+  c.scale(a);
+  REQUIRE(value_equal(c(2, 1), 3.0));
+
+  dense_vector<double> v = c.get_column_vector(0);
+  REQUIRE(value_equal(v[0], 6.0));
+  c.set_column_vector(1, v);
+  REQUIRE(value_equal(c(2, 1), 2.0));
+
+  std::vector<bool> keep = {false, true};
+  c.compact_columns(keep);
+  REQUIRE(c.get_column() == 1);
+  REQUIRE(value_equal(c(1, 0), 10.0));
+}
+
+TEST_CASE("dense block multiply and retire test", "[dense_block]") {
+  matrix<matrix_storage_cep<double>> A(3, 3);
+  A.set_value(1, 1, 2.0);
+  A.set_value(1, 3, 1.0);
+  A.set_value(2, 2, 3.0);
+  A.set_value(3, 1, -1.0);
+  dense_block<double> X(3, 3);
+  for (size_type i = 0; i < 3; ++i) {
+    for (size_type j = 0; j < 3; ++j) {
+      X(i, j) = (i + 1) * (j + 1);
+    }
+  }
+  dense_block<double> Y(3, 3);
+  matrix_block_multiply(A, X, Y);
+  for (size_type j = 0; j < 3; ++j) {
+    dense_vector<double> y(3);
+    matrix_vector_multiply(A, X.get_column_vector(j), y);
+    for (size_type i = 0; i < 3; ++i) {
+      REQUIRE(value_equal(Y(i, j), y[i]));
+    }
+  }
+
+  dense_block<double> result(3, 3);
+  std::vector<size_type> active = {0, 1, 2};
+  std::vector<bool> keep = {true, false, true};
+  REQUIRE(retire_columns(keep, Y, result, active) == true);
+  REQUIRE(active.size() == 2);
+  REQUIRE(active[1] == 2);
+  REQUIRE(Y.get_column() == 2);
+  REQUIRE(value_equal(result(1, 1), 12.0));
+  REQUIRE(value_equal(Y(1, 1), 18.0));
+  keep = {true, true};
+  REQUIRE(retire_columns(keep, Y, result, active) == false);
+
+  auto m = to_matrix<matrix<matrix_storage_cep<double>>>(result);
+  REQUIRE(m.get_element_count() == 3);
+  auto back = to_dense_block(m);
+  REQUIRE(value_equal(back(1, 1), 12.0));
+}
@@ -0,0 +1,64 @@
+#include "../third_party/catch.hpp"
+#include "../include/dense_vector.h"
+#include "../include/matrix.h"
+#include "../include/matrix_storage_block.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/value_compare.h"
+#include <cstdint>
+
+using namespace pnmatrix;
+
+TEST_CASE("dense vector test", "[dense_vector]") {
+  dense_vector<double> v(4);
+  REQUIRE(v.size() == 4);
+  REQUIRE(v.get_row() == 4);
+  REQUIRE(v.get_column() == 1);
+  REQUIRE(reinterpret_cast<std::uintptr_t>(v.data()) % 64 == 0);
+  for (size_type i = 0; i < 4; ++i) {
+    v[i] = i + 1;
+  }
+  REQUIRE(value_equal(v.get_value(2, 1), 2.0));
+  v.set_value(4, 1, 5.0);
+  REQUIRE(value_equal(v[3], 5.0));
+
+  dense_vector<double> w(4, 1.0);
+  REQUIRE(value_equal(v.inner_product(w), 11.0));
+  w.add_scaled(2.0, v);
+  REQUIRE(value_equal(w[2], 7.0));
+  w.scale(0.5);
+  REQUIRE(value_equal(w[0], 1.5));
+  dense_vector<double> u(2);
+  u[0] = 3.0;
+  u[1] = 4.0;
+  REQUIRE(value_equal(u.get_second_norm(), 5.0));
+  u.resize(3);
+  REQUIRE(value_equal(u[2], 0.0));
+  u.fill(2.0);
+  REQUIRE(value_equal(u[0], 2.0));
+}
+
+TEST_CASE("dense vector matrix interaction test", "[dense_vector]") {
+  matrix<matrix_storage_cep<double>> A(3, 3);
+  A.set_value(1, 1, 2.0);
+  A.set_value(1, 3, 1.0);
+  A.set_value(2, 2, 3.0);
+  A.set_value(3, 1, -1.0);
+  dense_vector<double> x(3);
+  x[0] = 1.0;
+  x[1] = 2.0;
+  x[2] = 3.0;
+  dense_vector<double> y(3);
+  matrix_vector_multiply(A, x, y);
+  REQUIRE(value_equal(y[0], 5.0));
+  REQUIRE(value_equal(y[1], 6.0));
+  REQUIRE(value_equal(y[2], -1.0));
+
+  matrix<matrix_storage_block<double>> b(3, 1);
+  b.set_value(2, 1, 4.0);
+  dense_vector<double> bv = to_dense_vector(b);
+  REQUIRE(value_equal(bv[0], 0.0));
+  REQUIRE(value_equal(bv[1], 4.0));
+  auto sparse_y = to_matrix<matrix<matrix_storage_cep<double>>>(y);
+  REQUIRE(sparse_y.get_element_count() == 3);
+  REQUIRE(value_equal(sparse_y.get_value(3, 1), -1.0));
+}
@@ -0,0 +1,198 @@
+#include "../third_party/catch.hpp"
+#include "../include/communicator.h"
+#include "../include/distributed_matrix.h"
+#include "../include/distributed_solver.h"
+#include "../include/value_compare.h"
+#include "grid_matrix.h"
+#include <vector>
+#include <cmath>
+
+using namespace pnmatrix;
+using distributed_test_matrix = matrix<matrix_storage_cep<double>>;
+
+// catch assertions are not thread safe, the ranks record and the test checks after run().
+
+TEST_CASE("thread world messages and reductions test", "[distributed]") {
+  thread_world world(4);
+  std::vector<size_type> received(4, -1);
+  std::vector<double> sums(4, 0);
+  world.run([&](communicator& comm) {
+    int rank = comm.get_rank();
+    int size = comm.get_size();
+    for (size_type i = 0; i < 3; ++i) {
+      size_type value = rank * 10 + i;
+      comm.send((rank + 1) % size, 7, &value, sizeof(value));
+    }
+    size_type last = -1;
+    for (size_type i = 0; i < 3; ++i) {
+      comm.receive((rank + size - 1) % size, 7, &last, sizeof(last));
+    }
+    received[rank] = last;
+    double v[2] = {double(rank), 1.0};
+    comm.all_reduce_sum(v, 2);
+    comm.barrier();
+    sums[rank] = v[0] * 10 + v[1];
+  });
+  for (int rank = 0; rank < 4; ++rank) {
+    REQUIRE(received[rank] == ((rank + 3) % 4) * 10 + 2);
+    REQUIRE(value_equal(sums[rank], 64.0));
+  }
+}
+
+TEST_CASE("row partition test", "[distributed]") {
+  row_partition p(10, 3);
+  REQUIRE(p.get_row() == 10);
+  REQUIRE(p.get_rank_count() == 3);
+  REQUIRE(p.get_local_row(0) + p.get_local_row(1) + p.get_local_row(2) == 10);
+  for (size_type row = 0; row < 10; ++row) {
+    int owner = p.get_owner(row);
+    REQUIRE(row >= p.get_first_row(owner));
+    REQUIRE(row < p.get_last_row(owner));
+  }
+}
+
+static void distributed_multiply_test(size_type k, const row_partition& partition) {
+  distributed_test_matrix A = grid_matrix(k);
+  size_type n = k * k;
+  dense_vector<double> x(n);
+  for (size_type i = 0; i < n; ++i) {
+    x[i] = std::cos(double(i));
+  }
+  dense_vector<double> expect(n);
+  matrix_vector_multiply(A, x, expect);
+  dense_vector<double> result(n);
+  std::vector<size_type> ghosts(partition.get_rank_count());
+  thread_world world(partition.get_rank_count());
+  world.run([&](communicator& comm) {
+    distributed_matrix<double> dA(comm, partition, get_row_block(A, partition, comm.get_rank()));
+    distributed_vector<double> dx(comm, partition);
+    distributed_vector<double> dy(comm, partition);
+    for (size_type i = 0; i < dx.get_local_size(); ++i) {
+      dx[i] = x[dx.get_first_row() + i];
+    }
+    dA.multiply(dx, dy);
+    dA.multiply(dx, dy);
+    for (size_type i = 0; i < dy.get_local_size(); ++i) {
+      result[dy.get_first_row() + i] = dy[i];
+    }
+    ghosts[comm.get_rank()] = dA.get_ghost_count();
+  });
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(result[i] - expect[i]) < 1e-12);
+  }
+  if (partition.get_rank_count() > 1) {
+    REQUIRE(ghosts[0] > 0);
+    REQUIRE(ghosts[0] <= k);
+  }
+}
+
+TEST_CASE("distributed matrix multiply test", "[distributed]") {
+  distributed_multiply_test(6, row_partition(36, 1));
+  distributed_multiply_test(6, row_partition(36, 4));
+  distributed_multiply_test(7, row_partition(std::vector<size_type>{0, 3, 20, 21, 49}));
+}
+
+template <typename Solver>
+static void distributed_solve_test(typename Solver::option op, int ranks) {
+  size_type k = 10;
+  size_type n = k * k;
+  distributed_test_matrix A = grid_matrix(k);
+  dense_vector<double> expect(n);
+  for (size_type i = 0; i < n; ++i) {
+    expect[i] = std::sin(double(i)) + 1;
+  }
+  dense_vector<double> b(n);
+  matrix_vector_multiply(A, expect, b);
+  row_partition partition(n, ranks);
+  dense_vector<double> result(n);
+  std::vector<solve_status> status(ranks);
+  std::vector<size_type> iterations(ranks);
+  thread_world world(ranks);
+  world.run([&](communicator& comm) {
+    distributed_matrix<double> dA(comm, partition, get_row_block(A, partition, comm.get_rank()));
+    distributed_vector<double> db(comm, partition);
+    distributed_vector<double> dx(comm, partition);
+    for (size_type i = 0; i < db.get_local_size(); ++i) {
+      db[i] = b[db.get_first_row() + i];
+    }
+    solve_control control;
+    Solver(op).solve(dA, db, dx, control);
+    for (size_type i = 0; i < dx.get_local_size(); ++i) {
+      result[dx.get_first_row() + i] = dx[i];
+    }
+    status[comm.get_rank()] = control.get_status();
+    iterations[comm.get_rank()] = control.get_progress().iteration;
+  });
+  for (int rank = 0; rank < ranks; ++rank) {
+    REQUIRE(status[rank] == solve_status::converged);
+    REQUIRE(iterations[rank] == iterations[0]);
+  }
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(result[i] - expect[i]) < 1e-7);
+  }
+}
+
+TEST_CASE("distributed cg and gmres test", "[distributed]") {
+  distributed_cg::option cg_op;
+  cg_op.rm = 1e-10;
+  distributed_solve_test<distributed_cg>(cg_op, 1);
+  distributed_solve_test<distributed_cg>(cg_op, 3);
+  distributed_gmres::option gmres_op;
+  gmres_op.rm = 1e-10;
+  gmres_op.m = 20;
+  distributed_solve_test<distributed_gmres>(gmres_op, 1);
+  distributed_solve_test<distributed_gmres>(gmres_op, 4);
+}
+
+// rank 1 cancels its own solve_control before the solve starts.
+template <typename Solver>
+static std::vector<solve_status> distributed_cancel_run(typename Solver::option op) {
+  size_type k = 8;
+  distributed_test_matrix A = grid_matrix(k);
+  row_partition partition(k * k, 3);
+  std::vector<solve_status> status(3);
+  thread_world world(3);
+  world.run([&](communicator& comm) {
+    distributed_matrix<double> dA(comm, partition, get_row_block(A, partition, comm.get_rank()));
+    distributed_vector<double> db(comm, partition);
+    distributed_vector<double> dx(comm, partition);
+    db.fill(1.0);
+    solve_control control;
+    if (comm.get_rank() == 1) {
+      control.cancel();
+    }
+    Solver(op).solve(dA, db, dx, control);
+    status[comm.get_rank()] = control.get_status();
+  });
+  return status;
+}
+
+template <typename Solver>
+static void distributed_cancel_test(typename Solver::option op) {
+  std::vector<solve_status> status = distributed_cancel_run<Solver>(op);
+  for (int rank = 0; rank < 3; ++rank) {
+    REQUIRE(status[rank] == solve_status::cancelled);
+  }
+}
+
+// the cancel of rank 1 and max_iteration are hit on the same iteration, every rank must still return.
+template <typename Solver>
+static void distributed_cancel_at_max_iteration_test(typename Solver::option op) {
+  op.max_iteration = 1;
+  std::vector<solve_status> status = distributed_cancel_run<Solver>(op);
+  REQUIRE(status[0] == solve_status::max_iteration_reached);
+  REQUIRE(status[1] == solve_status::cancelled);
+  REQUIRE(status[2] == solve_status::max_iteration_reached);
+}
+
+TEST_CASE("distributed solvers stop together test", "[distributed]") {
+  distributed_cg::option cg_op;
+  cg_op.rm = -1;
+  distributed_cancel_test<distributed_cg>(cg_op);
+  distributed_cancel_at_max_iteration_test<distributed_cg>(cg_op);
+  distributed_gmres::option gmres_op;
+  gmres_op.rm = -1;
+  gmres_op.m = 5;
+  distributed_cancel_test<distributed_gmres>(gmres_op);
+  distributed_cancel_at_max_iteration_test<distributed_gmres>(gmres_op);
+}
@@ -0,0 +1,153 @@
+#include "../third_party/catch.hpp"
+#include "../include/executor.h"
+#include "../include/parallel.h"
+#include "../include/dense_vector.h"
+#include "../include/matrix.h"
+#include "../include/matrix_storage_block.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/jacobian_solver.h"
+#include "../include/gmres_solver.h"
+#include "../include/value_compare.h"
+#include <atomic>
+#include <vector>
+
+using namespace pnmatrix;
+
+static thread_pool::option pool_option(size_type n) {
+  thread_pool::option op;
+  op.thread_count = n;
+  return op;
+}
+
+TEST_CASE("thread pool test", "[executor]") {
+  thread_pool pool(pool_option(4));
+  REQUIRE(pool.get_thread_count() == 4);
+
+  SECTION("every task runs once") {
+    std::vector<std::atomic<int>> hits(100);
+    pool.bulk(100, [&](size_type i) {
+      ++hits[i];
+    });
+    for (auto& each : hits) {
+      REQUIRE(each.load() == 1);
+    }
+  }
+
+  SECTION("nested regions run inline") {
+    std::atomic<int> nested_threads_ok(0);
+    pool.bulk(8, [&](size_type) {
+      REQUIRE(executor::in_parallel_region() == true);
+      std::thread::id self = std::this_thread::get_id();
+      bool same = true;
+      pool.bulk(4, [&](size_type) {
+        same = same && std::this_thread::get_id() == self;
+      });
+      if (same) {
+        ++nested_threads_ok;
+      }
+    });
+    REQUIRE(nested_threads_ok.load() == 8);
+    REQUIRE(executor::in_parallel_region() == false);
+  }
+
+  SECTION("parallel for covers the range") {
+    std::vector<int> seen(1000, 0);
+    std::atomic<size_type> max_chunk(0);
+    parallel_for(pool, 0, 1000, [&](size_type t, size_type first, size_type last) {
+      size_type m = max_chunk.load();
+      while (t > m && !max_chunk.compare_exchange_weak(m, t)) {
+      }
+      for (size_type i = first; i < last; ++i) {
+        ++seen[i];
+      }
+    });
+    REQUIRE(max_chunk.load() < 4);
+    for (int each : seen) {
+      REQUIRE(each == 1);
+    }
+  }
+}
+
+TEST_CASE("executor kernels test", "[executor]") {
+  thread_pool pool(pool_option(3));
+  const size_type n = 50;
+  matrix<matrix_storage_cep<double>> A(n, n);
+  matrix<matrix_storage_block<double>> D(n, n);
+  for (size_type i = 1; i <= n; ++i) {
+    A.set_value(i, i, 4.0);
+    D.set_value(i, i, 4.0);
+    if (i > 1) {
+      A.set_value(i, i - 1, -1.0);
+      D.set_value(i, i - 1, -1.0);
+    }
+    if (i < n) {
+      A.set_value(i, i + 1, -1.0);
+      D.set_value(i, i + 1, -1.0);
+    }
+  }
+  dense_vector<double> x(n);
+  for (size_type i = 0; i < n; ++i) {
+    x[i] = i * 0.5;
+  }
+
+  dense_vector<double> y(n);
+  dense_vector<double> y_pool(n);
+  matrix_vector_multiply(A, x, y);
+  matrix_vector_multiply(pool, A, x, y_pool);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(value_equal(y[i], y_pool[i]));
+  }
+  matrix_vector_multiply(pool, D, x, y_pool);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(value_equal(y[i], y_pool[i]));
+  }
+
+  REQUIRE(value_equal(inner_product(pool, x, y), x.inner_product(y)));
+  add_scaled(pool, y_pool, 2.0, x);
+  REQUIRE(value_equal(y_pool[7], y[7] + 7.0));
+
+  matrix<matrix_storage_block<double>> sum(1, 1);
+  evaluate(pool, D + D * 2.0, sum);
+  REQUIRE(sum.get_row() == n);
+  REQUIRE(value_equal(sum.get_value(3, 3), 12.0));
+  REQUIRE(value_equal(sum.get_value(3, 4), -3.0));
+}
+
+TEST_CASE("solvers on a thread pool test", "[executor]") {
+  thread_pool pool(pool_option(3));
+  const size_type n = 40;
+  matrix<matrix_storage_cep<double>> A(n, n);
+  matrix<matrix_storage_cep<double>> b(n, 1);
+  for (size_type i = 1; i <= n; ++i) {
+    A.set_value(i, i, 4.0);
+    if (i > 1) {
+      A.set_value(i, i - 1, -1.0);
+    }
+    if (i < n) {
+      A.set_value(i, i + 1, -1.0);
+    }
+  }
+  for (size_type i = 1; i <= n; ++i) {
+    double sum = 4.0 * i;
+    if (i > 1) {
+      sum -= i - 1;
+    }
+    if (i < n) {
+      sum -= i + 1;
+    }
+    b.set_value(i, 1, sum);
+  }
+
+  jacobian::option jop;
+  jop.exec = &pool;
+  auto xj = jacobian(jop).solve(A, b);
+  gmres::option gop;
+  gop.exec = &pool;
+  gop.rm = 1e-10;
+  gop.m = 10;
+  auto xg = gmres(gop).solve(A, b);
+  for (size_type i = 1; i <= n; ++i) {
+    REQUIRE(std::abs(xj.get_value(i, 1) - double(i)) < 1e-5);
+    REQUIRE(std::abs(xg.get_value(i, 1) - double(i)) < 1e-5);
+  }
+}
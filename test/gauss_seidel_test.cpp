@@ -57,3 +57,43 @@ TEST_CASE( "guass seidel block test", "[calculate]") {
   REQUIRE(value_equal(x.get_value(2, 1), 2.0));
   REQUIRE(value_equal(x.get_value(3, 1), 1.0));
 }
+
+TEST_CASE( "guass seidel multiple right hand sides test", "[calculate]") {
+  using matrix_type = matrix<matrix_storage_cep<double>>;
+  matrix_type m(3, 3);
+  m.set_value(1, 1, 8);
+  m.set_value(1, 2, -3);
+  m.set_value(1, 3, 2);
+  m.set_value(2, 1, 4);
+  m.set_value(2, 2, 11);
+  m.set_value(2, 3, -1);
+  m.set_value(3, 1, 6);
+  m.set_value(3, 2, 3);
+  m.set_value(3, 3, 12);
+  matrix_type b(3, 3);
+  b.set_value(1, 1, 20);
+  b.set_value(2, 1, 33);
+  b.set_value(3, 1, 36);
+  b.set_value(1, 2, 7);
+  b.set_value(2, 2, 14);
+  b.set_value(3, 2, 21);
+  b.set_value(1, 3, 40);
+  b.set_value(2, 3, 66);
+  b.set_value(3, 3, 72);
+
+  gauss_seidel::option op;
+  op.rm = 1e-6;
+  gauss_seidel solver(op);
+  auto x = solver.solve(m, b);
+  REQUIRE(x.get_row() == 3);
+  REQUIRE(x.get_column() == 3);
+  REQUIRE(value_equal(x.get_value(1, 1), 3.0));
+  REQUIRE(value_equal(x.get_value(2, 1), 2.0));
+  REQUIRE(value_equal(x.get_value(3, 1), 1.0));
+  REQUIRE(value_equal(x.get_value(1, 2), 1.0));
+  REQUIRE(value_equal(x.get_value(2, 2), 1.0));
+  REQUIRE(value_equal(x.get_value(3, 2), 1.0));
+  REQUIRE(value_equal(x.get_value(1, 3), 6.0));
+  REQUIRE(value_equal(x.get_value(2, 3), 4.0));
+  REQUIRE(value_equal(x.get_value(3, 3), 2.0));
+}
@@ -0,0 +1,143 @@
+#include "../third_party/catch.hpp"
+#include "../include/geometric_multigrid.h"
+#include "../include/gmres_solver.h"
+#include "../include/executor.h"
+#include "../include/value_compare.h"
+#include <cmath>
+
+using namespace pnmatrix;
+
+TEST_CASE("grid operator multiply and assemble test", "[geometric_multigrid]") {
+  for (size_type nz : {1, 3}) {
+    grid_operator<double> A = grid_operator<double>::laplacian(5, 4, nz, 0.5);
+    matrix<matrix_storage_cep<double>> m = A.assemble();
+    REQUIRE(m.get_row() == A.size());
+    dense_vector<double> u(A.size());
+    for (size_type i = 0; i < A.size(); ++i) {
+      u[i] = std::cos(double(i));
+    }
+    dense_vector<double> expect(A.size());
+    matrix_vector_multiply(m, u, expect);
+    dense_vector<double> result(A.size());
+    A.multiply(get_inline_executor(), u.data(), result.data());
+    for (size_type i = 0; i < A.size(); ++i) {
+      REQUIRE(std::abs(result[i] - expect[i]) < 1e-12);
+    }
+  }
+  grid_operator<double> B = grid_operator<double>::laplacian(7, 7);
+  REQUIRE(B.can_coarsen() == true);
+  grid_operator<double> C = B.coarsen();
+  REQUIRE(C.get_nx() == 3);
+  REQUIRE(C.get_nz() == 1);
+  REQUIRE(value_equal(C.get_center(), 1.0));
+  REQUIRE(grid_operator<double>::laplacian(6, 7).coarsen().get_nx() == 2);
+  REQUIRE(grid_operator<double>::laplacian(2, 7).can_coarsen() == false);
+}
+
+static size_type multigrid_iterations(const grid_operator<double>& A, geometric_multigrid<double>::option op) {
+  size_type n = A.size();
+  dense_vector<double> expect(n);
+  for (size_type i = 0; i < n; ++i) {
+    expect[i] = std::sin(double(i) * 0.13) + 1;
+  }
+  dense_vector<double> b(n);
+  A.multiply(get_inline_executor(), expect.data(), b.data());
+  op.rm = 1e-9;
+  geometric_multigrid<double> mg(A, op);
+  REQUIRE(mg.get_level_count() > 1);
+  dense_vector<double> x(n);
+  solve_control control;
+  mg.solve(b, x, control);
+  REQUIRE(control.get_status() == solve_status::converged);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(x[i] - expect[i]) < 1e-6);
+  }
+  return control.get_progress().iteration;
+}
+
+TEST_CASE("geometric multigrid iteration counts do not grow with the mesh test", "[geometric_multigrid]") {
+  geometric_multigrid<double>::option op;
+  op.coarse_size = 50;
+  for (multigrid_cycle cycle : {multigrid_cycle::v, multigrid_cycle::w, multigrid_cycle::f}) {
+    op.cycle = cycle;
+    size_type small = multigrid_iterations(grid_operator<double>::laplacian(31, 31, 1, 1.0 / 32), op);
+    size_type large = multigrid_iterations(grid_operator<double>::laplacian(127, 127, 1, 1.0 / 128), op);
+    REQUIRE(large <= 12);
+    REQUIRE(large <= small + 1);
+  }
+  op.cycle = multigrid_cycle::v;
+  size_type small = multigrid_iterations(grid_operator<double>::laplacian(7, 7, 7), op);
+  size_type large = multigrid_iterations(grid_operator<double>::laplacian(31, 31, 31), op);
+  REQUIRE(large <= 12);
+  REQUIRE(large <= small + 1);
+}
+
+TEST_CASE("geometric multigrid on even grids test", "[geometric_multigrid]") {
+  geometric_multigrid<double>::option op;
+  op.coarse_size = 50;
+  // the even axes coarsen all the way down and the iteration counts stay flat.
+  grid_operator<double> small = grid_operator<double>::laplacian(64, 64, 1, 1.0 / 65);
+  grid_operator<double> large = grid_operator<double>::laplacian(128, 128, 1, 1.0 / 129);
+  REQUIRE(geometric_multigrid<double>(large, op).get_level_count() == 5);
+  size_type small_iterations = multigrid_iterations(small, op);
+  size_type large_iterations = multigrid_iterations(large, op);
+  REQUIRE(large_iterations <= 16);
+  REQUIRE(large_iterations <= small_iterations + 1);
+  REQUIRE(multigrid_iterations(grid_operator<double>::laplacian(30, 24, 20), op) <= 20);
+  REQUIRE_THROWS_AS(geometric_multigrid<double>(grid_operator<double>::laplacian(400, 2, 2), op), std::invalid_argument);
+}
+
+TEST_CASE("geometric multigrid zero right hand side test", "[geometric_multigrid]") {
+  grid_operator<double> A = grid_operator<double>::laplacian(15, 15);
+  geometric_multigrid<double> mg(A);
+  dense_vector<double> b(A.size());
+  dense_vector<double> x(A.size(), 1.0);
+  solve_control control;
+  mg.solve(b, x, control);
+  REQUIRE(control.get_status() == solve_status::converged);
+  for (size_type i = 0; i < A.size(); ++i) {
+    REQUIRE(value_equal(x[i], 0.0));
+  }
+}
+
+TEST_CASE("geometric multigrid on an executor test", "[geometric_multigrid]") {
+  thread_pool::option pool_op;
+  pool_op.thread_count = 3;
+  thread_pool pool(pool_op);
+  grid_operator<double> A = grid_operator<double>::laplacian(31, 31, 15);
+  geometric_multigrid<double>::option op;
+  geometric_multigrid<double> serial(A, op);
+  op.exec = &pool;
+  geometric_multigrid<double> threaded(A, op);
+  dense_vector<double> r(A.size());
+  for (size_type i = 0; i < A.size(); ++i) {
+    r[i] = double(i % 13);
+  }
+  dense_vector<double> z1(A.size());
+  dense_vector<double> z2(A.size());
+  serial.apply(r.data(), z1.data());
+  threaded.apply(r.data(), z2.data());
+  for (size_type i = 0; i < A.size(); ++i) {
+    REQUIRE(value_equal(z1[i], z2[i]));
+  }
+}
+
+TEST_CASE("gmres with a geometric multigrid preconditioner test", "[geometric_multigrid]") {
+  grid_operator<double> A = grid_operator<double>::laplacian(63, 63);
+  matrix<matrix_storage_cep<double>> m = A.assemble();
+  geometric_multigrid<double> M(A);
+  dense_vector<double> b(A.size(), 1.0);
+  dense_vector<double> x(A.size());
+  gmres::option op;
+  op.rm = 1e-10;
+  gmres::workspace<double> ws;
+  solve_control control;
+  gmres(op).solve(m, b, x, control, ws, M);
+  REQUIRE(control.get_status() == solve_status::converged);
+  REQUIRE(control.get_progress().iteration <= 10);
+  dense_vector<double> ax(A.size());
+  matrix_vector_multiply(m, x, ax);
+  for (size_type i = 0; i < A.size(); ++i) {
+    REQUIRE(std::abs(ax[i] - 1.0) < 1e-8);
+  }
+}
@@ -58,3 +58,49 @@ TEST_CASE("gmres block test", "[calculate]") {
   REQUIRE(value_equal(x.get_value(2, 1), 2.0));
   REQUIRE(value_equal(x.get_value(3, 1), 3.0));
 }
+
+TEST_CASE( "gmres multiple right hand sides test", "[calculate]") {
+  using matrix_type = matrix<matrix_storage_cep<double>>;
+  matrix_type m(3, 3);
+  m.set_value(1, 1, 1);
+  m.set_value(1, 2, 1);
+  m.set_value(1, 3, 1);
+  m.set_value(2, 2, 4);
+  m.set_value(2, 3, -1);
+  m.set_value(3, 1, 2);
+  m.set_value(3, 2, -2);
+  m.set_value(3, 3, 1);
+  matrix_type b(3, 4);
+  b.set_value(1, 1, 6);
+  b.set_value(2, 1, 5);
+  b.set_value(3, 1, 1);
+  b.set_value(1, 2, 1);
+  b.set_value(2, 2, 0);
+  b.set_value(3, 2, 2);
+  b.set_value(1, 3, 12);
+  b.set_value(2, 3, 10);
+  b.set_value(3, 3, 2);
+  b.set_value(1, 4, 1);
+  b.set_value(2, 4, 4);
+  b.set_value(3, 4, -2);
+
+  gmres::option op;
+  op.rm = 1e-6;
+  op.m = 140;
+  gmres solver(op);
+  auto x = solver.solve(m, b);
+  REQUIRE(x.get_row() == 3);
+  REQUIRE(x.get_column() == 4);
+  REQUIRE(value_equal(x.get_value(1, 1), 1.0));
+  REQUIRE(value_equal(x.get_value(2, 1), 2.0));
+  REQUIRE(value_equal(x.get_value(3, 1), 3.0));
+  REQUIRE(value_equal(x.get_value(1, 2), 1.0));
+  REQUIRE(value_equal(x.get_value(2, 2), 0.0));
+  REQUIRE(value_equal(x.get_value(3, 2), 0.0));
+  REQUIRE(value_equal(x.get_value(1, 3), 2.0));
+  REQUIRE(value_equal(x.get_value(2, 3), 4.0));
+  REQUIRE(value_equal(x.get_value(3, 3), 6.0));
+  REQUIRE(value_equal(x.get_value(1, 4), 0.0));
+  REQUIRE(value_equal(x.get_value(2, 4), 1.0));
+  REQUIRE(value_equal(x.get_value(3, 4), 0.0));
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix.h"
+#include <vector>
+
+namespace pnmatrix {
+// 5 point laplacian of a k x k grid with dirichlet boundaries, center on the diagonal and -1 to
+// the neighbours. grid point y * k + x is row number[y * k + x], rows are numbered along x
+// when number is empty.
+inline matrix<matrix_storage_cep<double>> grid_matrix(size_type k, double center = 4, const std::vector<size_type>& number = {}) {
+  auto vertex = [&](size_type x, size_type y) {
+    return number.empty() == true ? y * k + x + 1 : number[y * k + x];
+  };
+  matrix<matrix_storage_cep<double>> m(k * k, k * k);
+  for (size_type y = 0; y < k; ++y) {
+    for (size_type x = 0; x < k; ++x) {
+      size_type v = vertex(x, y);
+      m.set_value(v, v, center);
+      if (x > 0) {
+        m.set_value(v, vertex(x - 1, y), -1);
+      }
+      if (x + 1 < k) {
+        m.set_value(v, vertex(x + 1, y), -1);
+      }
+      if (y > 0) {
+        m.set_value(v, vertex(x, y - 1), -1);
+      }
+      if (y + 1 < k) {
+        m.set_value(v, vertex(x, y + 1), -1);
+      }
+    }
+  }
+  return m;
+}
+}
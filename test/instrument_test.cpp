@@ -0,0 +1,91 @@
+#include "../third_party/catch.hpp"
+#include "../include/instrument.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/value_compare.h"
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace pnmatrix;
+
+TEST_CASE("instrument counter and timer test", "[instrument]") {
+  instrument::registry& r = instrument::registry::get();
+  r.reset();
+  instrument::counter& c = r.get_counter("test.counter");
+  REQUIRE(&c == &r.get_counter("test.counter"));
+  c.add(3);
+  c.add(4);
+  REQUIRE(r.get_counter_value("test.counter") == 7);
+
+  instrument::timer& t = r.get_timer("test.timer");
+  {
+    instrument::scoped_timer scope(t);
+  }
+  std::thread other([&t]() {
+    instrument::scoped_timer scope(t);
+  });
+  other.join();
+  REQUIRE(t.get_calls() == 2);
+
+  r.reset();
+  REQUIRE(c.get() == 0);
+  REQUIRE(t.get_calls() == 0);
+}
+
+TEST_CASE("instrument export test", "[instrument]") {
+  instrument::registry& r = instrument::registry::get();
+  r.reset();
+  r.get_counter("test.export").add(5);
+  {
+    instrument::scoped_timer scope(r.get_timer("test.export_timer"));
+  }
+
+  std::ostringstream json;
+  r.write_json(json);
+  std::string s = json.str();
+  REQUIRE(s.find("\"counters\": {") != std::string::npos);
+  REQUIRE(s.find("\"test.export\": 5") != std::string::npos);
+  REQUIRE(s.find("\"test.export_timer\": {\"calls\": 1") != std::string::npos);
+  REQUIRE(s.find("\"dropped_events\": 0") != std::string::npos);
+
+  std::ostringstream trace;
+  r.write_chrome_trace(trace);
+  s = trace.str();
+  REQUIRE(s.find("{\"traceEvents\": [") == 0);
+  REQUIRE(s.find("\"name\": \"test.export_timer\"") != std::string::npos);
+  REQUIRE(s.find("\"ph\": \"X\"") != std::string::npos);
+
+  r.set_event_limit(0);
+  {
+    instrument::scoped_timer scope(r.get_timer("test.export_timer"));
+  }
+  r.set_event_limit(instrument::registry::default_event_limit);
+  std::ostringstream dropped;
+  r.write_json(dropped);
+  REQUIRE(dropped.str().find("\"dropped_events\": 1") != std::string::npos);
+  r.reset();
+}
+
+#ifdef PNMATRIX_INSTRUMENT
+TEST_CASE("instrument cep storage counters test", "[instrument]") {
+  instrument::registry& r = instrument::registry::get();
+  r.reset();
+  matrix_storage_cep<double> m(3, 3);
+  m.set_value(1, 1, 1.0);
+  m.set_value(1, 3, 3.0);
+  m.set_value(1, 2, 2.0);
+  m.set_value(1, 2, 2.5);
+  REQUIRE(r.get_counter_value("cep.set_value.append") == 2);
+  REQUIRE(r.get_counter_value("cep.set_value.sort") == 1);
+  REQUIRE(r.get_counter_value("cep.set_value.update") == 1);
+  REQUIRE(value_equal(m.get_value(1, 3), 3.0));
+  REQUIRE(value_equal(m.get_value(2, 3), 0.0));
+  REQUIRE(r.get_counter_value("cep.get_value") == 2);
+  REQUIRE(r.get_counter_value("cep.get_value.scanned") == 3);
+#ifdef DELETE_ZERO
+  m.set_value(1, 1, 0.0);
+  REQUIRE(r.get_counter_value("cep.set_value.erase_zero") == 1);
+#endif
+  r.reset();
+}
+#endif
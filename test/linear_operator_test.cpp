@@ -0,0 +1,129 @@
+#include "../third_party/catch.hpp"
+#include "../include/linear_operator.h"
+#include "../include/gmres_solver.h"
+#include "../include/jacobian_solver.h"
+#include "../include/geometric_multigrid.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/value_compare.h"
+#include <cmath>
+
+using namespace pnmatrix;
+
+static_assert(is_linear_operator<matrix_operator<matrix<matrix_storage_cep<double>>>>::value, "");
+static_assert(is_linear_operator<grid_operator<double>>::value, "");
+static_assert(is_linear_operator<matrix<matrix_storage_cep<double>>>::value == false, "");
+static_assert(has_diagonal<grid_operator<double>>::value, "");
+
+// 1d stencil [-1 3 -1] of size n, never assembled.
+static auto tridiagonal_operator(size_type n) {
+  return make_operator<double>(n, n, [n](const double* x, double* y) {
+    for (size_type i = 0; i < n; ++i) {
+      double v = 3 * x[i];
+      if (i > 0) {
+        v -= x[i - 1];
+      }
+      if (i + 1 < n) {
+        v -= x[i + 1];
+      }
+      y[i] = v;
+    }
+  }, [n](double* d) {
+    std::fill(d, d + n, 3.0);
+  });
+}
+
+static matrix<matrix_storage_cep<double>> tridiagonal_matrix(size_type n) {
+  matrix<matrix_storage_cep<double>> m(n, n);
+  for (size_type i = 1; i <= n; ++i) {
+    m.set_value(i, i, 3);
+    if (i > 1) {
+      m.set_value(i, i - 1, -1);
+    }
+    if (i < n) {
+      m.set_value(i, i + 1, -1);
+    }
+  }
+  return m;
+}
+
+TEST_CASE("gmres on a function operator test", "[linear_operator]") {
+  size_type n = 200;
+  auto A = tridiagonal_operator(n);
+  matrix<matrix_storage_cep<double>> m = tridiagonal_matrix(n);
+  dense_vector<double> b(n);
+  for (size_type i = 0; i < n; ++i) {
+    b[i] = std::sin(double(i));
+  }
+  gmres::option op;
+  op.rm = 1e-10;
+  gmres::workspace<double> ws;
+  dense_vector<double> x1(n);
+  solve_control c1;
+  gmres(op).solve(A, b, x1, c1, ws);
+  dense_vector<double> x2(n);
+  solve_control c2;
+  gmres(op).solve(m, b, x2, c2, ws);
+  REQUIRE(c1.get_status() == solve_status::converged);
+  REQUIRE(c1.get_progress().iteration == c2.get_progress().iteration);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(x1[i] - x2[i]) < 1e-12);
+  }
+}
+
+TEST_CASE("jacobian on a function operator test", "[linear_operator]") {
+  size_type n = 50;
+  auto A = tridiagonal_operator(n);
+  dense_vector<double> expect(n);
+  for (size_type i = 0; i < n; ++i) {
+    expect[i] = double(i % 7);
+  }
+  dense_vector<double> b(n);
+  A.apply(expect, b);
+  jacobian::option op;
+  op.rm = 1e-10;
+  jacobian::workspace<double> ws;
+  dense_vector<double> x(n);
+  solve_control control;
+  jacobian(op).solve(A, b, x, control, ws);
+  REQUIRE(control.get_status() == solve_status::converged);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(x[i] - expect[i]) < 1e-8);
+  }
+}
+
+TEST_CASE("matrix operator adapter test", "[linear_operator]") {
+  matrix<matrix_storage_cep<double>> m = tridiagonal_matrix(5);
+  auto A = make_operator(m);
+  REQUIRE(A.get_row() == 5);
+  REQUIRE(A.get_column() == 5);
+  dense_vector<double> d(5);
+  A.get_diagonal(d.data());
+  for (size_type i = 0; i < 5; ++i) {
+    REQUIRE(value_equal(d[i], 3.0));
+  }
+  dense_vector<double> x(5, 1.0);
+  dense_vector<double> y(5);
+  A.apply(x, y);
+  REQUIRE(value_equal(y[0], 2.0));
+  REQUIRE(value_equal(y[2], 1.0));
+  REQUIRE(value_equal(y[4], 2.0));
+}
+
+TEST_CASE("matrix free gmres with a geometric multigrid preconditioner test", "[linear_operator]") {
+  grid_operator<double> A = grid_operator<double>::laplacian(63, 63);
+  geometric_multigrid<double> M(A);
+  dense_vector<double> b(A.size(), 1.0);
+  dense_vector<double> x(A.size());
+  gmres::option op;
+  op.rm = 1e-10;
+  gmres::workspace<double> ws;
+  solve_control control;
+  gmres(op).solve(A, b, x, control, ws, M);
+  REQUIRE(control.get_status() == solve_status::converged);
+  REQUIRE(control.get_progress().iteration <= 10);
+  dense_vector<double> ax(A.size());
+  A.apply(x, ax);
+  for (size_type i = 0; i < A.size(); ++i) {
+    REQUIRE(std::abs(ax[i] - 1.0) < 1e-8);
+  }
+}
@@ -0,0 +1,136 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix.h"
+#include "../include/matrix_storage_block.h"
+#include "../include/dense_vector.h"
+#include "../include/value_compare.h"
+
+using namespace pnmatrix;
+
+template <typename MatrixType>
+static MatrixType layout_test_matrix(size_type row, size_type column) {
+  MatrixType m(row, column);
+  for (size_type i = 1; i <= row; ++i) {
+    for (size_type j = 1; j <= column; ++j) {
+      m.set_value(i, j, i * 10 + j);
+    }
+  }
+  return m;
+}
+
+template <typename MatrixType>
+static void check_layout() {
+  auto m = layout_test_matrix<MatrixType>(5, 7);
+  auto expect = layout_test_matrix<matrix<matrix_storage_block<double>>>(5, 7);
+  for (size_type i = 1; i <= 5; ++i) {
+    for (size_type j = 1; j <= 7; ++j) {
+      REQUIRE(value_equal(m.get_value(i, j), expect.get_value(i, j)));
+    }
+  }
+
+  double sum = 0;
+  size_type count = 0;
+  for (auto row = m.begin(); row != m.end(); ++row) {
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      REQUIRE(value_equal(*col, double(row.row_index() * 10 + col.column_index())));
+      sum += *col;
+      ++count;
+    }
+  }
+  REQUIRE(count == 35);
+
+  dense_vector<double> x(7);
+  for (size_type j = 0; j < 7; ++j) {
+    x[j] = j + 1;
+  }
+  dense_vector<double> y(5);
+  dense_vector<double> y_expect(5);
+  matrix_vector_multiply(m, x, y);
+  matrix_vector_multiply(expect, x, y_expect);
+  for (size_type i = 0; i < 5; ++i) {
+    REQUIRE(value_equal(y[i], y_expect[i]));
+  }
+
+  MatrixType t = tr(m);
+  REQUIRE(value_equal(t.get_value(7, 2), 27.0));
+  MatrixType p = m * t;
+  matrix<matrix_storage_block<double>> p_expect = expect * tr(expect);
+  REQUIRE(value_equal(p.get_value(3, 4), p_expect.get_value(3, 4)));
+
+  MatrixType s = m.get_sub_matrix(2, 3, 3, 4);
+  REQUIRE(s.get_row() == 3);
+  REQUIRE(s.get_column() == 4);
+  for (size_type i = 1; i <= 3; ++i) {
+    for (size_type j = 1; j <= 4; ++j) {
+      REQUIRE(value_equal(s.get_value(i, j), double((i + 1) * 10 + j + 2)));
+    }
+  }
+
+  m.delete_row(2);
+  m.delete_column(3);
+  REQUIRE(m.get_row() == 4);
+  REQUIRE(m.get_column() == 6);
+  REQUIRE(value_equal(m.get_value(2, 3), 34.0));
+  REQUIRE(value_equal(m.get_value(4, 6), 57.0));
+  for (size_type i = 1; i <= 4; ++i) {
+    for (size_type j = 1; j <= 6; ++j) {
+      REQUIRE(value_equal(m.get_value(i, j), double((i < 2 ? i : i + 1) * 10 + (j < 3 ? j : j + 1))));
+    }
+  }
+  m.resize(9, 9);
+  REQUIRE(value_equal(m.get_value(4, 6), 57.0));
+  REQUIRE(value_equal(m.get_value(4, 7), 0.0));
+  REQUIRE(value_equal(m.get_value(9, 1), 0.0));
+}
+
+TEST_CASE("matrix storage block layout test", "[matrix_container]") {
+  SECTION("row major") {
+    check_layout<matrix<matrix_storage_block<double, row_major>>>();
+  }
+
+  SECTION("column major") {
+    check_layout<column_major_matrix<double>>();
+  }
+
+  SECTION("tiled") {
+    check_layout<tiled_matrix<double, 4>>();
+  }
+}
+
+TEST_CASE("matrix storage block layout placement test", "[matrix_container]") {
+  column_major_matrix<double> c(3, 4);
+  c.set_value(2, 3, 1.5);
+  REQUIRE(c.get_container().get_row_stride() == 1);
+  REQUIRE(c.get_container().get_column_stride() == 3);
+  REQUIRE(value_equal(c.get_container().data()[2 * 3 + 1], 1.5));
+  auto column = c.get_nth_column_view(3);
+  REQUIRE(value_equal(column.get_value(2, 1), 1.5));
+
+  tiled_matrix<double, 4> t(5, 6);
+  REQUIRE(t.get_container().get_row_capacity() == 8);
+  REQUIRE(t.get_container().get_column_capacity() == 8);
+  t.set_value(5, 6, 2.5);
+  // the second tile row starts after two 4 x 4 tiles.
+  REQUIRE(value_equal(t.get_container().data()[2 * 16 + 16 + 1], 2.5));
+}
+
+TEST_CASE("matrix storage block layout iterator test", "[matrix_container]") {
+  // the iterators step through the tiles without get_index, cross several tile columns.
+  auto t = layout_test_matrix<tiled_matrix<double, 4>>(6, 13);
+  const auto& ct = t;
+  for (auto row = ct.begin(); row != ct.end(); ++row) {
+    size_type column = 0;
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      REQUIRE(col.column_index() == ++column);
+      REQUIRE(value_equal(*col, double(row.row_index() * 10 + column)));
+    }
+    REQUIRE(column == 13);
+  }
+  auto c = layout_test_matrix<column_major_matrix<double>>(6, 13);
+  for (auto row = c.begin(); row != c.end(); ++row) {
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      *col += 1;
+    }
+  }
+  REQUIRE(value_equal(c.get_value(6, 13), 74.0));
+  REQUIRE(value_equal(c.get_value(1, 1), 12.0));
+}
@@ -0,0 +1,79 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix_storage_banded.h"
+#include "../include/dense_vector.h"
+#include "../include/executor.h"
+#include "../include/value_compare.h"
+#include <cmath>
+
+using namespace pnmatrix;
+
+TEST_CASE("matrix storage banded set and get test", "[matrix_container]") {
+  banded_matrix<double> m(5, 5);
+  REQUIRE(m.get_container().get_lower_bandwidth() == 0);
+  REQUIRE(m.get_element_count() == 5);
+  m.set_value(3, 3, 2.0);
+  m.set_value(2, 3, -1.0);
+  m.set_value(5, 3, 4.0);
+  m.set_value(1, 5, 0.0);
+  REQUIRE(m.get_container().get_lower_bandwidth() == 2);
+  REQUIRE(m.get_container().get_upper_bandwidth() == 1);
+  REQUIRE(value_equal(m.get_value(3, 3), 2.0));
+  REQUIRE(value_equal(m.get_value(2, 3), -1.0));
+  REQUIRE(value_equal(m.get_value(5, 3), 4.0));
+  REQUIRE(value_equal(m.get_value(1, 5), 0.0));
+  m.add_value(3, 3, 1.0);
+  REQUIRE(value_equal(m.get_value(3, 3), 3.0));
+  REQUIRE(m.get_nth_row_size(1) == 2);
+  REQUIRE(m.get_nth_row_size(3) == 4);
+  REQUIRE(m.get_nth_row_size(5) == 3);
+  REQUIRE(m.get_element_count() == 2 + 3 + 4 + 4 + 3);
+
+  std::vector<size_type> columns;
+  for (auto row = m.begin(); row != m.end(); ++row) {
+    if (row.row_index() == 5) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        columns.push_back(col.column_index());
+      }
+    }
+  }
+  REQUIRE(columns == std::vector<size_type>{3, 4, 5});
+}
+
+TEST_CASE("matrix storage banded conversion and spmv test", "[matrix_container]") {
+  thread_pool::option pool_op;
+  pool_op.thread_count = 3;
+  thread_pool pool(pool_op);
+  size_type n = 300;
+  matrix<matrix_storage_cep<double>> m(n, n + 2);
+  for (size_type i = 1; i <= n; ++i) {
+    for (size_type j = std::max<size_type>(1, i - 2); j <= std::min(n + 2, i + 3); ++j) {
+      m.set_value(i, j, std::sin(double(i * 7 + j)));
+    }
+  }
+  banded_matrix<double> b = to_banded_matrix(m);
+  REQUIRE(b.get_container().get_lower_bandwidth() == 2);
+  REQUIRE(b.get_container().get_upper_bandwidth() == 3);
+  REQUIRE(b.get_element_count() == m.get_element_count());
+  bool e = (b == to_banded_matrix(m));
+  REQUIRE(e == true);
+  for (size_type i = 1; i <= n; i += 7) {
+    for (size_type j = 1; j <= n + 2; ++j) {
+      REQUIRE(value_equal(b.get_value(i, j), m.get_value(i, j)));
+    }
+  }
+  dense_vector<double> x(n + 2);
+  for (size_type i = 0; i < x.size(); ++i) {
+    x[i] = double(i % 11) - 5;
+  }
+  dense_vector<double> expect(n);
+  matrix_vector_multiply(m, x, expect);
+  dense_vector<double> y(n);
+  matrix_vector_multiply(b, x, y);
+  dense_vector<double> yt(n);
+  matrix_vector_multiply(pool, b, x, yt);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(y[i] - expect[i]) < 1e-12);
+    REQUIRE(value_equal(y[i], yt[i]));
+  }
+}
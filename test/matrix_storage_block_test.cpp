@@ -93,6 +93,55 @@ TEST_CASE("matrix storage block resize test","[matrix_container]") {
   }
 }
 
+TEST_CASE("matrix storage block capacity test","[matrix_container]") {
+  matrix_storage_block<double> m1(2, 2);
+  m1.set_value(1, 1, 1.5);
+  m1.set_value(2, 2, 2.5);
+  m1.reserve(8, 6);
+  REQUIRE(m1.get_row() == 2);
+  REQUIRE(m1.get_column() == 2);
+  REQUIRE(m1.get_row_capacity() == 8);
+  REQUIRE(m1.get_column_capacity() == 6);
+  REQUIRE(value_equal(m1.get_value(2, 2), 2.5));
+
+  SECTION("grow within capacity") {
+    const double* p = m1.data();
+    m1.resize(5, 4);
+    REQUIRE(m1.data() == p);
+    REQUIRE(value_equal(m1.get_value(1, 1), 1.5));
+    REQUIRE(value_equal(m1.get_value(2, 2), 2.5));
+    REQUIRE(value_equal(m1.get_value(5, 4), 0.0));
+  }
+
+  SECTION("shrink then grow clears the old values") {
+    m1.resize(1, 1);
+    m1.resize(2, 2);
+    REQUIRE(m1.get_row_capacity() == 8);
+    REQUIRE(value_equal(m1.get_value(1, 1), 1.5));
+    REQUIRE(value_equal(m1.get_value(2, 2), 0.0));
+  }
+
+  SECTION("grow beyond capacity") {
+    m1.resize(9, 3);
+    REQUIRE(m1.get_row_capacity() >= 9);
+    REQUIRE(value_equal(m1.get_value(2, 2), 2.5));
+    REQUIRE(value_equal(m1.get_value(9, 3), 0.0));
+  }
+
+  SECTION("trailing delete keeps the storage") {
+    m1.resize(3, 3);
+    m1.set_value(3, 3, 3.5);
+    m1.set_value(2, 3, 4.5);
+    m1.delete_row(3);
+    m1.delete_column(1);
+    REQUIRE(m1.get_row() == 2);
+    REQUIRE(m1.get_column() == 2);
+    REQUIRE(m1.get_row_stride() == 6);
+    REQUIRE(value_equal(m1.get_value(2, 1), 2.5));
+    REQUIRE(value_equal(m1.get_value(2, 2), 4.5));
+  }
+}
+
 TEST_CASE("matrix storage block iterator test", "[matrix_container]") {
   matrix_storage_block<double> m1(4, 4);
   std::vector<double> nodes;
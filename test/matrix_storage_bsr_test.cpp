@@ -0,0 +1,193 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_bsr.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix.h"
+#include "../include/value_compare.h"
+#include <vector>
+
+using namespace pnmatrix;
+
+// block tridiagonal test matrix with 2x2 blocks, the last block row is padded.
+template <typename MatrixType>
+static MatrixType bsr_test_matrix(size_type n) {
+  MatrixType m(n, n);
+  for (size_type i = 1; i <= n; ++i) {
+    m.set_value(i, i, 6.0 + i * 0.1);
+    if (i % 2 == 1 && i + 1 <= n) {
+      m.set_value(i, i + 1, 1.5);
+      m.set_value(i + 1, i, -0.5);
+    }
+    if (i + 2 <= n) {
+      m.set_value(i, i + 2, -1.0);
+      m.set_value(i + 2, i, -1.2);
+    }
+  }
+  return m;
+}
+
+TEST_CASE("matrix storage bsr set and get value test", "[matrix_container]") {
+  matrix_storage_bsr<double, 2> m1(5, 5);
+  REQUIRE(m1.get_row() == 5);
+  REQUIRE(m1.get_block_row() == 3);
+  REQUIRE(value_equal(m1.get_value(5, 5), 0.0));
+  m1.set_value(5, 5, 2.5);
+  m1.set_value(1, 2, 1.5);
+  m1.add_value(1, 2, 1.0);
+  REQUIRE(m1.get_block_count() == 2);
+  REQUIRE(value_equal(m1.get_value(5, 5), 2.5));
+  REQUIRE(value_equal(m1.get_value(1, 2), 2.5));
+  REQUIRE(value_equal(m1.get_value(2, 1), 0.0));
+  REQUIRE(m1.get_nth_row_size(1) == 2);
+  REQUIRE(m1.get_nth_row_size(5) == 1);
+  m1.set_value(4, 4, 0.0);
+  REQUIRE(m1.get_block_count() == 2);
+}
+
+TEST_CASE("matrix bsr iterator and operator test", "[matrix]") {
+  auto a = bsr_test_matrix<bsr_matrix<double, 2>>(7);
+  auto c = bsr_test_matrix<matrix<matrix_storage_cep<double>>>(7);
+
+  SECTION("iterator") {
+    std::vector<double> nodes;
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        nodes.push_back(*col);
+      }
+    }
+    auto iter = nodes.begin();
+    for (auto row = a.begin(); row != a.end(); ++row) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        REQUIRE(col.column_index() <= 7);
+        REQUIRE(value_equal(*col, c.get_value(col.row_index(), col.column_index())));
+        if (value_equal(*col, 0.0) == false) {
+          REQUIRE(value_equal(*col, *iter));
+          ++iter;
+        }
+      }
+    }
+    REQUIRE(iter == nodes.end());
+  }
+
+  SECTION("block spmv") {
+    matrix<matrix_storage_cep<double>> x(7, 1);
+    for (size_type i = 1; i <= 7; ++i) {
+      x.set_value(i, 1, i * 0.3 - 1.0);
+    }
+    auto y1 = a * x;
+    auto y2 = c * x;
+    for (size_type i = 1; i <= 7; ++i) {
+      REQUIRE(value_equal(y1.get_value(i, 1), y2.get_value(i, 1)));
+    }
+  }
+
+  SECTION("add and transform") {
+    auto s = a + a;
+    REQUIRE(value_equal(s.get_value(7, 5), -2.4));
+    s.element_row_transform_swap(1, 7);
+    REQUIRE(value_equal(s.get_value(1, 5), -2.4));
+    REQUIRE(value_equal(s.get_value(7, 3), -2.0));
+    s.element_row_transform_plus(2, 1, 0.5);
+    REQUIRE(value_equal(s.get_value(2, 5), -1.2));
+  }
+
+  SECTION("resize and delete") {
+    a.delete_row(1);
+    REQUIRE(a.get_row() == 6);
+    REQUIRE(value_equal(a.get_value(1, 1), -0.5));
+    REQUIRE(value_equal(a.get_value(6, 7), 6.7));
+    a.delete_column(7);
+    REQUIRE(a.get_column() == 6);
+    REQUIRE(value_equal(a.get_value(6, 5), -1.2));
+    a.resize(4, 4);
+    REQUIRE(a.get_row() == 4);
+    REQUIRE(value_equal(a.get_value(2, 3), 6.3));
+    REQUIRE(value_equal(a.get_value(3, 4), 6.4));
+  }
+}
+
+TEST_CASE("bsr block jacobi and block ilu test", "[calculate]") {
+  auto a = bsr_test_matrix<bsr_matrix<double, 2>>(7);
+  std::vector<double> x(7);
+  for (size_type i = 0; i < 7; ++i) {
+    x[i] = 1.0 + i;
+  }
+  std::vector<double> b(7);
+  a.get_container().multiply(x.data(), b.data());
+
+  SECTION("block ilu0 is exact for block tridiagonal matrix") {
+    bsr_block_ilu0<double, 2> ilu(a);
+    REQUIRE(ilu.get_singular_block_row() == -1);
+    std::vector<double> z(7);
+    ilu.apply(b.data(), z.data());
+    for (size_type i = 0; i < 7; ++i) {
+      REQUIRE(value_equal(z[i], x[i]));
+    }
+    // the buffer of apply is reused.
+    std::vector<double> z2(7);
+    ilu.apply(b.data(), z2.data());
+    for (size_type i = 0; i < 7; ++i) {
+      REQUIRE(value_equal(z2[i], x[i]));
+    }
+  }
+
+  SECTION("singular diagonal blocks are reported") {
+    // the first diagonal block, rows and columns 1 and 2, becomes rank one.
+    a.set_value(1, 1, 1.0);
+    a.set_value(1, 2, 2.0);
+    a.set_value(2, 1, 2.0);
+    a.set_value(2, 2, 4.0);
+    bsr_block_jacobi<double, 2> jacobi(a);
+    REQUIRE(jacobi.get_singular_block_row() == 1);
+    std::vector<double> z(7);
+    jacobi.apply(b.data(), z.data());
+    REQUIRE(value_equal(z[0], b[0]));
+    REQUIRE(value_equal(z[1], b[1]));
+    bsr_block_ilu0<double, 2> ilu(a);
+    REQUIRE(ilu.get_singular_block_row() == 1);
+  }
+
+  SECTION("missing diagonal blocks are reported") {
+    // block row 2 holds only the blocks beside its diagonal.
+    bsr_matrix<double, 2> m(6, 6);
+    m.set_value(1, 1, 2.0);
+    m.set_value(2, 2, 2.0);
+    m.set_value(3, 1, 1.0);
+    m.set_value(4, 6, 1.0);
+    m.set_value(5, 5, 2.0);
+    m.set_value(6, 6, 2.0);
+    std::vector<double> r(6, 1.0);
+    std::vector<double> z(6);
+    bsr_block_jacobi<double, 2> jacobi(m);
+    REQUIRE(jacobi.get_singular_block_row() == 2);
+    bsr_block_ilu0<double, 2> ilu(m);
+    REQUIRE(ilu.get_singular_block_row() == 2);
+    ilu.apply(r.data(), z.data());
+    // z = U^-1 * L^-1 * r with the identity standing in for the missing pivot.
+    REQUIRE(value_equal(z[0], 0.5));
+    REQUIRE(value_equal(z[4], 0.5));
+    REQUIRE(value_equal(z[5], 0.5));
+    REQUIRE(value_equal(z[2], 0.5));
+    REQUIRE(value_equal(z[3], 0.5));
+  }
+
+  SECTION("block jacobi iteration") {
+    bsr_block_jacobi<double, 2> jacobi(a);
+    REQUIRE(jacobi.get_singular_block_row() == -1);
+    std::vector<double> xk(7, 0.0);
+    std::vector<double> r(7);
+    std::vector<double> z(7);
+    for (int it = 0; it < 200; ++it) {
+      a.get_container().multiply(xk.data(), r.data());
+      for (size_type i = 0; i < 7; ++i) {
+        r[i] = b[i] - r[i];
+      }
+      jacobi.apply(r.data(), z.data());
+      for (size_type i = 0; i < 7; ++i) {
+        xk[i] += z[i];
+      }
+    }
+    for (size_type i = 0; i < 7; ++i) {
+      REQUIRE(value_equal(xk[i], x[i]));
+    }
+  }
+}
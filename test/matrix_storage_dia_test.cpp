@@ -0,0 +1,114 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix_storage_dia.h"
+#include "../include/geometric_multigrid.h"
+#include "../include/gmres_solver.h"
+#include "../include/executor.h"
+#include "../include/value_compare.h"
+#include <cmath>
+
+using namespace pnmatrix;
+
+TEST_CASE("matrix storage dia set and get test", "[matrix_container]") {
+  dia_matrix<double> m(4, 5);
+  REQUIRE(m.get_element_count() == 0);
+  m.set_value(2, 2, 3.0);
+  m.set_value(1, 5, 7.0);
+  m.set_value(4, 1, -2.0);
+  m.set_value(3, 1, 0.0);
+  REQUIRE(m.get_container().get_diagonal_count() == 3);
+  REQUIRE(m.get_container().get_offset(0) == -3);
+  REQUIRE(m.get_container().get_offset(2) == 4);
+  REQUIRE(m.get_element_count() == 4 + 1 + 1);
+  REQUIRE(value_equal(m.get_value(2, 2), 3.0));
+  REQUIRE(value_equal(m.get_value(1, 5), 7.0));
+  REQUIRE(value_equal(m.get_value(4, 1), -2.0));
+  REQUIRE(value_equal(m.get_value(3, 3), 0.0));
+  REQUIRE(value_equal(m.get_value(3, 1), 0.0));
+  m.add_value(2, 2, 1.0);
+  REQUIRE(value_equal(m.get_value(2, 2), 4.0));
+  REQUIRE(m.get_nth_row_size(1) == 2);
+  REQUIRE(m.get_nth_row_size(4) == 2);
+
+  std::vector<size_type> columns;
+  for (auto row = m.begin(); row != m.end(); ++row) {
+    if (row.row_index() == 4) {
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        columns.push_back(col.column_index());
+      }
+    }
+  }
+  REQUIRE(columns == std::vector<size_type>{1, 4});
+}
+
+TEST_CASE("matrix storage dia from a stencil test", "[matrix_container]") {
+  grid_operator<double> g = grid_operator<double>::laplacian(6, 5, 3);
+  matrix<matrix_storage_cep<double>> m = g.assemble();
+  dia_matrix<double> d = to_dia_matrix(m);
+  REQUIRE(d.get_container().get_diagonal_count() == 7);
+  REQUIRE(d.get_element_count() >= m.get_element_count());
+  for (size_type i = 1; i <= m.get_row(); ++i) {
+    for (size_type j = 1; j <= m.get_column(); ++j) {
+      REQUIRE(value_equal(d.get_value(i, j), m.get_value(i, j)));
+    }
+  }
+  bool e = (d == to_dia_matrix(m));
+  REQUIRE(e == true);
+
+  dense_vector<double> x(m.get_row());
+  for (size_type i = 0; i < x.size(); ++i) {
+    x[i] = std::cos(double(i));
+  }
+  dense_vector<double> expect(m.get_row());
+  matrix_vector_multiply(m, x, expect);
+  dense_vector<double> y(m.get_row());
+  matrix_vector_multiply(d, x, y);
+  for (size_type i = 0; i < y.size(); ++i) {
+    REQUIRE(std::abs(y[i] - expect[i]) < 1e-12);
+  }
+}
+
+TEST_CASE("matrix storage dia rectangular multiply test", "[matrix_container]") {
+  matrix<matrix_storage_cep<double>> m(5, 3);
+  m.set_value(1, 3, 2.0);
+  m.set_value(2, 1, 1.0);
+  m.set_value(3, 3, -1.0);
+  m.set_value(5, 3, 4.0);
+  m.set_value(4, 2, 0.5);
+  dia_matrix<double> d = to_dia_matrix(m);
+  matrix<matrix_storage_cep<double>> x(3, 1);
+  x.set_value(1, 1, 1.0);
+  x.set_value(2, 1, 2.0);
+  x.set_value(3, 1, 3.0);
+  bool e = (d * x == m * x);
+  REQUIRE(e == true);
+}
+
+TEST_CASE("matrix storage dia spmv on an executor test", "[matrix_container]") {
+  thread_pool::option pool_op;
+  pool_op.thread_count = 3;
+  thread_pool pool(pool_op);
+  grid_operator<double> g = grid_operator<double>::laplacian(101, 97);
+  dia_matrix<double> d = to_dia_matrix(g.assemble());
+  dense_vector<double> x(g.size());
+  for (size_type i = 0; i < x.size(); ++i) {
+    x[i] = double(i % 17) - 8;
+  }
+  dense_vector<double> y1(g.size());
+  dense_vector<double> y2(g.size());
+  matrix_vector_multiply(d, x, y1);
+  matrix_vector_multiply(pool, d, x, y2);
+  for (size_type i = 0; i < x.size(); ++i) {
+    REQUIRE(value_equal(y1[i], y2[i]));
+  }
+
+  dense_vector<double> b(g.size(), 1.0);
+  dense_vector<double> sol(g.size());
+  gmres::option op;
+  op.rm = 1e-8;
+  op.exec = &pool;
+  gmres::workspace<double> ws;
+  solve_control control;
+  gmres(op).solve(d, b, sol, control, ws);
+  REQUIRE(control.get_status() == solve_status::converged);
+}
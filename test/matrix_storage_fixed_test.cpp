@@ -0,0 +1,119 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_fixed.h"
+#include "../include/matrix_storage_block.h"
+#include "../include/value_compare.h"
+
+using namespace pnmatrix;
+
+template <typename MatrixType>
+static MatrixType fixed_test_matrix() {
+  MatrixType m(3, 3);
+  m.set_value(1, 1, 2);
+  m.set_value(1, 2, 1);
+  m.set_value(1, 3, -1);
+  m.set_value(2, 1, -3);
+  m.set_value(2, 2, -1);
+  m.set_value(2, 3, 2);
+  m.set_value(3, 1, -2);
+  m.set_value(3, 2, 1);
+  m.set_value(3, 3, 2);
+  return m;
+}
+
+TEST_CASE("matrix storage fixed set and get value test", "[matrix_container]") {
+  matrix_storage_fixed<double, 2, 3> m1;
+  REQUIRE(m1.get_row() == 2);
+  REQUIRE(m1.get_column() == 3);
+  REQUIRE(value_equal(m1.get_value(2, 3), 0.0));
+  m1.set_value(2, 3, 1.5);
+  m1.add_value(2, 3, 0.25);
+  REQUIRE(value_equal(m1.get_value(2, 3), 1.75));
+  m1.element_row_transform_swap(1, 2);
+  REQUIRE(value_equal(m1.get_value(1, 3), 1.75));
+  m1.element_row_transform_multi(1, 2.0);
+  REQUIRE(value_equal(m1.get_value(1, 3), 3.5));
+  m1.element_row_transform_plus(2, 1, 0.5);
+  REQUIRE(value_equal(m1.get_value(2, 3), 1.75));
+  static_assert(matrix_storage_fixed<double, 2, 3>::row_count == 2, "");
+}
+
+TEST_CASE("fixed matrix operator test", "[matrix]") {
+  auto a = fixed_test_matrix<fixed_matrix<double, 3, 3>>();
+  auto ab = fixed_test_matrix<matrix<matrix_storage_block<double>>>();
+  fixed_matrix<double, 3, 1> x;
+  matrix<matrix_storage_block<double>> xb(3, 1);
+  for (size_type i = 1; i <= 3; ++i) {
+    x.set_value(i, 1, i * 0.5);
+    xb.set_value(i, 1, i * 0.5);
+  }
+
+  SECTION("multiply") {
+    auto y = a * x;
+    matrix<matrix_storage_block<double>> yb = ab * xb;
+    static_assert(std::is_same<decltype(y), fixed_matrix<double, 3, 1>>::value, "");
+    for (size_type i = 1; i <= 3; ++i) {
+      REQUIRE(value_equal(y.get_value(i, 1), yb.get_value(i, 1)));
+    }
+  }
+
+  SECTION("add sub and transposition") {
+    auto s = a + a - a;
+    bool e = (s == a);
+    REQUIRE(e == true);
+    auto t = tr(x);
+    static_assert(std::is_same<decltype(t), fixed_matrix<double, 1, 3>>::value, "");
+    REQUIRE(value_equal(t.get_value(1, 3), 1.5));
+  }
+
+  SECTION("expression templates") {
+    fixed_matrix<double, 3, 3> b = a * 2.0;
+    REQUIRE(value_equal(b.get_value(2, 1), -6.0));
+  }
+}
+
+TEST_CASE("fixed matrix lu inverse and qr test", "[calculate]") {
+  auto a = fixed_test_matrix<fixed_matrix<double, 3, 3>>();
+
+  SECTION("lu solve") {
+    fixed_matrix<double, 3, 3> lu;
+    std::array<size_type, 3> pivot;
+    REQUIRE(lu_decompose(a, lu, pivot) == true);
+    fixed_matrix<double, 3, 1> b;
+    b.set_value(1, 1, 8);
+    b.set_value(2, 1, -11);
+    b.set_value(3, 1, -3);
+    auto x = lu_solve(lu, pivot, b);
+    REQUIRE(value_equal(x.get_value(1, 1), 2.0));
+    REQUIRE(value_equal(x.get_value(2, 1), 3.0));
+    REQUIRE(value_equal(x.get_value(3, 1), -1.0));
+  }
+
+  SECTION("inverse") {
+    fixed_matrix<double, 3, 3> inv;
+    REQUIRE(inverse_with_lu(a, inv) == true);
+    bool e = (a * inv == fixed_matrix<double, 3, 3>::get_identity_matrix(3));
+    REQUIRE(e == true);
+    fixed_matrix<double, 2, 2> singular;
+    singular.set_value(1, 1, 1);
+    singular.set_value(1, 2, 2);
+    singular.set_value(2, 1, 2);
+    singular.set_value(2, 2, 4);
+    fixed_matrix<double, 2, 2> r;
+    REQUIRE(inverse_with_lu(singular, r) == false);
+  }
+
+  SECTION("qr") {
+    fixed_matrix<double, 4, 3> m;
+    for (size_type i = 1; i <= 4; ++i) {
+      for (size_type j = 1; j <= 3; ++j) {
+        m.set_value(i, j, (i == j ? 4.0 : 0.0) + i - j * 0.5);
+      }
+    }
+    auto qr = QR(m);
+    auto rebuilt = tr(qr.first) * qr.second;
+    bool e = (rebuilt == m);
+    REQUIRE(e == true);
+    REQUIRE(value_equal(qr.second.get_value(2, 1), 0.0));
+    REQUIRE(value_equal(qr.second.get_value(4, 3), 0.0));
+  }
+}
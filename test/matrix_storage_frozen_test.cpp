@@ -0,0 +1,170 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix_storage_frozen.h"
+#include "../include/gmres_solver.h"
+#include "../include/value_compare.h"
+#include "grid_matrix.h"
+#include <cmath>
+
+using namespace pnmatrix;
+
+static matrix<matrix_storage_cep<double>> frozen_test_matrix() {
+  matrix<matrix_storage_cep<double>> m(4, 4);
+  for (size_type i = 1; i <= 4; ++i) {
+    m.set_value(i, i, 4);
+    if (i > 1) {
+      m.set_value(i, i - 1, -1);
+    }
+    if (i < 4) {
+      m.set_value(i, i + 1, -1);
+    }
+  }
+  return m;
+}
+
+TEST_CASE("matrix storage frozen freeze pattern test", "[matrix_container]") {
+  auto m = frozen_test_matrix();
+  frozen_matrix<double> f = freeze_pattern(m);
+  bool e = (f == freeze_pattern(m));
+  REQUIRE(e == true);
+  REQUIRE(f.get_element_count() == 10);
+  REQUIRE(f.get_nth_row_size(1) == 2);
+  REQUIRE(f.get_nth_row_size(2) == 3);
+  const sparsity_pattern& p = f.get_container().get_pattern();
+  REQUIRE(p.find(2, 3) == p.row_begin(2) + 2);
+  REQUIRE(p.find(1, 4) == -1);
+  REQUIRE(p.get_diagonal_position(3) == p.find(3, 3));
+  for (size_type i = 1; i <= 4; ++i) {
+    for (size_type j = 1; j <= 4; ++j) {
+      REQUIRE(value_equal(f.get_value(i, j), m.get_value(i, j)));
+    }
+  }
+}
+
+TEST_CASE("matrix storage frozen keeps the pattern test", "[matrix_container]") {
+  frozen_matrix<double> f = freeze_pattern(frozen_test_matrix());
+  frozen_matrix<double> g = f;
+  REQUIRE(f.get_container().has_same_pattern(g.get_container()) == true);
+  REQUIRE(f.get_container().has_same_pattern(freeze_pattern(frozen_test_matrix()).get_container()) == false);
+  f.set_value(1, 2, 0.0);
+  REQUIRE(f.get_element_count() == 10);
+  f.add_value(1, 2, 2.5);
+  REQUIRE(value_equal(f.get_value(1, 2), 2.5));
+  f.set_value(1, 4, 0.0);
+  REQUIRE(value_equal(f.get_value(1, 4), 0.0));
+  f.get_container().fill(0);
+  REQUIRE(f.get_element_count() == 10);
+  REQUIRE(value_equal(f.get_value(3, 3), 0.0));
+}
+
+TEST_CASE("matrix storage frozen refill test", "[matrix_container]") {
+  frozen_matrix<double> f = freeze_pattern(frozen_test_matrix());
+  f.get_container().refill(4, [](size_type row, size_type column, double& v) {
+    v = row == column ? 2.0 * row : 1.0 / (row + column);
+  });
+  REQUIRE(value_equal(f.get_value(3, 3), 6.0));
+  REQUIRE(value_equal(f.get_value(3, 4), 1.0 / 7));
+  REQUIRE(value_equal(f.get_value(1, 3), 0.0));
+
+  double* values = f.get_container().get_values();
+  for (size_type i = 0; i < f.get_element_count(); ++i) {
+    values[i] = 1;
+  }
+  dense_vector<double> x(4, 1.0);
+  dense_vector<double> y(4);
+  matrix_vector_multiply(f, x, y);
+  REQUIRE(value_equal(y[0], 2.0));
+  REQUIRE(value_equal(y[1], 3.0));
+  REQUIRE(value_equal(y[3], 2.0));
+}
+
+TEST_CASE("matrix storage frozen solve after refill test", "[matrix_container]") {
+  auto m = frozen_test_matrix();
+  frozen_matrix<double> f = freeze_pattern(m);
+  f.get_container().refill(1, [](size_type row, size_type column, double& v) {
+    v = row == column ? 5.0 : -1.0;
+  });
+  matrix<matrix_storage_cep<double>> x_expect(4, 1);
+  x_expect.set_value(1, 1, 1);
+  x_expect.set_value(2, 1, 2);
+  x_expect.set_value(3, 1, 3);
+  x_expect.set_value(4, 1, 4);
+  dense_vector<double> rhs(4);
+  matrix_vector_multiply(f, to_dense_vector(x_expect), rhs);
+  gmres::option op;
+  op.rm = 1e-10;
+  gmres solver(op);
+  dense_vector<double> x(4);
+  gmres::workspace<double> ws;
+  solver.solve(f, rhs, x, ws);
+  for (size_type i = 0; i < 4; ++i) {
+    REQUIRE(value_equal(x[i], double(i + 1)));
+  }
+}
+
+TEST_CASE("matrix storage frozen sub matrix test", "[matrix_container]") {
+  // a storage without pattern could only hold zeros, the operations that need one do not compile.
+  static_assert(std::is_constructible<matrix_storage_frozen<double>, size_type, size_type>::value == false, "");
+  auto m = frozen_test_matrix();
+  frozen_matrix<double> f = freeze_pattern(m);
+  frozen_matrix<double> s = f.get_sub_matrix(2, 2, 2, 3);
+  REQUIRE(s.get_row() == 2);
+  REQUIRE(s.get_column() == 3);
+  REQUIRE(s.get_element_count() == 5);
+  for (size_type i = 1; i <= 2; ++i) {
+    for (size_type j = 1; j <= 3; ++j) {
+      REQUIRE(value_equal(s.get_value(i, j), m.get_value(i + 1, j + 1)));
+    }
+  }
+  REQUIRE(s.get_container().get_pattern().get_diagonal_position(2) == s.get_container().get_pattern().find(2, 2));
+  frozen_matrix<double> corner = f.get_sub_matrix(1, 1, 4, 1);
+  REQUIRE(corner.get_element_count() == 0);
+}
+
+TEST_CASE("frozen lu reuses the symbolic analysis test", "[matrix_container]") {
+  size_type k = 12;
+  size_type n = k * k;
+  frozen_matrix<double> f = freeze_pattern(grid_matrix(k));
+  dense_vector<double> r(n);
+  for (size_type i = 0; i < n; ++i) {
+    r[i] = std::sin(double(i)) + 1;
+  }
+  frozen_lu<double> ilu(f);
+  frozen_lu<double> lu(f, true);
+  for (double shift : {0.5, 2.0}) {
+    f.get_container().refill(1, [shift](size_type row, size_type column, double& v) {
+      v = row == column ? 4 + shift + double(row % 3) : -1.0;
+    });
+    ilu.factorize(f);
+    frozen_matrix<double> copy = f;
+    lu.factorize(copy);
+    REQUIRE(ilu.get_analysis_count() == 1);
+    REQUIRE(lu.get_analysis_count() == 1);
+    // the refactorization is the factorization from scratch.
+    frozen_lu<double> fresh(f);
+    dense_vector<double> z(n);
+    dense_vector<double> expect(n);
+    ilu.apply(r.data(), z.data());
+    fresh.apply(r.data(), expect.data());
+    for (size_type i = 0; i < n; ++i) {
+      REQUIRE(value_equal(z[i], expect[i]));
+    }
+    // with fill it solves exactly.
+    lu.apply(r.data(), z.data());
+    dense_vector<double> az(n);
+    matrix_vector_multiply(f, z, az);
+    for (size_type i = 0; i < n; ++i) {
+      REQUIRE(std::abs(az[i] - r[i]) < 1e-10);
+    }
+    gmres::option op;
+    op.rm = 1e-10;
+    gmres::workspace<double> ws;
+    dense_vector<double> x(n);
+    solve_control control;
+    gmres(op).solve(f, r, x, control, ws, ilu);
+    REQUIRE(control.get_status() == solve_status::converged);
+    REQUIRE(control.get_progress().iteration < 20);
+  }
+  ilu.factorize(freeze_pattern(grid_matrix(k)));
+  REQUIRE(ilu.get_analysis_count() == 2);
+}
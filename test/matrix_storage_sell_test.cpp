@@ -0,0 +1,148 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix_storage_sell.h"
+#include "../include/gmres_solver.h"
+#include "../include/executor.h"
+#include "../include/value_compare.h"
+#include <cmath>
+#include <limits>
+
+using namespace pnmatrix;
+
+// rows of irregular length : row i has i % 7 + 1 off diagonal elements spread over the columns.
+static matrix<matrix_storage_cep<double>> irregular_matrix(size_type n) {
+  matrix<matrix_storage_cep<double>> m(n, n);
+  for (size_type i = 1; i <= n; ++i) {
+    m.set_value(i, i, 10.0 + double(i % 5));
+    for (size_type k = 1; k <= i % 7 + 1; ++k) {
+      size_type j = (i * 37 + k * 101) % n + 1;
+      if (j != i) {
+        m.set_value(i, j, - 1.0 / double(k + 1));
+      }
+    }
+  }
+  return m;
+}
+
+TEST_CASE("matrix storage sell layout test", "[matrix_container]") {
+  matrix<matrix_storage_cep<double>> m = irregular_matrix(45);
+  sell_matrix<double> s = to_sell_matrix(m, 16);
+  REQUIRE(s.get_container().get_chunk_count() == 6);
+  REQUIRE(s.get_container().get_sigma() == 16);
+  REQUIRE(s.get_element_count() == m.get_element_count());
+  REQUIRE(s.get_container().get_padded_element_count() >= s.get_element_count());
+  for (size_type i = 1; i <= 45; ++i) {
+    REQUIRE(s.get_nth_row_size(i) == m.get_nth_row_size(i));
+    for (size_type j = 1; j <= 45; ++j) {
+      REQUIRE(value_equal(s.get_value(i, j), m.get_value(i, j)));
+    }
+  }
+  for (auto row = s.begin(); row != s.end(); ++row) {
+    size_type previous = 0;
+    for (auto col = row.begin(); col != row.end(); ++col) {
+      REQUIRE(col.column_index() > previous);
+      REQUIRE(value_equal(*col, m.get_value(row.row_index(), col.column_index())));
+      previous = col.column_index();
+    }
+  }
+  bool e = (s == to_sell_matrix(m, 1));
+  REQUIRE(e == true);
+
+  s.set_value(3, 3, 1.5);
+  s.add_value(3, 3, 1.0);
+  s.set_value(3, 4, 0.0);
+  REQUIRE(value_equal(s.get_value(3, 3), 2.5));
+  REQUIRE(s.get_element_count() == m.get_element_count());
+}
+
+TEST_CASE("matrix storage sell spmv test", "[matrix_container]") {
+  thread_pool::option pool_op;
+  pool_op.thread_count = 3;
+  thread_pool pool(pool_op);
+  for (size_type n : {1, 7, 8, 9, 300, 1001}) {
+    matrix<matrix_storage_cep<double>> m = irregular_matrix(n);
+    dense_vector<double> x(n);
+    for (size_type i = 0; i < n; ++i) {
+      x[i] = std::sin(double(i)) + 0.5;
+    }
+    dense_vector<double> expect(n);
+    matrix_vector_multiply(m, x, expect);
+    for (size_type sigma : {1, 32, 4096}) {
+      sell_matrix<double> s = to_sell_matrix(m, sigma);
+      dense_vector<double> y(n);
+      matrix_vector_multiply(s, x, y);
+      dense_vector<double> yt(n);
+      matrix_vector_multiply(pool, s, x, yt);
+      for (size_type i = 0; i < n; ++i) {
+        REQUIRE(std::abs(y[i] - expect[i]) < 1e-12);
+        REQUIRE(value_equal(y[i], yt[i]));
+      }
+    }
+    sell_matrix<double, 4> s4 = to_sell_matrix<4>(m);
+    dense_vector<double> y4(n);
+    matrix_vector_multiply(s4, x, y4);
+    for (size_type i = 0; i < n; ++i) {
+      REQUIRE(std::abs(y4[i] - expect[i]) < 1e-12);
+    }
+  }
+}
+
+TEST_CASE("matrix storage sell sub matrix test", "[matrix_container]") {
+  static_assert(std::is_constructible<matrix_storage_sell<double>, size_type, size_type>::value == false, "");
+  matrix<matrix_storage_cep<double>> m = irregular_matrix(45);
+  sell_matrix<double> s = to_sell_matrix(m, 16);
+  for (size_type first : {1, 2, 20}) {
+    sell_matrix<double> sub = s.get_sub_matrix(first, 17, 3, 30);
+    REQUIRE(sub.get_row() == 17);
+    REQUIRE(sub.get_column() == 30);
+    size_type count = 0;
+    for (size_type i = 1; i <= 17; ++i) {
+      for (size_type j = 1; j <= 30; ++j) {
+        REQUIRE(value_equal(sub.get_value(i, j), m.get_value(first + i - 1, j + 2)));
+        count += (m.get_container().get_value(first + i - 1, j + 2) != 0.0) ? 1 : 0;
+      }
+    }
+    REQUIRE(sub.get_element_count() == count);
+  }
+}
+
+TEST_CASE("matrix storage sell padding test", "[matrix_container]") {
+  // row 1 is the only one that reads x[0], rows 2 and 4 are padded inside its chunk and row 3 is empty.
+  matrix<matrix_storage_cep<double>> m(4, 4);
+  m.set_value(1, 1, 1.0);
+  m.set_value(1, 2, 1.0);
+  m.set_value(1, 3, 1.0);
+  m.set_value(2, 2, 2.0);
+  m.set_value(4, 4, 3.0);
+  sell_matrix<double> s = to_sell_matrix(m);
+  dense_vector<double> x(4, 1.0);
+  x[0] = std::numeric_limits<double>::quiet_NaN();
+  dense_vector<double> y(4);
+  matrix_vector_multiply(s, x, y);
+  REQUIRE(std::isnan(y[0]));
+  REQUIRE(value_equal(y[1], 2.0));
+  REQUIRE(value_equal(y[2], 0.0));
+  REQUIRE(value_equal(y[3], 3.0));
+}
+
+TEST_CASE("gmres on sell storage test", "[matrix_container]") {
+  size_type n = 500;
+  matrix<matrix_storage_cep<double>> m = irregular_matrix(n);
+  sell_matrix<double> s = to_sell_matrix(m);
+  dense_vector<double> expect(n);
+  for (size_type i = 0; i < n; ++i) {
+    expect[i] = double(i % 9) - 4;
+  }
+  dense_vector<double> b(n);
+  matrix_vector_multiply(m, expect, b);
+  gmres::option op;
+  op.rm = 1e-12;
+  gmres::workspace<double> ws;
+  dense_vector<double> x(n);
+  solve_control control;
+  gmres(op).solve(s, b, x, control, ws);
+  REQUIRE(control.get_status() == solve_status::converged);
+  for (size_type i = 0; i < n; ++i) {
+    REQUIRE(std::abs(x[i] - expect[i]) < 1e-8);
+  }
+}
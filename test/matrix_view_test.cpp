@@ -0,0 +1,82 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix.h"
+#include "../include/matrix_storage_block.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix_view.h"
+#include "../include/value_compare.h"
+
+using namespace pnmatrix;
+
+using dense_matrix = matrix<matrix_storage_block<double>>;
+
+static dense_matrix view_test_matrix() {
+  dense_matrix m(4, 5);
+  for (size_type i = 1; i <= 4; ++i) {
+    for (size_type j = 1; j <= 5; ++j) {
+      m.set_value(i, j, i * 10 + j);
+    }
+  }
+  return m;
+}
+
+TEST_CASE("dense matrix view test", "[matrix]") {
+  auto m = view_test_matrix();
+
+  SECTION("sub matrix view reads and writes the storage") {
+    auto v = m.get_sub_matrix_view(2, 2, 3, 3);
+    REQUIRE(v.get_row() == 2);
+    REQUIRE(v.get_column() == 3);
+    REQUIRE(value_equal(v.get_value(1, 1), 23.0));
+    REQUIRE(value_equal(v.get_value(2, 3), 35.0));
+    v.set_value(2, 2, -1.0);
+    REQUIRE(value_equal(m.get_value(3, 4), -1.0));
+  }
+
+  SECTION("column view in expression templates") {
+    const dense_matrix& cm = m;
+    auto col = cm.get_nth_column_view(2);
+    dense_matrix scaled = col * 2.0;
+    REQUIRE(scaled.get_row() == 4);
+    REQUIRE(scaled.get_column() == 1);
+    REQUIRE(value_equal(scaled.get_value(3, 1), 64.0));
+    dense_matrix row_vector(1, 4);
+    row_vector.set_value(1, 1, 1.0);
+    row_vector.set_value(1, 4, 1.0);
+    dense_matrix dot = row_vector * col;
+    REQUIRE(value_equal(dot.get_value(1, 1), 12.0 + 42.0));
+    dense_matrix sum = col + m.get_nth_column_view(1);
+    REQUIRE(value_equal(sum.get_value(2, 1), 22.0 + 21.0));
+  }
+
+  SECTION("set value from view") {
+    dense_matrix target(3, 3);
+    target.set_value_from_matrix(2, 2, m.get_sub_matrix_view(1, 2, 4, 2));
+    REQUIRE(value_equal(target.get_value(2, 2), 14.0));
+    REQUIRE(value_equal(target.get_value(3, 3), 25.0));
+    REQUIRE(value_equal(target.get_value(1, 1), 0.0));
+  }
+}
+
+TEST_CASE("sub matrix extraction test", "[matrix]") {
+  auto m = view_test_matrix();
+  auto sub = m.get_sub_matrix(2, 3, 2, 2);
+  REQUIRE(sub.get_row() == 3);
+  REQUIRE(sub.get_column() == 2);
+  REQUIRE(value_equal(sub.get_value(1, 1), 22.0));
+  REQUIRE(value_equal(sub.get_value(3, 2), 43.0));
+  auto col = m.get_nth_column(5);
+  REQUIRE(value_equal(col.get_value(4, 1), 45.0));
+
+  matrix<matrix_storage_cep<double>> s(5, 5);
+  s.set_value(1, 5, 1.5);
+  s.set_value(3, 2, 2.5);
+  s.set_value(3, 3, 3.5);
+  s.set_value(4, 3, 4.5);
+  auto ssub = s.get_sub_matrix(3, 2, 2, 2);
+  REQUIRE(ssub.get_element_count() == 3);
+  REQUIRE(value_equal(ssub.get_value(1, 1), 2.5));
+  REQUIRE(value_equal(ssub.get_value(2, 2), 4.5));
+  auto scol = s.get_nth_column(3);
+  REQUIRE(scol.get_element_count() == 2);
+  REQUIRE(value_equal(scol.get_value(4, 1), 4.5));
+}
@@ -0,0 +1,173 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix.h"
+#include "../include/reordering.h"
+#include "../include/gmres_solver.h"
+#include "../include/value_compare.h"
+#include "grid_matrix.h"
+#include <vector>
+#include <random>
+#include <algorithm>
+
+using namespace pnmatrix;
+using reorder_matrix = matrix<matrix_storage_cep<double>>;
+
+// 5 point laplacian of a k x k grid with the vertices numbered randomly.
+static reorder_matrix shuffled_grid(size_type k) {
+  std::vector<size_type> number(k * k);
+  for (size_type i = 0; i < k * k; ++i) {
+    number[i] = i + 1;
+  }
+  std::mt19937 gen(7);
+  std::shuffle(number.begin(), number.end(), gen);
+  return grid_matrix(k, 4, number);
+}
+
+static void require_permutation(const permutation& p, size_type n) {
+  REQUIRE(p.size() == n);
+  std::vector<bool> seen(n + 1, false);
+  for (size_type i = 1; i <= n; ++i) {
+    size_type old = p.get_old(i);
+    REQUIRE(old >= 1);
+    REQUIRE(old <= n);
+    REQUIRE(seen[old] == false);
+    seen[old] = true;
+    REQUIRE(p.get_new(old) == i);
+  }
+}
+
+TEST_CASE("reverse cuthill mckee reduces the bandwidth test", "[reordering]") {
+  reorder_matrix A = shuffled_grid(12);
+  permutation p = reverse_cuthill_mckee(A);
+  require_permutation(p, 144);
+  reorder_matrix B = permute(A, p);
+  REQUIRE(B.get_element_count() == A.get_element_count());
+  ordering_report report = get_ordering_report(A, B);
+  REQUIRE(report.bandwidth_after <= 2 * 12);
+  REQUIRE(report.bandwidth_after < report.bandwidth_before);
+  REQUIRE(report.profile_after < report.profile_before);
+  for (size_type i = 1; i <= 144; ++i) {
+    for (size_type j = 1; j <= 144; ++j) {
+      REQUIRE(value_equal(B.get_value(i, j), A.get_value(p.get_old(i), p.get_old(j))));
+    }
+  }
+}
+
+TEST_CASE("bandwidth and profile test", "[reordering]") {
+  reorder_matrix m(4, 4);
+  m.set_value(1, 1, 1);
+  m.set_value(2, 2, 1);
+  m.set_value(3, 1, 1);
+  m.set_value(4, 3, 1);
+  m.set_value(1, 4, 1);
+  REQUIRE(get_bandwidth(m) == 3);
+  REQUIRE(get_profile(m) == 3);
+}
+
+TEST_CASE("permute and unpermute vectors test", "[reordering]") {
+  permutation p(std::vector<size_type>{3, 1, 4, 2});
+  dense_vector<double> x(4);
+  for (size_type i = 0; i < 4; ++i) {
+    x[i] = double(i + 1);
+  }
+  dense_vector<double> y = permute_vector(x, p);
+  REQUIRE(value_equal(y[0], 3.0));
+  REQUIRE(value_equal(y[1], 1.0));
+  REQUIRE(value_equal(y[2], 4.0));
+  REQUIRE(value_equal(y[3], 2.0));
+  dense_vector<double> back = unpermute_vector(y, p);
+  for (size_type i = 0; i < 4; ++i) {
+    REQUIRE(value_equal(back[i], x[i]));
+  }
+  permutation q = p.inverse();
+  dense_vector<double> z = permute_vector(y, q);
+  for (size_type i = 0; i < 4; ++i) {
+    REQUIRE(value_equal(z[i], x[i]));
+  }
+}
+
+template <typename Ordering>
+static void solve_reordered_test(Ordering ordering) {
+  reorder_matrix A = shuffled_grid(8);
+  reorder_matrix b(64, 1);
+  for (size_type i = 1; i <= 64; ++i) {
+    b.set_value(i, 1, double(i % 7) + 1);
+  }
+  permutation p = ordering(A);
+  require_permutation(p, 64);
+  reorder_matrix B = permute(A, p);
+  reorder_matrix pb = permute_vector(b, p);
+  gmres::option op;
+  op.rm = 1e-12;
+  op.m = 64;
+  reorder_matrix x = unpermute_vector(gmres(op).solve(B, pb), p);
+  reorder_matrix expect = gmres(op).solve(A, b);
+  for (size_type i = 1; i <= 64; ++i) {
+    REQUIRE(std::abs(x.get_value(i, 1) - expect.get_value(i, 1)) < 1e-8);
+  }
+}
+
+TEST_CASE("solve a reordered system test", "[reordering]") {
+  solve_reordered_test([](const reorder_matrix& A) {
+    return reverse_cuthill_mckee(A);
+  });
+  solve_reordered_test([](const reorder_matrix& A) {
+    return nested_dissection(A, 4);
+  });
+}
+
+TEST_CASE("nested dissection orders the separator last test", "[reordering]") {
+  // a path 1 - 2 - ... - 9, any middle vertex separates it.
+  reorder_matrix m(9, 9);
+  for (size_type i = 1; i <= 9; ++i) {
+    m.set_value(i, i, 2);
+    if (i < 9) {
+      m.set_value(i, i + 1, -1);
+      m.set_value(i + 1, i, -1);
+    }
+  }
+  permutation p = nested_dissection(m, 2);
+  require_permutation(p, 9);
+  size_type last = p.get_old(9);
+  REQUIRE(last > 1);
+  REQUIRE(last < 9);
+  for (size_type i = 1; i < 9; ++i) {
+    size_type v = p.get_old(i);
+    REQUIRE(v != last);
+  }
+  // the vertices on one side of the separator come before all vertices on the other side.
+  size_type first_side = p.get_old(1) < last ? -1 : 1;
+  bool switched = false;
+  for (size_type i = 1; i < 9; ++i) {
+    size_type side = p.get_old(i) < last ? -1 : 1;
+    if (side != first_side) {
+      switched = true;
+    }
+    REQUIRE((switched == false || side != first_side) == true);
+  }
+}
+
+TEST_CASE("reordering disconnected graphs test", "[reordering]") {
+  reorder_matrix m(6, 6);
+  for (size_type i = 1; i <= 6; ++i) {
+    m.set_value(i, i, 1);
+  }
+  m.set_value(1, 5, 1);
+  m.set_value(5, 1, 1);
+  m.set_value(2, 6, 1);
+  m.set_value(6, 2, 1);
+  require_permutation(reverse_cuthill_mckee(m), 6);
+  require_permutation(nested_dissection(m, 1), 6);
+  REQUIRE(get_bandwidth(permute(m, reverse_cuthill_mckee(m))) == 1);
+
+  // many small components, each pair is its own part.
+  size_type n = 20000;
+  reorder_matrix pairs(n, n);
+  for (size_type i = 1; i <= n; i += 2) {
+    pairs.set_value(i, i, 1);
+    pairs.set_value(i + 1, i + 1, 1);
+    pairs.set_value(i, i + 1, 1);
+    pairs.set_value(i + 1, i, 1);
+  }
+  require_permutation(nested_dissection(pairs, 4), n);
+}
@@ -0,0 +1,144 @@
+#include "../third_party/catch.hpp"
+#include "../include/schwarz_preconditioner.h"
+#include "../include/gmres_solver.h"
+#include "../include/executor.h"
+#include "../include/value_compare.h"
+#include "grid_matrix.h"
+#include <vector>
+#include <cmath>
+
+using namespace pnmatrix;
+using schwarz_matrix = matrix<matrix_storage_cep<double>>;
+
+static thread_pool::option schwarz_pool_option(size_type n) {
+  thread_pool::option op;
+  op.thread_count = n;
+  return op;
+}
+
+TEST_CASE("additive schwarz with one exact subdomain is the inverse test", "[schwarz]") {
+  schwarz_matrix A = grid_matrix(6, 4.01);
+  additive_schwarz<double>::option op;
+  op.subdomains = 1;
+  op.exact = true;
+  additive_schwarz<double> M(A, op);
+  REQUIRE(M.get_subdomain_count() == 1);
+  REQUIRE(M.get_factor_element_count(0) > A.get_element_count());
+  dense_vector<double> r(36);
+  for (size_type i = 0; i < 36; ++i) {
+    r[i] = double(i % 5) - 2;
+  }
+  dense_vector<double> z(36);
+  M.apply(r.data(), z.data());
+  dense_vector<double> az(36);
+  matrix_vector_multiply(A, z, az);
+  for (size_type i = 0; i < 36; ++i) {
+    REQUIRE(std::abs(az[i] - r[i]) < 1e-10);
+  }
+}
+
+TEST_CASE("additive schwarz subdomains and overlap test", "[schwarz]") {
+  schwarz_matrix A = grid_matrix(8, 4.01);
+  additive_schwarz<double>::option op;
+  op.subdomains = 4;
+  additive_schwarz<double> block_jacobi(A, op);
+  REQUIRE(block_jacobi.get_subdomain_count() == 4);
+  size_type total = 0;
+  for (size_type s = 0; s < 4; ++s) {
+    total += block_jacobi.get_subdomain_size(s);
+  }
+  REQUIRE(total == 64);
+
+  op.overlap = 1;
+  additive_schwarz<double> overlapped(A, op);
+  // a row band of the grid grows by one grid row on each inner side.
+  REQUIRE(overlapped.get_subdomain_size(0) == block_jacobi.get_subdomain_size(0) + 8);
+  REQUIRE(overlapped.get_subdomain_size(1) == block_jacobi.get_subdomain_size(1) + 16);
+
+  // more subdomains than rows.
+  schwarz_matrix small = grid_matrix(2, 4.01);
+  op.subdomains = 10;
+  additive_schwarz<double> tiny(small, op);
+  REQUIRE(tiny.get_subdomain_count() == 4);
+}
+
+static size_type preconditioned_iterations(const schwarz_matrix& A, const additive_schwarz<double>* M, double& error) {
+  size_type n = A.get_row();
+  dense_vector<double> expect(n);
+  for (size_type i = 0; i < n; ++i) {
+    expect[i] = std::sin(double(i));
+  }
+  dense_vector<double> b(n);
+  matrix_vector_multiply(A, expect, b);
+  gmres::option op;
+  op.rm = 1e-10;
+  gmres solver(op);
+  gmres::workspace<double> ws;
+  dense_vector<double> x(n);
+  solve_control control;
+  if (M == nullptr) {
+    solver.solve(A, b, x, control, ws);
+  }
+  else {
+    solver.solve(A, b, x, control, ws, *M);
+  }
+  REQUIRE(control.get_status() == solve_status::converged);
+  error = 0;
+  for (size_type i = 0; i < n; ++i) {
+    error = std::max(error, std::abs(x[i] - expect[i]));
+  }
+  return control.get_progress().iteration;
+}
+
+TEST_CASE("gmres with an additive schwarz preconditioner test", "[schwarz]") {
+  schwarz_matrix A = grid_matrix(16, 4.01);
+  thread_pool pool(schwarz_pool_option(4));
+  double error = 0;
+  size_type plain = preconditioned_iterations(A, nullptr, error);
+  REQUIRE(error < 1e-7);
+
+  additive_schwarz<double>::option op;
+  op.exec = &pool;
+  additive_schwarz<double> block_jacobi(A, op);
+  REQUIRE(block_jacobi.get_subdomain_count() == 4);
+  size_type jacobi_iterations = preconditioned_iterations(A, &block_jacobi, error);
+  REQUIRE(error < 1e-7);
+  REQUIRE(jacobi_iterations < plain);
+
+  op.overlap = 2;
+  additive_schwarz<double> restricted(A, op);
+  size_type restricted_iterations = preconditioned_iterations(A, &restricted, error);
+  REQUIRE(error < 1e-7);
+  REQUIRE(restricted_iterations <= jacobi_iterations);
+
+  op.restricted = false;
+  op.exact = true;
+  additive_schwarz<double> summed(A, op);
+  preconditioned_iterations(A, &summed, error);
+  REQUIRE(error < 1e-7);
+}
+
+TEST_CASE("additive schwarz apply does not depend on the executor test", "[schwarz]") {
+  schwarz_matrix A = grid_matrix(10, 4.01);
+  thread_pool pool(schwarz_pool_option(3));
+  for (bool restricted : {true, false}) {
+    additive_schwarz<double>::option op;
+    op.subdomains = 5;
+    op.overlap = 1;
+    op.restricted = restricted;
+    additive_schwarz<double> serial(A, op);
+    op.exec = &pool;
+    additive_schwarz<double> threaded(A, op);
+    dense_vector<double> r(100);
+    for (size_type i = 0; i < 100; ++i) {
+      r[i] = double((i * 7) % 11);
+    }
+    dense_vector<double> z1(100);
+    dense_vector<double> z2(100);
+    serial.apply(r.data(), z1.data());
+    threaded.apply(r.data(), z2.data());
+    for (size_type i = 0; i < 100; ++i) {
+      REQUIRE(value_equal(z1[i], z2[i]));
+    }
+  }
+}
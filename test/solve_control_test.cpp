@@ -0,0 +1,134 @@
+#include "../third_party/catch.hpp"
+#include "../include/solve_control.h"
+#include "../include/matrix.h"
+#include "../include/matrix_storage_cep.h"
+#include "../include/jacobian_solver.h"
+#include "../include/gauss_seidel_solver.h"
+#include "../include/gmres_solver.h"
+#include "../include/value_compare.h"
+#include <chrono>
+#include <thread>
+
+using namespace pnmatrix;
+
+using sparse_matrix = matrix<matrix_storage_cep<double>>;
+
+// tridiagonal 4 -1, x = (1, 2, ..., n).
+static void control_test_system(size_type n, sparse_matrix& A, sparse_matrix& b) {
+  for (size_type i = 1; i <= n; ++i) {
+    A.set_value(i, i, 4.0);
+    double sum = 4.0 * i;
+    if (i > 1) {
+      A.set_value(i, i - 1, -1.0);
+      sum -= i - 1;
+    }
+    if (i < n) {
+      A.set_value(i, i + 1, -1.0);
+      sum -= i + 1;
+    }
+    b.set_value(i, 1, sum);
+  }
+}
+
+TEST_CASE("solve control test", "[solve_control]") {
+  solve_control control;
+  REQUIRE(control.get_status() == solve_status::running);
+  REQUIRE(control.next_iteration(3, 0.5) == true);
+  REQUIRE(control.get_progress().iteration == 3);
+  REQUIRE(value_equal(control.get_progress().residual, 0.5));
+  control.cancel();
+  REQUIRE(control.next_iteration(4, 0.25) == false);
+  REQUIRE(control.get_status() == solve_status::cancelled);
+  control.finish(solve_status::converged);
+  REQUIRE(control.get_status() == solve_status::cancelled);
+
+  solve_control late;
+  late.set_deadline(solve_control::clock::now() - std::chrono::seconds(1));
+  REQUIRE(late.next_iteration(1, 1.0) == false);
+  REQUIRE(late.get_status() == solve_status::deadline_exceeded);
+}
+
+TEST_CASE("solver max iteration and status test", "[solve_control]") {
+  sparse_matrix A(30, 30);
+  sparse_matrix b(30, 1);
+  control_test_system(30, A, b);
+
+  SECTION("jacobian") {
+    jacobian::option op;
+    op.rm = 1e-12;
+    op.max_iteration = 3;
+    solve_control control;
+    auto x = jacobian(op).solve(A, b, control);
+    REQUIRE(control.get_status() == solve_status::max_iteration_reached);
+    REQUIRE(control.get_progress().iteration == 3);
+    REQUIRE(x.get_row() == 30);
+  }
+
+  SECTION("gauss seidel") {
+    gauss_seidel::option op;
+    solve_control control;
+    auto x = gauss_seidel(op).solve(A, b, control);
+    REQUIRE(control.get_status() == solve_status::converged);
+    REQUIRE(std::abs(x.get_value(7, 1) - 7.0) < 1e-5);
+  }
+
+  SECTION("gmres") {
+    gmres::option op;
+    op.rm = 1e-14;
+    op.m = 5;
+    op.max_iteration = 4;
+    solve_control control;
+    auto x = gmres(op).solve(A, b, control);
+    REQUIRE(control.get_status() == solve_status::max_iteration_reached);
+    REQUIRE(control.get_progress().iteration == 4);
+    // the best iterate is returned, not the initial guess.
+    REQUIRE(std::abs(x.get_value(7, 1) - 7.0) < 1.0);
+  }
+}
+
+TEST_CASE("solve async test", "[solve_control]") {
+  sparse_matrix A(30, 30);
+  sparse_matrix b(30, 1);
+  control_test_system(30, A, b);
+
+  SECTION("runs to convergence") {
+    gmres::option op;
+    op.m = 10;
+    auto handle = solve_async(gmres(op), A, b);
+    auto x = handle.get();
+    REQUIRE(handle.get_status() == solve_status::converged);
+    REQUIRE(std::abs(x.get_value(30, 1) - 30.0) < 1e-4);
+  }
+
+  SECTION("cancelled before it starts") {
+    auto control = std::make_shared<solve_control>();
+    control->cancel();
+    jacobian::option op;
+    op.rm = -1;
+    auto handle = solve_async(jacobian(op), A, b, control);
+    REQUIRE(handle.wait_for(std::chrono::seconds(10)) == true);
+    auto x = handle.get();
+    REQUIRE(handle.get_status() == solve_status::cancelled);
+    REQUIRE(handle.get_progress().iteration == 1);
+  }
+
+  SECTION("deadline returns the best iterate") {
+    auto control = std::make_shared<solve_control>();
+    control->set_timeout(std::chrono::milliseconds(20));
+    jacobian::option op;
+    op.rm = -1;
+    auto handle = solve_async(jacobian(op), A, b, control);
+    auto x = handle.get();
+    REQUIRE(handle.get_status() == solve_status::deadline_exceeded);
+    size_type iteration = handle.get_progress().iteration;
+    REQUIRE(iteration >= 1);
+    // however far it got, x is the iterate of the last finished iteration.
+    op.max_iteration = iteration;
+    solve_control reference;
+    auto expect = jacobian(op).solve(A, b, reference);
+    REQUIRE(reference.get_status() == solve_status::max_iteration_reached);
+    for (size_type i = 1; i <= 30; ++i) {
+      REQUIRE(value_equal(x.get_value(i, 1), expect.get_value(i, 1)));
+    }
+  }
+}
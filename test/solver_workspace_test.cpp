@@ -0,0 +1,140 @@
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix.h"
+#include "../include/jacobian_solver.h"
+#include "../include/gauss_seidel_solver.h"
+#include "../include/gmres_solver.h"
+#include "../include/value_compare.h"
+#include "../include/allocator.h"
+
+#include "../third_party/catch.hpp"
+
+/*
+ * 8   -3    2     3      20
+ * 4   11   -1  *  2  ==  33
+ * 6   3    12     1      36
+ */
+
+using namespace pnmatrix;
+using workspace_matrix = matrix<matrix_storage_cep<double>>;
+
+static workspace_matrix workspace_test_matrix() {
+  workspace_matrix m(3, 3);
+  m.set_value(1, 1, 8);
+  m.set_value(1, 2, -3);
+  m.set_value(1, 3, 2);
+  m.set_value(2, 1, 4);
+  m.set_value(2, 2, 11);
+  m.set_value(2, 3, -1);
+  m.set_value(3, 1, 6);
+  m.set_value(3, 2, 3);
+  m.set_value(3, 3, 12);
+  return m;
+}
+
+static workspace_matrix workspace_test_vector(double a, double b, double c) {
+  workspace_matrix v(3, 1);
+  v.set_value(1, 1, a);
+  v.set_value(2, 1, b);
+  v.set_value(3, 1, c);
+  return v;
+}
+
+static void require_solution(const workspace_matrix& x) {
+  REQUIRE(value_equal(x.get_value(1, 1), 3.0));
+  REQUIRE(value_equal(x.get_value(2, 1), 2.0));
+  REQUIRE(value_equal(x.get_value(3, 1), 1.0));
+}
+
+template <typename Solver>
+static void exact_initial_guess_test(Solver solver) {
+  workspace_matrix m = workspace_test_matrix();
+  workspace_matrix b = workspace_test_vector(20, 33, 36);
+  workspace_matrix x0 = workspace_test_vector(3, 2, 1);
+  solve_control control;
+  workspace_matrix x = solver.solve(m, b, x0, control);
+  require_solution(x);
+  REQUIRE(control.get_status() == solve_status::converged);
+  REQUIRE(control.get_progress().iteration <= 1);
+}
+
+TEST_CASE("solvers start from the initial guess", "[workspace]") {
+  jacobian::option jop;
+  jop.rm = 1e-6;
+  exact_initial_guess_test(jacobian(jop));
+  gauss_seidel::option sop;
+  sop.rm = 1e-6;
+  exact_initial_guess_test(gauss_seidel(sop));
+  gmres::option gop;
+  gop.rm = 1e-6;
+  exact_initial_guess_test(gmres(gop));
+}
+
+TEST_CASE("solvers continue from a stopped solve", "[workspace]") {
+  workspace_matrix m = workspace_test_matrix();
+  workspace_matrix b = workspace_test_vector(20, 33, 36);
+  jacobian::option op;
+  op.rm = 1e-6;
+  op.max_iteration = 3;
+  jacobian solver(op);
+  solve_control first;
+  workspace_matrix x = solver.solve(m, b, first);
+  REQUIRE(first.get_status() == solve_status::max_iteration_reached);
+  jacobian::option rest;
+  rest.rm = 1e-6;
+  solve_control second;
+  x = jacobian(rest).solve(m, b, x, second);
+  require_solution(x);
+  REQUIRE(second.get_status() == solve_status::converged);
+}
+
+// the solver workspaces and vectors allocate through the library allocators, the tracker sees them.
+template <typename Solve>
+static size_type count_allocations(Solve f) {
+  allocation_tracker tracker;
+  f();
+  return tracker.get_count();
+}
+
+TEST_CASE("repeated solves with a workspace do not allocate", "[workspace]") {
+  workspace_matrix m = workspace_test_matrix();
+  dense_vector<double> b = to_dense_vector(workspace_test_vector(20, 33, 36));
+  dense_vector<double> x(3);
+
+  jacobian::option jop;
+  jop.rm = 1e-6;
+  jacobian jsolver(jop);
+  jacobian::workspace<double> jws;
+  jsolver.solve(m, b, x, jws);
+  REQUIRE(count_allocations([&]() {
+    for (int i = 0; i < 10; ++i) {
+      x.fill(0);
+      jsolver.solve(m, b, x, jws);
+    }
+  }) == 0);
+  require_solution(to_matrix<workspace_matrix>(x));
+
+  gauss_seidel::option sop;
+  sop.rm = 1e-6;
+  gauss_seidel ssolver(sop);
+  REQUIRE(count_allocations([&]() {
+    for (int i = 0; i < 10; ++i) {
+      x.fill(0);
+      ssolver.solve(m, b, x);
+    }
+  }) == 0);
+  require_solution(to_matrix<workspace_matrix>(x));
+
+  gmres::option gop;
+  gop.rm = 1e-10;
+  gop.m = 2;
+  gmres gsolver(gop);
+  gmres::workspace<double> gws;
+  gsolver.solve(m, b, x, gws);
+  REQUIRE(count_allocations([&]() {
+    for (int i = 0; i < 10; ++i) {
+      x.fill(0);
+      gsolver.solve(m, b, x, gws);
+    }
+  }) == 0);
+  require_solution(to_matrix<workspace_matrix>(x));
+}
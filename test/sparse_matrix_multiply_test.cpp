@@ -0,0 +1,103 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix_storage_block.h"
+#include "../include/matrix.h"
+#include "../include/sparse_matrix_multiply.h"
+#include "../include/value_compare.h"
+
+using namespace pnmatrix;
+
+using sparse_matrix = matrix<matrix_storage_cep<double>>;
+using dense_matrix = matrix<matrix_storage_block<double>>;
+
+template <typename MatrixType>
+static MatrixType spgemm_test_matrix(size_type row, size_type column, size_type seed) {
+  MatrixType m(row, column);
+  for (size_type i = 1; i <= row; ++i) {
+    for (size_type j = 1; j <= column; ++j) {
+      if ((i * 7 + j * 3 + seed) % 4 == 0 || i == j) {
+        m.set_value(i, j, (i + j + seed) * 0.25 - 2.0);
+      }
+    }
+  }
+  return m;
+}
+
+template <typename M1, typename M2>
+static bool same_values(const M1& m1, const M2& m2) {
+  if (m1.get_row() != m2.get_row() || m1.get_column() != m2.get_column()) {
+    return false;
+  }
+  for (size_type i = 1; i <= m1.get_row(); ++i) {
+    for (size_type j = 1; j <= m1.get_column(); ++j) {
+      if (value_equal(m1.get_value(i, j), m2.get_value(i, j)) == false) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+TEST_CASE("spgemm test", "[calculate]") {
+  auto a = spgemm_test_matrix<sparse_matrix>(9, 7, 1);
+  auto b = spgemm_test_matrix<sparse_matrix>(7, 11, 2);
+  auto da = spgemm_test_matrix<dense_matrix>(9, 7, 1);
+  auto db = spgemm_test_matrix<dense_matrix>(7, 11, 2);
+  dense_matrix expect = da * db;
+
+  SECTION("single thread") {
+    auto c = spgemm(a, b);
+    REQUIRE(same_values(c, expect));
+    for (auto row = c.begin(); row != c.end(); ++row) {
+      size_type last = 0;
+      for (auto col = row.begin(); col != row.end(); ++col) {
+        REQUIRE(col.column_index() > last);
+        last = col.column_index();
+      }
+    }
+  }
+
+  SECTION("multi thread") {
+    auto c = spgemm(a, b, 4);
+    REQUIRE(same_values(c, expect));
+  }
+
+  SECTION("operator *") {
+    sparse_matrix c = a * b;
+    REQUIRE(same_values(c, expect));
+  }
+}
+
+TEST_CASE("spgemm plan test", "[calculate]") {
+  auto a = spgemm_test_matrix<sparse_matrix>(8, 8, 3);
+  auto b = spgemm_test_matrix<sparse_matrix>(8, 8, 5);
+  spgemm_plan<double> plan(a, b, 2);
+  REQUIRE(plan.get_element_count() == spgemm(a, b).get_element_count());
+
+  // same pattern, new values.
+  a.every_nozero_element([](typename sparse_matrix::column_iterator it)->void {
+    *it = *it * 2 + 1;
+  });
+  auto c = plan.multiply(a, b, 3);
+  REQUIRE(c.get_element_count() == plan.get_element_count());
+  REQUIRE(same_values(c, spgemm(a, b)));
+}
+
+TEST_CASE("galerkin product test", "[calculate]") {
+  auto a = spgemm_test_matrix<sparse_matrix>(6, 6, 1);
+  sparse_matrix p(6, 3);
+  for (size_type i = 1; i <= 6; ++i) {
+    p.set_value(i, (i + 1) / 2, 1.0);
+  }
+  auto r = tr(p);
+  auto coarse = galerkin_product(r, a, p);
+  REQUIRE(coarse.get_row() == 3);
+  REQUIRE(coarse.get_column() == 3);
+  double sum = 0;
+  for (size_type i = 1; i <= 2; ++i) {
+    for (size_type j = 1; j <= 2; ++j) {
+      sum += a.get_value(i, j);
+    }
+  }
+  REQUIRE(value_equal(coarse.get_value(1, 1), sum));
+}
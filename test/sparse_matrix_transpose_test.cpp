@@ -0,0 +1,68 @@
+#include "../third_party/catch.hpp"
+#include "../include/matrix_storage_cep.h"
+#include "../include/matrix.h"
+#include "../include/sparse_matrix_transpose.h"
+#include "../include/value_compare.h"
+
+using namespace pnmatrix;
+
+using sparse_matrix = matrix<matrix_storage_cep<double>>;
+
+static sparse_matrix transpose_test_matrix(size_type row, size_type column) {
+  sparse_matrix m(row, column);
+  for (size_type i = 1; i <= row; ++i) {
+    for (size_type j = 1; j <= column; ++j) {
+      if ((i * 5 + j * 3) % 7 < 2) {
+        m.set_value(i, j, i * 1.5 - j * 0.25 + 0.1);
+      }
+    }
+  }
+  return m;
+}
+
+TEST_CASE("sparse transpose test", "[matrix]") {
+  auto m = transpose_test_matrix(13, 9);
+
+  SECTION("tr") {
+    auto t = tr(m);
+    REQUIRE(t.get_row() == 9);
+    REQUIRE(t.get_column() == 13);
+    REQUIRE(t.get_element_count() == m.get_element_count());
+    for (size_type i = 1; i <= 13; ++i) {
+      for (size_type j = 1; j <= 9; ++j) {
+        REQUIRE(value_equal(t.get_value(j, i), m.get_value(i, j)));
+      }
+    }
+    bool e = (tr(t) == m);
+    REQUIRE(e == true);
+  }
+
+  SECTION("parallel transpose") {
+    auto t = transpose(m, 5);
+    bool e = (t == tr(m));
+    REQUIRE(e == true);
+  }
+}
+
+TEST_CASE("csc view test", "[matrix]") {
+  auto m = transpose_test_matrix(11, 8);
+  csc_view<double> serial(m);
+  csc_view<double> parallel(m, 4);
+  REQUIRE(serial.get_element_count() == m.get_element_count());
+  REQUIRE(serial.column_ptr() == parallel.column_ptr());
+  REQUIRE(serial.row_indices() == parallel.row_indices());
+  for (size_type j = 1; j <= 8; ++j) {
+    size_type last = 0;
+    size_type count = 0;
+    parallel.for_each_in_column(j, [&](size_type row, const double& v) {
+      REQUIRE(row > last);
+      REQUIRE(value_equal(v, m.get_value(row, j)));
+      last = row;
+      ++count;
+    });
+    REQUIRE(count == serial.get_nth_column_size(j));
+    for (size_type i = 1; i <= 11; ++i) {
+      REQUIRE(value_equal(serial.get_value(i, j), m.get_value(i, j)));
+    }
+  }
+}